@@ -0,0 +1,70 @@
+// Multi document inserts into an existing collection go through the batched insert path
+// (bulkInsertFastPath).  Check that they end the same as inserting one document at a time.
+
+var coll = db.bulkInsertFastPath;
+
+function run( fastPath ) {
+    assert.commandWorked( db.adminCommand( { setParameter : 1, bulkInsertFastPath : fastPath } ) );
+
+    coll.drop();
+    coll.insert( { a : 0 } );
+    coll.ensureIndex( { a : 1 }, { unique : true } );
+    coll.ensureIndex( { b : 1 } );
+
+    // stops at the duplicate
+    coll.insert( [ { a : 1 }, { a : 2 }, { a : 1 }, { a : 3 } ] );
+    var gle = db.getLastErrorObj();
+    assert.eq( 11000, gle.code, tojson( gle ) );
+    assert.eq( [ 0, 1, 2 ], coll.find().sort( { a : 1 } ).map( function( x ) { return x.a; } ) );
+
+    // continueOnError skips it; the first of two equal keys in a batch wins
+    coll.insert( [ { a : 4 }, { a : 2 }, { a : 5, b : 1 }, { a : 5, b : 2 }, { a : 6 } ], 1 );
+    assert.eq( 11000, db.getLastErrorObj().code );
+    assert.eq( [ 0, 1, 2, 4, 5, 6 ],
+               coll.find().sort( { a : 1 } ).map( function( x ) { return x.a; } ) );
+    assert.eq( 1, coll.findOne( { a : 5 } ).b );
+    // the documents taken back out are not in the other indexes
+    assert.eq( 0, coll.find( { b : 2 } ).hint( { b : 1 } ).itcount() );
+
+    // a document refused before the insert stops the batch too
+    coll.insert( [ { a : 7 }, { a : 8, $bad : 1 }, { a : 9 } ], 0, true );
+    assert( db.getLastError() );
+    assert.eq( 1, coll.find( { a : { $gte : 7 } } ).itcount() );
+
+    // a document whose keys can't be generated stops the batch, and is in no index
+    coll.ensureIndex( { c : 1, d : 1 } );
+    coll.insert( [ { a : 20, c : 1 }, { a : 21, c : [ 1, 2 ], d : [ 1, 2 ] }, { a : 22, c : 1 } ] );
+    assert.eq( 10088, db.getLastErrorObj().code );
+    coll.insert( [ { a : 23, c : 1 }, { a : 24, c : [ 1, 2 ], d : [ 1, 2 ] }, { a : 25, c : 1 } ],
+                 1 );
+    assert.eq( 10088, db.getLastErrorObj().code );
+    assert.eq( [ 20, 23, 25 ], coll.find( { a : { $gte : 20, $lt : 30 } } ).sort( { a : 1 } ).map(
+                   function( x ) { return x.a; } ) );
+    assert.eq( 3, coll.find( { c : 1 } ).hint( { c : 1, d : 1 } ).itcount() );
+    assert.eq( 3, coll.find( { a : { $gte : 20, $lt : 30 } } ).hint( { a : 1 } ).itcount() );
+
+    // _id added and indexed, multikey noted
+    coll.insert( [ { a : 10, b : [ 1, 2 ] }, { a : 11 } ] );
+    assert.isnull( db.getLastError() );
+    assert( coll.findOne( { a : 10 } )._id );
+    assert.eq( 1, coll.find( { _id : coll.findOne( { a : 11 } )._id } ).hint( { _id : 1 } ).itcount() );
+    assert( coll.find( { b : 1 } ).hint( { b : 1 } ).explain().isMultiKey );
+
+    // a batch larger than one allocation run
+    var big = new Array( 4000 ).join( "x" );
+    var docs = [];
+    for ( var i = 0; i < 1000; i++ ) {
+        docs.push( { a : 100 + i, s : big } );
+    }
+    coll.insert( docs );
+    assert.isnull( db.getLastError() );
+    assert.eq( 1000, coll.find( { a : { $gte : 100 } } ).hint( { a : 1 } ).itcount() );
+
+    assert( coll.validate( true ).valid );
+    return coll.find().sort( { a : 1 } ).map( function( x ) { return [ x.a, x.b ]; } );
+}
+
+assert.eq( run( false ), run( true ) );
+
+db.adminCommand( { setParameter : 1, bulkInsertFastPath : true } );
+coll.drop();
@@ -0,0 +1,80 @@
+// Online compaction moves records out of sparse extents in small batches and frees the emptied
+// extents, leaving documents and indexes intact.
+
+t = db.jstests_compact_online;
+t.drop();
+
+var big = new Array( 200 ).join( 'a' );
+for( var i = 0; i < 5000; ++i ) {
+    t.insert( { _id:i, x:i, s:big } );
+}
+t.ensureIndex( { x:1 } );
+assert( !db.getLastError() );
+
+// Leave every tenth document, so every extent is sparse.
+t.remove( { _id:{ $not:{ $mod:[ 10, 0 ] } } } );
+assert.eq( 500, t.count() );
+
+var before = t.stats();
+assert.gt( before.numExtents, 2 );
+
+var res = t.runCommand( "compact", { online:true, batchSize:50, sleepMillis:0 } );
+printjson( res );
+assert.commandWorked( res );
+assert.gt( res.extentsFreed, 0 );
+assert.gt( res.recordsMoved, 0 );
+
+var after = t.stats();
+assert.eq( 500, after.count );
+assert.lt( after.numExtents, before.numExtents );
+assert.lt( after.storageSize, before.storageSize );
+assert( t.validate( true ).valid );
+
+// Indexes point at the moved documents.
+assert.eq( 500, t.find().hint( { x:1 } ).itcount() );
+assert.eq( 500, t.find().hint( { _id:1 } ).itcount() );
+for( var i = 0; i < 5000; i += 10 ) {
+    assert.eq( i, t.findOne( { x:i } )._id );
+}
+
+// Bad throttling knobs are rejected.
+assert.commandFailed( t.runCommand( "compact", { online:true, batchSize:0 } ) );
+assert.commandFailed( t.runCommand( "compact", { online:true, maxExtentFill:2 } ) );
+
+// A run killed partway through an extent puts the space of the records it moved out of it back
+// on the deleted lists.  All the space of the extents is then in records, deleted records and
+// extent headers, as before.
+t.drop();
+for( var i = 0; i < 5000; ++i ) {
+    t.insert( { _id:i, s:big } );
+}
+// sparse extents at the front, and room for their records in the extents behind them
+t.remove( { _id:{ $lt:2500, $not:{ $mod:[ 10, 0 ] } } } );
+t.remove( { _id:{ $gte:2500, $mod:[ 3, 0 ] } } );
+assert( !db.getLastError() );
+var nLeft = t.count();
+
+function unaccountedPerExtent() {
+    var v = t.validate( true );
+    var s = t.stats();
+    return ( s.storageSize - v.bytesWithHeaders - v.deletedSize ) / s.numExtents;
+}
+var extentHeader = unaccountedPerExtent();
+
+var killer = startParallelShell(
+    'var op;' +
+    'assert.soon( function() {' +
+    '    op = db.currentOp().inprog.filter( function( x ) {' +
+    '        return x.query && x.query.compact == "jstests_compact_online";' +
+    '    } )[ 0 ];' +
+    '    return op && op.progress && op.progress.done >= 10;' +
+    '} );' +
+    'db.killOp( op.opid );' );
+res = t.runCommand( "compact", { online:true, batchSize:1, sleepMillis:20 } );
+killer();
+assert.commandFailed( res );
+
+assert.eq( extentHeader, unaccountedPerExtent() );
+assert( t.validate( true ).valid );
+assert.eq( nLeft, t.count() );
+assert.eq( nLeft, t.find().hint( { _id:1 } ).itcount() );
@@ -0,0 +1,28 @@
+// serverStatus reports data file allocation, including time spent waiting for it.
+
+var port = allocatePorts( 1 )[ 0 ];
+var baseName = "jstests_disk_file_allocator_stats";
+
+var m = startMongod( "--port", port, "--dbpath", "/data/db/" + baseName, "--nohttpinterface",
+                     "--bind_ip", "127.0.0.1", "--smallfiles",
+                     "--setParameter", "fileAllocatorThreads=3" );
+var db = m.getDB( baseName );
+
+var stats = db.serverStatus().fileAllocator;
+printjson( stats );
+assert.eq( 3, stats.threads );
+
+var big = new Array( 8000 ).join( 'x' );
+for( var i = 0; i < 10000; ++i ) {
+    db.big.insert( { s:big } );
+}
+assert( !db.getLastError() );
+
+stats = db.serverStatus().fileAllocator;
+printjson( stats );
+assert.gt( stats.filesAllocated, 2 );
+assert.gt( stats.bytesAllocated, 0 );
+assert.gt( stats.waits, 0 ); // the first files are never preallocated
+assert.gte( stats.wait_ms, 0 );
+
+stopMongod( port );
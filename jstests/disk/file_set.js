@@ -0,0 +1,70 @@
+// Collections and indexes created with a fileSet allocate their extents only in files under
+// fileset.<name> in the database directory.
+
+var port = allocatePorts( 1 )[ 0 ];
+var baseName = "jstests_disk_file_set";
+var dbpath = "/data/db/" + baseName + "/";
+
+var m = startMongod( "--port", port, "--dbpath", dbpath, "--nohttpinterface",
+                     "--bind_ip", "127.0.0.1", "--smallfiles" );
+var db = m.getDB( baseName );
+
+function dataFiles( dir ) {
+    var names = [];
+    listFiles( dir ).forEach( function( f ) {
+                                  if ( !f.isDirectory &&
+                                       new RegExp( "/" + baseName + "\\.[0-9]+$" ).test( f.name ) ) {
+                                      names.push( f.name );
+                                  }
+                              } );
+    return names;
+}
+
+// Bad names are rejected.
+assert.commandFailed( db.runCommand( { create:"bad", fileSet:"../x" } ) );
+assert.commandFailed( db.runCommand( { create:"bad", fileSet:5 } ) );
+db.bad2.ensureIndex( { a:1 }, { fileSet:"a/b" } );
+assert( db.getLastError() );
+
+assert.commandWorked( db.runCommand( { create:"hot", fileSet:"fast" } ) );
+db.cold.insert( { a:1 } );
+var big = new Array( 1000 ).join( 'x' );
+for( var i = 0; i < 20000; ++i ) {
+    db.hot.insert( { _id:i, a:i, s:big } );
+}
+db.hot.ensureIndex( { a:1 }, { fileSet:"fastidx" } );
+assert( !db.getLastError() );
+
+assert.eq( "fast", db.hot.stats().fileSet );
+assert.eq( undefined, db.cold.stats().fileSet );
+
+assert.gt( dataFiles( dbpath + "fileset.fast" ).length, 0 );
+assert.eq( 1, dataFiles( dbpath + "fileset.fastidx" ).length );
+
+// The files are found again after a restart.
+stopMongod( port );
+m = startMongodNoReset( "--port", port, "--dbpath", dbpath, "--nohttpinterface",
+                        "--bind_ip", "127.0.0.1", "--smallfiles" );
+db = m.getDB( baseName );
+assert.eq( 20000, db.hot.count() );
+assert.eq( 20000, db.hot.find().hint( { a:1 } ).itcount() );
+assert.eq( 1, db.cold.count() );
+assert( db.hot.validate( true ).valid );
+
+// More extents of the collection go to its set only.
+var defaultFiles = dataFiles( dbpath ).length;
+var fastFiles = dataFiles( dbpath + "fileset.fast" ).length;
+for( var i = 20000; i < 60000; ++i ) {
+    db.hot.insert( { _id:i, a:i, s:big } );
+}
+assert( !db.getLastError() );
+assert.gt( dataFiles( dbpath + "fileset.fast" ).length, fastFiles );
+assert.eq( defaultFiles, dataFiles( dbpath ).length );
+
+// Dropping the database removes the files of all sets.
+db.dropDatabase();
+assert.eq( 0, dataFiles( dbpath + "fileset.fast" ).length );
+assert.eq( 0, dataFiles( dbpath + "fileset.fastidx" ).length );
+assert.eq( 0, dataFiles( dbpath ).length );
+
+stopMongod( port );
@@ -0,0 +1,40 @@
+/* a group commit of more than 1MB is journaled as a batch of sections compressed in parallel.
+   check that one is recovered whole after a hard kill.
+*/
+
+var path = "/data/db/batched_sections";
+
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur", "--smallfiles",
+                            "--durOptions", 8);
+var d = conn.getDB("test");
+
+var big = new Array(64 * 1024).join("x");
+for (var i = 0; i < 64; i++) {
+    d.foo.insert({ _id: i, s: big + i });
+}
+d.getLastError(1, 0, /*j*/true);
+
+// stats are for the previous 3 second interval
+var batched = 0;
+assert.soon(function () {
+    batched += d.serverStatus().dur.batchedSections;
+    return batched > 0;
+}, "no batched sections", 10000, 1000);
+
+print("kill -9 mongod");
+stopMongod(30001, /*signal*/9);
+
+// we must replay the journal from the beginning
+removeFile(path + "/journal/lsn");
+
+conn = startMongodNoReset("--port", 30002, "--dbpath", path, "--dur", "--smallfiles",
+                          "--durOptions", 8);
+d = conn.getDB("test");
+assert.eq(64, d.foo.count());
+for (var i = 0; i < 64; i++) {
+    assert.eq(big + i, d.foo.findOne({ _id: i }).s);
+}
+assert(d.foo.validate(true).valid);
+
+stopMongod(30002);
+print("SUCCESS batched_sections.js");
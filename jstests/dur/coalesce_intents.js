@@ -0,0 +1,31 @@
+/* the same bytes written many times in a group commit are journaled once.  dur.coalescedMB
+   counts what merging the write intents saved.
+*/
+
+var path = "/data/db/coalesce_intents";
+
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur", "--smallfiles",
+                            "--durOptions", 8, "--journalCommitInterval", 100);
+var d = conn.getDB("test");
+d.foo.insert({ _id: 1, n: 0, s: new Array(1024).join("x") });
+d.foo.ensureIndex({ n: 1 });
+d.getLastError();
+
+// stats are for the previous 3 second interval
+var saved = 0;
+var n = 0;
+var start = new Date();
+while (new Date() - start < 10000 && saved == 0) {
+    for (var i = 0; i < 1000; i++) {
+        d.foo.update({ _id: 1 }, { $inc: { n: 1 } });
+    }
+    n += 1000;
+    assert.isnull(d.getLastError());
+    saved += d.serverStatus().dur.coalescedMB;
+}
+assert.gt(saved, 0, "no write intents coalesced");
+assert.eq(n, d.foo.findOne().n);
+assert.eq(1, d.foo.find({ n: n }).hint({ n: 1 }).itcount());
+
+stopMongod(30001);
+print("SUCCESS coalesce_intents.js");
@@ -0,0 +1,38 @@
+/* journal sections written with each journalCompressor are recovered after a hard kill,
+   including a journal where the codec changed midway.
+*/
+
+var path = "/data/db/journal_compressor";
+
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur", "--smallfiles",
+                            "--durOptions", 8, "--setParameter", "journalCompressor=none");
+var d = conn.getDB("test");
+var a = d.adminCommand({ getParameter: 1, journalCompressor: 1 });
+assert.eq("none", a.journalCompressor);
+assert.commandFailed(d.adminCommand({ setParameter: 1, journalCompressor: "zip" }));
+
+var n = 0;
+["none", "snappy", "zstd", "none"].forEach(function (codec) {
+    assert.commandWorked(d.adminCommand({ setParameter: 1, journalCompressor: codec }));
+    for (var i = 0; i < 500; i++) {
+        d.foo.insert({ _id: n++, codec: codec, s: "abcdefghijklmnopqrstuvwxyz" });
+    }
+    d.getLastError(1, 0, /*j*/true);
+});
+
+print("kill -9 mongod");
+stopMongod(30001, /*signal*/9);
+
+// we must replay the journal from the beginning
+removeFile(path + "/journal/lsn");
+
+conn = startMongodNoReset("--port", 30002, "--dbpath", path, "--dur", "--smallfiles",
+                          "--durOptions", 8);
+d = conn.getDB("test");
+assert.eq(n, d.foo.count());
+assert.eq(500, d.foo.count({ codec: "snappy" }));
+assert.eq(500, d.foo.count({ codec: "zstd" }));
+assert(d.foo.validate(true).valid);
+
+stopMongod(30002);
+print("SUCCESS journal_compressor.js");
@@ -0,0 +1,53 @@
+/* journal files retired after a data file flush are renamed into prealloc.<n> and taken back at
+   the next rotation.  the stale sections left in them must not be replayed after a hard kill.
+*/
+
+var path = "/data/db/recycle_journal_files";
+
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--dur", "--smallfiles",
+                            "--nopreallocj", "--syncdelay", 1, "--durOptions", 8,
+                            "--setParameter", "journalCompressor=none");
+var d = conn.getDB("test");
+
+function journalFiles(prefix) {
+    return listFiles(path + "/journal").filter(function (f) {
+        return f.baseName.indexOf(prefix) == 0;
+    });
+}
+
+// each smallfiles journal file holds 128MB.  overwrite the same documents so the data files
+// stay small while the journal rotates several times.
+var big = new Array(1024 * 1024).join("x");
+var pass = 0;
+var start = new Date();
+while (new Date() - start < 120000 && (pass < 4 || journalFiles("prealloc.").length == 0)) {
+    for (var i = 0; i < 100; i++) {
+        d.foo.save({ _id: i, pass: pass, s: big + i });
+    }
+    d.getLastError(1, 0, /*j*/true);
+    pass++;
+}
+assert.gt(journalFiles("prealloc.").length, 0, "no journal file recycled");
+printjson(d.serverStatus().dur);
+
+// write into a recycled file
+for (var n = 0; n < 2; n++) {
+    for (var i = 0; i < 100; i++) {
+        d.foo.save({ _id: i, pass: pass, s: big + i });
+    }
+    d.getLastError(1, 0, /*j*/true);
+    pass++;
+}
+
+print("kill -9 mongod");
+stopMongod(30001, /*signal*/9);
+
+conn = startMongodNoReset("--port", 30002, "--dbpath", path, "--dur", "--smallfiles",
+                          "--durOptions", 8);
+d = conn.getDB("test");
+assert.eq(100, d.foo.count());
+assert.eq(100, d.foo.count({ pass: pass - 1 }));
+assert(d.foo.validate(true).valid);
+
+stopMongod(30002);
+print("SUCCESS recycle_journal_files.js");
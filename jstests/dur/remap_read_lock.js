@@ -0,0 +1,39 @@
+/* remapping the private views is done in a read lock, except on windows and solaris:
+   readers are not stopped by it.  checks the dur stats for remaps under write load, and that
+   the data read back through the remapped views with DurParanoid is right.
+*/
+
+var path = "/data/db/remap_read_lock";
+var port = 30001;
+
+// DurParanoid (8) + DurAlwaysRemap (32)
+var conn = startMongodEmpty("--port", port, "--dbpath", path, "--dur", "--smallfiles",
+                            "--durOptions", 8 + 32, "--journalCommitInterval", 10);
+var d = conn.getDB("test");
+
+d.foo.insert({ _id : -1 });
+d.getLastError();
+
+// long enough for the stats to rotate (every 3 seconds) with remaps in the interval reported
+var start = new Date();
+var i = 0;
+while (new Date() - start < 8000) {
+    for (var j = 0; j < 100; j++) {
+        d.foo.insert({ _id : i++, x : "abcdefghijklmnopqrstuvwxyz" });
+    }
+    d.foo.update({ _id : -1 }, { $set : { n : i } });
+    assert.isnull(d.getLastError());
+    assert.eq(i, d.foo.findOne({ _id : -1 }).n);
+}
+
+var dur = d.serverStatus().dur;
+printjson(dur);
+assert(dur.commits > 0, "no commits");
+assert("remapPause" in dur.timeMs, "no remapPause");
+if (!_isWindows() && getBuildInfo().sysInfo.indexOf("SunOS") < 0) {
+    assert.eq(0, dur.remapsInWriteLock, "remap in write lock");
+    assert.eq(0, dur.timeMs.remapPause, "remap pause");
+}
+
+assert.eq(i + 1, d.foo.count());
+stopMongod(port);
@@ -0,0 +1,83 @@
+// Collections created with inMemory:true keep their records out of the data files.
+
+var t = db.jstests_in_memory_collection;
+t.drop();
+
+// In memory collections must be temp, so they are dropped at startup.
+assert.commandFailed( db.runCommand( { create:t.getName(), inMemory:true } ) );
+assert.commandFailed( db.runCommand( { create:t.getName(), inMemory:true, temp:true,
+                                       capped:true, size:4096 } ) );
+
+assert.commandWorked( db.runCommand( { create:t.getName(), inMemory:true, temp:true } ) );
+
+for( var i = 0; i < 1000; ++i ) {
+    t.insert( { _id:i, a:i % 10, s:"x" } );
+}
+t.ensureIndex( { a:1 } );
+assert( !db.getLastError() );
+
+assert.eq( 1000, t.count() );
+assert.eq( 1000, t.find().itcount() );
+assert.eq( 100, t.find( { a:3 } ).itcount() );
+assert.eq( 100, t.find( { a:3 } ).hint( { a:1 } ).itcount() );
+
+// Natural order is insertion order, both ways.
+assert.eq( 0, t.find().sort( { $natural:1 } ).limit( 1 ).next()._id );
+assert.eq( 999, t.find().sort( { $natural:-1 } ).limit( 1 ).next()._id );
+
+// In place updates and updates that move the record.
+t.update( { _id:5 }, { $set:{ b:1 } } );
+t.update( { _id:6 }, { $set:{ s:new Array( 1000 ).join( 'y' ) } } );
+assert( !db.getLastError() );
+assert.eq( 1, t.findOne( { _id:5 } ).b );
+assert.eq( 999, t.findOne( { _id:6 } ).s.length );
+assert.eq( 1000, t.find().itcount() );
+
+t.remove( { a:{ $lt:5 } } );
+assert( !db.getLastError() );
+assert.eq( 500, t.count() );
+assert.eq( 500, t.find().itcount() );
+assert.eq( 0, t.find( { a:3 } ).hint( { a:1 } ).itcount() );
+
+assert.commandFailed( t.validate() );
+assert.commandFailed( db.runCommand( { compact:t.getName() } ) );
+
+t.drop();
+assert.eq( 0, t.find().itcount() );
+
+// Closing the database drops in memory collections, whose records are gone with it.
+assert.commandWorked( db.runCommand( { create:t.getName(), inMemory:true, temp:true } ) );
+for( var i = 0; i < 100; ++i ) {
+    t.insert( { _id:i, a:i } );
+}
+t.ensureIndex( { a:1 } );
+assert( !db.getLastError() );
+assert.commandWorked( db.getSisterDB( "admin" ).runCommand( { closeAllDatabases:1 } ) );
+assert.eq( 0, t.find().itcount() );
+assert.eq( 0, t.find( { a:3 } ).hint( { _id:1 } ).itcount() );
+assert.eq( 0, db.system.namespaces.count( { name:t.getFullName() } ) );
+t.insert( { _id:0 } );
+assert( !db.getLastError() );
+assert.eq( 1, t.find( { _id:0 } ).itcount() );
+t.drop();
+
+// The incremental collection of map/reduce can be kept in memory too.
+var m = db.jstests_in_memory_collection_mr;
+m.drop();
+for( var i = 0; i < 1000; ++i ) {
+    m.insert( { k:i % 7 } );
+}
+var admin = db.getSisterDB( "admin" );
+assert.commandWorked( admin.runCommand( { setParameter:1, mrInMemoryIncrementalCollection:true } ) );
+try {
+    var res = m.mapReduce( function() { emit( this.k, 1 ); },
+                           function( k, vals ) { return Array.sum( vals ); },
+                           { out:"jstests_in_memory_collection_mr_out" } );
+    assert.commandWorked( res );
+    assert.eq( 7, res.find().itcount() );
+    res.drop();
+}
+finally {
+    admin.runCommand( { setParameter:1, mrInMemoryIncrementalCollection:false } );
+}
+m.drop();
@@ -85,4 +85,4 @@ function textWithIndexVersion(version) {
     t.dropIndex(indexName);
 }
 
-[0, 1].map(textWithIndexVersion);
+[0, 1, 2].map(textWithIndexVersion);
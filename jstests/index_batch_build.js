@@ -0,0 +1,46 @@
+// The index specs of a collection inserted together into system.indexes are built from one scan
+// of it.  Check that they are all built, and that one failing leaves the others unbuilt.
+
+var t = db.jstests_index_batch_build;
+t.drop();
+
+for (var i = 0; i < 1000; i++) {
+    t.insert({a: i, b: [i, i + 1], c: i % 10});
+}
+assert.isnull(db.getLastError());
+
+db.system.indexes.insert([{ns: t.getFullName(), key: {a: 1}, name: "a_1", unique: true},
+                          {ns: t.getFullName(), key: {b: 1}, name: "b_1"},
+                          {ns: t.getFullName(), key: {c: -1}, name: "c_-1"}]);
+assert.isnull(db.getLastError());
+assert.eq(4, t.getIndexes().length);
+
+var v = t.validate(true);
+assert(v.valid, tojson(v));
+assert.eq(1000, v.keysPerIndex[t.getFullName() + ".$a_1"]);
+assert.eq(2000, v.keysPerIndex[t.getFullName() + ".$b_1"]);
+assert.eq(1000, v.keysPerIndex[t.getFullName() + ".$c_-1"]);
+
+assert.eq(1, t.find({a: 5}).hint({a: 1}).itcount());
+assert.eq(2, t.find({b: 5}).hint({b: 1}).itcount());
+assert.eq(100, t.find({c: 5}).hint({c: -1}).itcount());
+assert(t.find({b: 5}).hint({b: 1}).explain().isMultiKey);
+
+// c has duplicates, so neither index is built
+db.system.indexes.insert([{ns: t.getFullName(), key: {a: 1, c: 1}, name: "a_1_c_1"},
+                          {ns: t.getFullName(), key: {c: 1}, name: "c_1", unique: true}]);
+assert.neq(null, db.getLastError());
+assert.eq(4, t.getIndexes().length);
+assert.eq(null, db.system.namespaces.findOne({name: t.getFullName() + ".$a_1_c_1"}));
+
+// specs of indexes that exist already are not counted as inserted
+db.system.profile.drop();
+db.setProfilingLevel(2);
+db.system.indexes.insert([{ns: t.getFullName(), key: {b: 1}, name: "b_1"},
+                          {ns: t.getFullName(), key: {a: 1, b: 1}, name: "a_1_b_1"}]);
+assert.isnull(db.getLastError());
+db.setProfilingLevel(0);
+assert.eq(5, t.getIndexes().length);
+var op = db.system.profile.findOne({op: "insert", ns: db.getName() + ".system.indexes"});
+assert(op, tojson(db.system.profile.find().toArray()));
+assert.eq(1, op.ninserted, tojson(op));
@@ -0,0 +1,97 @@
+// v:2 indexes store their keys prefix compressed.  Check that they answer queries as v:1 indexes
+// do, in less space, whether keys are inserted one at a time or the index is built.
+
+t = db.jstests_index_v2;
+u = db.jstests_index_v2_v1;
+t.drop();
+u.drop();
+
+t.ensureIndex( {tenant:1, path:1}, {v:2} );
+u.ensureIndex( {tenant:1, path:1}, {v:1} );
+assert.eq( 2, t.getIndexes().filter( function( x ) { return x.name == "tenant_1_path_1"; } )[ 0 ].v );
+
+function fill( c ) {
+    for( var i = 0; i < 5000; ++i ) {
+        c.insert( {_id:i, tenant:"tenant" + ( i % 7 ),
+                   path:"/projects/alpha/documents/2013/07/report-" + ( i * 7919 % 5000 )} );
+    }
+    assert.isnull( db.getLastError() );
+}
+
+function check() {
+    assert( t.validate( true ).valid );
+    assert.eq( u.count(), t.find().hint( {tenant:1, path:1} ).itcount() );
+    ["tenant0", "tenant3", "tenant6"].forEach( function( tenant ) {
+        var q = {tenant:tenant, path:{$gte:"/projects/alpha/documents/2013/07/report-2",
+                                      $lt:"/projects/alpha/documents/2013/07/report-4"}};
+        [1, -1].forEach( function( dir ) {
+            var s = {tenant:dir, path:dir};
+            var ids = function( c ) {
+                return c.find( q, {_id:1} ).sort( s ).hint( {tenant:1, path:1} ).map(
+                    function( x ) { return x._id; } );
+            };
+            var expected = ids( u );
+            assert.gt( expected.length, 0 );
+            assert.eq( expected, ids( t ), tenant + " " + dir );
+        } );
+    } );
+    var v2 = t.stats().indexSizes.tenant_1_path_1;
+    var v1 = u.stats().indexSizes.tenant_1_path_1;
+    assert.lt( v2, v1, "v:2 index not smaller" );
+}
+
+// inserted key by key
+fill( t );
+fill( u );
+check();
+
+t.remove( {_id:{$mod:[3, 0]}} );
+u.remove( {_id:{$mod:[3, 0]}} );
+assert.isnull( db.getLastError() );
+check();
+
+// built bottom up
+t.dropIndex( {tenant:1, path:1} );
+u.dropIndex( {tenant:1, path:1} );
+t.ensureIndex( {tenant:1, path:1}, {v:2} );
+u.ensureIndex( {tenant:1, path:1}, {v:1} );
+assert.isnull( db.getLastError() );
+check();
+
+// unique v:2 index
+t.ensureIndex( {path:1}, {v:2, unique:true} );
+assert.isnull( db.getLastError() );
+t.insert( {path:t.findOne( {}, {path:1} ).path} );
+assert.eq( 11000, db.getLastErrorObj().code );
+
+// keys not in compact form: long strings, subdocuments, NaN and large longs
+t.drop();
+u.drop();
+t.ensureIndex( {a:1, b:1}, {v:2} );
+u.ensureIndex( {a:1, b:1}, {v:1} );
+var long = new Array( 300 ).join( "x" );
+[t, u].forEach( function( c ) {
+    for( var i = 0; i < 2000; ++i ) {
+        var a = [long + ( i % 20 ), {x:i % 20, y:long}, NaN,
+                 NumberLong( "9007199254740993" )][ i % 4 ];
+        c.insert( {_id:i, a:a, b:long + i} );
+    }
+} );
+assert.isnull( db.getLastError() );
+assert( t.validate( true ).valid );
+[1, -1].forEach( function( dir ) {
+    var keys = function( c ) {
+        return c.find().sort( {a:dir, b:dir} ).hint( {a:1, b:1} )
+                ._addSpecial( "$returnKey", true ).toArray();
+    };
+    var expected = keys( u );
+    assert.eq( 2000, expected.length );
+    assert.eq( expected, keys( t ), "direction " + dir );
+} );
+assert.eq( u.find( {a:{x:3, y:long}} ).hint( {a:1, b:1} ).itcount(),
+           t.find( {a:{x:3, y:long}} ).hint( {a:1, b:1} ).itcount() );
+assert.eq( 100, t.find( {a:long + 4, b:{$gte:long}} ).hint( {a:1, b:1} ).itcount() );
+
+// no such version
+t.ensureIndex( {x:1}, {v:3} );
+assert( db.getLastError() );
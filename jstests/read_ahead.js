@@ -0,0 +1,61 @@
+// Collection scans with extent read-ahead return the same documents as without it.
+
+var t = db.jstests_read_ahead;
+t.drop();
+
+db.createCollection( t.getName(), { size:4096 } );
+var big = new Array( 2000 ).join( 'x' );
+for( var i = 0; i < 500; ++i ) {
+    t.insert( { _id:i, s:big } );
+}
+assert( !db.getLastError() );
+assert.gt( t.stats().numExtents, 4 );
+
+function scanIds( reverse ) {
+    var ids = [];
+    t.find( {}, { _id:1 } ).sort( { $natural:reverse ? -1 : 1 } ).forEach( function( o ) {
+                                                                            ids.push( o._id ); } );
+    return ids;
+}
+
+var forward = scanIds( false );
+var backward = scanIds( true );
+
+var old = db.adminCommand( { setParameter:1, collectionScanReadAheadExtents:3 } );
+assert.commandWorked( old );
+try {
+    assert.eq( forward, scanIds( false ) );
+    assert.eq( backward, scanIds( true ) );
+
+    // Through the collection scan stage, with the number of extents given per scan.
+    var res = db.runCommand( { stageDebug:{ cscan:{ args:{ name:t.getName(), direction:1,
+                                                           readAhead:2 } } } } );
+    assert.commandWorked( res );
+    assert.eq( 500, res.results.length );
+
+    // A capped collection that has looped is scanned from the middle of its extents, going on
+    // from the other end of them.
+    var c = db.jstests_read_ahead_capped;
+    c.drop();
+    db.createCollection( c.getName(), { capped:true, size:8192, $nExtents:8 } );
+    for( var i = 0; i < 200; ++i ) {
+        c.insert( { _id:i, s:big } );
+    }
+    assert( !db.getLastError() );
+    var n = c.count();
+    assert.lt( n, 200 );
+    var ids = c.find().sort( { $natural:1 } ).toArray().map( function( o ) { return o._id; } );
+    assert.eq( n, ids.length );
+    assert.eq( 199, ids[ n - 1 ] );
+    var reversed = c.find().sort( { $natural:-1 } ).toArray().map( function( o ) {
+                                                                       return o._id; } );
+    assert.eq( ids.reverse(), reversed );
+
+    var metrics = db.serverStatus().metrics.readAhead;
+    printjson( metrics );
+    assert( metrics );
+    assert.gt( metrics.extentsQueued, 0 );
+}
+finally {
+    db.adminCommand( { setParameter:1, collectionScanReadAheadExtents:old.was } );
+}
@@ -0,0 +1,49 @@
+// reclaimFreeSpace gives the space of freed extents back to the OS and leaves the database usable.
+
+var testDb = db.getSisterDB( "jstests_reclaim_free_space" );
+testDb.dropDatabase();
+
+// Everything that stays is allocated before the big collection, so its extents fill the
+// trailing data files alone.  Dropping a collection first creates the $freelist, which would
+// otherwise get an extent after the big collection's when that is dropped.
+testDb.first.insert( { a:1 } );
+testDb.first.drop();
+testDb.small.insert( { a:1 } );
+for( var i = 0; i < 10; ++i ) {
+    testDb.cursors.insert( { _id:i } );
+}
+assert( !testDb.getLastError() );
+
+var big = new Array( 4000 ).join( 'a' );
+var t = testDb.big;
+for( var i = 0; i < 20000; ++i ) {
+    t.insert( { _id:i, s:big } );
+}
+assert( !testDb.getLastError() );
+var fileSize = testDb.stats().fileSize;
+
+t.drop();
+
+var cursor = testDb.cursors.find().batchSize( 2 );
+cursor.next();
+
+var res = testDb.runCommand( { reclaimFreeSpace:1 } );
+printjson( res );
+assert.commandWorked( res );
+assert.gt( res.filesRemoved, 0 );
+assert.gt( res.bytesReleased, 0 );
+assert.lt( testDb.stats().fileSize, fileSize );
+
+// Removing files kills the cursors of the database, which could have been left in them.
+assert.throws( function() { cursor.itcount(); } );
+
+// Freed extents are still reusable after their space was released.
+for( var i = 0; i < 2000; ++i ) {
+    t.insert( { _id:i, s:big } );
+}
+assert( !testDb.getLastError() );
+assert.eq( 2000, t.count() );
+assert.eq( 1, testDb.small.count() );
+assert( testDb.runCommand( { validate:"big", full:true } ).valid );
+
+testDb.dropDatabase();
@@ -0,0 +1,81 @@
+// With uniqueIndexBloomFilters set, lookups in unique and _id indexes of keys an index certainly
+// doesn't hold skip its btree, and a secondary applies a replicated insert whose _id isn't there as
+// an insert rather than an upsert.  Check that the data and the duplicate key checks are unchanged.
+
+var replTest = new ReplSetTest({name: "unique_key_filter", nodes: 2,
+                                nodeOptions: {setParameter: "uniqueIndexBloomFilters=true"}});
+replTest.startSet();
+replTest.initiate();
+var primary = replTest.getMaster();
+var t = primary.getDB("test").unique_key_filter;
+
+function filterStats(conn) {
+    return conn.getDB("admin").serverStatus().metrics.index.uniqueKeyFilter;
+}
+
+t.ensureIndex({a: 1}, {unique: true});
+for (var i = 0; i < 5000; i++) {
+    t.insert({_id: i, a: i});
+}
+assert.isnull(t.getDB().getLastError());
+replTest.awaitReplication();
+
+// the secondary built a filter of its _id index and ruled out most of the _ids with it
+var secondary = replTest.getSecondary();
+secondary.setSlaveOk();
+var s = secondary.getDB("test").unique_key_filter;
+assert.eq(5000, s.count());
+assert.eq(5000, s.find().hint({a: 1}).itcount());
+var stats = filterStats(secondary);
+assert.gte(stats.builds, 1, tojson(stats));
+assert.gt(stats.misses, 4000, tojson(stats));
+
+// updates changing a key of the unique index check it against the filter of the index first
+t.update({_id: 1}, {$set: {a: 2}});
+assert.neq(null, t.getDB().getLastError());
+t.update({_id: 1}, {$set: {a: -1}});
+assert.isnull(t.getDB().getLastError());
+t.insert({_id: 5000, a: 3});
+assert.neq(null, t.getDB().getLastError());
+t.insert({_id: 3, a: 5000});
+assert.neq(null, t.getDB().getLastError());
+stats = filterStats(primary);
+assert.gte(stats.lookups, 2, tojson(stats));
+assert.gte(stats.misses, 1, tojson(stats));
+
+// a key the filter learned from an insert is not ruled out
+t.insert({_id: 5001, a: 5001});
+t.update({_id: 2}, {$set: {a: 5001}});
+assert.neq(null, t.getDB().getLastError());
+
+replTest.awaitReplication();
+assert.eq(t.find().sort({_id: 1}).toArray(), s.find().sort({_id: 1}).toArray());
+assert.eq(1, s.find({a: -1}).hint({a: 1}).itcount());
+
+replTest.stopSet();
+
+// indexes with more keys than uniqueIndexBloomFilterMaxKeys get no filter, and true and false keys
+// are told apart by a filter
+var conn = startMongodEmpty("--port", 30001, "--dbpath", MongoRunner.dataPath + "unique_key_filter",
+                            "--setParameter", "uniqueIndexBloomFilters=true",
+                            "--setParameter", "uniqueIndexBloomFilterMaxKeys=100");
+var b = conn.getDB("test").unique_key_filter_bound;
+b.ensureIndex({a: 1}, {unique: true});
+b.insert({_id: 0, a: true});
+b.insert({_id: 1, a: false});
+assert.isnull(b.getDB().getLastError());
+b.insert({_id: 2, a: true});
+assert.neq(null, b.getDB().getLastError());
+stats = filterStats(conn);
+assert.gte(stats.builds, 2, tojson(stats));
+for (var i = 3; i < 200; i++) {
+    b.insert({_id: i, a: i});
+}
+b.dropIndex({a: 1});
+var built = filterStats(conn).builds;
+b.insert({_id: 200});
+b.insert({_id: 1});
+assert.neq(null, b.getDB().getLastError());
+assert.eq(built, filterStats(conn).builds);
+assert.eq(200, b.count());
+stopMongod(30001);
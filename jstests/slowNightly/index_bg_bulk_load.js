@@ -0,0 +1,72 @@
+// Background index builds sort the keys found by a yielding collection scan and load them bottom
+// up, recording the writes made meanwhile and applying them once the index is loaded.  Check that
+// the index matches the collection after writes of every kind during the build, and that it is
+// smaller than an index built key by key.
+
+var t = db.jstests_index_bg_bulk_load;
+t.drop();
+
+var n = 200000;
+for (var i = 0; i < n; i++) {
+    t.insert({_id: i, a: i % 1000, b: [i % 7, i % 11]});
+}
+assert.isnull(db.getLastError());
+
+function build() {
+    // inserts, key changes, moves and removes while the index is built
+    var writer = startParallelShell(
+        'var t = db.jstests_index_bg_bulk_load;' +
+        'for (var i = 0; i < 5000; i++) {' +
+        '    t.insert({a: i % 1000, b: [i % 13]});' +
+        '    t.update({_id: i * 37 % ' + n + '}, {$set: {a: -i}});' +
+        '    t.update({_id: i * 41 % ' + n + '}, {$set: {pad: new Array(512).join("x")}});' +
+        '    t.remove({_id: i * 43 % ' + n + '});' +
+        '}' +
+        'db.getLastError();');
+    t.ensureIndex({a: 1, b: 1}, {background: true});
+    assert.isnull(db.getLastError());
+    writer();
+}
+
+function check() {
+    var v = t.validate(true);
+    assert(v.valid, tojson(v));
+
+    var keys = 0;
+    t.find().forEach(function(x) {
+        var seen = {};
+        x.b.forEach(function(y) {
+            if (!seen[y]) {
+                seen[y] = true;
+                keys++;
+            }
+        });
+    });
+    assert.eq(keys, v.keysPerIndex[t.getFullName() + ".$a_1_b_1"]);
+
+    [-4999, -100, 0, 1, 500, 999].forEach(function(a) {
+        assert.eq(t.find({a: a}).hint({$natural: 1}).itcount(),
+                  t.find({a: a}).hint({a: 1, b: 1}).itcount(), "a: " + a);
+    });
+    assert.eq(t.count(), t.find({a: {$gte: -1e9}}).hint({a: 1, b: 1}).itcount());
+    return t.stats().indexSizes.a_1_b_1;
+}
+
+build();
+var bulkSize = check();
+
+// key by key
+t.dropIndex({a: 1, b: 1});
+assert.commandWorked(db.adminCommand({setParameter: 1, bulkLoadBackgroundIndexes: false}));
+build();
+var keyByKeySize = check();
+assert.commandWorked(db.adminCommand({setParameter: 1, bulkLoadBackgroundIndexes: true}));
+
+assert.lt(bulkSize, keyByKeySize, "bulk loaded index not smaller");
+
+// writes recorded past sideWriteTableMaxMB spill to a file, and are applied from it in order
+t.dropIndex({a: 1, b: 1});
+assert.commandWorked(db.adminCommand({setParameter: 1, sideWriteTableMaxMB: 0}));
+build();
+check();
+assert.commandWorked(db.adminCommand({setParameter: 1, sideWriteTableMaxMB: 100}));
@@ -29,6 +29,7 @@
 #include "mongo/db/dbhelpers.h"
 #include "mongo/db/dur_commitjob.h"
 #include "mongo/db/index/btree_index_cursor.h"  // for aboutToDeleteBucket
+#include "mongo/db/index/unique_key_filter.h"
 #include "mongo/db/intervalbtreecursor.h"  // also for aboutToDeleteBucket
 #include "mongo/db/json.h"
 #include "mongo/db/kill_current_op.h"
@@ -41,6 +42,7 @@ namespace mongo {
 
     BOOST_STATIC_ASSERT( Record::HeaderSize == 16 );
     BOOST_STATIC_ASSERT( Record::HeaderSize + BtreeData_V1::BucketSize == 8192 );
+    BOOST_STATIC_ASSERT( Record::HeaderSize + BtreeData_V2::BucketSize == 8192 );
 
     NOINLINE_DECL void checkFailed(unsigned line) {
         static time_t last;
@@ -326,7 +328,7 @@ namespace mongo {
         KeyNode kn = keyNode(this->n-1);
         recLoc = kn.recordLoc;
         key.assign(kn.key);
-        int keysize = kn.key.dataSize();
+        int keysize = this->_storedSizeAt(k(this->n-1).keyDataOfs());
 
         massert( 10283 , "rchild not null in btree popBack()", this->nextChild.isNull());
 
@@ -344,7 +346,7 @@ namespace mongo {
     /** add a key.  must be > all existing.  be careful to set next ptr right. */
     template< class V >
     bool BucketBasics<V>::_pushBack(const DiskLoc recordLoc, const Key& key, const Ordering &order, const DiskLoc prevChild) {
-        int bytesNeeded = key.dataSize() + sizeof(_KeyNode);
+        int bytesNeeded = this->_storedSize(key) + sizeof(_KeyNode);
         if ( bytesNeeded > this->emptySize )
             return false;
         verify( bytesNeeded <= this->emptySize );
@@ -358,14 +360,18 @@ namespace mongo {
                 verify(false);
             }
         }
+        int adopt = this->_prefixToAdopt(key);
+        if ( adopt )
+            _adoptPrefix(key, adopt);
         this->emptySize -= sizeof(_KeyNode);
         _KeyNode& kn = k(this->n++);
         kn.prevChildBucket = prevChild;
         kn.recordLoc = recordLoc;
-        kn.setKeyDataOfs( (short) _alloc(key.dataSize()) );
+        kn.setKeyDataOfs( (short) _alloc(this->_storedSize(key)) );
+        this->_setSearchPrefix(kn, key);
         short ofs = kn.keyDataOfs();
         char *p = dataAt(ofs);
-        memcpy(p, key.data(), key.dataSize());
+        this->_storeKey(p, key);
 
         return true;
     }
@@ -382,13 +388,21 @@ namespace mongo {
     bool BucketBasics<V>::basicInsert(const DiskLoc thisLoc, int &keypos, const DiskLoc recordLoc, const Key& key, const Ordering &order) const {
         check( this->n < 1024 );
         check( keypos >= 0 && keypos <= this->n );
-        int bytesNeeded = key.dataSize() + sizeof(_KeyNode);
+        int bytesNeeded = this->_storedSize(key) + sizeof(_KeyNode);
         if ( bytesNeeded > this->emptySize ) {
             _pack(thisLoc, order, keypos);
+            // packing may have chosen a new prefix
+            bytesNeeded = this->_storedSize(key) + sizeof(_KeyNode);
             if ( bytesNeeded > this->emptySize )
                 return false;
         }
 
+        int adopt = this->_prefixToAdopt(key);
+        if ( adopt ) {
+            // the prefix is written along with the header, declare the whole bucket
+            getDur().writingPtr((void *) this, V::BucketSize);
+        }
+
         BucketBasics *b;
         {
             const char *p = (const char *) &k(keypos);
@@ -409,15 +423,19 @@ namespace mongo {
         getDur().declareWriteIntent(&b->emptySize, sizeof(this->emptySize)+sizeof(this->topSize)+sizeof(this->n));
         b->emptySize -= sizeof(_KeyNode);
         b->n++;
+        if ( adopt )
+            b->_adoptPrefix(key, adopt);
 
         // This _KeyNode was marked for writing above.
         _KeyNode& kn = b->k(keypos);
         kn.prevChildBucket.Null();
         kn.recordLoc = recordLoc;
-        kn.setKeyDataOfs((short) b->_alloc(key.dataSize()) );
+        int sz = b->_storedSize(key);
+        kn.setKeyDataOfs((short) b->_alloc(sz) );
+        b->_setSearchPrefix(kn, key);
         char *p = b->dataAt(kn.keyDataOfs());
-        getDur().declareWriteIntent(p, key.dataSize());
-        memcpy(p, key.data(), key.dataSize());
+        getDur().declareWriteIntent(p, sz);
+        b->_storeKey(p, key);
         return true;
     }
 
@@ -430,17 +448,29 @@ namespace mongo {
         return index > 0 && ( index != refPos ) && k( index ).isUnused() && k( index ).prevChildBucket.isNull();
     }
 
+    template< class V >
+    int BucketBasics<V>::movedDataSize( int refPos ) const {
+        int size = 0;
+        for( int j = 0; j < this->n; ++j ) {
+            if ( mayDropKey( j, refPos ) ) {
+                continue;
+            }
+            size += V::maxStoredSize( keyNode( j ).key.dataSize() ) + sizeof( _KeyNode );
+        }
+        return size;
+    }
+
     template< class V >
     int BucketBasics<V>::packedDataSize( int refPos ) const {
         if ( this->flags & Packed ) {
             return V::BucketSize - this->emptySize - headerSize();
         }
-        int size = 0;
+        int size = this->_prefixLen();
         for( int j = 0; j < this->n; ++j ) {
             if ( mayDropKey( j, refPos ) ) {
                 continue;
             }
-            size += keyNode( j ).key.dataSize() + sizeof( _KeyNode );
+            size += this->_storedSizeAt( k( j ).keyDataOfs() ) + sizeof( _KeyNode );
         }
         return size;
     }
@@ -516,6 +546,107 @@ namespace mongo {
         assertValid( order );
     }
 
+    /**
+     * v:2 buckets are packed by putting each kept key back together and storing it again against
+     * whichever prefix makes the bucket smallest: the one it has, the one all its keys share, or
+     * its middle key.
+     */
+    template<>
+    void BucketBasics<V2>::_packReadyForMod( const Ordering &order, int &refPos ) {
+        assertWritable();
+
+        if ( this->flags & Packed )
+            return;
+
+        // the kept keys, one after the other, with ends[i] where the i-th one ends
+        StackBufBuilder keys;
+        vector<int> ends;
+        int i = 0;
+        for ( int j = 0; j < this->n; j++ ) {
+            if( mayDropKey( j, refPos ) ) {
+                continue; // key is unused and has no children - drop it
+            }
+            if( i != j ) {
+                if ( refPos == j ) {
+                    refPos = i; // i < j so j will never be refPos again
+                }
+                k( i ) = k( j );
+            }
+            int shared, unshared;
+            const char *rest = this->_entry( k( i ).keyDataOfs(), shared, unshared );
+            keys.appendBuf( this->_prefixData(), shared );
+            keys.appendBuf( rest, unshared );
+            ends.push_back( keys.len() );
+            ++i;
+        }
+        if ( refPos == this->n ) {
+            refPos = i;
+        }
+        this->n = i;
+
+        const char *all = keys.buf();
+        const char *candidates[3];
+        int candidateLens[3];
+        candidates[0] = this->_prefixData();
+        candidateLens[0] = this->prefixLen;
+        candidates[1] = candidates[2] = all;
+        candidateLens[1] = candidateLens[2] = 0;
+        if ( this->n ) {
+            int lcp = std::min( ends[0], (int) MaxPrefix );
+            for ( int j = 1; j < this->n; j++ )
+                lcp = commonPrefix( all, lcp, all + ends[j-1], ends[j] - ends[j-1] );
+            candidateLens[1] = lcp;
+            int m = this->n / 2;
+            int start = m ? ends[m-1] : 0;
+            candidates[2] = all + start;
+            candidateLens[2] = std::min( ends[m] - start, (int) MaxPrefix );
+        }
+        int best = 0;
+        int bestSize = 0;
+        for ( int c = 0; c < 3; c++ ) {
+            int size = candidateLens[c];
+            int start = 0;
+            for ( int j = 0; j < this->n; j++ ) {
+                int len = ends[j] - start;
+                size += entrySize( len, commonPrefix( candidates[c], candidateLens[c], all + start, len ) );
+                start = ends[j];
+            }
+            if ( c == 0 || size < bestSize ) {
+                best = c;
+                bestSize = size;
+            }
+        }
+
+        int tdz = totalDataSize();
+        char temp[V2::BucketSize];
+        int ofs = tdz - candidateLens[best];
+        memcpy( temp + ofs, candidates[best], candidateLens[best] );
+        short prefixOfs = (short) ofs;
+        int start = 0;
+        for ( int j = 0; j < this->n; j++ ) {
+            int len = ends[j] - start;
+            int shared = commonPrefix( candidates[best], candidateLens[best], all + start, len );
+            ofs -= entrySize( len, shared );
+            _encode( temp + ofs, all + start, len, shared );
+            k( j ).setKeyDataOfsSavingUse( ofs );
+            start = ends[j];
+        }
+        int dataUsed = tdz - ofs;
+        memcpy( this->data + ofs, temp + ofs, dataUsed );
+        this->_setPrefix( prefixOfs, candidateLens[best] );
+        this->topSize = dataUsed;
+
+        this->emptySize = tdz - dataUsed - this->n * sizeof(_KeyNode);
+        {
+            int foo = this->emptySize;
+            verify( foo >= 0 );
+        }
+
+        setPacked();
+
+        assertValid( order );
+    }
+
     template< class V >
     inline void BucketBasics<V>::truncateTo(int N, const Ordering &order, int &refPos) {
         verify( Lock::somethingWriteLocked() );
@@ -552,7 +683,7 @@ namespace mongo {
         // TODO I think we only want to do the 90% split on the rhs node of the tree.
         int rightSizeLimit = ( this->topSize + sizeof( _KeyNode ) * this->n ) / ( keypos == this->n ? 10 : 2 );
         for( int i = this->n - 1; i > -1; --i ) {
-            rightSize += keyNode( i ).key.dataSize() + sizeof( _KeyNode );
+            rightSize += this->_storedSizeAt( k( i ).keyDataOfs() ) + sizeof( _KeyNode );
             if ( rightSize > rightSizeLimit ) {
                 split = i;
                 break;
@@ -584,10 +715,32 @@ namespace mongo {
         _KeyNode &kn = k( i );
         kn.recordLoc = recordLoc;
         kn.prevChildBucket = prevChildBucket;
-        short ofs = (short) _alloc( key.dataSize() );
+        int adopt = this->_prefixToAdopt( key );
+        if ( adopt )
+            _adoptPrefix( key, adopt );
+        short ofs = (short) _alloc( this->_storedSize( key ) );
         kn.setKeyDataOfs( ofs );
+        this->_setSearchPrefix( kn, key );
         char *p = dataAt( ofs );
-        memcpy( p, key.data(), key.dataSize() );
+        this->_storeKey( p, key );
+    }
+
+    template< class V >
+    void BucketBasics<V>::_adoptPrefix( const Key& key, int len ) {
+        short ofs = (short) _alloc( len );
+        memcpy( dataAt( ofs ), key.data(), len );
+        this->_setPrefix( ofs, len );
+    }
+
+    template< class V >
+    void BucketBasics<V>::_copyPrefix( const BucketBasics& from ) {
+        verify( this->n == 0 && this->_prefixLen() == 0 );
+        int len = from._prefixLen();
+        if ( len == 0 )
+            return;
+        short ofs = (short) _alloc( len );
+        memcpy( dataAt( ofs ), from._prefixData(), len );
+        this->_setPrefix( ofs, len );
     }
 
     template< class V >
@@ -600,6 +753,82 @@ namespace mongo {
         _packReadyForMod( order, refpos );
     }
 
+    /* - BtreeData_V2 -------------------------------------------------- */
+
+    int BtreeData_V2::commonPrefix(const char *a, int aLen, const char *b, int bLen) {
+        int len = std::min( std::min( aLen, bLen ), (int) MaxPrefix );
+        int i = 0;
+        while ( i < len && a[i] == b[i] )
+            i++;
+        return i;
+    }
+
+    const char * BtreeData_V2::_entry(short ofs, int &shared, int &unshared) const {
+        const unsigned char *e = (const unsigned char *) data + ofs;
+        shared = e[0];
+        unshared = e[1];
+        if ( unshared < 0x80 )
+            return (const char *) e + 2;
+        unshared = ( ( unshared & 0x7f ) << 8 ) | e[2];
+        return (const char *) e + 3;
+    }
+
+    int BtreeData_V2::_encode(char *p, const char *keyData, int len, int shared) {
+        dassert( shared <= MaxPrefix && shared <= len );
+        unsigned char *e = (unsigned char *) p;
+        int unshared = len - shared;
+        int h = 2;
+        e[0] = (unsigned char) shared;
+        if ( unshared < 0x80 ) {
+            e[1] = (unsigned char) unshared;
+        }
+        else {
+            e[1] = (unsigned char) ( 0x80 | ( unshared >> 8 ) );
+            e[2] = (unsigned char) unshared;
+            h = 3;
+        }
+        memcpy( p + h, keyData + shared, unshared );
+        return h + unshared;
+    }
+
+    KeyV2 BtreeData_V2::_keyAt(short ofs) const {
+        int shared, unshared;
+        const char *rest = _entry( ofs, shared, unshared );
+        if ( shared == 0 )
+            return KeyV2( rest );
+        return KeyV2::join( _prefixData(), shared, rest, unshared );
+    }
+
+    const char * BtreeData_V2::_keyDataAt(short ofs, char *buf) const {
+        int shared, unshared;
+        const char *rest = _entry( ofs, shared, unshared );
+        if ( shared == 0 )
+            return rest;
+        memcpy( buf, _prefixData(), shared );
+        memcpy( buf + shared, rest, unshared );
+        return buf;
+    }
+
+    int BtreeData_V2::_storedSize(const KeyV2& key) const {
+        int len = key.dataSize();
+        if ( prefixLen == 0 ) {
+            int adopt = _prefixToAdopt( key );
+            return adopt + entrySize( len, adopt );
+        }
+        return entrySize( len, commonPrefix( _prefixData(), prefixLen, key.data(), len ) );
+    }
+
+    int BtreeData_V2::_storedSizeAt(short ofs) const {
+        int shared, unshared;
+        const char *rest = _entry( ofs, shared, unshared );
+        return (int) ( rest - ( data + ofs ) ) + unshared;
+    }
+
+    void BtreeData_V2::_storeKey(char *p, const KeyV2& key) const {
+        int len = key.dataSize();
+        _encode( p, key.data(), len, commonPrefix( _prefixData(), prefixLen, key.data(), len ) );
+    }
+
     /* - BtreeBucket --------------------------------------------------- */
 
     /** @return largest key in the subtree. */
@@ -757,9 +986,23 @@ namespace mongo {
         if( guessIncreasing ) {
             m = h;
         }
+        // v:2 nodes hold a prefix of their key which decides most comparisons.  otherwise the
+        // key is put back together here, without allocating, to compare it.
+        const unsigned keyPrefix = this->_keySearchPrefix(key);
+        const bool firstDescending = order.descending(1);
+        char keyBuf[V::KeyMax];
         while ( l <= h ) {
-            KeyNode M = this->keyNode(m);
-            int x = key.woCompare(M.key, order);
+            const _KeyNode& M = k(m);
+            const unsigned mPrefix = this->_searchPrefix(M);
+            int x;
+            if ( keyPrefix && mPrefix && keyPrefix != mPrefix ) {
+                x = ( keyPrefix > mPrefix ) - ( keyPrefix < mPrefix );
+                if ( firstDescending )
+                    x = -x;
+            }
+            else {
+                x = key.woCompare(Key(this->_keyDataAt(M.keyDataOfs(), keyBuf)), order);
+            }
             if ( x == 0 ) {
                 if( assertIfDup ) {
                     if( k(m).isUnused() ) {
@@ -971,7 +1214,11 @@ namespace mongo {
         {
             const BtreeBucket *l = leftNodeLoc.btree<V>();
             const BtreeBucket *r = rightNodeLoc.btree<V>();
-            if ( ( this->headerSize() + l->packedDataSize( pos ) + r->packedDataSize( pos ) + keyNode( leftIndex ).key.dataSize() + sizeof(_KeyNode) > unsigned( V::BucketSize ) ) ) {
+            // l packed is no larger than it is now, while the keys moved into it are stored
+            // against its prefix, which for v:2 keys may share nothing with them
+            int rSize = V::PrefixCompressed ? r->movedDataSize( pos ) : r->packedDataSize( pos );
+            int separatorSize = V::maxStoredSize( keyNode( leftIndex ).key.dataSize() );
+            if ( ( this->headerSize() + l->packedDataSize( pos ) + rSize + separatorSize + sizeof(_KeyNode) > unsigned( V::BucketSize ) ) ) {
                 return false;
             }
         }
@@ -1208,6 +1455,21 @@ namespace mongo {
         bool mayBalanceRight = ( ( parentIdx < p->n ) && !p->childForPos( parentIdx + 1 ).isNull() );
         bool mayBalanceLeft = ( ( parentIdx > 0 ) && !p->childForPos( parentIdx - 1 ).isNull() );
 
+        if ( V::PrefixCompressed ) {
+            // keys moved to a neighbor are stored against its prefix, which the size arithmetic
+            // of balancing doesn't allow for.  merge when the moved keys surely fit.
+            BtreeBucket *pm = BTREEMOD(this->parent);
+            if ( mayBalanceRight && p->canMergeChildren( this->parent, parentIdx ) ) {
+                pm->doMergeChildren( this->parent, parentIdx, id, order );
+                return true;
+            }
+            if ( mayBalanceLeft && p->canMergeChildren( this->parent, parentIdx - 1 ) ) {
+                pm->doMergeChildren( this->parent, parentIdx - 1, id, order );
+                return true;
+            }
+            return false;
+        }
+
         // Balance if possible on one side - we merge only if absolutely necessary
         // to preserve btree bucket utilization constraints since that's a more
         // heavy duty operation (especially if we must re-split later).
@@ -1369,6 +1631,8 @@ namespace mongo {
         int split = this->splitPos( keypos );
         DiskLoc rLoc = addBucket(idx);
         BtreeBucket *r = rLoc.btreemod<V>();
+        // the keys moved to r keep the size they have here
+        r->_copyPrefix(*this);
         if ( split_debug )
             out() << "     split:" << split << ' ' << keyNode(split).key.toString() << " n:" << this->n << endl;
         for ( int i = split+1; i < this->n; i++ ) {
@@ -1798,6 +2062,7 @@ namespace mongo {
         try {
             x = _insert(thisLoc, recordLoc, key, order, dupsAllowed, DiskLoc(), DiskLoc(), idx);
             this->assertValid( order );
+            UniqueKeyFilter::noteInsert(idx, _key);
         }
         catch( ... ) { 
             guessIncreasing = false;
@@ -1896,8 +2161,10 @@ namespace mongo {
 
     template class BucketBasics<V0>;
     template class BucketBasics<V1>;
+    template class BucketBasics<V2>;
     template class BtreeBucket<V0>;
     template class BtreeBucket<V1>;
+    template class BtreeBucket<V2>;
     template struct __KeyNode<DiskLoc>;
     template struct __KeyNode<DiskLoc56Bit>;
 
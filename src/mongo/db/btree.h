@@ -183,6 +183,24 @@ namespace mongo {
         static const int KeyMax = OldBucketSize / 10;
         // A sentinel value sometimes used to identify a deallocated bucket.
         static const int INVALID_N_SENTINEL = -1;
+        enum { PrefixCompressed = 0 };
+    protected:
+        /* how keys are laid out in the bucket body, see BtreeData_V2.  here they are stored whole. */
+        Key _keyAt(short ofs) const { return Key(data + ofs); }
+        const char * _keyDataAt(short ofs, char *) const { return data + ofs; }
+        int _storedSize(const Key& key) const { return key.dataSize(); }
+        int _storedSizeAt(short ofs) const { return _keyAt(ofs).dataSize(); }
+        void _storeKey(char *p, const Key& key) const { memcpy(p, key.data(), key.dataSize()); }
+        int _prefixToAdopt(const Key&) const { return 0; }
+        int _prefixLen() const { return 0; }
+        const char * _prefixData() const { return 0; }
+        void _setPrefix(short, int) { }
+        static unsigned _keySearchPrefix(const Key&) { return 0; }
+        static unsigned _searchPrefix(const _KeyNode&) { return 0; }
+        static void _setSearchPrefix(_KeyNode&, const Key&) { }
+    public:
+        /** @return the most a key of dataSize bytes takes when stored into any bucket */
+        static int maxStoredSize(int dataSize) { return dataSize; }
     };
 
     // a a a ofs ofs ofs ofs
@@ -274,6 +292,7 @@ namespace mongo {
         static const int KeyMax = 1024;
         // A sentinel value sometimes used to identify a deallocated bucket.
         static const unsigned short INVALID_N_SENTINEL = 0xffff;
+        enum { PrefixCompressed = 0 };
     protected:
         /** Parent bucket of this bucket, which isNull() for the root bucket. */
         Loc parent;
@@ -295,10 +314,133 @@ namespace mongo {
         char data[4];
 
         void _init() { }
+
+        /* how keys are laid out in the bucket body, see BtreeData_V2.  here they are stored whole. */
+        Key _keyAt(short ofs) const { return Key(data + ofs); }
+        const char * _keyDataAt(short ofs, char *) const { return data + ofs; }
+        int _storedSize(const Key& key) const { return key.dataSize(); }
+        int _storedSizeAt(short ofs) const { return _keyAt(ofs).dataSize(); }
+        void _storeKey(char *p, const Key& key) const { memcpy(p, key.data(), key.dataSize()); }
+        int _prefixToAdopt(const Key&) const { return 0; }
+        int _prefixLen() const { return 0; }
+        const char * _prefixData() const { return 0; }
+        void _setPrefix(short, int) { }
+        static unsigned _keySearchPrefix(const Key&) { return 0; }
+        static unsigned _searchPrefix(const _KeyNode&) { return 0; }
+        static void _setSearchPrefix(_KeyNode&, const Key&) { }
+    public:
+        /** @return the most a key of dataSize bytes takes when stored into any bucket */
+        static int maxStoredSize(int dataSize) { return dataSize; }
+    };
+
+    /**
+     * The v:2 _KeyNode also holds the KeyV1::searchPrefix() of its key, so the binary search over
+     * a bucket can often decide a comparison without reading the key.
+     */
+    struct __KeyNodeV2 : public __KeyNode<DiskLoc56Bit> {
+        unsigned keyPrefix;
+    };
+
+    /**
+     * v:2 buckets hold KeyV1 format keys prefix compressed.  The header is that of v:1 plus the
+     * offset and length of a prefix, which is stored in the top region ahead of the keys.  Each
+     * key is stored as
+     *
+     *   <shared:1><unshared length:1 or 2><unshared bytes>
+     *
+     * where shared is the number of leading bytes the key has in common with the prefix, and an
+     * unshared length of 0x80 or more takes two bytes with the high bit of the first one set.
+     * Every key decodes on its own, so the binary search over the _KeyNodes is unchanged, and
+     * the _KeyNodes carry a prefix of their keys (see __KeyNodeV2) that most of its comparisons
+     * are decided on.
+     *
+     * A bucket takes its prefix from the first key stored into it, and chooses it again when it is
+     * packed.  Because a key moved between buckets is stored against a different prefix, v:2
+     * buckets are not balanced with their neighbors on delete, and are merged with one only when
+     * the moved keys would fit sharing nothing with its prefix.
+     */
+    class BtreeData_V2 {
+    public:
+        typedef DiskLoc56Bit Loc;
+        typedef __KeyNodeV2 _KeyNode;
+        typedef KeyV2 Key;
+        typedef KeyV2Owned KeyOwned;
+        enum { BucketSize = 8192-16 }; // leave room for Record header
+        // largest key size we allow, as for v:1
+        static const int KeyMax = 1024;
+        // A sentinel value sometimes used to identify a deallocated bucket.
+        static const unsigned short INVALID_N_SENTINEL = 0xffff;
+        enum { PrefixCompressed = 1, MaxPrefix = 255 };
+
+        /** @return the number of leading bytes a and b have in common, at most MaxPrefix */
+        static int commonPrefix(const char *a, int aLen, const char *b, int bLen);
+        /** @return the size of a key of dataSize bytes stored with 'shared' bytes from the prefix */
+        static int entrySize(int dataSize, int shared) {
+            int unshared = dataSize - shared;
+            return 1 + ( unshared < 0x80 ? 1 : 2 ) + unshared;
+        }
+        /** @return the most a key of dataSize bytes takes when stored into any bucket, which is
+            when it shares nothing with the prefix or when it gives an empty bucket its prefix */
+        static int maxStoredSize(int dataSize) { return entrySize(dataSize, 0); }
+    protected:
+        /** Parent bucket of this bucket, which isNull() for the root bucket. */
+        Loc parent;
+        /** Given that there are n keys, this is the n index child. */
+        Loc nextChild;
+
+        unsigned short flags;
+
+        /** basicInsert() assumes the next three members are consecutive and in this order: */
+
+        /** Size of the empty region. */
+        unsigned short emptySize;
+        /** Size used for key storage, including the prefix and storage of old keys. */
+        unsigned short topSize;
+        /* Number of keys in the bucket. */
+        unsigned short n;
+
+        /** Where the prefix is in the body, and its length, which is 0 when there is none. */
+        unsigned short prefixOfs;
+        unsigned short prefixLen;
+
+        /* Beginning of the bucket's body */
+        char data[4];
+
+        void _init() {
+            prefixOfs = 0;
+            prefixLen = 0;
+        }
+
+        Key _keyAt(short ofs) const;
+        /** @return the key data stored at ofs, put together in buf (of KeyMax bytes) if need be */
+        const char * _keyDataAt(short ofs, char *buf) const;
+        /** @return the bytes storing key will take, including a prefix taken from it */
+        int _storedSize(const Key& key) const;
+        int _storedSizeAt(short ofs) const;
+        void _storeKey(char *p, const Key& key) const;
+        /** @return how much of key a bucket without a prefix takes as its prefix */
+        int _prefixToAdopt(const Key& key) const {
+            return prefixLen ? 0 : std::min(key.dataSize(), (int) MaxPrefix);
+        }
+        int _prefixLen() const { return prefixLen; }
+        const char * _prefixData() const { return data + prefixOfs; }
+        void _setPrefix(short ofs, int len) {
+            prefixOfs = ofs;
+            prefixLen = len;
+        }
+        static unsigned _keySearchPrefix(const Key& key) { return key.searchPrefix(); }
+        static unsigned _searchPrefix(const _KeyNode& kn) { return kn.keyPrefix; }
+        static void _setSearchPrefix(_KeyNode& kn, const Key& key) { kn.keyPrefix = key.searchPrefix(); }
+
+        /** @return the unshared bytes of the key stored at ofs, setting shared and unshared */
+        const char * _entry(short ofs, int &shared, int &unshared) const;
+        /** stores key data of len bytes at p, @return the bytes written */
+        static int _encode(char *p, const char *keyData, int len, int shared);
     };
 
     typedef BtreeData_V0 V0;
     typedef BtreeData_V1 V1;
+    typedef BtreeData_V2 V2;
 
     /**
      * This class adds functionality to BtreeData for managing a single bucket.
@@ -503,8 +645,15 @@ namespace mongo {
         /** Pack when already writable */
         void _packReadyForMod(const Ordering &order, int &refPos);
 
+        /** allocate the first len bytes of key as the prefix of a bucket without one */
+        void _adoptPrefix(const Key& key, int len);
+        /** give an empty bucket the prefix of another, so keys moved here keep their size */
+        void _copyPrefix(const BucketBasics& from);
+
         /** @return the size the bucket's body would have if we were to call pack() */
         int packedDataSize( int refPos ) const;
+        /** @return at most the size the bucket's keys would take if moved into another bucket */
+        int movedDataSize( int refPos ) const;
         void setNotPacked() { this->flags &= ~Packed; }
         void setPacked() { this->flags |= Packed; }
         /**
@@ -592,6 +741,9 @@ namespace mongo {
         void setKey( int i, const DiskLoc recordLoc, const Key& key, const DiskLoc prevChildBucket );
     };
 
+    /** v:2 buckets choose their prefix again when packed */
+    template<> void BucketBasics<V2>::_packReadyForMod( const Ordering &order, int &refPos );
+
     class IndexDetails;
 
     /**
@@ -907,7 +1059,7 @@ namespace mongo {
         Key keyAt(int i) const {
             if( i >= this->n ) 
                 return Key();
-            return Key(this->data + k(i).keyDataOfs());
+            return this->_keyAt(k(i).keyDataOfs());
         }
     protected:
 
@@ -1013,7 +1165,7 @@ namespace mongo {
     template< class V >
     BucketBasics<V>::KeyNode::KeyNode(const BucketBasics<V>& bb, const _KeyNode &k) :
         prevChildBucket(k.prevChildBucket),
-        recordLoc(k.recordLoc), key(bb.data+k.keyDataOfs())
+        recordLoc(k.recordLoc), key(bb._keyAt(k.keyDataOfs()))
     { }
 
 } // namespace mongo;
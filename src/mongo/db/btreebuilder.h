@@ -29,7 +29,7 @@ namespace mongo {
         typedef typename V::Key Key;
         
         bool dupsAllowed;
-        IndexDetails& idx;
+        IndexDetails* idx;
         /** Number of keys added to btree. */
         unsigned long long n;
         /** Last key passed to addKey(). */
@@ -61,6 +61,12 @@ namespace mongo {
          */
         void commit(bool mayInterrupt);
 
+        /**
+         * Call after releasing the write lock between two addKey()s, with the details of the index
+         * as they are now: those of an index built in the background can move meanwhile.
+         */
+        void relocate(IndexDetails& _idx);
+
         unsigned long long getn() { return n; }
     };
 
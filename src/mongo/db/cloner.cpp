@@ -208,29 +208,21 @@ namespace mongo {
         }
 
         if ( storedForLater.size() ) {
-            for (list<BSONObj>::const_iterator i = storedForLater.begin();
-                 i != storedForLater.end();
-                 ++i) {
-                BSONObj js = *i;
-                scoped_lock precalcLock(theDataFileMgr._precalcedMutex);
-                try {
-                    theDataFileMgr.insertWithObjMod(to_collection, js);
-                    theDataFileMgr.setPrecalced(NULL);
-
-                    if ( logForRepl )
-                        logOp("i", to_collection, js);
-
-                    getDur().commitIfNeeded();
-                }
-                catch( UserException& e ) {
-                    theDataFileMgr.setPrecalced(NULL);
-                    error() << "error: exception cloning object in " << from_collection << ' ' << e.what() << " obj:" << js.toString() << '\n';
-                    throw;
-                }
-                catch(const DBException&) {
-                    theDataFileMgr.setPrecalced(NULL);
-                    throw;
-                }
+            // the indexes of each collection are built from one scan of it
+            vector<BSONObj> specs(storedForLater.begin(), storedForLater.end());
+            scoped_lock precalcLock(theDataFileMgr._precalcedMutex);
+            try {
+                theDataFileMgr.insertIndexes(to_collection, specs, false, logForRepl);
+                theDataFileMgr.setPrecalced(NULL);
+            }
+            catch( UserException& e ) {
+                theDataFileMgr.setPrecalced(NULL);
+                error() << "error: exception cloning indexes in " << from_collection << ' ' << e.what() << '\n';
+                throw;
+            }
+            catch(const DBException&) {
+                theDataFileMgr.setPrecalced(NULL);
+                throw;
             }
         }
     }
@@ -31,6 +31,7 @@
 #include "mongo/db/matcher.h"
 #include "mongo/db/query_optimizer.h"
 #include "mongo/db/repl/is_master.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/scripting/engine.h"
 #include "mongo/s/collection_metadata.h"
 #include "mongo/s/d_logic.h"
@@ -42,6 +43,11 @@ namespace mongo {
 
     namespace mr {
 
+        // keep the incremental collection of map/reduce jobs in memory rather than in the data
+        // files.  it is scratch space dropped at the end of the job, but can be as large as the
+        // emitted data.
+        MONGO_EXPORT_SERVER_PARAMETER( mrInMemoryIncrementalCollection, bool, false );
+
         AtomicUInt Config::JOB_NUMBER;
 
         JSFunction::JSFunction( const std::string& type , const BSONElement& e ) {
@@ -323,8 +329,12 @@ namespace mongo {
                 // create the inc collection and make sure we have index on "0" key
                 {
                     Client::WriteContext ctx( _config.incLong );
+                    BSONObjBuilder options;
+                    options << "autoIndexId" << 0 << "temp" << true;
+                    if ( mrInMemoryIncrementalCollection )
+                        options << "inMemory" << true;
                     string err;
-                    if ( ! userCreateNS( _config.incLong.c_str() , BSON( "autoIndexId" << 0 << "temp" << true ) , err , false ) ) {
+                    if ( ! userCreateNS( _config.incLong.c_str() , options.obj() , err , false ) ) {
                         uasserted( 13631 , str::stream() << "userCreateNS failed for mr incLong ns: " << _config.incLong << " err: " << err );
                     }
                 }
@@ -272,6 +272,204 @@ namespace mongo {
         return true;
     }
 
+    /* online compaction --------------------------------------------------------------------
+
+       rather than rewriting every extent under one long write lock, records are moved out of
+       sparse extents in small batches, each batch under its own short DBWrite lock and ending
+       at a journal commit point.  the moved records land in free space of the other extents,
+       and each extent is handed back to the freelist as soon as it is empty.
+    */
+
+    struct OnlineCompactOptions {
+        OnlineCompactOptions() : batchSize(100), sleepMillis(10), maxExtentFill(0.5) { }
+        int batchSize;        // records moved per write lock acquisition
+        int sleepMillis;      // pause between batches, with no lock held
+        double maxExtentFill; // only extents filled less than this are emptied
+    };
+
+    /** @return the fraction of an extent's length used by records */
+    static double extentFill(const DiskLoc& extLoc, long long* nrecords) {
+        Extent *e = extLoc.ext();
+        long long used = 0;
+        *nrecords = 0;
+        for( DiskLoc L = e->firstRecord; !L.isNull(); L = L.rec()->getNext(L) ) {
+            used += L.rec()->lengthWithHeaders();
+            (*nrecords)++;
+        }
+        return static_cast<double>(used) / e->length;
+    }
+
+    /** unlink an extent from anywhere in the collection's extent list and free it */
+    static void freeExtentOfCollection(NamespaceDetails *d, const DiskLoc& extLoc) {
+        Extent *e = extLoc.ext();
+        verify( e->firstRecord.isNull() );
+
+        if( e->xprev.isNull() ) {
+            verify( d->firstExtent() == extLoc );
+            d->setFirstExtent( e->xnext );
+        }
+        else {
+            getDur().writingDiskLoc( e->xprev.ext()->xnext ) = e->xnext;
+        }
+
+        if( e->xnext.isNull() ) {
+            verify( d->lastExtent() == extLoc );
+            d->setLastExtent( e->xprev );
+        }
+        else {
+            getDur().writingDiskLoc( e->xnext.ext()->xprev ) = e->xprev;
+        }
+
+        getDur().writing(e)->markEmpty();
+        freeExtents( extLoc, extLoc );
+    }
+
+    typedef map< DiskLoc, vector<DiskLoc> > DeletedRecordsByExtent;
+
+    /**
+     * put back on the deleted lists the free space taken out of the extents that were not
+     * emptied: their deleted records, and the space of the records moved out of them
+     */
+    static void restoreDeletedRecords(NamespaceDetails *d, const set<DiskLoc>& freedExtents,
+                                      const DeletedRecordsByExtent& removed) {
+        for( DeletedRecordsByExtent::const_iterator i = removed.begin(); i != removed.end(); ++i ) {
+            if( freedExtents.count( i->first ) )
+                continue;
+            for( vector<DiskLoc>::const_iterator j = i->second.begin(); j != i->second.end(); ++j )
+                d->addDeletedRec(j->drec(), *j);
+        }
+    }
+
+    bool _compactOnline(const string& ns, string& errmsg, BSONObjBuilder& result,
+                        const OnlineCompactOptions& opts) {
+        scoped_ptr<BackgroundOperation> bgop;
+
+        vector<DiskLoc> sparseExtents;
+        DeletedRecordsByExtent removedDeletedRecords;
+        long long nToMove = 0;
+        {
+            Lock::DBWrite lk(ns);
+            Client::Context ctx(ns);
+            NamespaceDetails *d = nsdetails(ns);
+            if( !d ) {
+                errmsg = "namespace does not exist";
+                return false;
+            }
+            BackgroundOperation::assertNoBgOpInProgForNs(ns);
+            bgop.reset( new BackgroundOperation(ns) );
+
+            // the last extent is left alone: it is where the collection grows
+            for( DiskLoc L = d->firstExtent(); !L.isNull() && L != d->lastExtent(); L = L.ext()->xnext ) {
+                long long n;
+                if( extentFill(L, &n) < opts.maxExtentFill ) {
+                    sparseExtents.push_back(L);
+                    nToMove += n;
+                }
+            }
+
+            // moved records must land in the dense extents, not in another extent that is about
+            // to be emptied.  the free space of extents we do not get to is put back at the end.
+            set<DiskLoc> sparse( sparseExtents.begin(), sparseExtents.end() );
+            vector<DiskLoc> removed;
+            d->removeDeletedRecordsInExtents( sparse, &removed );
+            for( vector<DiskLoc>::const_iterator i = removed.begin(); i != removed.end(); ++i )
+                removedDeletedRecords[ i->drec()->myExtentLoc(*i) ].push_back(*i);
+            getDur().commitIfNeeded();
+        }
+        log() << "compact online " << ns << ' ' << sparseExtents.size() << " sparse extents, "
+              << nToMove << " records to move" << endl;
+
+        ProgressMeterHolder pm(cc().curop()->setMessage("compact online",
+                                                        "Online Compaction Progress",
+                                                        nToMove));
+
+        long long nMoved = 0;
+        long long bytesFreed = 0;
+        set<DiskLoc> freedExtents;
+        bool outOfRoom = false;
+
+        try {
+            for( vector<DiskLoc>::const_iterator i = sparseExtents.begin();
+                 i != sparseExtents.end() && !outOfRoom; ++i ) {
+                const DiskLoc extLoc = *i;
+                bool emptied = false;
+                while( !emptied && !outOfRoom ) {
+                    killCurrentOp.checkForInterrupt(false);
+                    {
+                        Lock::DBWrite lk(ns);
+                        Client::Context ctx(ns);
+                        NamespaceDetails *d = nsdetails(ns);
+                        massert( 17119, "collection dropped during online compaction", d );
+                        Extent *e = extLoc.ext();
+
+                        for( int n = 0; n < opts.batchSize && !e->firstRecord.isNull(); n++ ) {
+                            DiskLoc L = e->firstRecord;
+                            Record *r = L.rec();
+                            int lenWHdr = d->getRecordAllocationSize( BSONObj::make(r).objsize() +
+                                                                      Record::HeaderSize );
+                            if( d->allocWillBeAt(ns.c_str(), lenWHdr).isNull() ) {
+                                // moving on would only grow the collection by a new extent
+                                outOfRoom = true;
+                                break;
+                            }
+                            theDataFileMgr.moveRecordOutOfExtent(d, ns.c_str(), r, L);
+                            // free with the extent, or put back if the run stops short of that
+                            removedDeletedRecords[extLoc].push_back(L);
+                            nMoved++;
+                            pm.hit();
+                        }
+
+                        if( e->firstRecord.isNull() ) {
+                            // space freed here by removes from other clients since we began
+                            set<DiskLoc> thisExtent;
+                            thisExtent.insert(extLoc);
+                            d->removeDeletedRecordsInExtents(thisExtent);
+
+                            bytesFreed += e->length;
+                            freeExtentOfCollection(d, extLoc);
+                            freedExtents.insert(extLoc);
+                            emptied = true;
+                        }
+
+                        getDur().commitIfNeeded();
+                    }
+                    if( opts.sleepMillis > 0 )
+                        sleepmillis(opts.sleepMillis);
+                }
+            }
+        }
+        catch( DBException& ) {
+            Lock::DBWrite lk(ns);
+            Client::Context ctx(ns);
+            NamespaceDetails *d = nsdetails(ns);
+            if( d )
+                restoreDeletedRecords(d, freedExtents, removedDeletedRecords);
+            throw;
+        }
+
+        {
+            Lock::DBWrite lk(ns);
+            Client::Context ctx(ns);
+            NamespaceDetails *d = nsdetails(ns);
+            massert( 17123, "collection dropped during online compaction", d );
+            restoreDeletedRecords(d, freedExtents, removedDeletedRecords);
+            getDur().commitIfNeeded();
+        }
+
+        pm.finished();
+
+        log() << "compact online " << ns << " moved " << nMoved << " records, freed "
+              << freedExtents.size() << " extents (" << bytesFreed/1000000.0 << "MB)"
+              << ( outOfRoom ? ", stopped: no free space left in dense extents" : "" ) << endl;
+
+        result.append("recordsMoved", nMoved);
+        result.append("extentsFreed", static_cast<long long>(freedExtents.size()));
+        result.append("bytesFreed", bytesFreed);
+        if( outOfRoom )
+            result.append("note", "stopped early, no free space left in dense extents");
+        return true;
+    }
+
     bool isCurrentlyAReplSetPrimary();
 
     class CompactCmd : public Command {
@@ -294,7 +492,14 @@ namespace mongo {
                 "{ compact : <collection_name>, [force:<bool>], [validate:<bool>],\n"
                 "  [paddingFactor:<num>], [paddingBytes:<num>] }\n"
                 "  force - allows to run on a replica set primary\n"
-                "  validate - check records are noncorrupt before adding to newly compacting extents. slower but safer (defaults to true in this version)\n";
+                "  validate - check records are noncorrupt before adding to newly compacting extents. slower but safer (defaults to true in this version)\n"
+                "{ compact : <collection_name>, online:true, [batchSize:<num>], [sleepMillis:<num>],\n"
+                "  [maxExtentFill:<num>] }\n"
+                "  online - move records out of sparse extents in small batches, yielding the lock between\n"
+                "           batches, and free the emptied extents. may run on a primary\n"
+                "  batchSize - records moved per lock acquisition (default 100)\n"
+                "  sleepMillis - pause between batches (default 10)\n"
+                "  maxExtentFill - empty extents whose records fill less than this fraction (default 0.5)\n";
         }
         CompactCmd() : Command("compact") { }
 
@@ -315,7 +520,9 @@ namespace mongo {
                 return false;
             }
 
-            if( isCurrentlyAReplSetPrimary() && !cmdObj["force"].trueValue() ) { 
+            bool online = cmdObj["online"].trueValue();
+
+            if( !online && isCurrentlyAReplSetPrimary() && !cmdObj["force"].trueValue() ) { 
                 errmsg = "will not run compact on an active replica set primary as this is a slow blocking operation. use force:true to force";
                 return false;
             }
@@ -345,6 +552,32 @@ namespace mongo {
                     errmsg = "cannot compact a capped collection";
                     return false;
                 }
+
+                if ( d->isInMemory() ) {
+                    errmsg = "cannot compact an in memory collection";
+                    return false;
+                }
+            }
+
+            if( online ) {
+                OnlineCompactOptions opts;
+                if( cmdObj.hasElement("batchSize") ) {
+                    opts.batchSize = cmdObj["batchSize"].numberInt();
+                    uassert( 17120, "batchSize must be positive", opts.batchSize > 0 );
+                }
+                if( cmdObj.hasElement("sleepMillis") ) {
+                    opts.sleepMillis = cmdObj["sleepMillis"].numberInt();
+                    uassert( 17121, "sleepMillis must not be negative", opts.sleepMillis >= 0 );
+                }
+                if( cmdObj.hasElement("maxExtentFill") ) {
+                    opts.maxExtentFill = cmdObj["maxExtentFill"].Number();
+                    uassert( 17122, "maxExtentFill must be in (0, 1]",
+                             opts.maxExtentFill > 0 && opts.maxExtentFill <= 1.0 );
+                }
+                log() << "compact online " << ns << " begin" << endl;
+                bool ok = _compactOnline(ns, errmsg, result, opts);
+                log() << "compact online " << ns << " end" << endl;
+                return ok;
             }
 
             double pf = 1.0;
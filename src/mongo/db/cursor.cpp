@@ -36,6 +36,7 @@ namespace mongo {
             last = curr;
             curr = s->next( curr );
         }
+        _readAhead.noteRecord( curr );
         incNscanned();
         return ok();
     }
@@ -84,6 +85,7 @@ namespace mongo {
     }
 
     ForwardCappedCursor::ForwardCappedCursor( NamespaceDetails* _nsd ) :
+        BasicCursor( forward(), true ),
         nsd( _nsd ) {
     }
 
@@ -104,6 +106,10 @@ namespace mongo {
         }
         curr = start;
         s = this;
+        if ( nsd->capLooped() ) {
+            // the scan goes on from the first extent after the last one
+            _readAhead.setWrap( nsd->firstExtent() );
+        }
         incNscanned();
     }
 
@@ -128,6 +134,7 @@ namespace mongo {
     }
 
     ReverseCappedCursor::ReverseCappedCursor( NamespaceDetails *_nsd, const DiskLoc &startLoc ) :
+        BasicCursor( reverse(), false ),
         nsd( _nsd ) {
         if ( !nsd )
             return;
@@ -142,6 +149,10 @@ namespace mongo {
         }
         curr = start;
         s = this;
+        if ( nsd->capLooped() ) {
+            // the scan goes on from the last extent after the first one
+            _readAhead.setWrap( nsd->lastExtent() );
+        }
         incNscanned();
     }
 
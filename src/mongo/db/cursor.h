@@ -23,6 +23,7 @@
 #include "mongo/db/matcher.h"
 #include "mongo/db/matcher_covered.h"
 #include "mongo/db/projection.h"
+#include "mongo/db/storage/extent_read_ahead.h"
 
 namespace mongo {
 
@@ -236,11 +237,14 @@ namespace mongo {
      */
     class BasicCursor : public Cursor {
     public:
-        BasicCursor(DiskLoc dl, const AdvanceStrategy *_s = forward()) : curr(dl), s( _s ), _nscanned() {
+        /** @param scanForward - whether '_s' walks the extents of the collection forward */
+        BasicCursor(DiskLoc dl, const AdvanceStrategy *_s = forward(), bool scanForward = true) :
+            curr(dl), s( _s ), _readAhead( scanForward ), _nscanned() {
             incNscanned();
             init();
         }
-        BasicCursor(const AdvanceStrategy *_s = forward()) : s( _s ), _nscanned() {
+        BasicCursor(const AdvanceStrategy *_s = forward(), bool scanForward = true) :
+            s( _s ), _readAhead( scanForward ), _nscanned() {
             init();
         }
         bool ok() { return !curr.isNull(); }
@@ -273,10 +277,15 @@ namespace mongo {
             _keyFieldsOnly = keyFieldsOnly;
         }
         virtual long long nscanned() { return _nscanned; }
+        // the extents queued for read-ahead may be gone once the lock was released, after a
+        // yield or between getMores
+        virtual void recoverFromYield() { _readAhead.reset(); Cursor::recoverFromYield(); }
+        virtual void checkLocation() { _readAhead.reset(); }
 
     protected:
         DiskLoc curr, last;
         const AdvanceStrategy *s;
+        ExtentReadAhead _readAhead;
         void incNscanned() { if ( !curr.isNull() ) { ++_nscanned; } }
     private:
         bool tailable_;
@@ -289,8 +298,8 @@ namespace mongo {
     /* used for order { $natural: -1 } */
     class ReverseCursor : public BasicCursor {
     public:
-        ReverseCursor(DiskLoc dl) : BasicCursor( dl, reverse() ) { }
-        ReverseCursor() : BasicCursor( reverse() ) { }
+        ReverseCursor(DiskLoc dl) : BasicCursor( dl, reverse(), false ) { }
+        ReverseCursor() : BasicCursor( reverse(), false ) { }
         virtual string toString() { return "ReverseCursor"; }
     };
 
@@ -48,6 +48,40 @@ namespace mongo {
         }
         _collections.clear();
 
+        for ( HeapRecordStoreMap::iterator i = _heapRecordStores.begin();
+              i != _heapRecordStores.end(); ++i ) {
+            delete i->second;
+        }
+        _heapRecordStores.clear();
+    }
+
+    void Database::dropInMemoryCollections() {
+        Lock::assertWriteLocked( _name );
+
+        vector<string> toDrop;
+        for ( HeapRecordStoreMap::const_iterator i = _heapRecordStores.begin();
+              i != _heapRecordStores.end(); ++i ) {
+            toDrop.push_back( i->first );
+        }
+
+        for ( size_t i = 0; i < toDrop.size(); i++ ) {
+            const string& ns = toDrop[i];
+
+            string errmsg;
+            BSONObjBuilder result;
+            try {
+                mongo::dropCollection( ns, errmsg, result );
+            }
+            catch ( DBException& e ) {
+                errmsg = e.toString();
+            }
+
+            if ( errmsg.size() > 0 ) {
+                // the next open drops it
+                warning() << "could not drop in memory collection: " << ns
+                          << " because of: " << errmsg << endl;
+            }
+        }
     }
 
     Status Database::validateDBName( const StringData& dbname ) {
@@ -197,16 +231,20 @@ namespace mongo {
         BSONObj nsObj;
         Runner::RunnerState state;
         while (Runner::RUNNER_ADVANCED == (state = runner->getNext(&nsObj, NULL))) {
-            BSONElement e = nsObj.getFieldDotted( "options.temp" );
-            if ( !e.trueValue() )
-                continue;
-
             string ns = nsObj["name"].String();
 
             // Do not attempt to drop indexes
             if ( !NamespaceString::normal(ns.c_str()) )
                 continue;
 
+            // the records of an in memory collection are gone, whatever its options say
+            BSONElement e = nsObj.getFieldDotted( "options.temp" );
+            if ( !e.trueValue() ) {
+                NamespaceDetails* d = _namespaceIndex.details( ns );
+                if ( !d || !d->isInMemory() )
+                    continue;
+            }
+
             toDelete.push_back(ns);
         }
 
@@ -228,13 +266,23 @@ namespace mongo {
         }
     }
 
-    Extent* Database::allocExtent( const char *ns, int size, bool capped, bool enforceQuota ) {
+    Extent* Database::allocExtent( const char *ns, int size, bool capped, bool enforceQuota,
+                                   const StringData& newFileSet ) {
+        NamespaceDetails* d = _namespaceIndex.details( ns );
+        const string fileSet = d ? d->fileSet().toString() : newFileSet.toString();
+
         bool fromFreeList = true;
-        Extent *e = DataFileMgr::allocFromFreeList( ns, size, capped );
+        Extent *e = DataFileMgr::allocFromFreeList( ns, size, capped, fileSet );
         if( e == 0 ) {
             fromFreeList = false;
-            e = _extentManager.createExtent( ns, size, capped, enforceQuota );
+            e = _extentManager.createExtent( ns, size, capped, enforceQuota, fileSet );
         }
+
+        if ( !d && !fileSet.empty() ) {
+            // the first extent created the namespace
+            _namespaceIndex.details( ns )->setFileSet( fileSet );
+        }
+
         LOG(1) << "allocExtent " << ns << " size " << size << ' ' << fromFreeList << endl;
         return e;
     }
@@ -267,8 +315,31 @@ namespace mongo {
         // TODO: XXX-ERH
         // move impl from pdfile.cpp here
 
-        scoped_lock lk( _collectionLock );
-        _collections.erase( fullns.toString() );
+        {
+            scoped_lock lk( _collectionLock );
+            _collections.erase( fullns.toString() );
+        }
+
+        HeapRecordStoreMap::iterator i = _heapRecordStores.find( fullns.toString() );
+        if ( i != _heapRecordStores.end() ) {
+            delete i->second;
+            _heapRecordStores.erase( i );
+        }
+    }
+
+    HeapRecordStore* Database::getHeapRecordStore( const StringData& ns ) {
+        HeapRecordStoreMap::const_iterator i = _heapRecordStores.find( ns.toString() );
+        if ( i == _heapRecordStores.end() )
+            return NULL;
+        return i->second;
+    }
+
+    HeapRecordStore* Database::createHeapRecordStore( const StringData& ns ) {
+        Lock::assertWriteLocked( _name );
+        verify( _heapRecordStores.count( ns.toString() ) == 0 );
+        HeapRecordStore* store = new HeapRecordStore( ns );
+        _heapRecordStores[ns.toString()] = store;
+        return store;
     }
 
     CollectionTemp* Database::getCollectionTemp( const StringData& ns ) {
@@ -307,6 +378,12 @@ namespace mongo {
     Status Database::renameCollection( const StringData& fromNS, const StringData& toNS,
                                        bool stayTemp ) {
 
+        // an in memory collection has to stay temp, so that it is dropped at startup
+        HeapRecordStoreMap::iterator heapStore = _heapRecordStores.find( fromNS.toString() );
+        if ( heapStore != _heapRecordStores.end() && !stayTemp )
+            return Status( ErrorCodes::IllegalOperation,
+                           "an in memory collection can only be renamed with stayTemp" );
+
         // move data namespace
         Status s = _renameSingleNamespace( fromNS, toNS, stayTemp );
         if ( !s.isOK() )
@@ -315,6 +392,12 @@ namespace mongo {
         NamespaceDetails* details = _namespaceIndex.details( toNS );
         verify( details );
 
+        // move the records of an in memory collection
+        if ( heapStore != _heapRecordStores.end() ) {
+            _heapRecordStores[toNS.toString()] = heapStore->second;
+            _heapRecordStores.erase( heapStore );
+        }
+
         // move index namespaces
         string indexName = _name + ".system.indexes";
         BSONObj oldIndexSpec;
@@ -24,6 +24,7 @@
 #include "mongo/db/storage/record.h"
 #include "mongo/db/storage/extent_manager.h"
 #include "mongo/db/structure/collection.h"
+#include "mongo/db/structure/record_store.h"
 
 namespace mongo {
 
@@ -50,6 +51,12 @@ namespace mongo {
 
         void clearTmpCollections();
 
+        /**
+         * drops the in memory collections, whose records go with this object.  closeDatabase()
+         * calls it, and clearTmpCollections() drops those of a database that didn't close.
+         */
+        void dropInMemoryCollections();
+
         /**
          * tries to make sure that this hasn't been deleted
          */
@@ -82,7 +89,12 @@ namespace mongo {
          */
         void preallocateAFile() { _extentManager.preallocateAFile(); }
 
-        Extent* allocExtent( const char *ns, int size, bool capped, bool enforceQuota );
+        /**
+         * @param fileSet - the file set to allocate in if ns does not exist yet.  an existing
+         *                  namespace always allocates in its own set.
+         */
+        Extent* allocExtent( const char *ns, int size, bool capped, bool enforceQuota,
+                             const StringData& fileSet = StringData() );
 
         /**
          * @return true if success.  false if bad level or error creating profile ns
@@ -123,6 +135,15 @@ namespace mongo {
          */
         CollectionTemp* getCollectionTemp( const StringData& ns );
 
+        /**
+         * @return the store of an in memory collection ({ inMemory : true }), or NULL if 'ns'
+         *         is kept in the data files
+         */
+        HeapRecordStore* getHeapRecordStore( const StringData& ns );
+
+        /** creates the store of new in memory collection 'ns' */
+        HeapRecordStore* createHeapRecordStore( const StringData& ns );
+
         Status renameCollection( const StringData& fromNS, const StringData& toNS, bool stayTemp );
 
         /**
@@ -173,6 +194,10 @@ namespace mongo {
         CollectionMap _collections;
         mutex _collectionLock;
 
+        // owned; in memory collections only.  guarded by the database lock.
+        typedef std::map< std::string, HeapRecordStore* > HeapRecordStoreMap;
+        HeapRecordStoreMap _heapRecordStores;
+
     };
 
 } // namespace mongo
@@ -23,6 +23,7 @@
 #include <fstream>
 
 #include "mongo/base/init.h"
+#include "mongo/base/parse_number.h"
 #include "mongo/base/initializer.h"
 #include "mongo/base/status.h"
 #include "mongo/db/auth/authz_manager_external_state_d.h"
@@ -50,6 +51,7 @@
 #include "mongo/db/pdfile.h"
 #include "mongo/db/query/internal_plans.h"
 #include "mongo/db/range_deleter_service.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/repl/repl_start.h"
 #include "mongo/db/repl/replication_server_status.h"
 #include "mongo/db/repl/rs.h"
@@ -486,6 +488,23 @@ namespace mongo {
         return 0;
     }
 
+    // start the write out of dirty data file pages between the syncdelay flushes
+    MONGO_EXPORT_SERVER_PARAMETER(incrementalFlush, bool, true);
+
+    /** @return bytes of dirty pages in the page cache, -1 if unknown */
+    static long long systemDirtyBytes() {
+#if defined(__linux__)
+        ifstream f( "/proc/meminfo" );
+        string line;
+        while ( getline( f, line ) ) {
+            long long kb;
+            if ( sscanf( line.c_str(), "Dirty: %lld kB", &kb ) == 1 )
+                return kb * 1024;
+        }
+#endif
+        return -1;
+    }
+
     /**
      * does background async flushes of mmapped files
      */
@@ -495,7 +514,13 @@ namespace mongo {
             : ServerStatusSection( "backgroundFlushing" ),
               _total_time( 0 ),
               _flushes( 0 ),
-              _last() {
+              _last_time( 0 ),
+              _max_time( 0 ),
+              _last(),
+              _incrementalBytes( 0 ),
+              _periodBytes( 0 ),
+              _bytesPerSec( 0 ),
+              _lastDirty( -1 ) {
         }
 
         virtual bool includeByDefault() const { return true; }
@@ -522,7 +547,17 @@ namespace mongo {
                     continue;
                 }
 
-                sleepmillis( (long long) std::max(0.0, (cmdLine.syncdelay * 1000) - time_flushing) );
+                // until the full flush, start writing out the dirty pages a second at a time so
+                // the io is spread out and the full flush has little left to do
+                long long untilFlush = (long long) std::max(0.0, (cmdLine.syncdelay * 1000) - time_flushing);
+                Timer t;
+                long long left;
+                while ( ( left = untilFlush - t.millis() ) > 0 && !inShutdown() ) {
+                    sleepmillis( std::min( left, 1000LL ) );
+                    left = untilFlush - t.millis();
+                    if ( incrementalFlush && left > 0 )
+                        _flushSome( left );
+                }
 
                 if ( inShutdown() ) {
                     // occasional issue trying to flush during shutdown when sleep interrupted
@@ -533,7 +568,7 @@ namespace mongo {
                 int numFiles = MemoryMappedFile::flushAll( true );
                 time_flushing = (int) (jsTime() - start);
 
-                _flushed(time_flushing);
+                _flushed( time_flushing, t.millis() );
 
                 if( logger::globalLogDomain()->shouldLog(logger::LogSeverity::Debug(1)) || time_flushing >= 10000 ) {
                     log() << "flushing mmaps took " << time_flushing << "ms " << " for " << numFiles << " files" << endl;
@@ -547,27 +582,147 @@ namespace mongo {
             b.appendNumber( "total_ms" , _total_time );
             b.appendNumber( "average_ms" , (_flushes ? (_total_time / double(_flushes)) : 0.0) );
             b.appendNumber( "last_ms" , _last_time );
+            b.appendNumber( "max_ms" , _max_time );
             b.append("last_finished", _last);
+            b.appendNumber( "incremental_MB" , _incrementalBytes / 1000000.0 );
+            b.appendNumber( "incremental_MB_per_sec" , _bytesPerSec / 1000000.0 );
+            if ( _lastDirty >= 0 )
+                b.appendNumber( "dirty_MB" , _lastDirty / 1000000.0 );
             return b.obj();
         }
 
     private:
 
-        void _flushed(int ms) {
+        /** @param msLeft until the next full flush */
+        void _flushSome( long long msLeft ) {
+            long long dirty = systemDirtyBytes();
+            long long grown = _lastDirty >= 0 ? dirty - _lastDirty : 0;
+            _lastDirty = dirty;
+            if ( dirty <= 0 )
+                return;
+
+            // what was dirtied since the last time, and a share of what is dirty so that it is
+            // all started by the full flush.  we can't tell which pages are dirty, so we go over
+            // the share of the files that is that share of the dirty pages.
+            double ticksLeft = std::max( 1.0, msLeft / 1000.0 );
+            double want = std::max( 0LL, grown ) + dirty / ticksLeft;
+            double mapped = (double) MemoryMappedFile::totalMappedLength();
+            double range = std::min( mapped, mapped * want / dirty );
+
+            unsigned long long started = MongoFile::startFlushSome( (unsigned long long) range );
+            _incrementalBytes += started;
+            _periodBytes += started;
+        }
+
+        /** @param periodMs since the previous full flush finished */
+        void _flushed(int ms, long long periodMs) {
             _flushes++;
             _total_time += ms;
             _last_time = ms;
+            _max_time = std::max( _max_time, ms );
             _last = jsTime();
+            _bytesPerSec = periodMs > 0 ? _periodBytes * 1000 / periodMs : 0;
+            _periodBytes = 0;
         }
 
         long long _total_time;
         long long _flushes;
         int _last_time;
+        int _max_time; // longest full flush: what a write waiting on it could stall for
         Date_t _last;
+        unsigned long long _incrementalBytes; // file range whose write out was started between flushes
+        unsigned long long _periodBytes;      // same, since the last full flush
+        unsigned long long _bytesPerSec;      // of that over the last period
+        long long _lastDirty;
 
 
     } dataFileSync;
 
+    // threads allocating data files.  files of one database are allocated one at a time
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(fileAllocatorThreads, int, 2);
+
+    class FileAllocatorServerStatusSection : public ServerStatusSection {
+    public:
+        FileAllocatorServerStatusSection() : ServerStatusSection( "fileAllocator" ) {}
+        virtual bool includeByDefault() const { return true; }
+
+        BSONObj generateSection(const BSONElement& configElement) const {
+            FileAllocator::Stats s = FileAllocator::get()->getStats();
+            BSONObjBuilder b;
+            b.append( "threads" , s.threads );
+            b.append( "pending" , s.pending );
+            b.append( "inProgress" , s.inProgress );
+            b.appendNumber( "filesAllocated" , s.filesAllocated );
+            b.appendNumber( "bytesAllocated" , s.bytesAllocated );
+            b.appendNumber( "allocation_ms" , s.allocationMicros / 1000 );
+            // inserts and the like blocked on a file being allocated
+            b.appendNumber( "waits" , s.waits );
+            b.appendNumber( "wait_ms" , s.waitMicros / 1000 );
+            return b.obj();
+        }
+    } fileAllocatorServerStatusSection;
+
+    // how the data file views are backed, see MemoryMappedFile::MapPolicy.
+    // mmapNumaPolicy is "default", "interleave" or "bind:<node>"
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(mmapHugePages, bool, false);
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(mmapNumaPolicy, string, "default");
+
+    static void setMapPolicy() {
+        MemoryMappedFile::MapPolicy policy;
+        policy.hugePages = mmapHugePages;
+        if ( mmapNumaPolicy == "interleave" ) {
+            policy.numa = MemoryMappedFile::MapPolicy::NumaInterleave;
+        }
+        else if ( str::startsWith( mmapNumaPolicy, "bind:" ) ) {
+            policy.numa = MemoryMappedFile::MapPolicy::NumaBind;
+            Status s = parseNumberFromString( mmapNumaPolicy.substr( 5 ), &policy.numaNode );
+            uassert( 17135, str::stream() << "bad node in mmapNumaPolicy: " << mmapNumaPolicy,
+                     s.isOK() && policy.numaNode >= 0 && policy.numaNode < 1024 );
+        }
+        else {
+            uassert( 17136, str::stream() << "mmapNumaPolicy must be default, interleave or "
+                                          << "bind:<node>, not " << mmapNumaPolicy,
+                     mmapNumaPolicy == "default" );
+        }
+        if ( policy.hugePages || policy.numa != MemoryMappedFile::MapPolicy::NumaDefault )
+            MemoryMappedFile::setMapPolicy( policy );
+    }
+
+    class MappedNumaNodesServerStatusSection : public ServerStatusSection {
+    public:
+        MappedNumaNodesServerStatusSection() : ServerStatusSection( "mappedNumaNodes" ) {}
+        // walks the page tables of every mapped file
+        virtual bool includeByDefault() const { return false; }
+
+        BSONObj generateSection(const BSONElement& configElement) const {
+            bool supported = true;
+            vector<long long> pagesByNode;
+            {
+                LockMongoFilesShared lk;
+                const set<MongoFile*>& files = MongoFile::getAllFiles();
+                for ( set<MongoFile*>::const_iterator i = files.begin();
+                      supported && i != files.end(); i++ ) {
+                    MemoryMappedFile* mmf = dynamic_cast<MemoryMappedFile*>( *i );
+                    if ( mmf )
+                        supported = mmf->residentPagesByNode( &pagesByNode );
+                }
+            }
+
+            BSONObjBuilder b;
+            MemoryMappedFile::MapPolicy policy = MemoryMappedFile::getMapPolicy();
+            b.append( "hugePages" , policy.hugePages );
+            b.append( "numaPolicy" , mmapNumaPolicy );
+            b.append( "supported" , supported );
+            if ( supported ) {
+                BSONObjBuilder nodes( b.subobjStart( "residentPages" ) );
+                for ( size_t i = 0; i < pagesByNode.size(); i++ )
+                    nodes.appendNumber( BSONObjBuilder::numStr( i ), pagesByNode[i] );
+                nodes.done();
+            }
+            return b.obj();
+        }
+    } mappedNumaNodesServerStatusSection;
+
     namespace {
         class MemJournalServerStatusMetric : public ServerStatusMetric {
         public:
@@ -679,7 +834,10 @@ namespace mongo {
         acquirePathLock(forceRepair);
         boost::filesystem::remove_all( dbpath + "/_tmp/" );
 
-        FileAllocator::get()->start();
+        // before any data file is mapped, and before the threads that fault them in start
+        setMapPolicy();
+
+        FileAllocator::get()->start( fileAllocatorThreads );
 
         MONGO_ASSERT_ON_EXCEPTION_WITH_MSG( clearTmpFiles(), "clear tmp files" );
 
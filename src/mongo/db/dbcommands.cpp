@@ -1260,6 +1260,9 @@ namespace mongo {
                 result.appendNumber( "max" , nsd->maxCappedDocs() );
             }
 
+            if ( !nsd->fileSet().empty() )
+                result.append( "fileSet" , nsd->fileSet() );
+
             if ( verbose )
                 result.appendArray( "extents" , extents.arr() );
 
@@ -1277,6 +1280,8 @@ namespace mongo {
             help << 
                 "Sets collection options.\n"
                 "Example: { collMod: 'foo', usePowerOf2Sizes:true }\n"
+                "Example: { collMod: 'foo', segregatedFitAlloc:true }\n"
+                "Example: { collMod: 'foo', hotPlacement:true }\n"
                 "Example: { collMod: 'foo', index: {keyPattern: {a: 1}, expireAfterSeconds: 600} }";
         }
         virtual void addRequiredPrivileges(const std::string& dbname,
@@ -1316,6 +1321,36 @@ namespace mongo {
                         result.appendBool( "usePowerOf2Sizes_new", newPowerOf2 );
                     }
                 }
+                else if ( str::equals( "segregatedFitAlloc", e.fieldName() ) ) {
+                    bool oldSegregated =
+                        nsd->isUserFlagSet( NamespaceDetails::Flag_SegregatedFitAlloc );
+                    bool newSegregated = e.trueValue();
+
+                    if ( oldSegregated != newSegregated ) {
+                        result.appendBool( "segregatedFitAlloc_old", oldSegregated );
+
+                        newSegregated ?
+                            nsd->setUserFlag( NamespaceDetails::Flag_SegregatedFitAlloc ) :
+                            nsd->clearUserFlag( NamespaceDetails::Flag_SegregatedFitAlloc );
+                        nsd->syncUserFlags( ns ); // must keep system.namespaces up-to-date
+
+                        result.appendBool( "segregatedFitAlloc_new", newSegregated );
+                    }
+                }
+                else if ( str::equals( "hotPlacement", e.fieldName() ) ) {
+                    bool oldHot = nsd->isUserFlagSet( NamespaceDetails::Flag_HotPlacement );
+                    bool newHot = e.trueValue();
+
+                    if ( oldHot != newHot ) {
+                        result.appendBool( "hotPlacement_old", oldHot );
+
+                        newHot ? nsd->setUserFlag( NamespaceDetails::Flag_HotPlacement ) :
+                                 nsd->clearUserFlag( NamespaceDetails::Flag_HotPlacement );
+                        nsd->syncUserFlags( ns ); // must keep system.namespaces up-to-date
+
+                        result.appendBool( "hotPlacement_new", newHot );
+                    }
+                }
                 else if ( str::equals( "index", e.fieldName() ) ) {
                     BSONObj indexObj = e.Obj();
                     BSONObj keyPattern = indexObj.getObjectField( "keyPattern" );
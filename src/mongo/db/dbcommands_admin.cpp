@@ -172,6 +172,12 @@ namespace mongo {
                 return false;
             }
 
+            if ( d->isInMemory() ) {
+                // validateNS walks the extents, which an in memory collection leaves empty
+                errmsg = "cannot validate an in memory collection";
+                return false;
+            }
+
             result.append( "ns", ns );
             validateNS( ns.c_str() , d, cmdObj, result);
             return true;
@@ -501,4 +507,41 @@ namespace mongo {
         }
     } validateCmd;
 
+    class ReclaimFreeSpaceCmd : public Command {
+    public:
+        ReclaimFreeSpaceCmd() : Command( "reclaimFreeSpace" ) {}
+        virtual bool logTheOp() { return false; }
+        virtual bool slaveOk() const { return true; }
+        virtual bool maintenanceMode() const { return true; }
+        virtual void help( stringstream& h ) const {
+            h << "give the disk space of freed extents (from dropped collections/indexes or compact)\n"
+                 "back to the operating system.  trailing data files holding only freed extents are\n"
+                 "deleted; other freed extents are released with hole punching where the filesystem\n"
+                 "supports it.  { reclaimFreeSpace : 1 }";
+        }
+        virtual LockType locktype() const { return WRITE; }
+        // syncDataAndTruncateJournal needs the global lock
+        virtual bool lockGlobally() const { return true; }
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            actions.addAction(ActionType::repairDatabase);
+            out->push_back(Privilege(dbname, actions));
+        }
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            log() << "reclaimFreeSpace " << dbname << endl;
+            long long bytesReleased = 0;
+            int filesRemoved = 0;
+            Status status = reclaimFreedSpace( &bytesReleased, &filesRemoved );
+            result.append( "bytesReleased", bytesReleased );
+            result.append( "filesRemoved", filesRemoved );
+            if ( !status.isOK() ) {
+                // removing trailing files may have succeeded; only hole punching is unsupported
+                result.append( "note", status.reason() );
+            }
+            return true;
+        }
+    } reclaimFreeSpaceCmd;
+
 }
@@ -23,15 +23,20 @@
        we will build an output buffer ourself and then use O_DIRECT
        we could be in read lock for this
        for very large objects write directly to redo log in situ?
+       a large commit is cut into pieces of about 1MB at entry boundaries (see JEntry::OpCode_BatchContinues)
      WRITETOJOURNAL
+       the pieces are compressed in parallel (journalCompressorThreads) and appended, as a batch of sections, 
+         each as soon as it and those before it are compressed.  so the disk writes overlap the compression.
        we could be unlocked (the main db lock that is...) for this, with sufficient care, but there is some complexity
          have to handle falling behind which would use too much ram (going back into a read lock would suffice to stop that).
          for now (1.7.5/1.8.0) we are in read lock which is not ideal.
      WRITETODATAFILES
        apply the writes back to the non-private MMF after they are for certain in redo log
      REMAPPRIVATEVIEW
-       we could in a write lock quickly flip readers back to the main view, then stay in read lock and do our real
-         remapping. with many files (e.g., 1000), remapping could be time consuming (several ms), so we don't want
+       done in the read lock the commit was done in: writers are excluded, so nothing is left uncommitted in the
+         private views, and readers see the same data before and after.  windows and solaris need a write lock
+         as a view is briefly unmapped there (see RemapNeedsWriteLock).
+         with many files (e.g., 1000), remapping could be time consuming (several ms), so we don't want
          to be too frequent.
        there could be a slow down immediately after remapping as fresh copy-on-writes for commonly written pages will
          be required.  so doing these remaps fractionally is helpful. 
@@ -68,6 +73,7 @@
 #include "mongo/db/dur_journal.h"
 #include "mongo/db/dur_recover.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/server.h"
 #include "mongo/util/concurrency/race.h"
 #include "mongo/util/mongoutils/hash.h"
@@ -84,8 +90,8 @@ namespace mongo {
         void assertNothingSpooled();
         void unspoolWriteIntents();
 
-        void PREPLOGBUFFER(JSectHeader& outParm, AlignedBuilder&);
-        void WRITETOJOURNAL(JSectHeader h, AlignedBuilder& uncompressed);
+        void PREPLOGBUFFER(JSectHeader& outParm, AlignedBuilder&, vector<unsigned>& sectionEnds);
+        void WRITETOJOURNAL(JSectHeader h, AlignedBuilder& uncompressed, const vector<unsigned>& sectionEnds);
         void WRITETODATAFILES(const JSectHeader& h, AlignedBuilder& uncompressed);
 
         /** declared later in this file
@@ -114,7 +120,7 @@ namespace mongo {
         string _CSVHeader();
 
         string Stats::S::_CSVHeader() { 
-            return "cmts  jrnMB\twrDFMB\tcIWLk\tearly\tprpLgB  wrToJ\twrToDF\trmpPrVw";
+            return "cmts  jrnMB\twrDFMB\tcIWLk\tearly\tprpLgB  wrToJ\twrToDF\trmpPrVw\trmpPs";
         }
 
         string Stats::S::_asCSV() { 
@@ -129,7 +135,8 @@ namespace mongo {
                 (unsigned) (_prepLogBufferMicros/1000) << '\t' << 
                 (unsigned) (_writeToJournalMicros/1000) << '\t' << 
                 (unsigned) (_writeToDataFilesMicros/1000) << '\t' << 
-                (unsigned) (_remapPrivateViewMicros/1000);
+                (unsigned) (_remapPrivateViewMicros/1000) << '\t' << 
+                (unsigned) (_remapPauseMicros/1000);
             return ss.str();
         }
 
@@ -143,12 +150,20 @@ namespace mongo {
                        "compression" << _journaledBytes / (_uncompressedBytes+1.0) <<
                        "commitsInWriteLock" << _commitsInWriteLock <<
                        "earlyCommits" << _earlyCommits << 
+                       "remapsInWriteLock" << _remapsInWriteLock <<
+                       "batchedSections" << _batchedSections <<
+                       "coalescedMB" << _coalescedBytes / 1000000.0 <<
+                       "journalFilesRecycled" << _journalFilesRecycled <<
+                       "journalFilesCreated" << _journalFilesCreated <<
                        "timeMs" <<
                        BSON( "dt" << _dtMillis <<
                              "prepLogBuffer" << (unsigned) (_prepLogBufferMicros/1000) <<
                              "writeToJournal" << (unsigned) (_writeToJournalMicros/1000) <<
                              "writeToDataFiles" << (unsigned) (_writeToDataFilesMicros/1000) <<
-                             "remapPrivateView" << (unsigned) (_remapPrivateViewMicros/1000)
+                             "remapPrivateView" << (unsigned) (_remapPrivateViewMicros/1000) <<
+                             "remapPause" << (unsigned) (_remapPauseMicros/1000) <<
+                             "rotate" << (unsigned) (_rotateMicros/1000) <<
+                             "prealloc" << (unsigned) (_preallocMicros/1000)
                            );
             if( cmdLine.journalCommitInterval != 0 )
                 b << "journalCommitIntervalMs" << cmdLine.journalCommitInterval;
@@ -448,6 +463,17 @@ namespace mongo {
 
         extern size_t privateMapBytes;
 
+#if defined(_WIN32) || defined(__sunos__)
+        // there is a window during which a view being remapped is not mapped at all, so
+        // readers have to be kept out too.  see the LockMongoFilesExclusive below.
+        const bool RemapNeedsWriteLock = true;
+#else
+        // mmap MAP_FIXED replaces the old view in one step, and the new one has the same
+        // contents once the writes are in the data files.  so excluding writers (R) is enough:
+        // there is then nothing uncommitted in the private views that the remap would drop.
+        const bool RemapNeedsWriteLock = false;
+#endif
+
         static void _REMAPPRIVATEVIEW() {
             // todo: Consider using ProcessInfo herein and watching for getResidentSize to drop.  that could be a way 
             //       to assure very good behavior here.
@@ -457,7 +483,7 @@ namespace mongo {
 
             LOG(4) << "journal REMAPPRIVATEVIEW" << endl;
 
-            verify( Lock::isW() );
+            verify( Lock::isW() || ( !RemapNeedsWriteLock && Lock::isR() ) );
             verify( !commitJob.hasWritten() );
 
             // we want to remap all private views about every 2 seconds.  there could be ~1000 views so
@@ -542,10 +568,12 @@ namespace mongo {
         // below.  however we don't truly do that so that we don't have to 
         // reallocate, and more importantly regrow it, on every single commit.
         static AlignedBuilder __theBuilder(4 * 1024 * 1024);
+        static vector<unsigned> __theSectionEnds;
 
         static bool _groupCommitWithLimitedLocks() {
             unspoolWriteIntents(); // in case we were doing some writing ourself (likely impossible with limitedlocks version)
             AlignedBuilder &ab = __theBuilder;
+            vector<unsigned> &sectionEnds = __theSectionEnds;
 
             verify( ! Lock::isLocked() );
 
@@ -566,7 +594,7 @@ namespace mongo {
             }
 
             JSectHeader h;
-            PREPLOGBUFFER(h,ab); // need to be in readlock (writes excluded) for this
+            PREPLOGBUFFER(h,ab,sectionEnds); // need to be in readlock (writes excluded) for this
 
             LockMongoFilesShared lk3;
 
@@ -579,7 +607,7 @@ namespace mongo {
 
             // ****** now other threads can do writes ******
 
-            WRITETOJOURNAL(h, ab);
+            WRITETOJOURNAL(h, ab, sectionEnds);
             verify( abLen == ab.len() ); // a check that no one touched the builder while we were doing work. if so, our locking is wrong.
 
             // data is now in the journal, which is sufficient for acknowledging getLastError.
@@ -634,6 +662,7 @@ namespace mongo {
 
             {
                 AlignedBuilder &ab = __theBuilder;
+                vector<unsigned> &sectionEnds = __theSectionEnds;
 
                 // we need to make sure two group commits aren't running at the same time
                 // (and we are only read locked in the dbMutex, so it could happen)
@@ -647,12 +676,12 @@ namespace mongo {
                 }
                 else {
                     JSectHeader h;
-                    PREPLOGBUFFER(h,ab);
+                    PREPLOGBUFFER(h,ab,sectionEnds);
 
                     // todo : write to the journal outside locks, as this write can be slow.
                     //        however, be careful then about remapprivateview as that cannot be done 
                     //        if new writes are then pending in the private maps.
-                    WRITETOJOURNAL(h, ab);
+                    WRITETOJOURNAL(h, ab, sectionEnds);
 
                     // data is now in the journal, which is sufficient for acknowledging getLastError.
                     // (ok to crash after that)
@@ -672,7 +701,12 @@ namespace mongo {
             // we wouldn't see newly written data on reads.
             //
             DEV verify( !commitJob.hasWritten() );
-            if( !Lock::isW() ) {
+            if( !RemapNeedsWriteLock && Lock::isR() ) {
+                // writers are excluded for the whole commit already; readers go on while we
+                // remap.
+                REMAPPRIVATEVIEW();
+            }
+            else if( !Lock::isW() ) {
                 // REMAPPRIVATEVIEW needs done in a write lock (as there is a short window during remapping when each view 
                 // might not exist) thus we do it later.
                 // 
@@ -685,8 +719,11 @@ namespace mongo {
                 // to be in W the entire time we were committing about (in particular for WRITETOJOURNAL() which takes time).
                 if( lgw ) { 
                     LOG(4) << "_groupCommit upgrade" << endl;
+                    Timer t;
                     lgw->upgrade();
                     REMAPPRIVATEVIEW();
+                    stats.curr->_remapsInWriteLock++;
+                    stats.curr->_remapPauseMicros += t.micros();
                 }
             }
             else {
@@ -695,7 +732,10 @@ namespace mongo {
                 // may do a write without a new lock acquisition.  this can happen when DurableMappedFile::close() calls
                 // this method when a file (and its views) is about to go away.
                 //
+                Timer t;
                 REMAPPRIVATEVIEW();
+                stats.curr->_remapsInWriteLock++;
+                stats.curr->_remapPauseMicros += t.micros();
             }
         }
 
@@ -742,8 +782,17 @@ namespace mongo {
                     return;
             }
 
+            if( !RemapNeedsWriteLock && privateMapBytes < UncommittedBytesLimit ) {
+                // commit and remap in a read lock: readers are never stopped.  waiting for
+                // the lock does not stop anyone either, unlike a pending write lock.
+                Lock::GlobalRead r;
+                groupCommit(0);
+                return;
+            }
+
             // we get a write lock, downgrade, do work, upgrade, finish work.
             // getting a write lock is helpful also as we need to be greedy and not be starved here
+            // (writes outpacing the commits, for the read lock version above).
             // note our "stopgreed" parm -- to stop greed by others while we are working. you can't write 
             // anytime soon anyway if we are journaling for a while, that was the idea.
             Lock::GlobalWrite w(/*stopgreed:*/true);
@@ -772,6 +821,11 @@ namespace mongo {
         extern int groupCommitIntervalMs;
         boost::filesystem::path getJournalDir();
 
+        /** how long a getLastError j:true may wait for the scheduled group commit before one is
+            done early for it.  negative for a third of the commit interval.
+        */
+        MONGO_EXPORT_SERVER_PARAMETER(journalCommitMaxWaitMs, int, -1);
+
         void durThread() {
             Client::initThread("journal");
 
@@ -793,18 +847,37 @@ namespace mongo {
                 }
 
                 unsigned oneThird = (ms / 3) + 1; // +1 so never zero
+                int maxWaitParam = journalCommitMaxWaitMs;
+                unsigned maxWait = maxWaitParam >= 0 ? maxWaitParam : oneThird;
+                unsigned step = std::max( 1U, std::min( oneThird, maxWait / 2 ) );
 
                 try {
                     stats.rotate();
 
-                    // commit sooner if one or more getLastError j:true is pending
-                    sleepmillis(oneThird);
-                    for( unsigned i = 1; i <= 2; i++ ) {
-                        if( commitJob._notify.nWaiting() )
+                    // getLastError j:true waiters park on the commit number and are all woken by the
+                    // next group commit.  it is done early for them only once the first has waited 
+                    // maxWait, so that many writers share one journal write.
+                    Timer t;
+                    unsigned lastLook = 0;
+                    unsigned waitersSince = 0;
+                    bool waiters = false;
+                    while( 1 ) {
+                        sleepmillis(step);
+                        unsigned now = t.millis();
+                        if( now >= ms )
                             break;
                         if( commitJob.bytes() > UncommittedBytesLimit / 2  )
                             break;
-                        sleepmillis(oneThird);
+                        if( commitJob._notify.nWaiting() ) {
+                            if( !waiters ) {
+                                // could have come any time since we last looked
+                                waiters = true;
+                                waitersSince = lastLook;
+                            }
+                            if( now - waitersSince >= maxWait )
+                                break;
+                        }
+                        lastLook = now;
                     }
                                         
                     //DEV log() << "privateMapBytes=" << privateMapBytes << endl;
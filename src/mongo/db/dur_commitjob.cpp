@@ -22,6 +22,7 @@
 
 #include "mongo/db/client.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/structure/record_store.h"
 #include "mongo/db/taskqueue.h"
 #include "mongo/util/concurrency/threadlocal.h"
 #include "mongo/util/stacktrace.h"
@@ -125,6 +126,10 @@ namespace mongo {
         /** we batch up our write intents so that we do not have to synchronize too often */
         void DurableImpl::declareWriteIntent(void *p, unsigned len) {
             cc().writeHappened();
+            if( HeapRecordStore::ownsMemory(p) ) {
+                // records of in memory collections are not journaled
+                return;
+            }
             MemoryMappedFile::makeWritable(p, len);
             ThreadLocalIntents *t = tlIntents.getMake();
             t->push(WriteIntent(p,len));
@@ -149,6 +154,8 @@ namespace mongo {
             _alreadyNoted.clear();
             _intents.clear();
             _durOps.clear();
+            _nDeclared = 0;
+            _declaredBytes = 0;
 #if defined(DEBUG_WRITE_INTENT)
             cout << "_debug clear\n";
             _debug.clear();
@@ -205,6 +212,9 @@ namespace mongo {
 
             dassert( _hasWritten );
 
+            _intentsAndDurOps._nDeclared++;
+            _intentsAndDurOps._declaredBytes += len;
+
             // from the point of view of the dur module, it would be fine (i think) to only
             // be read locked here.  but must be at least read locked to avoid race with
             // remapprivateview
@@ -43,6 +43,7 @@ namespace mongo {
             void* end() const                              { return p; }
             unsigned length() const                        { return len; }
             bool operator < (const WriteIntent& rhs) const { return end() < rhs.end(); }
+            static bool startsBefore(const WriteIntent& a, const WriteIntent& b) { return a.start() < b.start(); }
             bool overlaps(const WriteIntent& rhs) const    { return (start() <= rhs.end() && end() >= rhs.start()); }
             bool contains(const WriteIntent& rhs) const    { return (start() <= rhs.start() && end() >= rhs.end()); }
             // merge into me:
@@ -93,6 +94,12 @@ namespace mongo {
             Already<127> _alreadyNoted;
             vector< shared_ptr<DurOp> > _durOps; // all the ops other than basic writes
 
+            // every note() of the commit, counted before any dedup, to see how much merging saves
+            unsigned _nDeclared;
+            unsigned long long _declaredBytes;
+
+            IntentsAndDurOps() : _nDeclared(0), _declaredBytes(0) { }
+
             /** reset the IntentsAndDurOps structure (empties all the above) */
             void clear();
 
@@ -171,15 +178,19 @@ namespace mongo {
             /** we check how much written and if it is getting to be a lot, we commit sooner. */
             size_t bytes() const { return _bytes; }
 
-            /** used in prepbasicwrites. sorted so that overlapping and duplicate items 
-             * can be merged.  we sort here so the caller receives something they must 
+            /** used in prepbasicwrites. sorted by start so that overlapping, adjacent and duplicate
+             * items can be merged in one pass.  we sort here so the caller receives something they must 
              * keep const from their pov. */
             const vector<WriteIntent>& getIntentsSorted() {
                 groupCommitMutex.dassertLocked();
-                sort(_intentsAndDurOps._intents.begin(), _intentsAndDurOps._intents.end());
+                sort(_intentsAndDurOps._intents.begin(), _intentsAndDurOps._intents.end(), WriteIntent::startsBefore);
                 return _intentsAndDurOps._intents;
             }
 
+            /** write intents noted this commit and their bytes, duplicates included */
+            unsigned nDeclared() const { return _intentsAndDurOps._nDeclared; }
+            unsigned long long declaredBytes() const { return _intentsAndDurOps._declaredBytes; }
+
             bool _hasWritten;
 
         private:
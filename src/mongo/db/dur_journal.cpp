@@ -28,12 +28,14 @@
 #include "mongo/db/dur_journalformat.h"
 #include "mongo/db/dur_journalimpl.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/platform/random.h"
 #include "mongo/server.h"
 #include "mongo/util/alignedbuilder.h"
 #include "mongo/util/checksum.h"
 #include "mongo/util/compress.h"
 #include "mongo/util/concurrency/race.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/file.h"
 #include "mongo/util/logfile.h"
 #include "mongo/util/mmap.h"
@@ -396,9 +398,9 @@ namespace mongo {
             if (! (cmdLine.durOptions & CmdLine::DurNoCheckSpace))
                 checkFreeSpace();
 
-            if( exists(preallocPath(0)) || // if enabled previously, keep using
-                exists(preallocPath(1)) ||
-                ( cmdLine.preallocj && preallocateIsFaster() ) ) {
+            // prealloc.<n> files left by a previous run may just be recycled journal files, so they
+            // are not a sign zero filling was found faster here.  they are used either way.
+            if( cmdLine.preallocj && preallocateIsFaster() ) {
                     usingPreallocate = true;
                     try {
                         _preallocateFiles();
@@ -411,13 +413,32 @@ namespace mongo {
             j.open();
         }
 
+        /** rename retired journal files into prealloc.<n> rather than deleting them, so that rotation
+            reuses their blocks instead of allocating a new file.  a recycled file keeps its old
+            sections past the new header; recovery stops at the first with a differing fileId.
+        */
+        MONGO_EXPORT_STARTUP_SERVER_PARAMETER(journalRecycleFiles, bool, true);
+
+        /** files shorter than a full journal file (the last one at a clean shutdown) are not worth
+            recycling: extending them would leave a sparse file, allocated as it is written anyway.
+        */
+        static bool worthRecycling(const boost::filesystem::path& p) {
+            try {
+                return boost::filesystem::file_size(p) >= DataLimitPerJournalFile;
+            }
+            catch (const std::exception&) {
+                return false;
+            }
+        }
+
         void removeOldJournalFile(boost::filesystem::path p) { 
-            if( usingPreallocate ) {
+            if( usingPreallocate || ( journalRecycleFiles && worthRecycling(p) ) ) {
                 try {
                     for( int i = 0; i < NUM_PREALLOC_FILES; i++ ) {
                         boost::filesystem::path filepath = preallocPath(i);
                         if( !boost::filesystem::exists(filepath) ) {
                             // we can recycle this file into this prealloc file location
+                            Timer t;
                             boost::filesystem::path temppath = filepath.string() + ".temp";
                             boost::filesystem::rename(p, temppath);
                             {
@@ -431,6 +452,8 @@ namespace mongo {
                                 f.fsync();
                             }
                             boost::filesystem::rename(temppath, filepath);
+                            stats.curr->_journalFilesRecycled++;
+                            stats.curr->_preallocMicros += t.micros();
                             return;
                         }
                     }
@@ -488,6 +511,7 @@ namespace mongo {
             boost::filesystem::path fname = getFilePathFor(_nextFileNumber);
 
             // if we have a prealloced file, use it 
+            bool prealloced = false;
             {
                 boost::filesystem::path p = findPrealloced();
                 if( !p.empty() ) { 
@@ -501,6 +525,7 @@ namespace mongo {
                             f.synchronousAppend(b.buf(), b.len());
                         }
                         boost::filesystem::rename(p, fname);
+                        prealloced = true;
                     }
                     catch (const std::exception& e) {
                         log() << "warning couldn't write to / rename file " << p.string()
@@ -509,6 +534,9 @@ namespace mongo {
                 }
             }
 
+            if( !prealloced )
+                stats.curr->_journalFilesCreated++;
+
             _curLogFile = new LogFile(fname.string());
             _nextFileNumber++;
             {
@@ -675,6 +703,7 @@ namespace mongo {
             if( _curLogFile && _written < DataLimitPerJournalFile )
                 return;
 
+            Timer rotateTimer;
             if( _curLogFile ) {
                 _curLogFile->truncate();
                 closeCurrentJournalFile();
@@ -688,6 +717,7 @@ namespace mongo {
                 if( ms >= 200 ) {
                     log() << "DR101 latency warning on journal file open " << ms << "ms" << endl;
                 }
+                stats.curr->_rotateMicros += rotateTimer.micros();
             }
             catch(std::exception& e) {
                 log() << "warning exception opening journal file " << e.what() << endl;
@@ -698,35 +728,117 @@ namespace mongo {
         /** write (append) the buffer we have built to the journal and fsync it.
             outside of dbMutex lock as this could be slow.
             @param uncompressed - a buffer that will be written to the journal after compression
+            @param sectionEnds - where PREPLOGBUFFER cut uncompressed into a batch of sections
             will not return until on disk
         */
-        void WRITETOJOURNAL(JSectHeader h, AlignedBuilder& uncompressed) {
+        void WRITETOJOURNAL(JSectHeader h, AlignedBuilder& uncompressed, const vector<unsigned>& sectionEnds) {
             Timer t;
-            j.journal(h, uncompressed);
+            j.journal(h, uncompressed, sectionEnds);
             stats.curr->_writeToJournalMicros += t.micros();
         }
-        void Journal::journal(const JSectHeader& h, const AlignedBuilder& uncompressed) {
-            RACECHECK
-            static AlignedBuilder b(32*1024*1024);
-            /* buffer to journal will be
+        /** threads compressing the sections of a batch.  0 to journal each group commit as one section. */
+        MONGO_EXPORT_STARTUP_SERVER_PARAMETER(journalCompressorThreads, int, 4);
+
+        static const unsigned BatchSectionBytes = 1024 * 1024;
+
+        unsigned Journal::batchSectionBytes() const {
+            return journalCompressorThreads > 0 ? BatchSectionBytes : 0;
+        }
+
+        /** the codec new sections are written with.  a JSectCodec, set by journalCompressor. */
+        static volatile int journalCodec = JSectCodec_Snappy;
+
+        /** the zstd level of sections written with journalCompressor zstd, 1 (fastest) to 22 */
+        MONGO_EXPORT_SERVER_PARAMETER(journalCompressorLevel, int, 3);
+
+        /** journalCompressor : "snappy", "zstd" or "none".  may be changed at runtime, sections
+            written from then on use it.  zstd costs more cpu than snappy but writes fewer bytes,
+            for nodes whose journal disk is the bottleneck.  a section that doesn't compress is
+            written as is.
+        */
+        class JournalCompressorParameter : public ServerParameter {
+        public:
+            JournalCompressorParameter()
+                : ServerParameter( ServerParameterSet::getGlobal(), "journalCompressor" ) {
+            }
+
+            virtual void append( BSONObjBuilder& b, const string& name ) {
+                switch ( journalCodec ) {
+                case JSectCodec_None: b.append( name, "none" ); break;
+                case JSectCodec_Zstd: b.append( name, "zstd" ); break;
+                default: b.append( name, "snappy" ); break;
+                }
+            }
+
+            virtual Status set( const BSONElement& newValueElement ) {
+                if ( newValueElement.type() != String )
+                    return Status( ErrorCodes::BadValue, "journalCompressor must be a string" );
+                return setFromString( newValueElement.valuestrsafe() );
+            }
+
+            virtual Status setFromString( const string& codec ) {
+                if ( codec == "snappy" )
+                    journalCodec = JSectCodec_Snappy;
+                else if ( codec == "zstd" )
+                    journalCodec = JSectCodec_Zstd;
+                else if ( codec == "none" )
+                    journalCodec = JSectCodec_None;
+                else
+                    return Status( ErrorCodes::BadValue,
+                                   str::stream() << "unknown journalCompressor " << codec
+                                                 << ", expected snappy, zstd or none" );
+                return Status::OK();
+            }
+        } journalCompressorParameter;
+
+        /** builds, in b, the section for uncompressed:
                JSectHeader
                compressed operations
                JSectFooter
-            */
+               padding to Alignment
+            @return the padded length
+        */
+        static unsigned buildSection(AlignedBuilder& b, const JSectHeader& h, const char *uncompressed, unsigned len) {
             const unsigned headTailSize = sizeof(JSectHeader) + sizeof(JSectFooter);
-            const unsigned max = maxCompressedLength(uncompressed.len()) + headTailSize;
+            JSectCodec codec = (JSectCodec) journalCodec;
+            const unsigned max = std::max( std::max( (unsigned) maxCompressedLength(len),
+                                                     (unsigned) zstdMaxCompressedLength(len) ),
+                                           len ) + headTailSize;
+            massert( 17141, "journal section too large", max <= JSectHeader::LenMask );
             b.reset(max);
 
             {
-                dassert( h.sectionLen() == (unsigned) 0xffffffff ); // we will backfill later
+                dassert( h.sectionLen() == (unsigned) JSectHeader::LenMask ); // we will backfill later
                 b.appendStruct(h);
             }
 
-            size_t compressedLength = 0;
-            rawCompress(uncompressed.buf(), uncompressed.len(), b.cur(), &compressedLength);
-            verify( compressedLength < 0xffffffff );
-            verify( compressedLength < max );
-            b.skip(compressedLength);
+            if( codec == JSectCodec_Snappy ) {
+                size_t compressedLength = 0;
+                rawCompress(uncompressed, len, b.cur(), &compressedLength);
+                verify( compressedLength < 0xffffffff );
+                verify( compressedLength < max );
+                if( compressedLength < len - len / 8 ) {
+                    b.skip(compressedLength);
+                }
+                else {
+                    // doesn't pay for the uncompress on recovery
+                    codec = JSectCodec_None;
+                }
+            }
+            else if( codec == JSectCodec_Zstd ) {
+                size_t compressedLength = 0;
+                if( zstdRawCompress(uncompressed, len, journalCompressorLevel, b.cur(),
+                                    max - headTailSize, &compressedLength) &&
+                    compressedLength < len - len / 8 ) {
+                    b.skip(compressedLength);
+                }
+                else {
+                    codec = JSectCodec_None;
+                }
+            }
+            if( codec == JSectCodec_None ) {
+                b.appendBuf(uncompressed, len);
+            }
 
             // footer
             unsigned L = 0xffffffff;
@@ -737,7 +849,7 @@ namespace mongo {
                 L = (lenUnpadded + Alignment-1) & (~(Alignment-1));
                 dassert( L >= lenUnpadded );
 
-                ((JSectHeader*)b.atOfs(0))->setSectionLen(lenUnpadded);
+                ((JSectHeader*)b.atOfs(0))->setSectionLen(lenUnpadded, codec);
 
                 JSectFooter f(b.buf(), b.len()); // computes checksum
                 b.appendStruct(f);
@@ -746,6 +858,103 @@ namespace mongo {
                 b.skip(L - lenUnpadded);
                 dassert( b.len() % Alignment == 0 );
             }
+            return L;
+        }
+
+        /** a section of a batch, compressed on one of the journal compressor threads */
+        class BatchSection : boost::noncopyable {
+        public:
+            BatchSection() : b(BatchSectionBytes + BatchSectionBytes / 4), _src(0), _len(0), _padded(0) { }
+            AlignedBuilder b;
+
+            void reset(const char *src, unsigned len) { 
+                _src = src;
+                _len = len;
+                _padded = 0;
+            }
+
+            /** thread: a compressor */
+            void compress(JSectHeader h) {
+                unsigned padded = 0;
+                try {
+                    padded = buildSection(b, h, _src, _len);
+                }
+                catch(std::exception& e) {
+                    log() << "error exception compressing journal section " << e.what() << endl;
+                    padded = 0xffffffff;
+                }
+                scoped_lock lk(_m);
+                _padded = padded;
+                _compressed.notify_all();
+            }
+
+            /** @return the padded length of the section in b, once compressed */
+            unsigned waitCompressed() {
+                scoped_lock lk(_m);
+                while( _padded == 0 )
+                    _compressed.wait(lk.boost());
+                return _padded;
+            }
+
+            unsigned uncompressedLen() const { return _len; }
+
+        private:
+            const char *_src;
+            unsigned _len;
+            unsigned _padded; // 0 until compressed, 0xffffffff on failure
+            static mongo::mutex _m;
+            static boost::condition _compressed;
+        };
+        mongo::mutex BatchSection::_m("journalBatchSection");
+        boost::condition BatchSection::_compressed;
+
+        static void compressBatchSection(BatchSection *s, JSectHeader h) {
+            s->compress(h);
+        }
+
+        void Journal::journal(const JSectHeader& h, const AlignedBuilder& uncompressed, const vector<unsigned>& sectionEnds) {
+            RACECHECK
+            if( sectionEnds.empty() ) {
+                static AlignedBuilder b(32*1024*1024);
+                unsigned L = buildSection(b, h, uncompressed.buf(), uncompressed.len());
+
+                try {
+                    SimpleMutex::scoped_lock lk(_curLogFileMutex);
+
+                    // must already be open -- so that _curFileId is correct for previous buffer building
+                    verify( _curLogFile );
+
+                    stats.curr->_uncompressedBytes += uncompressed.len();
+                    unsigned w = b.len();
+                    _written += w;
+                    verify( w <= L );
+                    stats.curr->_journaledBytes += L;
+                    _curLogFile->synchronousAppend((const void *) b.buf(), L);
+                    _rotate();
+                }
+                catch(std::exception& e) {
+                    log() << "error exception in dur::journal " << e.what() << endl;
+                    throw;
+                }
+                return;
+            }
+
+            // a batch.  the compressors work ahead while we write out the sections already done,
+            // in order.  we rotate only after the last one so a batch is never split over files.
+            static ThreadPool *compressors = new ThreadPool( std::min( std::max( (int)journalCompressorThreads, 1 ), 64 ) );
+            static vector< boost::shared_ptr<BatchSection> > sections;
+            const unsigned nSections = sectionEnds.size() + 1;
+            while( sections.size() < nSections )
+                sections.push_back( boost::shared_ptr<BatchSection>( new BatchSection() ) );
+
+            unsigned start = 0;
+            for( unsigned i = 0; i < nSections; i++ ) {
+                unsigned end = i < sectionEnds.size() ? sectionEnds[i] : uncompressed.len();
+                verify( start < end && end <= (unsigned) uncompressed.len() );
+                sections[i]->reset(uncompressed.buf() + start, end - start);
+                compressors->schedule(compressBatchSection, sections[i].get(), h);
+                start = end;
+            }
 
             try {
                 SimpleMutex::scoped_lock lk(_curLogFileMutex);
@@ -753,16 +962,26 @@ namespace mongo {
                 // must already be open -- so that _curFileId is correct for previous buffer building
                 verify( _curLogFile );
 
-                stats.curr->_uncompressedBytes += uncompressed.len();
-                unsigned w = b.len();
-                _written += w;
-                verify( w <= L );
-                stats.curr->_journaledBytes += L;
-                _curLogFile->synchronousAppend((const void *) b.buf(), L);
+                for( unsigned i = 0; i < nSections; i++ ) {
+                    BatchSection& s = *sections[i];
+                    unsigned L = s.waitCompressed();
+                    if( L == 0xffffffff ) {
+                        compressors->join(); // they use the buffers
+                        msgasserted(17139, "couldn't compress journal section");
+                    }
+                    stats.curr->_uncompressedBytes += s.uncompressedLen();
+                    unsigned w = s.b.len();
+                    _written += w;
+                    verify( w <= L );
+                    stats.curr->_journaledBytes += L;
+                    _curLogFile->synchronousAppend((const void *) s.b.buf(), L);
+                }
+                stats.curr->_batchedSections += nSections;
                 _rotate();
             }
             catch(std::exception& e) {
                 log() << "error exception in dur::journal " << e.what() << endl;
+                compressors->join();
                 throw;
             }
         }
@@ -37,9 +37,15 @@ namespace mongo {
             // x4142 is asci--readable if you look at the file with head/less -- thus the starting values were near
             // that.  simply incrementing the version # is safe on a fwd basis.
 #if defined(_NOCOMPRESS)
-            enum { CurrentVersion = 0x4148 };
+            // 0x4151: 0x4148 with the batches of sections and the section codecs of 0x414a to
+            // 0x414c.  kept apart from the versions below, so only files of this version are read.
+            enum { CurrentVersion = 0x4151, OldestReadableVersion = 0x4151 };
 #else
-            enum { CurrentVersion = 0x4149 };
+            // 0x414a: a group commit may be journaled as a batch of sections (JEntry::OpCode_BatchContinues).
+            // 0x414b: the codec of a section is in its JSectHeader (JSectCodec).
+            // 0x414c: sections may be compressed with zstd (JSectCodec_Zstd).
+            // files from 0x4149 are a subset of that, so we still recover them.
+            enum { CurrentVersion = 0x414c, OldestReadableVersion = 0x4149 };
 #endif
             unsigned short _version;
 
@@ -55,25 +61,40 @@ namespace mongo {
             char reserved3[8026]; // 8KB total for the file header
             char txt2[2];         // "\n\n" at the end
 
-            bool versionOk() const { return _version == CurrentVersion; }
+            bool versionOk() const { 
+                return _version >= OldestReadableVersion && _version <= CurrentVersion;
+            }
             bool valid() const { return magic[0] == 'j' && txt2[1] == '\n' && fileId; }
         };
 
+        /** how the data of a section is compressed.  snappy is 0 as that is what the sections
+            from before there was a choice are.
+        */
+        enum JSectCodec {
+            JSectCodec_Snappy = 0,
+            JSectCodec_None   = 1,
+            JSectCodec_Zstd   = 2
+        };
+
         /** "Section" header.  A section corresponds to a group commit.
             len is length of the entire section including header and footer.
             header and footer are not compressed, just the stuff in between.
         */
         struct JSectHeader {
         private:
-            unsigned _sectionLen;          // unpadded length in bytes of the whole section
+            unsigned _sectionLen;          // unpadded length in bytes of the whole section; the codec in the top bits
         public:
+            enum { LenMask = 0x3fffffff, CodecShift = 30 };
             unsigned long long seqNumber;  // sequence number that can be used on recovery to not do too much work
             unsigned long long fileId;     // matches JHeader::fileId
-            unsigned sectionLen() const { return _sectionLen; }
+            unsigned sectionLen() const { return _sectionLen & LenMask; }
+            JSectCodec codec() const { return (JSectCodec) (_sectionLen >> CodecShift); }
 
             // we store the unpadded length so we can use that when we uncompress. to 
             // get the true total size this must be rounded up to the Alignment.
-            void setSectionLen(unsigned lenUnpadded) { _sectionLen = lenUnpadded; }
+            void setSectionLen(unsigned lenUnpadded, JSectCodec codec = JSectCodec_Snappy) { 
+                _sectionLen = (lenUnpadded & LenMask) | (codec << CodecShift);
+            }
 
             unsigned sectionLenWithPadding() const { 
                 unsigned x = (sectionLen() + (Alignment-1)) & (~(Alignment-1));
@@ -84,6 +105,8 @@ namespace mongo {
 
         /** an individual write operation within a group commit section.  Either the entire section should
             be applied, or nothing.  (We check the md5 for the whole section before doing anything on recovery.)
+            A large group commit is written as a batch of sections, each but the last ending with 
+            OpCode_BatchContinues; recovery applies the batch only once its last section is read.
         */
         struct JEntry {
             enum OpCodes {
@@ -91,6 +114,7 @@ namespace mongo {
                 OpCode_DbContext   = 0xfffffffe,
                 OpCode_FileCreated = 0xfffffffd,
                 OpCode_DropDb      = 0xfffffffc,
+                OpCode_BatchContinues = 0xfffffffb, // last entry of a section, more of the group commit follows
                 OpCode_Min         = 0xfffff000
             };
             union {
@@ -42,8 +42,16 @@ namespace mongo {
             void rotate();
 
             /** append to the journal file
+                @param sectionEnds offsets in b after each OpCode_BatchContinues entry.  the pieces
+                       between them are compressed in parallel and written as a batch of sections,
+                       each one as soon as it and those before it are compressed.
             */
-            void journal(const JSectHeader& h, const AlignedBuilder& b);
+            void journal(const JSectHeader& h, const AlignedBuilder& b, const vector<unsigned>& sectionEnds);
+
+            /** a group commit is cut into a batch of sections about this size (uncompressed).
+                0 if it is to be written as one section.
+            */
+            unsigned batchSectionBytes() const;
 
             boost::filesystem::path getFilePathFor(int filenumber) const;
 
@@ -34,6 +34,7 @@
 #include "mongo/db/dur_stats.h"
 #include "mongo/server.h"
 #include "mongo/util/alignedbuilder.h"
+#include "mongo/util/mmap.h"
 #include "mongo/util/mongoutils/hash.h"
 #include "mongo/util/mongoutils/str.h"
 #include "mongo/util/stacktrace.h"
@@ -117,41 +118,76 @@ namespace mongo {
 
         void assertNothingSpooled();
 
+        /** true if the gap between two intents is worth journaling to save a JEntry.  only
+            within a page, so both ends are in the same view and the bytes between are mapped.
+        */
+        static bool fillGap(const WriteIntent& last, const WriteIntent& next) {
+            size_t a = (size_t) last.end();
+            size_t b = (size_t) next.start();
+            dassert( a < b );
+            return b - a < sizeof(JEntry) && (a - 1) / g_minOSPageSizeBytes == b / g_minOSPageSizeBytes;
+        }
+
         /** basic write ops / write intents.  note there is no particular order to these : if we have
-            two writes to the same location during the group commit interval, it is likely
-            (although not assured) that it is journaled here once.
+            two writes to the same location during the group commit interval, it is journaled here once.
+            intents that overlap or touch are merged, as are ones a few bytes apart (see fillGap), so a
+            hot bucket or namespace header declared many times in a commit costs one JEntry.
         */
-        static void prepBasicWrites(AlignedBuilder& bb) {
+        static void prepBasicWrites(AlignedBuilder& bb, vector<unsigned>& sectionEnds) {
             scoped_lock lk(privateViews._mutex());
 
             // each time events switch to a different database we journal a JDbContext
             // switches will be rare as we sort by memory location first and we batch commit.
             RelativePath lastDbPath;
 
+            // a big commit is cut into a batch of sections so the journal can compress them in 
+            // parallel.  a section starts with its own JDbContext.
+            const unsigned sectionBytes = j.batchSectionBytes();
+            unsigned sectionStart = 0;
+
             assertNothingSpooled();
             const vector<WriteIntent>& _intents = commitJob.getIntentsSorted();
             verify( !_intents.empty() );
 
+            const unsigned startLen = bb.len();
+
             WriteIntent last;
             for( vector<WriteIntent>::const_iterator i = _intents.begin(); i != _intents.end(); i++ ) { 
-                if( i->start() < last.end() ) { 
-                    // overlaps
+                if( i != _intents.begin() && i->start() <= last.end() ) { 
+                    // overlaps or adjacent
                     last.absorb(*i);
                 }
+                else if( i != _intents.begin() && fillGap(last, *i) ) {
+                    last = WriteIntent(last.start(), (char*) i->end() - (char*) last.start());
+                }
                 else { 
                     // discontinuous
-                    if( i != _intents.begin() )
+                    if( i != _intents.begin() ) {
+                        if( sectionBytes && bb.len() - sectionStart >= sectionBytes ) {
+                            bb.appendNum((unsigned) JEntry::OpCode_BatchContinues);
+                            sectionStart = bb.len();
+                            sectionEnds.push_back(sectionStart);
+                            lastDbPath = RelativePath();
+                        }
                         prepBasicWrite_inlock(bb, &last, lastDbPath);
+                    }
                     last = *i;
                 }
             }
             prepBasicWrite_inlock(bb, &last, lastDbPath);
+
+            // what the intents would have cost journaled one by one, less what they did
+            unsigned long long declared = commitJob.declaredBytes() + 
+                (unsigned long long) commitJob.nDeclared() * sizeof(JEntry);
+            unsigned long long journaled = bb.len() - startLen;
+            if( declared > journaled )
+                stats.curr->_coalescedBytes += declared - journaled;
         }
 
         static void resetLogBuffer(/*out*/JSectHeader& h, AlignedBuilder& bb) {
             bb.reset();
 
-            h.setSectionLen(0xffffffff);  // total length, will fill in later
+            h.setSectionLen(JSectHeader::LenMask);  // total length, will fill in later
             h.seqNumber = getLastDataFileFlushTime();
             h.fileId = j.curFileId();
         }
@@ -161,11 +197,12 @@ namespace mongo {
             caller handles locking
             @return partially populated sectheader and _ab set
         */
-        static void _PREPLOGBUFFER(JSectHeader& h, AlignedBuilder& bb) {
+        static void _PREPLOGBUFFER(JSectHeader& h, AlignedBuilder& bb, vector<unsigned>& sectionEnds) {
             verify( cmdLine.dur );
             assertLockedForCommitting();
 
             resetLogBuffer(h, bb); // adds JSectHeader
+            sectionEnds.clear();
 
             // ops other than basic writes (DurOp's)
             {
@@ -174,15 +211,16 @@ namespace mongo {
                 }
             }
 
-            prepBasicWrites(bb);
+            prepBasicWrites(bb, sectionEnds);
 
             return;
         }
-        void PREPLOGBUFFER(/*out*/ JSectHeader& h, AlignedBuilder& ab) {
+        /** @param sectionEnds set to where the buffer is cut into a batch of sections, if it is */
+        void PREPLOGBUFFER(/*out*/ JSectHeader& h, AlignedBuilder& ab, /*out*/ vector<unsigned>& sectionEnds) {
             assertLockedForCommitting();
             Timer t;
             j.assureLogFileOpen(); // so fileId is set
-            _PREPLOGBUFFER(h, ab);
+            _PREPLOGBUFFER(h, ab, sectionEnds);
             stats.curr->_prepLogBufferMicros += t.micros();
         }
 
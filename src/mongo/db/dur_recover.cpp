@@ -37,12 +37,15 @@
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/storage/durable_mapped_file.h"
 #include "mongo/db/pdfile.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/util/bufreader.h"
 #include "mongo/util/checksum.h"
 #include "mongo/util/compress.h"
 #include "mongo/util/concurrency/race.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/mongoutils/str.h"
 #include "mongo/util/startup_test.h"
+#include "mongo/util/timer.h"
 
 using namespace mongoutils;
 
@@ -102,22 +105,42 @@ namespace mongo {
             const char *_lastDbName; // pointer into mmaped journal file
             const bool _doDurOps;
             string _uncompressed;
+            bool _batchContinues;
         public:
             JournalSectionIterator(const JSectHeader& h, const void *compressed, unsigned compressedLen, bool doDurOpsRecovering) :
                 _h(h),
                 _lastDbName(0)
                 , _doDurOps(doDurOpsRecovering)
+                , _batchContinues(false)
             {
                 verify( doDurOpsRecovering );
-                bool ok = uncompress((const char *)compressed, compressedLen, &_uncompressed);
-                if( !ok ) { 
-                    // it should always be ok (i think?) as there is a previous check to see that the JSectFooter is ok
-                    log() << "couldn't uncompress journal section" << endl;
-                    msgasserted(15874, "couldn't uncompress journal section");
-                }
-                const char *p = _uncompressed.c_str();
                 verify( compressedLen == _h.sectionLen() - sizeof(JSectFooter) - sizeof(JSectHeader) );
-                _entries = auto_ptr<BufReader>( new BufReader(p, _uncompressed.size()) );
+                switch( _h.codec() ) {
+                case JSectCodec_Snappy: {
+                    bool ok = uncompress((const char *)compressed, compressedLen, &_uncompressed);
+                    if( !ok ) { 
+                        // it should always be ok (i think?) as there is a previous check to see that the JSectFooter is ok
+                        log() << "couldn't uncompress journal section" << endl;
+                        msgasserted(15874, "couldn't uncompress journal section");
+                    }
+                    _entries = auto_ptr<BufReader>( new BufReader(_uncompressed.c_str(), _uncompressed.size()) );
+                    break;
+                }
+                case JSectCodec_Zstd:
+                    if( !zstdUncompress((const char *)compressed, compressedLen, &_uncompressed) ) {
+                        log() << "couldn't uncompress zstd journal section" << endl;
+                        msgasserted(17157, "couldn't uncompress zstd journal section");
+                    }
+                    _entries = auto_ptr<BufReader>( new BufReader(_uncompressed.c_str(), _uncompressed.size()) );
+                    break;
+                case JSectCodec_None:
+                    // the mapped journal file is read directly
+                    _entries = auto_ptr<BufReader>( new BufReader(compressed, compressedLen) );
+                    break;
+                default:
+                    log() << "unknown journal section codec " << (int) _h.codec() << endl;
+                    msgasserted(17142, "unknown journal section codec");
+                }
             }
 
             // we work with the uncompressed buffer when doing a WRITETODATAFILES (for speed)
@@ -126,11 +149,15 @@ namespace mongo {
                 _h(h),
                 _lastDbName(0)
                 , _doDurOps(false)
+                , _batchContinues(false)
 
                 { }
 
             bool atEof() const { return _entries->atEof(); }
 
+            /** true if the group commit goes on in the next section.  valid at eof. */
+            bool batchContinues() const { return _batchContinues; }
+
             unsigned long long seqNumber() const { return _h.seqNumber; }
 
             /** get the next entry from the log.  this function parses and combines JDbContext and JEntry's.
@@ -157,6 +184,19 @@ namespace mongo {
                         return;
                     }
 
+                    case JEntry::OpCode_BatchContinues: {
+                        // nothing to apply.  in the journal it ends the section; in the buffer
+                        // of WRITETODATAFILES it is where the journal cut the commit.
+                        e.e = 0;
+                        e.op.reset();
+                        e.dbName = 0;
+                        _batchContinues = true;
+                        if( _doDurOps ) {
+                            massert(17140, "journal section goes on after its end of batch marker", atEof());
+                        }
+                        return;
+                    }
+
                     case JEntry::OpCode_DbContext: {
                         _lastDbName = (const char*) _entries->pos();
                         const unsigned limit = std::min((unsigned)Namespace::MaxNsLen, _entries->remaining());
@@ -199,6 +239,17 @@ namespace mongo {
             return full.string();
         }
 
+        struct RecoveryJob::Batch {
+            vector< boost::shared_ptr<JournalSectionIterator> > sections;
+            vector<ParsedJournalEntry> entries;
+            void clear() { entries.clear(); sections.clear(); }
+        };
+
+        RecoveryJob::RecoveryJob() : _lastDataSyncedFromLastRun(0), _batch(new Batch()),
+            _appliedSections(0), _appliedBytes(0), _mx("recovery"), _recovering(false) {
+            _lastSeqMentionedInConsoleLog = 1;
+        }
+
         RecoveryJob::~RecoveryJob() {
             DESTRUCTOR_GUARD(
                 if( !_mmfs.empty() )
@@ -336,9 +387,102 @@ namespace mongo {
             return mmf;
         }
 
+        /** threads applying the writes of a section during recovery.  1 to apply them serially. */
+        MONGO_EXPORT_STARTUP_SERVER_PARAMETER(journalRecoveryThreads, int, 8);
+
+        /** the writes of a section to one data file, or a part of them, applied by one recovery thread.
+            the writes of a section never overlap, so they can be applied in any order.
+        */
+        struct RecoveryWrites {
+            enum { MaxBytes = 4 * 1024 * 1024 }; // more than that to one file is split over threads
+            RecoveryWrites(DurableMappedFile *f) : mmf(f), bytes(0) { }
+            DurableMappedFile *mmf;
+            vector<const JEntry*> writes;
+            unsigned long long bytes;
+        };
+
+        static int recoveryThreads() {
+            return std::min( std::max( (int) journalRecoveryThreads, 1 ), 64 );
+        }
+
+        static void applyRecoveryWrites(const RecoveryWrites *w) {
+            char *view = (char *) w->mmf->view_write();
+            for( vector<const JEntry*>::const_iterator i = w->writes.begin(); i != w->writes.end(); ++i ) {
+                memcpy(view + (*i)->ofs, (*i)->srcData(), (*i)->len);
+            }
+        }
+
+        void RecoveryJob::applyEntriesInParallel(const vector<ParsedJournalEntry> &entries) {
+            static ThreadPool *appliers = new ThreadPool( recoveryThreads() );
+            static vector<RecoveryWrites> parts;
+            map<DurableMappedFile*, unsigned> partForFile;
+
+            Last last;
+            vector<ParsedJournalEntry>::const_iterator i = entries.begin();
+            while( i != entries.end() ) {
+                if( !i->e ) {
+                    // a DurOp is done alone: it may create, drop or close files
+                    applyEntry(last, *i, true, false);
+                    last = Last(); // files may have been closed
+                    ++i;
+                    continue;
+                }
+
+                // a run of basic writes. look up the files here, only the copying is parallel.
+                parts.clear();
+                partForFile.clear();
+                for( ; i != entries.end() && i->e; ++i ) {
+                    DurableMappedFile *mmf = last.newEntry(*i, *this);
+                    if( i->e->ofs + i->e->len > mmf->length() ) {
+                        massert(13622, "Trying to write past end of file in WRITETODATAFILES", _recovering);
+                        continue;
+                    }
+                    verify(mmf->view_write());
+
+                    map<DurableMappedFile*, unsigned>::iterator p = partForFile.find(mmf);
+                    if( p == partForFile.end() || parts[p->second].bytes >= RecoveryWrites::MaxBytes ) {
+                        partForFile[mmf] = parts.size();
+                        parts.push_back( RecoveryWrites(mmf) );
+                        p = partForFile.find(mmf);
+                    }
+                    RecoveryWrites& w = parts[p->second];
+                    w.writes.push_back(i->e);
+                    w.bytes += i->e->len;
+                }
+
+                unsigned long long bytes = 0;
+                for( unsigned k = 0; k < parts.size(); k++ ) {
+                    bytes += parts[k].bytes;
+                }
+                if( parts.size() == 1 ) {
+                    applyRecoveryWrites(&parts[0]);
+                }
+                else {
+                    for( unsigned k = 0; k < parts.size(); k++ ) {
+                        appliers->schedule(applyRecoveryWrites, &parts[k]);
+                    }
+                    appliers->join(); // sections are applied in order
+                }
+                stats.curr->_writeToDataFilesBytes += bytes;
+            }
+        }
+
         void RecoveryJob::applyEntries(const vector<ParsedJournalEntry> &entries) {
             bool apply = (cmdLine.durOptions & CmdLine::DurScanOnly) == 0;
             bool dump = cmdLine.durOptions & CmdLine::DurDumpJournal;
+            if( _recovering && apply ) {
+                _appliedSections++;
+                for( vector<ParsedJournalEntry>::const_iterator i = entries.begin(); i != entries.end(); ++i ) {
+                    if( i->e )
+                        _appliedBytes += i->e->len;
+                }
+            }
+
+            if( _recovering && apply && !dump && recoveryThreads() > 1 ) {
+                applyEntriesInParallel(entries);
+                return;
+            }
+
             if( dump )
                 log() << "BEGIN section" << endl;
 
@@ -410,10 +554,33 @@ namespace mongo {
                 }
             }
 
+            if( _recovering && i->batchContinues() ) {
+                // the rest of this group commit is in the sections that follow.  keep the
+                // iterator, the entries point into its buffer.
+                _batch->sections.push_back( boost::shared_ptr<JournalSectionIterator>(i.release()) );
+                _batch->entries.insert(_batch->entries.end(), entries.begin(), entries.end());
+                return;
+            }
+
+            if( !_batch->sections.empty() ) {
+                _batch->entries.insert(_batch->entries.end(), entries.begin(), entries.end());
+                applyEntries(_batch->entries);
+                _batch->clear();
+                return;
+            }
+
             // got all the entries for one group commit.  apply them:
             applyEntries(entries);
         }
 
+        void RecoveryJob::discardIncompleteBatch() {
+            if( _batch->sections.empty() )
+                return;
+            log() << "recover skipping the last group commit, it was not all journaled (" 
+                  << _batch->sections.size() << " of its sections were)" << endl;
+            _batch->clear();
+        }
+
         /** apply a specific journal file, that is already mmap'd
             @param p start of the memory mapped file
             @return true if this is detected to be the last file (ends abruptly)
@@ -450,7 +617,9 @@ namespace mongo {
                     }
                 }
 
-                // read sections
+                // read sections.  a recycled journal file still holds the sections of its previous
+                // use past ours: they have another fileId, and an older seqNumber.
+                unsigned long long lastSeqNumber = 0;
                 while ( !br.atEof() ) {
                     JSectHeader h;
                     br.peek(h);
@@ -461,6 +630,12 @@ namespace mongo {
                         }
                         return true;
                     }
+                    if( h.seqNumber < lastSeqNumber ) {
+                        log() << "Ending processFileBuffer at seqnum going backwards " << lastSeqNumber
+                              << " to " << h.seqNumber << endl;
+                        return true;
+                    }
+                    lastSeqNumber = h.seqNumber;
                     unsigned slen = h.sectionLen();
                     unsigned dataLen = slen - sizeof(JSectHeader) - sizeof(JSectFooter);
                     const char *hdr = (const char *) br.skip(h.sectionLenWithPadding());
@@ -506,6 +681,9 @@ namespace mongo {
             log() << "recover begin" << endl;
             LockMongoFilesExclusive lkFiles; // for RecoveryJob::Last
             _recovering = true;
+            _appliedSections = 0;
+            _appliedBytes = 0;
+            Timer t;
 
             // load the last sequence number synced to the datafiles on disk before the last crash
             _lastDataSyncedFromLastRun = journalReadLSN();
@@ -513,6 +691,8 @@ namespace mongo {
 
             for( unsigned i = 0; i != files.size(); ++i ) {
                 bool abruptEnd = processFile(files[i]);
+                // a batch of sections is never split over files
+                discardIncompleteBatch();
                 if( abruptEnd && i+1 < files.size() ) {
                     log() << "recover error: abrupt end to file " << files[i].string() << ", yet it isn't the last journal file" << endl;
                     close();
@@ -522,6 +702,14 @@ namespace mongo {
 
             close();
 
+            {
+                int ms = t.millis();
+                log() << "recover applied " << _appliedSections << " sections, " 
+                      << _appliedBytes / 1000000.0 << "MB in " << ms << "ms (" 
+                      << _appliedBytes / 1000.0 / ( ms + 1 ) << "MB/s) with " 
+                      << recoveryThreads() << " threads" << endl;
+            }
+
             if( cmdLine.durOptions & CmdLine::DurScanOnly ) {
                 uasserted(13545, str::stream() << "--durOptions " << (int) CmdLine::DurScanOnly << " (scan only) specified");
             }
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <boost/filesystem/operations.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <list>
 
 #include "mongo/db/dur_journalformat.h"
@@ -44,8 +45,7 @@ namespace mongo {
                 int fileNo;
             } last;        
         public:
-            RecoveryJob() : _lastDataSyncedFromLastRun(0), 
-                _mx("recovery"), _recovering(false) { _lastSeqMentionedInConsoleLog = 1; }
+            RecoveryJob();
             void go(vector<boost::filesystem::path>& files);
             ~RecoveryJob();
 
@@ -59,8 +59,10 @@ namespace mongo {
             void write(Last& last, const ParsedJournalEntry& entry); // actually writes to the file
             void applyEntry(Last& last, const ParsedJournalEntry& entry, bool apply, bool dump);
             void applyEntries(const vector<ParsedJournalEntry> &entries);
+            void applyEntriesInParallel(const vector<ParsedJournalEntry> &entries);
             bool processFileBuffer(const void *, unsigned len);
             bool processFile(boost::filesystem::path journalfile);
+            void discardIncompleteBatch();
             void _close(); // doesn't lock
             DurableMappedFile* getDurableMappedFile(const ParsedJournalEntry& entry);
 
@@ -68,6 +70,14 @@ namespace mongo {
 
             unsigned long long _lastDataSyncedFromLastRun;
             unsigned long long _lastSeqMentionedInConsoleLog;
+
+            /** the sections read so far of a group commit journaled as a batch */
+            struct Batch;
+            boost::scoped_ptr<Batch> _batch;
+
+            // for the recovery throughput in the log
+            unsigned _appliedSections;
+            unsigned long long _appliedBytes;
         public:
             mongo::mutex _mx; // protects _mmfs
         private:
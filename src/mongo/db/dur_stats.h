@@ -51,6 +51,25 @@ namespace mongo {
                 // - data being written faster than the normal group commit interval
                 unsigned _commitsInWriteLock;
 
+                // remaps done in a write lock (see dur.cpp RemapNeedsWriteLock), and the time
+                // readers and writers were all stopped for them, waiting for the lock included
+                unsigned _remapsInWriteLock;
+                unsigned long long _remapPauseMicros;
+
+                // sections written for group commits big enough to be journaled as a batch
+                unsigned _batchedSections;
+
+                // uncompressed journal bytes saved by merging duplicate, overlapping and adjacent write intents
+                unsigned long long _coalescedBytes;
+
+                // journal file rotation: the time for it, and of that the time spent renaming retired
+                // files into prealloc.<n> for reuse.  files created rather than taken from prealloc.<n>
+                // are allocated on the commit path, so we count them.
+                unsigned long long _rotateMicros;
+                unsigned long long _preallocMicros;
+                unsigned _journalFilesRecycled;
+                unsigned _journalFilesCreated;
+
                 unsigned _dtMillis;
             };
             S *curr;
@@ -46,7 +46,8 @@ namespace mongo {
 
             _iter.reset( collection->getIterator( _params.start,
                                                   _params.tailable,
-                                                  _params.direction ) );
+                                                  _params.direction,
+                                                  _params.readAheadExtents ) );
 
             ++_commonStats.needTime;
             return PlanStage::NEED_TIME;
@@ -28,7 +28,8 @@ namespace mongo {
 
         CollectionScanParams() : start(DiskLoc()),
                                  direction(FORWARD),
-                                 tailable(false) { }
+                                 tailable(false),
+                                 readAheadExtents(-1) { }
 
         // What collection?
         string ns;
@@ -41,6 +42,10 @@ namespace mongo {
 
         // Do we want the scan to be 'tailable'?  Only meaningful if the collection is capped.
         bool tailable;
+
+        // How many extents ahead of the scan should be read in?  0 for none, -1 to use the
+        // collectionScanReadAheadExtents server parameter.  Not used for capped collections.
+        int readAheadExtents;
     };
 
 }  // namespace mongo
@@ -51,7 +51,8 @@ namespace mongo {
      *                   args: {name: "collectionname", indexKeyPattern: kpObj, start: startObj,
      *                          stop: stopObj, endInclusive: true/false, direction: -1/1,
      *                          limit: int}}}
-     * node -> {cscan: {filter: {filter}, args: {name: "collectionname", direction: -1/1}}}
+     * node -> {cscan: {filter: {filter}, args: {name: "collectionname", direction: -1/1,
+     *                                          readAhead: numExtents}}}
      *
      * Internal Nodes:
      *
@@ -290,6 +291,11 @@ namespace mongo {
                     params.direction = CollectionScanParams::BACKWARD;
                 }
 
+                // How many extents to read ahead?
+                if (nodeArgs["readAhead"].isNumber()) {
+                    params.readAheadExtents = nodeArgs["readAhead"].numberInt();
+                }
+
                 return new CollectionScan(params, workingSet, matcher);
             }
             else if ("sort" == nodeName) {
@@ -65,11 +65,42 @@ namespace mongo {
 
     BSONObjExternalSorter::BSONObjExternalSorter(const ExternalSortComparison* comp,
                                                  long maxFileSize)
-        : _mayInterrupt(boost::make_shared<bool>(false))
+        : _comp(comp)
+        , _mayInterrupt(boost::make_shared<bool>(false))
         , _sorter(Sorter<BSONObj, DiskLoc>::make(
                     SortOptions().ExtSortAllowed().MaxMemoryUsageBytes(maxFileSize),
                     OldExtSortComparator(comp, _mayInterrupt)))
+        , _adoptedFiles(0)
     {}
+
+    void BSONObjExternalSorter::sort(bool mayInterrupt) {
+        *_mayInterrupt = mayInterrupt;
+        if (!_sorted.get()) {
+            _sorted.reset(_sorter->done());
+        }
+    }
+
+    void BSONObjExternalSorter::adopt(BSONObjExternalSorter& other) {
+        other.sort(*other._mayInterrupt);
+        _adoptedFiles += other.numFiles();
+        _adopted.push_back(boost::shared_ptr<Iterator>(other.iterator().release()));
+    }
+
+    auto_ptr<BSONObjExternalSorter::Iterator> BSONObjExternalSorter::iterator() {
+        if (!_sorted.get()) {
+            _sorted.reset(_sorter->done());
+        }
+        if (_adopted.empty()) {
+            return _sorted;
+        }
+
+        vector<boost::shared_ptr<Iterator> > runs;
+        runs.swap(_adopted);
+        runs.push_back(boost::shared_ptr<Iterator>(_sorted.release()));
+        return auto_ptr<Iterator>(Iterator::merge(runs,
+                                                  SortOptions(),
+                                                  OldExtSortComparator(_comp, _mayInterrupt)));
+    }
 }
 
 #include "mongo/db/sorter/sorter.cpp"
@@ -59,16 +59,29 @@ namespace mongo {
             _sorter->add(o.getOwned(), loc);
         }
 
-        auto_ptr<Iterator> iterator() { return auto_ptr<Iterator>(_sorter->done()); }
+        auto_ptr<Iterator> iterator();
 
-        void sort( bool mayInterrupt ) { *_mayInterrupt = mayInterrupt; }
-        int numFiles() { return _sorter->numFiles(); }
+        /* call after adding values, and before fetching the iterator */
+        void sort( bool mayInterrupt );
+
+        /**
+         * Sorts 'other', which must use the same comparison, and merges its data into what
+         * iterator() returns.  Nothing can be added to 'other' afterwards.  Lets several threads
+         * each sort a part of the data, merged once by the reader.
+         */
+        void adopt( BSONObjExternalSorter& other );
+
+        int numFiles() { return _sorter->numFiles() + _adoptedFiles; }
         long getCurSizeSoFar() { return _sorter->memUsed(); }
         void hintNumObjects(long long) {} // unused
 
     private:
+        const ExternalSortComparison* _comp;
         shared_ptr<bool> _mayInterrupt;
         scoped_ptr<Sorter<BSONObj, DiskLoc> > _sorter;
+        auto_ptr<Iterator> _sorted; // set by sort()
+        vector<shared_ptr<Iterator> > _adopted;
+        int _adoptedFiles;
     };
 #else
     /**
@@ -34,6 +34,7 @@
 #include "mongo/db/ops/delete.h"
 #include "mongo/db/query/internal_plans.h"
 #include "mongo/db/repl/rs.h"
+#include "mongo/db/storage/extent_manager.h"
 #include "mongo/util/scopeguard.h"
 #include "mongo/util/mongoutils/str.h"
 
@@ -243,6 +244,14 @@ namespace mongo {
             uasserted(12504, s);
         }
 
+        // the file set of the index, see ExtentManager.  defaults to the collection's set.
+        BSONElement fileSet = io["fileSet"];
+        if ( !fileSet.eoo() ) {
+            uassert(17133, "index fileSet must be a string", fileSet.type() == String);
+            Status s = ExtentManager::validateFileSetName(fileSet.valuestr());
+            uassert(17134, s.reason(), s.isOK());
+        }
+
         sourceCollection = nsdetails(sourceNS);
         if( sourceCollection == 0 ) {
             // try to create it
@@ -340,7 +349,7 @@ namespace mongo {
                 // note (one day) we may be able to fresh build less versions than we can use
                 // isASupportedIndexVersionNumber() is what we can use
                 uassert(14803, str::stream() << "this version of mongod cannot build new indexes of version number " << vv, 
-                    vv == 0 || vv == 1);
+                    vv == 0 || vv == 1 || vv == 2);
                 v = (int) vv;
             }
             // idea is to put things we use a lot earlier
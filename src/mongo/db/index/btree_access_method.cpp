@@ -16,11 +16,14 @@
 
 #include "mongo/db/index/btree_access_method.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "mongo/base/status.h"
 #include "mongo/db/index/btree_index_cursor.h"
 #include "mongo/db/index/btree_interface.h"
+#include "mongo/db/index/side_write_table.h"
+#include "mongo/db/index/unique_key_filter.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/keypattern.h"
 #include "mongo/db/pdfile.h"
@@ -31,7 +34,8 @@ namespace mongo {
     BtreeBasedAccessMethod::BtreeBasedAccessMethod(IndexDescriptor *descriptor)
         : _descriptor(descriptor), _ordering(Ordering::make(_descriptor->keyPattern())) {
 
-        verify(0 == descriptor->version() || 1 == descriptor->version());
+        verify(0 == descriptor->version() || 1 == descriptor->version() ||
+               2 == descriptor->version());
         _interface = BtreeInterface::interfaces[descriptor->version()];
     }
 
@@ -45,6 +49,18 @@ namespace mongo {
         // Delegate to the subclass.
         getKeys(obj, &keys);
 
+        SideWriteTable* sideWrites = sideWriteTable();
+        if (sideWrites) {
+            for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
+                sideWrites->insert(*i, loc);
+            }
+            *numInserted = keys.size();
+            if (*numInserted > 1) {
+                _descriptor->setMultikey();
+            }
+            return Status::OK();
+        }
+
         Status ret = Status::OK();
 
         for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
@@ -80,6 +96,101 @@ namespace mongo {
         return ret;
     }
 
+    namespace {
+        struct BulkKey {
+            BSONObj key;
+            size_t pos;     // of the document in the batch
+            bool inserted;
+        };
+
+        // Key order, and batch order between equal keys so that of two documents with the same
+        // key in a unique index the later one is the duplicate, as it is inserting one by one.
+        class BulkKeyLess {
+        public:
+            BulkKeyLess(const Ordering& ordering) : _ordering(ordering) { }
+            bool operator()(const BulkKey& l, const BulkKey& r) const {
+                int c = l.key.woCompare(r.key, _ordering, false);
+                return c != 0 ? c < 0 : l.pos < r.pos;
+            }
+        private:
+            Ordering _ordering;
+        };
+    }
+
+    Status BtreeBasedAccessMethod::insertBulk(const vector<BSONObj>& objs,
+                                              const vector<DiskLoc>& locs,
+                                              size_t numObjs,
+                                              const InsertDeleteOptions& options,
+                                              size_t* numIndexed) {
+        verify(numObjs <= objs.size() && numObjs <= locs.size());
+
+        // Documents from the first one whose keys can't be generated (parallel arrays, say) are
+        // left out, as for a duplicate key.
+        size_t limit = numObjs;
+        Status ret = Status::OK();
+        vector<BulkKey> keys;
+        vector<int> keysPerDoc(numObjs, 0);
+        for (size_t pos = 0; pos < numObjs; ++pos) {
+            BSONObjSet docKeys;
+            try {
+                getKeys(objs[pos], &docKeys);
+            } catch (AssertionException& e) {
+                limit = pos;
+                ret = Status(ErrorCodes::InternalError, e.what(), e.getCode());
+                break;
+            }
+            for (BSONObjSet::const_iterator i = docKeys.begin(); i != docKeys.end(); ++i) {
+                BulkKey k;
+                k.key = *i;
+                k.pos = pos;
+                k.inserted = false;
+                keys.push_back(k);
+            }
+            keysPerDoc[pos] = docKeys.size();
+        }
+        std::sort(keys.begin(), keys.end(), BulkKeyLess(_ordering));
+
+        // In key order, consecutive keys mostly go to the same bucket, so the part of the tree
+        // the batch touches stays in cache instead of being walked at random per document.
+        for (vector<BulkKey>::iterator i = keys.begin(); i != keys.end(); ++i) {
+            if (i->pos >= limit)
+                continue;
+            try {
+                _interface->bt_insert(_descriptor->getHead(), locs[i->pos], i->key, _ordering,
+                                      options.dupsAllowed, _descriptor->getOnDisk(), true);
+                i->inserted = true;
+            } catch (AssertionException& e) {
+                if (options.dupsAllowed) {
+                    // as insert() does, the document keeps the keys that went in
+                    problem() << " caught assertion addKeysToIndex "
+                              << _descriptor->indexNamespace()
+                              << objs[i->pos]["_id"] << endl;
+                    ret = Status(ErrorCodes::InternalError, e.what(), e.getCode());
+                } else {
+                    // Assuming it's a duplicate key exception.
+                    limit = i->pos;
+                    ret = Status(ErrorCodes::DuplicateKey, e.what(), e.getCode());
+                }
+            }
+        }
+
+        // Take the documents from the first failure on back out.
+        for (vector<BulkKey>::const_iterator i = keys.begin(); i != keys.end(); ++i) {
+            if (i->inserted && i->pos >= limit)
+                removeOneKey(i->key, locs[i->pos]);
+        }
+
+        for (size_t pos = 0; pos < limit; ++pos) {
+            if (keysPerDoc[pos] > 1) {
+                _descriptor->setMultikey();
+                break;
+            }
+        }
+
+        *numIndexed = limit;
+        return ret;
+    }
+
     bool BtreeBasedAccessMethod::removeOneKey(const BSONObj& key, const DiskLoc& loc) {
         bool ret = false;
 
@@ -106,6 +217,15 @@ namespace mongo {
         getKeys(obj, &keys);
         *numDeleted = 0;
 
+        SideWriteTable* sideWrites = sideWriteTable();
+        if (sideWrites) {
+            for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
+                sideWrites->remove(*i, loc);
+            }
+            *numDeleted = keys.size();
+            return Status::OK();
+        }
+
         for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
             bool thisKeyOK = removeOneKey(*i, loc);
 
@@ -140,7 +260,20 @@ namespace mongo {
         }
     }
 
+    SideWriteTable* BtreeBasedAccessMethod::sideWriteTable() {
+        // only an index being built in the background has one
+        if (!_descriptor->isBackgroundIndex()) {
+            return NULL;
+        }
+        return SideWriteTable::get(_descriptor->getOnDisk());
+    }
+
     Status BtreeBasedAccessMethod::touch(const BSONObj& obj) {
+        if (sideWriteTable()) {
+            // no btree yet
+            return Status::OK();
+        }
+
         BSONObjSet keys;
         getKeys(obj, &keys);
 
@@ -181,6 +314,10 @@ namespace mongo {
 
         if (checkForDups) {
             for (vector<BSONObj*>::iterator i = data->added.begin(); i != data->added.end(); i++) {
+                if (UniqueKeyFilter::ABSENT == UniqueKeyFilter::check(_descriptor->getOnDisk(),
+                                                                      **i)) {
+                    continue;
+                }
                 if (_interface->wouldCreateDup(_descriptor->getOnDisk(), _descriptor->getHead(),
                                                **i, _ordering, record)) {
                     status->_isValid = false;
@@ -209,6 +346,18 @@ namespace mongo {
             _descriptor->setMultikey();
         }
 
+        SideWriteTable* sideWrites = sideWriteTable();
+        if (sideWrites) {
+            for (size_t i = 0; i < data->removed.size(); ++i) {
+                sideWrites->remove(*data->removed[i], data->loc);
+            }
+            for (size_t i = 0; i < data->added.size(); ++i) {
+                sideWrites->insert(*data->added[i], data->loc);
+            }
+            *numUpdated = data->added.size();
+            return Status::OK();
+        }
+
         for (size_t i = 0; i < data->added.size(); ++i) {
             _interface->bt_insert(_descriptor->getHead(), data->loc, *data->added[i], _ordering,
                                   data->dupsAllowed, _descriptor->getOnDisk(), true);
@@ -242,7 +391,8 @@ namespace mongo {
         if (0 == descriptor->version()) {
             _keyGenerator.reset(new BtreeKeyGeneratorV0(fieldNames, fixed,
                 _descriptor->isSparse()));
-        } else if (1 == descriptor->version()) {
+        } else if (1 == descriptor->version() || 2 == descriptor->version()) {
+            // v:2 stores the same keys as v:1, prefix compressed
             _keyGenerator.reset(new BtreeKeyGeneratorV1(fieldNames, fixed,
                 _descriptor->isSparse()));
         } else {
@@ -27,6 +27,8 @@
 
 namespace mongo {
 
+    class SideWriteTable;
+
     /**
      * Any access method that is Btree based subclasses from this.
      *
@@ -50,6 +52,12 @@ namespace mongo {
                               const InsertDeleteOptions& options,
                               int64_t* numDeleted);
 
+        virtual Status insertBulk(const vector<BSONObj>& objs,
+                                  const vector<DiskLoc>& locs,
+                                  size_t numObjs,
+                                  const InsertDeleteOptions& options,
+                                  size_t* numIndexed);
+
         virtual Status validateUpdate(const BSONObj& from,
                                       const BSONObj& to,
                                       const DiskLoc& loc,
@@ -81,6 +89,9 @@ namespace mongo {
 
     private:
         bool removeOneKey(const BSONObj& key, const DiskLoc& loc);
+
+        /** @return where the writes to this index go while a background build loads it, if so */
+        SideWriteTable* sideWriteTable();
     };
 
     /**
@@ -16,16 +16,26 @@
 
 #include "mongo/db/index/btree_based_builder.h"
 
+#include <boost/thread/condition.hpp>
+
+#include "mongo/base/owned_pointer_vector.h"
 #include "mongo/db/btreebuilder.h"
+#include "mongo/db/db.h"
 #include "mongo/db/index/catalog_hack.h"
 #include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/index/index_access_method.h"
+#include "mongo/db/index/side_write_table.h"
+#include "mongo/db/index_names.h"
+#include "mongo/db/key_string.h"
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/pdfile_private.h"
 #include "mongo/db/query/internal_plans.h"
+#include "mongo/db/query/runner_yield_policy.h"
 #include "mongo/db/repl/is_master.h"
 #include "mongo/db/repl/rs.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/sort_phase_one.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/processinfo.h"
 
 namespace mongo {
@@ -60,6 +70,271 @@ namespace mongo {
         const Ordering _ordering;
     };
 
+    /** compares the keys SortPhaseOne::addKeys() added as KeyStrings, with a memcmp */
+    class ExternalSortComparisonKeyString : public ExternalSortComparison {
+    public:
+        virtual ~ExternalSortComparisonKeyString() { }
+
+        virtual int compare(const ExternalSortDatum& l, const ExternalSortDatum& r) const {
+            int x = KeyString::compareSortKeys(l.first, r.first);
+            if (x) { return x; }
+            return l.second.compare(r.second);
+        }
+    };
+
+    /** threads generating and sorting the keys of a foreground index build, 1 to do it on the
+        thread scanning the collection.  read when a build starts.
+    */
+    MONGO_EXPORT_SERVER_PARAMETER(indexBuildThreads, int, 4);
+
+    /** whether background index builds sort their keys and load them bottom up, see
+        BtreeBasedBuilder::bulkLoadInBackground(), rather than insert them key by key
+    */
+    MONGO_EXPORT_SERVER_PARAMETER(bulkLoadBackgroundIndexes, bool, true);
+
+    /**
+     * Generates and sorts the keys of a foreground index build on a pool of threads, while the
+     * thread holding the lock scans the collection and hands them batches of its documents.
+     * Each thread adds the keys to SortPhaseOnes of its own, one per index built, and finish()
+     * merges their sorted runs into the build's.  The threads don't use the Client, so they
+     * don't check for interrupts: the scanning thread does.
+     */
+    class BtreeBasedBuilder::ParallelPhaseOne : boost::noncopyable {
+    public:
+        /** 'phaseOnes[i]' sorts the keys 'iams[i]' generates */
+        ParallelPhaseOne(const vector<BtreeBasedAccessMethod*>& iams,
+                         const vector<SortPhaseOne*>& phaseOnes,
+                         int nThreads)
+            : _iams(iams), _phaseOnes(phaseOnes), _batch(new Batch()),
+              _mutex("ParallelPhaseOne"), _pending(0), _errorCode(0), _userError(false),
+              _threads(nThreads) {
+            // the threads share the memory a serial build sorts in
+            long sortBytes = 100 * 1024 * 1024 / nThreads / phaseOnes.size();
+            for (int i = 0; i < nThreads; i++) {
+                shared_ptr<Lane> lane(new Lane(phaseOnes.size()));
+                for (unsigned j = 0; j < phaseOnes.size(); j++) {
+                    SortPhaseOne& phaseOne = (*lane)[j];
+                    phaseOne.sortCmp = phaseOnes[j]->sortCmp;
+                    phaseOne.keyStringOrdering = phaseOnes[j]->keyStringOrdering;
+                    phaseOne.sorter.reset(new BSONObjExternalSorter(phaseOne.sortCmp.get(),
+                                                                    sortBytes));
+                }
+                _lanes.push_back(lane);
+                _freeLanes.push_back(lane.get());
+            }
+            _batch->reserve(BatchSize);
+        }
+
+        /** 'o' must stay valid until finish() returns, as it does while the lock is held */
+        void add(const BSONObj& o, const DiskLoc& loc) {
+            _batch->push_back(make_pair(o, loc));
+            if (_batch->size() == BatchSize) {
+                flush();
+            }
+        }
+
+        /** waits for the threads and merges their keys into the build's SortPhaseOne, or
+            throws the first error one of them hit
+        */
+        void finish() {
+            flush();
+            _threads.join();
+            for (unsigned i = 0; i < _lanes.size(); i++) {
+                for (unsigned j = 0; j < _phaseOnes.size(); j++) {
+                    _threads.schedule(sortLane, this, &(*_lanes[i])[j]);
+                }
+            }
+            _threads.join();
+            rethrowError();
+
+            for (unsigned i = 0; i < _lanes.size(); i++) {
+                for (unsigned j = 0; j < _phaseOnes.size(); j++) {
+                    SortPhaseOne& lane = (*_lanes[i])[j];
+                    SortPhaseOne* phaseOne = _phaseOnes[j];
+                    phaseOne->n += lane.n;
+                    phaseOne->nkeys += lane.nkeys;
+                    phaseOne->multi = phaseOne->multi || lane.multi;
+                    phaseOne->sorter->adopt(*lane.sorter);
+                }
+            }
+        }
+
+    private:
+        typedef vector< pair<BSONObj, DiskLoc> > Batch;
+        typedef vector<SortPhaseOne> Lane; // a thread's SortPhaseOne for each index
+        enum { BatchSize = 1000 };
+
+        /** hands the current batch to a thread, once fewer than two batches per thread wait */
+        void flush() {
+            if (_batch->empty()) {
+                return;
+            }
+            {
+                scoped_lock lk(_mutex);
+                while (_pending >= 2 * _lanes.size() && !_errorCode) {
+                    _done.wait(lk.boost());
+                }
+                ++_pending;
+            }
+            rethrowError();
+            _threads.schedule(generateKeys, this, _batch);
+            _batch.reset(new Batch());
+            _batch->reserve(BatchSize);
+        }
+
+        static void generateKeys(ParallelPhaseOne* self, shared_ptr<Batch> batch) {
+            Lane* lane;
+            {
+                scoped_lock lk(self->_mutex);
+                // there are as many lanes as threads
+                verify(!self->_freeLanes.empty());
+                lane = self->_freeLanes.back();
+                self->_freeLanes.pop_back();
+            }
+            try {
+                for (Batch::const_iterator i = batch->begin(); i != batch->end(); ++i) {
+                    for (unsigned j = 0; j < self->_iams.size(); j++) {
+                        BSONObjSet keys;
+                        self->_iams[j]->getKeys(i->first, &keys);
+                        (*lane)[j].addKeys(keys, i->second, false);
+                    }
+                }
+            }
+            catch (UserException& e) {
+                self->setError(e.getCode(), e.what(), true);
+            }
+            catch (DBException& e) {
+                self->setError(e.getCode(), e.what(), false);
+            }
+            catch (std::exception& e) {
+                self->setError(17149, e.what(), false);
+            }
+            scoped_lock lk(self->_mutex);
+            self->_freeLanes.push_back(lane);
+            --self->_pending;
+            self->_done.notify_all();
+        }
+
+        static void sortLane(ParallelPhaseOne* self, SortPhaseOne* lane) {
+            try {
+                lane->sorter->sort(false);
+            }
+            catch (DBException& e) {
+                self->setError(e.getCode(), e.what(), false);
+            }
+            catch (std::exception& e) {
+                self->setError(17149, e.what(), false);
+            }
+        }
+
+        void setError(int code, const string& msg, bool userError) {
+            scoped_lock lk(_mutex);
+            if (!_errorCode) {
+                _errorCode = code;
+                _errorMsg = msg;
+                _userError = userError;
+            }
+            _done.notify_all();
+        }
+
+        void rethrowError() {
+            scoped_lock lk(_mutex);
+            if (!_errorCode) {
+                return;
+            }
+            if (_userError) {
+                uasserted(_errorCode, _errorMsg);
+            }
+            msgasserted(_errorCode, _errorMsg);
+        }
+
+        const vector<BtreeBasedAccessMethod*> _iams;
+        const vector<SortPhaseOne*> _phaseOnes;
+        vector<shared_ptr<Lane> > _lanes;
+        shared_ptr<Batch> _batch;
+
+        mongo::mutex _mutex;
+        boost::condition _done; // a batch was done or an error set
+        vector<Lane*> _freeLanes;
+        unsigned _pending; // batches scheduled and not done
+        int _errorCode;
+        string _errorMsg;
+        bool _userError;
+
+        ThreadPool _threads; // last, so its destructor waits for the threads first
+    };
+
+    namespace {
+
+        /** @return the threads to generate the keys of 'descriptors' on, 1 to do it on this one */
+        int keyGenerationThreads(const vector<IndexDescriptor*>& descriptors, int64_t nrecords) {
+            // the btree and hashed key generators keep no state, the other plugins may
+            for (unsigned i = 0; i < descriptors.size(); i++) {
+                string type = CatalogHack::getAccessMethodName(descriptors[i]->keyPattern());
+                if (type != "" && type != IndexNames::HASHED) {
+                    return 1;
+                }
+            }
+            // not worth the threads for a small collection
+            if (nrecords < 10000) {
+                return 1;
+            }
+            return std::min(std::max((int) indexBuildThreads, 1), 64);
+        }
+
+        void buildBottomUp(bool dupsAllowed,
+                           IndexDetails& idx,
+                           bool dropDups,
+                           set<DiskLoc>& dupsToDrop,
+                           CurOp* op,
+                           SortPhaseOne* phase1,
+                           ProgressMeterHolder& pm,
+                           Timer& t,
+                           bool mayInterrupt,
+                           BackgroundBuildYield* yield = NULL) {
+            BSONObjExternalSorter& sorter = *(phase1->sorter);
+            if( idx.version() == 0 )
+                buildBottomUpPhases2And3<V0>(dupsAllowed,
+                                             idx,
+                                             sorter,
+                                             dropDups,
+                                             dupsToDrop,
+                                             op,
+                                             phase1,
+                                             pm,
+                                             t,
+                                             mayInterrupt,
+                                             yield);
+            else if( idx.version() == 1 ) 
+                buildBottomUpPhases2And3<V1>(dupsAllowed,
+                                             idx,
+                                             sorter,
+                                             dropDups,
+                                             dupsToDrop,
+                                             op,
+                                             phase1,
+                                             pm,
+                                             t,
+                                             mayInterrupt,
+                                             yield);
+            else if( idx.version() == 2 )
+                buildBottomUpPhases2And3<V2>(dupsAllowed,
+                                             idx,
+                                             sorter,
+                                             dropDups,
+                                             dupsToDrop,
+                                             op,
+                                             phase1,
+                                             pm,
+                                             t,
+                                             mayInterrupt,
+                                             yield);
+            else
+                verify(false);
+        }
+
+    } // namespace
+
     template< class V >
     void buildBottomUpPhases2And3( bool dupsAllowed,
                                    IndexDetails& idx,
@@ -70,7 +345,8 @@ namespace mongo {
                                    SortPhaseOne* phase1,
                                    ProgressMeterHolder& pm,
                                    Timer& t,
-                                   bool mayInterrupt ) {
+                                   bool mayInterrupt,
+                                   BackgroundBuildYield* yield ) {
         BtreeBuilder<V> btBuilder(dupsAllowed, idx);
         BSONObj keyLast;
         auto_ptr<BSONObjExternalSorter::Iterator> i = sorter.iterator();
@@ -82,6 +358,9 @@ namespace mongo {
         while( i->more() ) {
             RARELY killCurrentOp.checkForInterrupt( !mayInterrupt );
             ExternalSortDatum d = i->next();
+            if ( phase1->keyStringOrdering ) {
+                d.first = KeyString::fromSortKey(d.first);
+            }
 
             try {
                 if ( !dupsAllowed && dropDups ) {
@@ -112,6 +391,10 @@ namespace mongo {
                 uassert( 10092 , "too may dups on index build with dropDups=true", dupsToDrop.size() < 1000000 );
             }
             pm.hit();
+
+            if ( yield && yield->yieldIfNeeded() ) {
+                btBuilder.relocate( yield->idx() );
+            }
         }
         pm.finished();
         op->setMessage("index: (3/3) btree-middle", "Index: (3/3) BTree Middle Progress");
@@ -126,8 +409,11 @@ namespace mongo {
     DiskLoc BtreeBasedBuilder::makeEmptyIndex(const IndexDetails& idx) {
         if (0 == idx.version()) {
             return BtreeBucket<V0>::addBucket(idx);
-        } else {
+        } else if (1 == idx.version()) {
             return BtreeBucket<V1>::addBucket(idx);
+        } else {
+            verify(2 == idx.version());
+            return BtreeBucket<V2>::addBucket(idx);
         }
     }
 
@@ -136,11 +422,25 @@ namespace mongo {
         if (0 == version) {
             return new ExternalSortComparisonV0(keyPattern);
         } else {
-            verify(1 == version);
+            // v:2 keys sort as v:1 keys do
+            verify(1 == version || 2 == version);
             return new ExternalSortComparisonV1(keyPattern);
         }
     }
 
+    void BtreeBasedBuilder::initPhaseOne(const IndexDetails& idx, SortPhaseOne* phaseOne,
+                                         long sortBytes) {
+        if (0 == idx.version()) {
+            phaseOne->sortCmp.reset(getComparison(idx.version(), idx.keyPattern()));
+        }
+        else {
+            // v:1 and v:2 keys are sorted by a memcmp of their KeyStrings rather than a woCompare
+            phaseOne->keyStringOrdering.reset(new Ordering(Ordering::make(idx.keyPattern())));
+            phaseOne->sortCmp.reset(new ExternalSortComparisonKeyString());
+        }
+        phaseOne->sorter.reset(new BSONObjExternalSorter(phaseOne->sortCmp.get(), sortBytes));
+    }
+
     void BtreeBasedBuilder::addKeysToPhaseOne(NamespaceDetails* d, const char* ns,
                            const IndexDetails& idx,
                            const BSONObj& order,
@@ -148,29 +448,65 @@ namespace mongo {
                            int64_t nrecords,
                            ProgressMeter* progressMeter,
                            bool mayInterrupt, int idxNo) {
-        auto_ptr<Runner> runner(InternalPlanner::collectionScan(ns));
-        phaseOne->sortCmp.reset(getComparison(idx.version(), idx.keyPattern()));
-        phaseOne->sorter.reset(new BSONObjExternalSorter(phaseOne->sortCmp.get()));
-        phaseOne->sorter->hintNumObjects( nrecords );
         auto_ptr<IndexDescriptor> desc(CatalogHack::getDescriptor(d, idxNo));
-        auto_ptr<BtreeBasedAccessMethod> iam(CatalogHack::getBtreeBasedIndex(desc.get()));
+        addKeysToPhaseOnes(ns,
+                           vector<IndexDescriptor*>(1, desc.get()),
+                           vector<SortPhaseOne*>(1, phaseOne),
+                           nrecords,
+                           progressMeter,
+                           mayInterrupt);
+    }
+
+    void BtreeBasedBuilder::addKeysToPhaseOnes(const char* ns,
+                                               const vector<IndexDescriptor*>& descriptors,
+                                               const vector<SortPhaseOne*>& phaseOnes,
+                                               int64_t nrecords,
+                                               ProgressMeter* progressMeter,
+                                               bool mayInterrupt) {
+        verify(descriptors.size() == phaseOnes.size());
+        auto_ptr<Runner> runner(InternalPlanner::collectionScan(ns));
+        // the indexes share the memory a single build sorts in
+        long sortBytes = 100 * 1024 * 1024 / descriptors.size();
+        OwnedPointerVector<BtreeBasedAccessMethod> iams;
+        for (unsigned i = 0; i < descriptors.size(); i++) {
+            initPhaseOne(descriptors[i]->getOnDisk(), phaseOnes[i], sortBytes);
+            phaseOnes[i]->sorter->hintNumObjects( nrecords );
+            iams.mutableVector().push_back(CatalogHack::getBtreeBasedIndex(descriptors[i]));
+        }
+        int nThreads = keyGenerationThreads(descriptors, nrecords);
+        scoped_ptr<ParallelPhaseOne> parallel;
+        if (nThreads > 1) {
+            parallel.reset(new ParallelPhaseOne(iams.vector(), phaseOnes, nThreads));
+        }
+        unsigned long long nScanned = 0;
         BSONObj o;
         DiskLoc loc;
         Runner::RunnerState state;
         while (Runner::RUNNER_ADVANCED == (state = runner->getNext(&o, &loc))) {
             RARELY killCurrentOp.checkForInterrupt( !mayInterrupt );
-            BSONObjSet keys;
-            iam->getKeys(o, &keys);
-            phaseOne->addKeys(keys, loc, mayInterrupt);
+            if (parallel) {
+                parallel->add(o, loc);
+            }
+            else {
+                for (unsigned i = 0; i < iams.size(); i++) {
+                    BSONObjSet keys;
+                    iams.vector()[i]->getKeys(o, &keys);
+                    phaseOnes[i]->addKeys(keys, loc, mayInterrupt);
+                }
+            }
             progressMeter->hit();
             if (logger::globalLogDomain()->shouldLog(logger::LogSeverity::Debug(2))
-                && phaseOne->n % 10000 == 0 ) {
+                && ++nScanned % 10000 == 0 ) {
                 printMemInfo( "\t iterating objects" );
             }
         }
 
         uassert(17050, "Internal error reading docs from collection", Runner::RUNNER_EOF == state);
 
+        if (parallel) {
+            parallel->finish();
+            LOG(1) << "\t keys generated and sorted by " << nThreads << " threads" << endl;
+        }
     }
 
     uint64_t BtreeBasedBuilder::fastBuildIndex(const char* ns, NamespaceDetails* d,
@@ -201,8 +537,6 @@ namespace mongo {
                           mayInterrupt, idxNo );
         pm.finished();
 
-        BSONObjExternalSorter& sorter = *(phase1.sorter);
-
         if( phase1.multi ) {
             d->setIndexIsMultikey(ns, idxNo);
         }
@@ -213,36 +547,13 @@ namespace mongo {
         if ( logger::globalLogDomain()->shouldLog(logger::LogSeverity::Debug(2) ) )
             printMemInfo( "after final sort" );
 
-        LOG(t.seconds() > 5 ? 0 : 1) << "\t external sort used : " << sorter.numFiles()
+        LOG(t.seconds() > 5 ? 0 : 1) << "\t external sort used : " << phase1.sorter->numFiles()
                                      << " files " << " in " << t.seconds() << " secs" << endl;
 
         set<DiskLoc> dupsToDrop;
 
         /* build index --- */
-        if( idx.version() == 0 )
-            buildBottomUpPhases2And3<V0>(dupsAllowed,
-                                         idx,
-                                         sorter,
-                                         dropDups,
-                                         dupsToDrop,
-                                         op,
-                                         &phase1,
-                                         pm,
-                                         t,
-                                         mayInterrupt);
-        else if( idx.version() == 1 ) 
-            buildBottomUpPhases2And3<V1>(dupsAllowed,
-                                         idx,
-                                         sorter,
-                                         dropDups,
-                                         dupsToDrop,
-                                         op,
-                                         &phase1,
-                                         pm,
-                                         t,
-                                         mayInterrupt);
-        else
-            verify(false);
+        buildBottomUp(dupsAllowed, idx, dropDups, dupsToDrop, op, &phase1, pm, t, mayInterrupt);
 
         if( dropDups ) 
             log() << "\t fastBuildIndex dupsToDrop:" << dupsToDrop.size() << endl;
@@ -252,6 +563,192 @@ namespace mongo {
         return phase1.n;
     }
 
+    uint64_t BtreeBasedBuilder::fastBuildIndexes(const char* ns, NamespaceDetails* d,
+                                                 const vector<IndexDescriptor*>& descriptors,
+                                                 bool mayInterrupt) {
+        CurOp * op = cc().curop();
+
+        Timer t;
+
+        MONGO_TLOG(1) << "fastBuildIndexes " << ns << ' ' << descriptors.size() << " indexes"
+                      << endl;
+
+        for (unsigned i = 0; i < descriptors.size(); i++) {
+            IndexDetails& idx = descriptors[i]->getOnDisk();
+            bool dupsAllowed = !idx.unique() || ignoreUniqueIndex(idx);
+            verify(dupsAllowed || !(idx.dropDups() || inDBRepair));
+            getDur().writingDiskLoc(descriptors[i]->getHead()).Null();
+        }
+
+        /* get and sort the keys of all the indexes ----- */
+        ProgressMeterHolder pm(op->setMessage("index: (1/3) external sort",
+                                              "Index: (1/3) External Sort Progress",
+                                              d->numRecords(),
+                                              10));
+        vector<shared_ptr<SortPhaseOne> > phaseOnes;
+        vector<SortPhaseOne*> phaseOnePtrs;
+        for (unsigned i = 0; i < descriptors.size(); i++) {
+            phaseOnes.push_back(shared_ptr<SortPhaseOne>(new SortPhaseOne()));
+            phaseOnePtrs.push_back(phaseOnes.back().get());
+        }
+        addKeysToPhaseOnes(ns, descriptors, phaseOnePtrs, d->numRecords(), pm.get(),
+                           mayInterrupt);
+        pm.finished();
+
+        LOG(t.seconds() > 5 ? 0 : 1) << "\t keys of " << descriptors.size() << " indexes "
+                                     << "generated in one scan in " << t.seconds() << " secs"
+                                     << endl;
+
+        /* build each index --- */
+        uint64_t n = phaseOnes[0]->n;
+        for (unsigned i = 0; i < descriptors.size(); i++) {
+            IndexDetails& idx = descriptors[i]->getOnDisk();
+            SortPhaseOne& phase1 = *phaseOnes[i];
+
+            if( phase1.multi ) {
+                descriptors[i]->setMultikey();
+            }
+
+            phase1.sorter->sort( mayInterrupt );
+            LOG(t.seconds() > 5 ? 0 : 1) << "\t external sort of " << idx.indexName()
+                                         << " used : " << phase1.sorter->numFiles() << " files "
+                                         << " in " << t.seconds() << " secs" << endl;
+
+            bool dupsAllowed = !idx.unique() || ignoreUniqueIndex(idx);
+            set<DiskLoc> dupsToDrop;
+            buildBottomUp(dupsAllowed, idx, false, dupsToDrop, op, &phase1, pm, t, mayInterrupt);
+
+            // done with its keys
+            phaseOnes[i].reset();
+        }
+
+        return n;
+    }
+
+    bool BtreeBasedBuilder::canBulkLoadInBackground(const IndexDetails& idx) {
+        // a unique index would need its duplicates checked against the writes made while the
+        // scan yields, and dropDups deletes documents as the scan finds them.  those insert their
+        // keys one by one.
+        return bulkLoadBackgroundIndexes && !idx.unique() && !idx.dropDups();
+    }
+
+    uint64_t BtreeBasedBuilder::bulkLoadInBackground(const char* ns, NamespaceDetails* d,
+                                                     const string& idxName) {
+        CurOp * op = cc().curop();
+
+        Timer t;
+
+        // After a yield the index may be at another position, see insert_makeIndex, so idxNo is
+        // looked up again and no reference to its IndexDetails is kept across one.
+        int idxNo = IndexBuildsInProgress::get(ns, idxName);
+        getDur().writingDiskLoc(d->idx(idxNo).head).Null();
+
+        // from here on writers record their changes to the index rather than make them
+        SideWriteTable sideWrites(d->idx(idxNo));
+
+        /* get and sort all the keys, yielding ----- */
+        ProgressMeterHolder pm(op->setMessage("index: (1/3) external sort",
+                                              "Index: (1/3) External Sort Progress",
+                                              d->numRecords(),
+                                              10));
+        SortPhaseOne phase1;
+        initPhaseOne(d->idx(idxNo), &phase1);
+        {
+            auto_ptr<Runner> runner(InternalPlanner::collectionScan(ns));
+            // We're not delegating yielding to the runner because the access method has to be
+            // made again after a yield.
+            RunnerYieldPolicy yieldPolicy;
+            auto_ptr<IndexDescriptor> desc(CatalogHack::getDescriptor(d, idxNo));
+            auto_ptr<BtreeBasedAccessMethod> iam(CatalogHack::getBtreeBasedIndex(desc.get()));
+            BSONObj o;
+            DiskLoc loc;
+            Runner::RunnerState state;
+            while (Runner::RUNNER_ADVANCED == (state = runner->getNext(&o, &loc))) {
+                BSONObjSet keys;
+                iam->getKeys(o, &keys);
+                phase1.addKeys(keys, loc, true);
+                pm.hit();
+
+                if (yieldPolicy.shouldYield()) {
+                    uassert(17150, "cursor gone during bg index",
+                            yieldPolicy.yieldAndCheckIfOK(runner.get()));
+                    pm->setTotalWhileRunning(d->numRecords());
+                    idxNo = IndexBuildsInProgress::get(ns, idxName);
+                    iam.reset();
+                    desc.reset(CatalogHack::getDescriptor(d, idxNo));
+                    iam.reset(CatalogHack::getBtreeBasedIndex(desc.get()));
+                }
+            }
+            uassert(17151, "Internal error reading docs from collection",
+                    Runner::RUNNER_EOF == state);
+        }
+        pm.finished();
+
+        if( phase1.multi ) {
+            d->setIndexIsMultikey(ns, idxNo);
+        }
+
+        {
+            // the sort only works on memory and the sorter's files: writers go on meanwhile
+            dbtempreleasecond unlock;
+            phase1.sorter->sort( true );
+        }
+        LOG(t.seconds() > 5 ? 0 : 1) << "\t external sort used : " << phase1.sorter->numFiles()
+                                     << " files " << " in " << t.seconds() << " secs" << endl;
+
+        /* build index, yielding while the sorted runs are merged into it --- */
+        BackgroundBuildYield yield(ns, d, idxName);
+        set<DiskLoc> dupsToDrop;
+        buildBottomUp(true, yield.idx(), false, dupsToDrop, op, &phase1, pm, t, true, &yield);
+
+        /* apply the writes recorded meanwhile, yielding, until none are left --- */
+        op->setMessage("index: applying writes made during the build",
+                       "Index: Side Writes Applied",
+                       sideWrites.size(),
+                       10);
+        Ordering ordering = Ordering::make(yield.idx().keyPattern());
+        while (sideWrites.size() > 0) {
+            sideWrites.applyNext(yield.idx(), ordering);
+            pm.hit();
+
+            getDur().commitIfNeeded();
+            if (yield.yieldIfNeeded()) {
+                pm->setTotalWhileRunning(pm->done() + sideWrites.size());
+            }
+        }
+        pm.finished();
+        LOG(t.seconds() > 5 ? 0 : 1) << "\t applied " << sideWrites.numRecorded()
+                                     << " writes made during the build" << endl;
+
+        // the write lock is held from the last check above, so no write can be missed before the
+        // caller completes the index
+        return phase1.n;
+    }
+
+    BackgroundBuildYield::BackgroundBuildYield(const char* ns, NamespaceDetails* d,
+                                               const string& idxName) :
+        _ns(ns),
+        _d(d),
+        _idxName(idxName),
+        _idxNo(IndexBuildsInProgress::get(ns, idxName)),
+        _policy(new RunnerYieldPolicy()) {
+    }
+
+    BackgroundBuildYield::~BackgroundBuildYield() { }
+
+    bool BackgroundBuildYield::yieldIfNeeded() {
+        if (!_policy->shouldYield()) {
+            return false;
+        }
+        _policy->yield();
+        _idxNo = IndexBuildsInProgress::get(_ns, _idxName);
+        return true;
+    }
+
+    IndexDetails& BackgroundBuildYield::idx() const {
+        return _d->idx(_idxNo);
+    }
+
     void BtreeBasedBuilder::doDropDups(const char* ns, NamespaceDetails* d,
                                        const set<DiskLoc>& dupsToDrop, bool mayInterrupt) {
 
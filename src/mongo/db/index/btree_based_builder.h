@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <boost/scoped_ptr.hpp>
 #include <set>
+#include <vector>
 
 #include "mongo/db/jsobj.h"
 #include "mongo/db/pdfile.h"
@@ -32,10 +34,12 @@ namespace mongo {
 
     class BSONObjExternalSorter;
     class ExternalSortComparison;
+    class IndexDescriptor;
     class IndexDetails;
     class NamespaceDetails;
     class ProgressMeter;
     class ProgressMeterHolder;
+    class RunnerYieldPolicy;
     struct SortPhaseOne;
 
     class BtreeBasedBuilder {
@@ -45,15 +49,42 @@ namespace mongo {
          */
         static uint64_t fastBuildIndex(const char* ns, NamespaceDetails* d, IndexDetails& idx,
                                        bool mayInterrupt, int idxNo);
+
+        /**
+         * Builds the indexes 'descriptors' of the collection 'ns' as fastBuildIndex() does, from
+         * one scan of the collection that generates the keys of all of them, each into a sorter
+         * of its own.  None may drop duplicates: the other indexes have the keys of the documents
+         * it would delete.  Returns the number of documents scanned.  Throws DBException.
+         */
+        static uint64_t fastBuildIndexes(const char* ns, NamespaceDetails* d,
+                                         const vector<IndexDescriptor*>& descriptors,
+                                         bool mayInterrupt);
+
         static DiskLoc makeEmptyIndex(const IndexDetails& idx);
         static ExternalSortComparison* getComparison(int version, const BSONObj& keyPattern);
 
+        /**
+         * Builds the background index 'idxName' as fastBuildIndex() does, but from a scan of the
+         * collection that yields.  The writes made to the collection meanwhile are recorded in a
+         * SideWriteTable, and applied once the btree is loaded.  Returns holding the write lock
+         * with the index ready to be completed.  Throws DBException.
+         */
+        static uint64_t bulkLoadInBackground(const char* ns, NamespaceDetails* d,
+                                             const string& idxName);
+        /** @return whether bulkLoadInBackground() can build 'idx' */
+        static bool canBulkLoadInBackground(const IndexDetails& idx);
+
     private:
         friend class IndexUpdateTests::AddKeysToPhaseOne;
         friend class IndexUpdateTests::InterruptAddKeysToPhaseOne;
         friend class IndexUpdateTests::DoDropDups;
         friend class IndexUpdateTests::InterruptDoDropDups;
 
+        class ParallelPhaseOne; // addKeysToPhaseOne() on several threads
+
+        /** sets up 'phaseOne' to sort the keys of 'idx' in runs of up to 'sortBytes' */
+        static void initPhaseOne(const IndexDetails& idx, SortPhaseOne* phaseOne,
+                                 long sortBytes = 100 * 1024 * 1024);
 
         static void addKeysToPhaseOne(NamespaceDetails* d, const char* ns, const IndexDetails& idx,
                                       const BSONObj& order, SortPhaseOne* phaseOne,
@@ -61,11 +92,48 @@ namespace mongo {
                                       bool mayInterrupt,
                                       int idxNo);
 
+        /** addKeysToPhaseOne() for several indexes from one scan, 'phaseOnes[i]' sorting the
+            keys of 'descriptors[i]'
+        */
+        static void addKeysToPhaseOnes(const char* ns,
+                                       const vector<IndexDescriptor*>& descriptors,
+                                       const vector<SortPhaseOne*>& phaseOnes,
+                                       int64_t nrecords, ProgressMeter* progressMeter,
+                                       bool mayInterrupt);
+
         static void doDropDups(const char* ns, NamespaceDetails* d, const set<DiskLoc>& dupsToDrop,
                                bool mayInterrupt );
     };
 
-    // Exposed for testing purposes.
+    /**
+     * Releases the write lock from time to time while a background build works on the index
+     * 'idxName' of 'ns', and finds the index again after: the details of an index being built
+     * can move while the lock is released, see insert_makeIndex.
+     */
+    class BackgroundBuildYield : boost::noncopyable {
+    public:
+        BackgroundBuildYield(const char* ns, NamespaceDetails* d, const string& idxName);
+        ~BackgroundBuildYield();
+
+        /**
+         * Yields the write lock if it was held a while and other operations wait for it.
+         * @return true if it may have, idx() having to be looked up again
+         */
+        bool yieldIfNeeded();
+
+        int idxNo() const { return _idxNo; }
+        IndexDetails& idx() const;
+
+    private:
+        const char* _ns;
+        NamespaceDetails* _d;
+        const string _idxName;
+        int _idxNo;
+        boost::scoped_ptr<RunnerYieldPolicy> _policy;
+    };
+
+    // Exposed for testing purposes.  With 'yield', the write lock is released from time to time
+    // while the btree is loaded.
     template< class V >
     void buildBottomUpPhases2And3( bool dupsAllowed,
                                    IndexDetails& idx,
@@ -76,6 +144,7 @@ namespace mongo {
                                    SortPhaseOne* phase1,
                                    ProgressMeterHolder& pm,
                                    Timer& t,
-                                   bool mayInterrupt );
+                                   bool mayInterrupt,
+                                   BackgroundBuildYield* yield = NULL );
 
 }  // namespace mongo
@@ -119,10 +119,23 @@ namespace mongo {
         virtual Status validate(int64_t* numKeys) = 0;
 
         //
-        // Bulk operations support (TODO)
+        // Bulk operations support
         //
 
-        // virtual Status insertBulk(BulkDocs arg) = 0;
+        /**
+         * Insert the keys of the first 'numObjs' documents of 'objs', which are at the matching
+         * positions of 'locs', adding them in key order rather than document by document.
+         * Stops at the first document (in 'objs' order) whose keys can't be generated or,
+         * without options.dupsAllowed, some key of which is refused as a duplicate: on return the keys of objs[0 .. *numIndexed) are
+         * in the index and none of the keys of the documents after.  With it, as insert() does,
+         * a key that fails is logged and skipped, its document is kept, and the error is
+         * returned with *numIndexed == numObjs.
+         */
+        virtual Status insertBulk(const vector<BSONObj>& objs,
+                                  const vector<DiskLoc>& locs,
+                                  size_t numObjs,
+                                  const InsertDeleteOptions& options,
+                                  size_t* numIndexed) = 0;
 
         // virtual Status removeBulk(BulkDocs arg) = 0;
     };
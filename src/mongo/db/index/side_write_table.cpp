@@ -0,0 +1,181 @@
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/db/index/side_write_table.h"
+
+#include <boost/filesystem/operations.hpp>
+#include <map>
+
+#include "mongo/db/cmdline.h"
+#include "mongo/db/index.h"
+#include "mongo/db/index/btree_interface.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/util/concurrency/mutex.h"
+
+namespace mongo {
+
+    /** memory the writes recorded during a background index build may take before they spill */
+    MONGO_EXPORT_SERVER_PARAMETER(sideWriteTableMaxMB, int, 100);
+
+    namespace {
+        // the builds of different databases register and look up their tables concurrently
+        SimpleMutex tablesMutex("SideWriteTable");
+        std::map<DiskLoc, SideWriteTable*> tables;
+        unsigned long long nextSpillFile = 0;
+    }
+
+    SideWriteTable::SideWriteTable(const IndexDetails& idx) :
+        _info(idx.info),
+        _bytes(0),
+        _nRecorded(0),
+        _nSpilled(0),
+        _spillReadOfs(0),
+        _spillWriteOfs(0) {
+        SimpleMutex::scoped_lock lk(tablesMutex);
+        verify(tables.find(_info) == tables.end());
+        tables[_info] = this;
+    }
+
+    SideWriteTable::~SideWriteTable() {
+        {
+            SimpleMutex::scoped_lock lk(tablesMutex);
+            tables.erase(_info);
+        }
+        if (_spillFile) {
+            _spillFile.reset();
+            try {
+                boost::filesystem::remove(_spillPath);
+            }
+            catch (const boost::filesystem::filesystem_error& e) {
+                warning() << "couldn't remove " << _spillPath << ": " << e.what() << endl;
+            }
+        }
+    }
+
+    SideWriteTable* SideWriteTable::get(const IndexDetails& idx) {
+        SimpleMutex::scoped_lock lk(tablesMutex);
+        std::map<DiskLoc, SideWriteTable*>::const_iterator i = tables.find(idx.info);
+        return i == tables.end() ? NULL : i->second;
+    }
+
+    void SideWriteTable::insert(const BSONObj& key, const DiskLoc& loc) {
+        add(true, key, loc);
+    }
+
+    void SideWriteTable::remove(const BSONObj& key, const DiskLoc& loc) {
+        add(false, key, loc);
+    }
+
+    void SideWriteTable::add(bool insert, const BSONObj& key, const DiskLoc& loc) {
+        Write w;
+        w.insert = insert;
+        w.key = key.getOwned();
+        w.loc = loc;
+        _writes.push_back(w);
+        _bytes += sizeof(Write) + w.key.objsize();
+        _nRecorded++;
+        if (_bytes > static_cast<size_t>(sideWriteTableMaxMB) * 1024 * 1024) {
+            spill();
+        }
+    }
+
+    void SideWriteTable::spill() {
+        if (!_spillFile) {
+            stringstream path;
+            path << dbpath;
+            if (dbpath[dbpath.size() - 1] != '/') {
+                path << '/';
+            }
+            {
+                SimpleMutex::scoped_lock lk(tablesMutex);
+                path << "_tmp/sidewrites." << time(0) << '.' << nextSpillFile++;
+            }
+            _spillPath = path.str();
+            boost::filesystem::create_directories(boost::filesystem::path(_spillPath).parent_path());
+            _spillFile.reset(new File());
+            _spillFile->open(_spillPath.c_str());
+            uassert(17152, str::stream() << "couldn't open " << _spillPath, !_spillFile->bad());
+            LOG(1) << "spilling the writes recorded for an index build to " << _spillPath << endl;
+        }
+
+        // the older writes are already in the file, and these go after them
+        BufBuilder buf;
+        for (std::deque<Write>::const_iterator i = _writes.begin(); i != _writes.end(); ++i) {
+            BSONObjBuilder b(buf);
+            b.appendBool("i", i->insert);
+            b.append("k", i->key);
+            b.append("a", i->loc.a());
+            b.append("o", i->loc.getOfs());
+            b.done();
+        }
+        _spillFile->write(_spillWriteOfs, buf.buf(), buf.len());
+        uassert(17153, str::stream() << "couldn't write to " << _spillPath, !_spillFile->bad());
+        _spillWriteOfs += buf.len();
+        _nSpilled += _writes.size();
+        _writes.clear();
+        _bytes = 0;
+    }
+
+    SideWriteTable::Write SideWriteTable::readSpilled() {
+        int size;
+        _spillFile->read(_spillReadOfs, reinterpret_cast<char*>(&size), sizeof(size));
+        uassert(17154, str::stream() << "couldn't read from " << _spillPath, !_spillFile->bad());
+        boost::shared_array<char> data(new char[size]);
+        _spillFile->read(_spillReadOfs, data.get(), size);
+        uassert(17155, str::stream() << "couldn't read from " << _spillPath, !_spillFile->bad());
+        _spillReadOfs += size;
+        if (--_nSpilled == 0) {
+            // all read back, the next spill can start over
+            _spillReadOfs = _spillWriteOfs = 0;
+        }
+
+        BSONObj o(data.get());
+        Write w;
+        w.insert = o["i"].trueValue();
+        w.key = o["k"].Obj().getOwned();
+        w.loc = DiskLoc(o["a"].numberInt(), o["o"].numberInt());
+        return w;
+    }
+
+    void SideWriteTable::applyNext(IndexDetails& idx, const Ordering& ordering) {
+        Write w;
+        if (_nSpilled > 0) {
+            w = readSpilled();
+        }
+        else {
+            verify(!_writes.empty());
+            w = _writes.front();
+            _writes.pop_front();
+            _bytes -= sizeof(Write) + w.key.objsize();
+        }
+
+        BtreeInterface* btree = BtreeInterface::interfaces[idx.version()];
+        if (!w.insert) {
+            btree->unindex(idx.head, idx, w.key, w.loc);
+            return;
+        }
+        try {
+            btree->bt_insert(idx.head, w.loc, w.key, ordering, true, idx, true);
+        }
+        catch (AssertionException& e) {
+            // 10287: key+recloc already in index, from the scan
+            if (e.getCode() != 10287) {
+                throw;
+            }
+        }
+    }
+
+}  // namespace mongo
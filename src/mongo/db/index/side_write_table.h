@@ -0,0 +1,95 @@
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/scoped_ptr.hpp>
+#include <deque>
+
+#include "mongo/db/diskloc.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/util/file.h"
+
+namespace mongo {
+
+    class IndexDetails;
+
+    /**
+     * The keys inserted into and removed from an index while a background build loads it from a
+     * yielding scan of the collection.  Writers add their changes here rather than to the btree,
+     * which the build loads bottom up once the scan is done, and then applies the changes to in
+     * the order they were made.  Whatever version of a document the scan saw, the changes made to
+     * it after the build started leave its current keys in the index.
+     *
+     * A table is registered for its index from construction to destruction.  Writers find it with
+     * get() and add to it holding the write lock, as the build does when it reads it.
+     *
+     * The writes are kept in memory up to the sideWriteTableMaxMB server parameter.  Past that the
+     * ones held in memory are appended to a file in the _tmp directory, which is read back first
+     * when they are applied, so a build on a busy collection doesn't grow without bound.
+     */
+    class SideWriteTable : boost::noncopyable {
+    public:
+        explicit SideWriteTable(const IndexDetails& idx);
+        ~SideWriteTable();
+
+        /** @return the table recording the writes to 'idx', or NULL if its writes go to its btree */
+        static SideWriteTable* get(const IndexDetails& idx);
+
+        void insert(const BSONObj& key, const DiskLoc& loc);
+        void remove(const BSONObj& key, const DiskLoc& loc);
+
+        /** the number of writes recorded and not applied yet */
+        size_t size() const { return _writes.size() + _nSpilled; }
+
+        /** the number of writes recorded, applied or not */
+        unsigned long long numRecorded() const { return _nRecorded; }
+
+        /**
+         * Applies the oldest write not applied yet to the btree of 'idx', which must contain the
+         * keys the scan found, and discards it.  A key inserted that is already there was found by
+         * the scan, a key removed that isn't there wasn't.
+         */
+        void applyNext(IndexDetails& idx, const Ordering& ordering);
+
+    private:
+        struct Write {
+            bool insert;
+            BSONObj key;
+            DiskLoc loc;
+        };
+
+        void add(bool insert, const BSONObj& key, const DiskLoc& loc);
+
+        /** appends the writes held in memory to the spill file */
+        void spill();
+
+        /** reads back the oldest write in the spill file */
+        Write readSpilled();
+
+        const DiskLoc _info; // names the index, whose IndexDetails can move while the build yields
+        std::deque<Write> _writes; // the newest writes, the older ones are in the spill file
+        size_t _bytes;             // memory held by _writes
+        unsigned long long _nRecorded;
+
+        std::string _spillPath;
+        boost::scoped_ptr<File> _spillFile; // opened by the first spill
+        size_t _nSpilled;          // writes in the spill file not applied yet
+        fileofs _spillReadOfs;
+        fileofs _spillWriteOfs;
+    };
+
+}  // namespace mongo
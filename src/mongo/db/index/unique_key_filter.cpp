@@ -0,0 +1,326 @@
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/db/index/unique_key_filter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "mongo/base/counter.h"
+#include "mongo/db/btree.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/index.h"
+#include "mongo/db/namespace_details.h"
+#include "mongo/db/namespace_details-inl.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/util/timer.h"
+
+namespace mongo {
+
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(uniqueIndexBloomFilters, bool, false);
+
+    // building a filter walks the whole btree holding the write lock, so indexes larger than
+    // this get no filter rather than stalling the writes (and a secondary's oplog application)
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(uniqueIndexBloomFilterMaxKeys, int, 1000000);
+
+    namespace {
+
+        Counter64 lookups;
+        Counter64 misses;
+        Counter64 falsePositives;
+        Counter64 builds;
+        ServerStatusMetricField<Counter64> displayLookups("index.uniqueKeyFilter.lookups",
+                                                          &lookups);
+        ServerStatusMetricField<Counter64> displayMisses("index.uniqueKeyFilter.misses",
+                                                         &misses);
+        ServerStatusMetricField<Counter64> displayFalsePositives(
+                                                "index.uniqueKeyFilter.falsePositives",
+                                                &falsePositives);
+        ServerStatusMetricField<Counter64> displayBuilds("index.uniqueKeyFilter.builds",
+                                                         &builds);
+
+        // about 1% false positives when the filter is full
+        const size_t BitsPerKey = 10;
+        const size_t BitsPerBlock = 512;
+        const int BitsSetPerKey = 7;
+
+        /** the finalizer of MurmurHash3, so that every bit of a hash depends on every bit hashed */
+        uint64_t mix(uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        /** 64 bit FNV-1a */
+        class Hasher {
+        public:
+            Hasher() : _h(14695981039346656037ULL) { }
+
+            void add(const void* data, size_t len) {
+                const unsigned char* p = static_cast<const unsigned char*>(data);
+                for (size_t i = 0; i < len; i++) {
+                    _h ^= p[i];
+                    _h *= 1099511628211ULL;
+                }
+            }
+
+            template<class T>
+            void addValue(const T& value) { add(&value, sizeof(value)); }
+
+            void addString(const char* s) { add(s, strlen(s)); }
+
+            uint64_t finish() const { return mix(_h); }
+
+        private:
+            uint64_t _h;
+        };
+
+        /**
+         * Hashes what compareElementValues() looks at, coarsely where it compares more loosely
+         * than the bytes: numbers as doubles, and code with scope by its code only.
+         */
+        void hashElement(const BSONElement& e, bool withFieldName, Hasher* hasher) {
+            hasher->addValue(e.canonicalType());
+            if (withFieldName) {
+                hasher->addString(e.fieldName());
+            }
+            switch (e.type()) {
+            case EOO:
+            case Undefined:
+            case jstNULL:
+            case MaxKey:
+            case MinKey:
+                break;
+            case Bool:
+                hasher->addValue(e.boolean());
+                break;
+            case Timestamp:
+            case Date:
+                hasher->addValue(e.date().millis);
+                break;
+            case NumberDouble:
+            case NumberLong:
+            case NumberInt: {
+                double d = e.number();
+                if (isNaN(d)) {
+                    d = std::numeric_limits<double>::quiet_NaN();
+                }
+                else if (d == 0) {
+                    d = 0; // -0 == 0
+                }
+                hasher->addValue(d);
+                break;
+            }
+            case Code:
+            case Symbol:
+            case String:
+                hasher->add(e.valuestr(), e.valuestrsize());
+                break;
+            case Object:
+            case Array: {
+                BSONObjIterator i(e.embeddedObject());
+                while (i.more()) {
+                    hashElement(i.next(), true, hasher);
+                }
+                break;
+            }
+            case RegEx:
+                hasher->addString(e.regex());
+                hasher->addString(e.regexFlags());
+                break;
+            case CodeWScope:
+                hasher->addString(e.codeWScopeCode());
+                break;
+            default:
+                // jstOID, BinData, DBRef
+                hasher->add(e.value(), e.valuesize());
+                break;
+            }
+        }
+
+        /** @return false, leaving the walk, once 'filter' holds more than 'maxKeys' keys */
+        template<class V>
+        bool addKeys(const DiskLoc& bucketLoc, size_t maxKeys, UniqueKeyFilter* filter) {
+            if (bucketLoc.isNull()) {
+                return true;
+            }
+            const BtreeBucket<V>* bucket = bucketLoc.btree<V>();
+            for (int i = 0; i < bucket->getN(); i++) {
+                typename BucketBasics<V>::KeyNode kn = bucket->keyNode(i);
+                if (!addKeys<V>(kn.prevChildBucket, maxKeys, filter)) {
+                    return false;
+                }
+                if (bucket->isUsed(i)) {
+                    filter->add(UniqueKeyFilter::hash(kn.key.toBson()));
+                    if (filter->size() > maxKeys) {
+                        return false;
+                    }
+                }
+            }
+            return addKeys<V>(bucket->getNextChild(), maxKeys, filter);
+        }
+
+        bool addKeys(const IndexDetails& idx, size_t maxKeys, UniqueKeyFilter* filter) {
+            switch (idx.version()) {
+            case 0: return addKeys<V0>(idx.head, maxKeys, filter);
+            case 1: return addKeys<V1>(idx.head, maxKeys, filter);
+            default: verify(2 == idx.version()); return addKeys<V2>(idx.head, maxKeys, filter);
+            }
+        }
+
+        /**
+         * @return a filter of the keys of 'idx', with room for as many again, or an empty pointer
+         * if the index has more than uniqueIndexBloomFilterMaxKeys keys
+         */
+        shared_ptr<UniqueKeyFilter> build(const IndexDetails& idx, long long nrecords) {
+            const size_t maxKeys = static_cast<size_t>(std::max(uniqueIndexBloomFilterMaxKeys, 0));
+            if (static_cast<unsigned long long>(nrecords) > maxKeys) {
+                return shared_ptr<UniqueKeyFilter>();
+            }
+            Timer t;
+            size_t capacity = std::max(2 * static_cast<size_t>(nrecords), size_t(1024));
+            shared_ptr<UniqueKeyFilter> filter(new UniqueKeyFilter(capacity));
+            if (!addKeys(idx, maxKeys, filter.get())) {
+                // a multikey index with too many keys; the walk stopped at maxKeys of them
+                return shared_ptr<UniqueKeyFilter>();
+            }
+            if (filter->size() > capacity / 2) {
+                // a multikey index, with more keys than records
+                filter.reset(new UniqueKeyFilter(2 * filter->size()));
+                addKeys(idx, maxKeys, filter.get());
+            }
+            builds.increment();
+            LOG(t.millis() > 100 ? 0 : 1) << "built the unique key filter of " << idx.indexNamespace()
+                                          << ", " << filter->size() << " keys, in " << t.millis()
+                                          << "ms" << endl;
+            return filter;
+        }
+
+        bool filterable(const IndexDetails& idx) {
+            return uniqueIndexBloomFilters && (idx.unique() || idx.isIdIndex());
+        }
+
+    }  // namespace
+
+    UniqueKeyFilter::UniqueKeyFilter(size_t capacity) :
+        _capacity(capacity),
+        _n(0),
+        _words((capacity * BitsPerKey / BitsPerBlock + 1) * BlockWords, 0) {
+    }
+
+    // static
+    UniqueKeyFilter::Answer UniqueKeyFilter::check(const IndexDetails& idx, const BSONObj& key) {
+        if (!filterable(idx)) {
+            return NO_FILTER;
+        }
+        const string ns = idx.parentNS();
+        const string name = idx.indexName();
+        NamespaceDetailsTransient& nsdt = NamespaceDetailsTransient::get(ns.c_str());
+        UniqueKeyFilter* filter = nsdt.uniqueKeyFilter(name);
+        if (!filter) {
+            // readers share the filters but don't build them
+            if (!Lock::isWriteLocked(ns) || nsdt.uniqueKeyFilterDeclined(name)) {
+                return NO_FILTER;
+            }
+            NamespaceDetails* d = nsdetails(ns);
+            if (!d || d->idxNo(idx) >= d->getCompletedIndexCount()) {
+                return NO_FILTER;
+            }
+            shared_ptr<UniqueKeyFilter> built = build(idx, d->numRecords());
+            if (!built) {
+                log() << "not building a unique key filter of " << idx.indexNamespace()
+                      << ", it has more than uniqueIndexBloomFilterMaxKeys ("
+                      << uniqueIndexBloomFilterMaxKeys << ") keys" << endl;
+                nsdt.declineUniqueKeyFilter(name);
+                return NO_FILTER;
+            }
+            nsdt.setUniqueKeyFilter(name, built);
+            filter = built.get();
+        }
+
+        lookups.increment();
+        if (filter->mayContain(hash(key))) {
+            return MAYBE_PRESENT;
+        }
+        misses.increment();
+        return ABSENT;
+    }
+
+    // static
+    void UniqueKeyFilter::noteInsert(const IndexDetails& idx, const BSONObj& key) {
+        if (!filterable(idx)) {
+            return;
+        }
+        const string name = idx.indexName();
+        NamespaceDetailsTransient& nsdt = NamespaceDetailsTransient::get(idx.parentNS().c_str());
+        UniqueKeyFilter* filter = nsdt.uniqueKeyFilter(name);
+        if (!filter) {
+            return;
+        }
+        if (filter->full()) {
+            // the next check() builds a larger one
+            nsdt.setUniqueKeyFilter(name, shared_ptr<UniqueKeyFilter>());
+            return;
+        }
+        filter->add(hash(key));
+    }
+
+    // static
+    void UniqueKeyFilter::noteFalsePositive() {
+        falsePositives.increment();
+    }
+
+    // static
+    uint64_t UniqueKeyFilter::hash(const BSONObj& key) {
+        // btree keys compare without their field names
+        Hasher hasher;
+        BSONObjIterator i(key);
+        while (i.more()) {
+            hashElement(i.next(), false, &hasher);
+        }
+        return hasher.finish();
+    }
+
+    size_t UniqueKeyFilter::block(uint64_t keyHash) const {
+        const uint64_t nblocks = _words.size() / BlockWords;
+        return static_cast<size_t>(((keyHash >> 32) * nblocks) >> 32) * BlockWords;
+    }
+
+    void UniqueKeyFilter::add(uint64_t keyHash) {
+        uint64_t* words = &_words[block(keyHash)];
+        uint64_t bits = mix(keyHash);
+        for (int i = 0; i < BitsSetPerKey; i++, bits >>= 9) {
+            words[(bits & 511) >> 6] |= 1ULL << (bits & 63);
+        }
+        _n++;
+    }
+
+    bool UniqueKeyFilter::mayContain(uint64_t keyHash) const {
+        const uint64_t* words = &_words[block(keyHash)];
+        uint64_t bits = mix(keyHash);
+        for (int i = 0; i < BitsSetPerKey; i++, bits >>= 9) {
+            if (!(words[(bits & 511) >> 6] & (1ULL << (bits & 63)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+}  // namespace mongo
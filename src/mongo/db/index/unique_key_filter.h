@@ -0,0 +1,90 @@
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/platform/cstdint.h"
+
+namespace mongo {
+
+    class IndexDetails;
+
+    /**
+     * A blocked Bloom filter over the keys of a unique or _id index, held in memory so that a
+     * lookup of a key the index doesn't have can usually be answered without reading its btree.
+     * Each key sets bits in one 64 byte block only, so adding or testing a key touches one cache
+     * line.  Keys equal as index keys (5, 5.0 and NumberLong(5) for instance) hash the same.
+     *
+     * Filters are enabled by the uniqueIndexBloomFilters startup parameter.  The filter of an
+     * index is built from its btree by the first check() made holding the write lock, kept up to
+     * date by the inserts into the btree, and dropped with the other cached information of its
+     * collection when an index of the collection is added or dropped.  Removed keys stay in the
+     * filter, which only makes it answer MAYBE_PRESENT more often.
+     *
+     * The build walks the whole btree without yielding, stalling the other operations on the
+     * database (a secondary's oplog application included) for as long as it takes.  To bound the
+     * stall, indexes with more than uniqueIndexBloomFilterMaxKeys keys get no filter until the
+     * cached information of their collection is next dropped.
+     */
+    class UniqueKeyFilter : boost::noncopyable {
+    public:
+        /** an empty filter sized for 'capacity' keys */
+        explicit UniqueKeyFilter(size_t capacity);
+
+        enum Answer {
+            ABSENT,         // the index certainly doesn't hold the key
+            MAYBE_PRESENT,  // the index may hold the key
+            NO_FILTER       // the index has no filter to ask
+        };
+
+        /**
+         * @return whether the completed index 'idx' may hold 'key', according to its filter.
+         * Call holding at least the read lock of its collection.
+         */
+        static Answer check(const IndexDetails& idx, const BSONObj& key);
+
+        /** Adds 'key' to the filter of 'idx' if it has one.  Call holding the write lock. */
+        static void noteInsert(const IndexDetails& idx, const BSONObj& key);
+
+        /** Counts a lookup that check() answered MAYBE_PRESENT for and didn't find its key. */
+        static void noteFalsePositive();
+
+        /** @return a hash of 'key' that is the same for keys comparing equal in a btree */
+        static uint64_t hash(const BSONObj& key);
+
+        void add(uint64_t keyHash);
+        bool mayContain(uint64_t keyHash) const;
+
+        /** the number of keys added */
+        size_t size() const { return _n; }
+
+        /** true once more keys were added than the filter was sized for */
+        bool full() const { return _n > _capacity; }
+
+    private:
+        static const size_t BlockWords = 8;
+
+        size_t block(uint64_t keyHash) const;
+
+        const size_t _capacity;
+        size_t _n;
+        std::vector<uint64_t> _words;
+    };
+
+}  // namespace mongo
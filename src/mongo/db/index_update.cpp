@@ -16,6 +16,7 @@
 
 #include "mongo/db/index_update.h"
 
+#include "mongo/base/owned_pointer_vector.h"
 #include "mongo/client/dbclientinterface.h"
 #include "mongo/db/background.h"
 #include "mongo/db/btreebuilder.h"
@@ -24,6 +25,7 @@
 #include "mongo/db/index.h"
 #include "mongo/db/index/btree_based_builder.h"
 #include "mongo/db/index/catalog_hack.h"
+#include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/namespace_details.h"
 #include "mongo/db/pdfile_private.h"
@@ -117,6 +119,35 @@ namespace mongo {
         }
     }
 
+    size_t indexRecordBatch(NamespaceDetails* d, const vector<BSONObj>& objs,
+                            const vector<DiskLoc>& locs) {
+        size_t numIndexed = objs.size();
+        int numIndices = d->getTotalIndexCount();
+
+        for (int i = 0; i < numIndices && numIndexed > 0; ++i) {
+            IndexDetails& id = d->idx(i);
+            auto_ptr<IndexDescriptor> desc(CatalogHack::getDescriptor(d, i));
+            auto_ptr<IndexAccessMethod> iam(CatalogHack::getIndex(desc.get()));
+            InsertDeleteOptions options;
+            options.logIfError = false;
+            options.dupsAllowed = (!KeyPattern::isIdKeyPattern(id.keyPattern()) && !id.unique())
+                || ignoreUniqueIndex(id);
+
+            size_t n;
+            iam->insertBulk(objs, locs, numIndexed, options, &n);
+            if (n < numIndexed) {
+                // the indexes done before do not keep records this one did not take either
+                for (int j = 0; j < i; ++j) {
+                    for (size_t k = n; k < numIndexed; ++k) {
+                        _unindexRecord(d, j, objs[k], locs[k], false);
+                    }
+                }
+                numIndexed = n;
+            }
+        }
+        return numIndexed;
+    }
+
     //
     // Bulk index building
     //
@@ -239,8 +270,13 @@ namespace mongo {
 
             prep(ns.c_str(), d);
             try {
-                idx.head.writing() = BtreeBasedBuilder::makeEmptyIndex(idx);
-                n = addExistingToIndex(ns.c_str(), d, idx);
+                if (BtreeBasedBuilder::canBulkLoadInBackground(idx)) {
+                    n = BtreeBasedBuilder::bulkLoadInBackground(ns.c_str(), d, idx.indexName());
+                }
+                else {
+                    idx.head.writing() = BtreeBasedBuilder::makeEmptyIndex(idx);
+                    n = addExistingToIndex(ns.c_str(), d, idx);
+                }
                 // idx may point at an invalid index entry at this point
             }
             catch(...) {
@@ -284,6 +320,38 @@ namespace mongo {
         MONGO_TLOG(0) << "build index done.  scanned " << n << " total records. " << t.millis() / 1000.0 << " secs" << endl;
     }
 
+    void buildIndexes(const std::string& ns,
+                      NamespaceDetails* d,
+                      const std::vector<std::string>& idxNames,
+                      bool mayInterrupt) {
+
+        verify( Lock::isWriteLocked(ns) );
+
+        OwnedPointerVector<IndexDescriptor> descriptors;
+        for (size_t i = 0; i < idxNames.size(); i++) {
+            int idxNo = IndexBuildsInProgress::get(ns.c_str(), idxNames[i]);
+            descriptors.mutableVector().push_back(CatalogHack::getDescriptor(d, idxNo));
+            MONGO_TLOG(0) << "build index on: " << ns << " properties: "
+                          << d->idx(idxNo).info.obj().jsonString() << endl;
+        }
+
+        Timer t;
+        unsigned long long n = BtreeBasedBuilder::fastBuildIndexes(ns.c_str(), d,
+                                                                   descriptors.vector(),
+                                                                   mayInterrupt);
+        MONGO_TLOG(0) << "build " << idxNames.size() << " indexes done.  scanned " << n
+                      << " total records. " << t.millis() / 1000.0 << " secs" << endl;
+    }
+
+    bool canBuildWithOtherIndexes(const BSONObj& spec) {
+        // see buildAnIndex()
+        if ( !inDBRepair && spec["background"].trueValue() )
+            return false;
+        // dropping a duplicate deletes a document whose keys the other indexes were given
+        return !spec["unique"].trueValue() ||
+               !( spec["dropDups"].trueValue() || inDBRepair );
+    }
+
     extern BSONObj id_obj;  // { _id : 1 }
 
     void ensureHaveIdIndex(const char* ns, bool mayInterrupt) {
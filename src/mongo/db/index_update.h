@@ -37,9 +37,31 @@ namespace mongo {
                       IndexDetails& idx,
                       bool mayInterrupt);
 
+    /**
+     * Builds the foreground indexes 'idxNames' of 'd', all in progress, from one scan of the
+     * collection.  Throws DBException, with none of them built.
+     */
+    void buildIndexes(const std::string& ns,
+                      NamespaceDetails* d,
+                      const std::vector<std::string>& idxNames,
+                      bool mayInterrupt);
+
+    /** @return whether the index 'spec' can be built by buildIndexes() with others */
+    bool canBuildWithOtherIndexes(const BSONObj& spec);
+
     // add index keys for a newly inserted record 
     void indexRecord(const char *ns, NamespaceDetails *d, const BSONObj& obj, const DiskLoc &loc);
 
+    /**
+     * add the index keys for a batch of newly inserted records, objs[i] being at locs[i].  each
+     * index gets the keys of the whole batch in key order.  stops at the first record (in batch
+     * order) some key of which could not be added: that record and the ones after it are left
+     * out of all indexes.
+     * @return the number of records indexed, objs.size() if all were
+     */
+    size_t indexRecordBatch(NamespaceDetails* d, const vector<BSONObj>& objs,
+                            const vector<DiskLoc>& locs);
+
     bool dropIndexes(NamespaceDetails *d, const char *ns, const char *name, string &errmsg,
                      BSONObjBuilder &anObjBuilder, bool maydeleteIdIndex );
 
@@ -57,6 +57,7 @@
 #include "mongo/db/pagefault.h"
 #include "mongo/db/repl/is_master.h"
 #include "mongo/db/repl/oplog.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/stats/counters.h"
 #include "mongo/platform/process_id.h"
 #include "mongo/s/d_logic.h"
@@ -556,6 +557,9 @@ namespace mongo {
         Database *database = ctx->db();
         verify( database->name() == db );
 
+        // their records go with the Database object
+        database->dropInMemoryCollections();
+
         oplogCheckCloseDatabase( database ); // oplog caches some things, dirty its caches
 
         if( BackgroundOperation::inProgForDb(db) ) {
@@ -862,7 +866,106 @@ namespace mongo {
         logOp("i", ns, js);
     }
 
+    // multi document inserts into existing collections go through DataFileMgr::insertBatch()
+    MONGO_EXPORT_SERVER_PARAMETER(bulkInsertFastPath, bool, true);
+
+    /** @return true if checkAndInsert() would not refuse js before it gets to the insert */
+    static bool okForBatchInsert(const NamespaceString& nsString, const BSONObj& js) {
+        return js.objsize() <= BSONObjMaxUserSize &&
+               (nsString.isConfigDB() || js.okForStorageAsRoot()) &&
+               js["_id"].type() != Array;
+    }
+
+    static void logInserted(const char *ns, const vector<BSONObj>& objs,
+                            const vector<DiskLoc>& locs) {
+        for (size_t i = 0; i < locs.size(); i++) {
+            if (!locs[i].isNull())
+                logOp("i", ns, objs[i]);
+        }
+    }
+
+    /**
+     * insertMulti() with the runs of documents between those checkAndInsert() would refuse
+     * inserted by DataFileMgr::insertBatch().  the outcome is that of the document by document
+     * loop.
+     */
+    static void insertMultiBatched(bool keepGoing, const char *ns, NamespaceDetails *d,
+                                   vector<BSONObj>& objs, CurOp& op) {
+        NamespaceString nsString(ns);
+        size_t i = 0;
+        while (i < objs.size()) {
+            size_t end = i;
+            while (end < objs.size() && okForBatchInsert(nsString, objs[end]))
+                end++;
+
+            if (end > i) {
+                vector<BSONObj> batch(objs.begin() + i, objs.begin() + end);
+                vector<DiskLoc> locs;
+                try {
+                    theDataFileMgr.insertBatch(ns, d, batch, keepGoing, &locs);
+                }
+                catch (const UserException&) {
+                    if (!keepGoing || end == objs.size()) {
+                        logInserted(ns, batch, locs);
+                        // as the loop counts, up to the document that failed
+                        size_t n = 0;
+                        while (n < locs.size() && !locs[n].isNull())
+                            n++;
+                        globalOpCounters.incInsertInWriteLock(keepGoing ? objs.size() - 1 : i + n);
+                        throw;
+                    }
+                }
+                logInserted(ns, batch, locs);
+                getDur().commitIfNeeded();
+            }
+
+            if (end < objs.size()) {
+                // refused by checkAndInsert(), with its error
+                try {
+                    checkAndInsert(ns, objs[end]);
+                    getDur().commitIfNeeded();
+                }
+                catch (const UserException&) {
+                    if (!keepGoing || end == objs.size() - 1) {
+                        globalOpCounters.incInsertInWriteLock(end);
+                        throw;
+                    }
+                }
+                end++;
+            }
+            i = end;
+        }
+
+        globalOpCounters.incInsertInWriteLock(i);
+        op.debug().ninserted = i;
+    }
+
+    /**
+     * insertMulti() of index specs, without keepGoing: the indexes of a collection are built
+     * from one scan of it, see DataFileMgr::insertIndexes().
+     */
+    static void insertIndexSpecs(const char *ns, vector<BSONObj>& specs, CurOp& op) {
+        for (size_t i = 0; i < specs.size(); i++) {
+            uassert( 10059 , "object to insert too large", specs[i].objsize() <= BSONObjMaxUserSize);
+        }
+        // as checkAndInsert()
+        size_t n = theDataFileMgr.insertIndexes(ns, specs, cc().curop()->parent() == NULL, true);
+        globalOpCounters.incInsertInWriteLock(n);
+        op.debug().ninserted = n;
+    }
+
     NOINLINE_DECL void insertMulti(bool keepGoing, const char *ns, vector<BSONObj>& objs, CurOp& op) {
+        if (!keepGoing && nsToCollectionSubstring(ns) == "system.indexes") {
+            insertIndexSpecs(ns, objs, op);
+            return;
+        }
+
+        NamespaceDetails *d = nsdetails(ns);
+        if (bulkInsertFastPath && DataFileMgr::canInsertBatch(ns, d)) {
+            insertMultiBatched(keepGoing, ns, d, objs, op);
+            return;
+        }
+
         size_t i;
         for (i=0; i<objs.size(); i++){
             try {
@@ -244,6 +244,35 @@ namespace mongo {
         dassert( (*_keyData & cNOTUSED) == 0 );
     }
 
+    void KeyV2::own(const char *a, int aLen, const char *b, int bLen) {
+        _buf.reset(new char[aLen + bLen]);
+        memcpy(_buf.get(), a, aLen);
+        if ( bLen )
+            memcpy(_buf.get() + aLen, b, bLen);
+        _keyData = (const unsigned char *) _buf.get();
+        dassert( aLen + bLen == dataSize() );
+    }
+
+    KeyV2 KeyV2::join(const char *a, int aLen, const char *b, int bLen) {
+        KeyV2 k;
+        k.own(a, aLen, b, bLen);
+        return k;
+    }
+
+    BSONObj KeyV2::toBson() const {
+        BSONObj o = KeyV1::toBson();
+        return _buf ? o.getOwned() : o;
+    }
+
+    KeyV2Owned::KeyV2Owned(const KeyV2& rhs) {
+        own(rhs.data(), rhs.dataSize(), 0, 0);
+    }
+
+    KeyV2Owned::KeyV2Owned(const BSONObj& obj) {
+        KeyV1Owned k(obj);
+        own(k.data(), k.dataSize(), 0, 0);
+    }
+
     // fromBSON to Key format
     KeyV1Owned::KeyV1Owned(const BSONObj& obj) {
         BSONObj::iterator i(obj);
@@ -514,6 +543,61 @@ namespace mongo {
         return 0;
     }
 
+    /** @return the first 4 bytes at p big endian, the bytes past len taken as 0 */
+    static unsigned leadingBytes(const unsigned char *p, int len) {
+        unsigned x = 0;
+        for( int i = 0; i < 4; i++ ) {
+            x <<= 8;
+            if( i < len )
+                x |= p[i];
+        }
+        return x;
+    }
+
+    unsigned KeyV1::searchPrefix() const {
+        const unsigned char *p = _keyData;
+        if( !isCompactFormat() )
+            return 0;
+
+        // the canonical type in the top 4 bits, which are never all 0, then the first 28 bits of
+        // the value in an order compare() agrees with
+        unsigned type = *p & cCANONTYPEMASK;
+        p++;
+        unsigned long long v = 0;
+        switch( type ) {
+        case cdouble:
+            {
+                double d = (reinterpret_cast< const PackedDouble* >(p))->d;
+                if( d == 0 )
+                    d = 0; // -0 == 0
+                memcpy(&v, &d, sizeof(v));
+                v = ( v & 0x8000000000000000ULL ) ? ~v : v | 0x8000000000000000ULL;
+                break;
+            }
+        case cdate:
+            {
+                long long L;
+                memcpy(&L, p, sizeof(L));
+                v = ((unsigned long long) L) ^ 0x8000000000000000ULL;
+                break;
+            }
+        case cstring:
+            v = ((unsigned long long) leadingBytes(p + 1, *p)) << 32;
+            break;
+        case coid:
+            v = ((unsigned long long) leadingBytes(p, 4)) << 32;
+            break;
+        case cbindata:
+            // length code and subtype, then the data
+            v = ((unsigned long long) leadingBytes(p, 1 + binDataCodeToLength(*p))) << 32;
+            break;
+        default:
+            // e.g. null == null
+            ;
+        }
+        return ( type << 28 ) | (unsigned) ( v >> 36 );
+    }
+
     // at least one of this and right are traditional BSON format
     int NOINLINE_DECL KeyV1::compareHybrid(const KeyV1& right, const Ordering& order) const { 
         BSONObj L = toBson();
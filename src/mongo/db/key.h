@@ -18,6 +18,8 @@
 
 #pragma once
  
+#include <boost/shared_array.hpp>
+
 #include "jsobj.h"
 
 namespace mongo { 
@@ -27,6 +29,8 @@ namespace mongo {
         KeyBson is a legacy wrapper implementation for old BSONObj style keys for v:0 indexes.
 
         KeyV1 is the new implementation.
+
+        KeyV2 is KeyV1 for v:2 (prefix compressed) indexes.
     */
     class KeyBson /* "KeyV0" */ { 
     public:
@@ -87,6 +91,12 @@ namespace mongo {
         bool isCompactFormat() const { return *_keyData != IsBSON; }
 
         bool isValid() const { return _keyData > (const unsigned char*)1; }
+
+        /** @return a number ordered as the first field of compact format keys is in woCompare
+                    (ascending), or 0 for keys in BSON format.  only unequal nonzero values of two
+                    keys decide how the keys compare.
+        */
+        unsigned searchPrefix() const;
     protected:
         enum { IsBSON = 0xff };
         const unsigned char *_keyData;
@@ -115,4 +125,44 @@ namespace mongo {
         void traditional(const BSONObj& obj); // store as traditional bson not as compact format
     };
 
+    class KeyV2Owned;
+
+    /** corresponding to BtreeData_V2.  the key data is in KeyV1 format, but a key read from a
+        prefix compressed bucket is put back together in a buffer of its own, which copies share.
+    */
+    class KeyV2 : public KeyV1 {
+        void operator=(const KeyV2&);
+        KeyV2(const KeyV2Owned&);
+    public:
+        KeyV2() { }
+        explicit KeyV2(const char *keyData) : KeyV1(keyData) { }
+        KeyV2(const KeyV2& rhs) : KeyV1(rhs), _buf(rhs._buf) { }
+
+        void assign(const KeyV2& rhs) {
+            KeyV1::assign(rhs);
+            _buf = rhs._buf;
+        }
+
+        /** @return a key holding a copy of the aLen bytes at a followed by the bLen bytes at b */
+        static KeyV2 join(const char *a, int aLen, const char *b, int bLen);
+
+        /** as KeyV1::toBson(), but a key that isn't in compact format and was put back together
+            in a buffer of its own is copied out of it, as the buffer may go with this key */
+        BSONObj toBson() const;
+        string toString() const { return toBson().toString(); }
+    protected:
+        void own(const char *a, int aLen, const char *b, int bLen);
+        boost::shared_array<char> _buf;
+    };
+
+    class KeyV2Owned : public KeyV2 {
+        void operator=(const KeyV2Owned&);
+    public:
+        /** @obj a BSON object to be translated to KeyV1 format, as KeyV1Owned does */
+        KeyV2Owned(const BSONObj& obj);
+
+        /** makes a copy */
+        KeyV2Owned(const KeyV2& rhs);
+    };
+
 };
@@ -0,0 +1,551 @@
+// @file key_string.cpp
+
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/db/key_string.h"
+
+#include "mongo/platform/float_utils.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    namespace {
+
+        // type bytes, in canonicalizeBSONType() order.  all are below 0x80 so a bit inverted
+        // (descending) field can be told from an ascending one.
+        enum {
+            kEnd = 4,           // ends the key and each embedded object or array
+            kMinKey = 10,
+            kUndefined = 15,
+            kNull = 20,
+            kNumber = 30,
+            kString = 35,       // and Symbol
+            kObject = 40,
+            kArray = 45,
+            kBinData = 50,
+            kOID = 55,
+            kBool = 60,
+            kDate = 65,
+            kTimestamp = 66,
+            kRegEx = 70,
+            kDBRef = 75,
+            kCode = 80,
+            kCodeWScope = 85,
+            kMaxKey = 120
+        };
+
+        // what follows the double of a number
+        enum {
+            kLongBelowDouble = 0x10,    // then the long
+            kExact = 0x20,
+            kLongAboveDouble = 0x30     // then the long
+        };
+
+        // the type bits, a byte for each number and each String or Symbol, and the whole of
+        // each CodeWScope.  they follow the key in reverse order, where they only decide between
+        // keys woCompare() finds equal.
+        enum {
+            kTypeInt = 1,
+            kTypeLong,
+            kTypeDouble,
+            kTypeNegativeZero,
+            kTypeString,
+            kTypeSymbol
+        };
+
+        const unsigned long long signBit = 1ULL << 63;
+
+        unsigned char typeByte(const BSONElement& e) {
+            switch (e.type()) {
+            case MinKey: return kMinKey;
+            case EOO:
+            case Undefined: return kUndefined;
+            case jstNULL: return kNull;
+            case NumberDouble:
+            case NumberInt:
+            case NumberLong: return kNumber;
+            case String:
+            case Symbol: return kString;
+            case Object: return kObject;
+            case Array: return kArray;
+            case BinData: return kBinData;
+            case jstOID: return kOID;
+            case Bool: return kBool;
+            case Date: return kDate;
+            case Timestamp: return kTimestamp;
+            case RegEx: return kRegEx;
+            case DBRef: return kDBRef;
+            case Code: return kCode;
+            case CodeWScope: return kCodeWScope;
+            case MaxKey: return kMaxKey;
+            default:
+                massert(17143, mongoutils::str::stream() << "can't encode bson type "
+                                                         << e.type() << " in a KeyString",
+                        false);
+                return 0;
+            }
+        }
+
+        void appendBigEndian32(BufBuilder& b, unsigned v) {
+            unsigned char buf[4];
+            for (int i = 3; i >= 0; --i) {
+                buf[i] = static_cast<unsigned char>(v);
+                v >>= 8;
+            }
+            b.appendBuf(buf, 4);
+        }
+
+        void appendBigEndian64(BufBuilder& b, unsigned long long v) {
+            unsigned char buf[8];
+            for (int i = 7; i >= 0; --i) {
+                buf[i] = static_cast<unsigned char>(v);
+                v >>= 8;
+            }
+            b.appendBuf(buf, 8);
+        }
+
+        /** order preserving, nan sorting first as in compareElementValues() */
+        unsigned long long encodeDouble(double d) {
+            if (isNaN(d))
+                return 0;
+            if (d == 0)
+                d = 0; // -0.0 sorts with 0.0
+            unsigned long long bits;
+            memcpy(&bits, &d, sizeof(bits));
+            return (bits & signBit) ? ~bits : bits | signBit;
+        }
+
+        double decodeDouble(unsigned long long v) {
+            unsigned long long bits = (v & signBit) ? v & ~signBit : ~v;
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            return d;
+        }
+
+        void appendNumber(BufBuilder& b, std::string& types, const BSONElement& e) {
+            if (e.type() == NumberLong) {
+                long long l = e._numberLong();
+                double d = static_cast<double>(l);
+                appendBigEndian64(b, encodeDouble(d));
+                // a long a double can't hold sorts next to the double it rounds to
+                int exactness;
+                if (d >= 9223372036854775808.0) {
+                    exactness = kLongBelowDouble;
+                }
+                else {
+                    long long rounded = static_cast<long long>(d);
+                    exactness = rounded == l ? kExact :
+                                rounded < l ? kLongAboveDouble : kLongBelowDouble;
+                }
+                b.appendChar(static_cast<char>(exactness));
+                if (exactness != kExact)
+                    appendBigEndian64(b, static_cast<unsigned long long>(l) ^ signBit);
+                types += static_cast<char>(kTypeLong);
+                return;
+            }
+            double d = e.number();
+            unsigned long long bits;
+            memcpy(&bits, &d, sizeof(bits));
+            appendBigEndian64(b, encodeDouble(d));
+            b.appendChar(kExact);
+            types += static_cast<char>(e.type() == NumberInt ? kTypeInt :
+                                       bits == signBit ? kTypeNegativeZero : kTypeDouble);
+        }
+
+        /** zero bytes become 0x00 0xff, then a zero byte ends the string */
+        void appendEscaped(BufBuilder& b, const char* s, int len) {
+            const char* end = s + len;
+            while (s < end) {
+                const char* zero = static_cast<const char*>(memchr(s, 0, end - s));
+                if (!zero) {
+                    b.appendBuf(s, end - s);
+                    break;
+                }
+                b.appendBuf(s, zero - s + 1);
+                b.appendChar(static_cast<char>(0xff));
+                s = zero + 1;
+            }
+            b.appendChar(0);
+        }
+
+        void appendElement(BufBuilder& b, std::string& types, const BSONElement& e,
+                           bool withFieldName);
+
+        void appendObject(BufBuilder& b, std::string& types, const BSONObj& o) {
+            BSONObjIterator i(o);
+            while (i.more()) {
+                appendElement(b, types, i.next(), true);
+            }
+            b.appendChar(kEnd);
+        }
+
+        void appendElement(BufBuilder& b, std::string& types, const BSONElement& e,
+                           bool withFieldName) {
+            b.appendChar(typeByte(e));
+            if (withFieldName)
+                b.appendStr(e.fieldName());
+
+            switch (e.type()) {
+            case NumberDouble:
+            case NumberInt:
+            case NumberLong:
+                appendNumber(b, types, e);
+                break;
+            case String:
+            case Symbol:
+                appendEscaped(b, e.valuestr(), e.valuestrsize() - 1);
+                types += static_cast<char>(e.type() == String ? kTypeString : kTypeSymbol);
+                break;
+            case Code:
+                appendEscaped(b, e.valuestr(), e.valuestrsize() - 1);
+                break;
+            case Object:
+            case Array:
+                appendObject(b, types, e.embeddedObject());
+                break;
+            case BinData: {
+                // compareElementValues() orders by length first
+                int len;
+                const char* data = e.binData(len);
+                appendBigEndian32(b, len);
+                b.appendChar(static_cast<char>(e.binDataType()));
+                b.appendBuf(data, len);
+                break;
+            }
+            case jstOID:
+                b.appendBuf(e.value(), OID::kOIDSize);
+                break;
+            case Bool:
+                b.appendChar(*e.value());
+                break;
+            case Date:
+                appendBigEndian64(b, e.date().millis ^ signBit);
+                break;
+            case Timestamp:
+                appendBigEndian64(b, e.date().millis);
+                break;
+            case RegEx:
+                b.appendStr(e.regex());
+                b.appendStr(e.regexFlags());
+                break;
+            case DBRef:
+                // compareElementValues() orders a DBRef by length first
+                appendBigEndian32(b, e.valuesize());
+                b.appendBuf(e.value(), e.valuesize());
+                break;
+            case CodeWScope: {
+                // only the two strings compareElementValues() strcmp()s go in the key
+                b.appendStr(e.codeWScopeCode());
+                b.appendStr(e.codeWScopeScopeDataUnsafe());
+                unsigned len = e.valuesize();
+                for (int shift = 24; shift >= 0; shift -= 8)
+                    types += static_cast<char>(len >> shift);
+                types.append(e.value(), len);
+                break;
+            }
+            default:
+                // the type byte is all
+                break;
+            }
+        }
+
+        /** reads a KeyString back, inverting the bytes of descending fields */
+        class Reader {
+        public:
+            Reader(const char* data, int len) :
+                _p(reinterpret_cast<const unsigned char*>(data)),
+                _end(_p + len),
+                _types(_end),
+                _mask(0) {
+            }
+
+            void setInverted(bool inverted) { _mask = inverted ? 0xff : 0; }
+
+            unsigned char peek() const {
+                massert(17144, "KeyString ends early", _p < _end);
+                return *_p ^ _mask;
+            }
+
+            unsigned char read() {
+                unsigned char c = peek();
+                ++_p;
+                return c;
+            }
+
+            /** the type bits are read from the end */
+            unsigned char readType() {
+                massert(17145, "KeyString type bits end early", _types > _p);
+                return *--_types;
+            }
+
+            unsigned readBigEndian32() {
+                unsigned v = 0;
+                for (int i = 0; i < 4; ++i)
+                    v = (v << 8) | read();
+                return v;
+            }
+
+            unsigned long long readBigEndian64() {
+                unsigned long long v = 0;
+                for (int i = 0; i < 8; ++i)
+                    v = (v << 8) | read();
+                return v;
+            }
+
+            void readBytes(std::string& out, unsigned len) {
+                massert(17146, "KeyString ends early", len <= unsigned(_end - _p));
+                out.resize(len);
+                for (unsigned i = 0; i < len; ++i)
+                    out[i] = static_cast<char>(read());
+            }
+
+            void readCString(std::string& out) {
+                out.clear();
+                for (unsigned char c; (c = read()) != 0; )
+                    out.push_back(static_cast<char>(c));
+            }
+
+            void readEscaped(std::string& out) {
+                out.clear();
+                while (true) {
+                    unsigned char c = read();
+                    if (c == 0) {
+                        if (_p == _end || peek() != 0xff)
+                            return;
+                        ++_p;
+                    }
+                    out.push_back(static_cast<char>(c));
+                }
+            }
+
+        private:
+            const unsigned char* _p;
+            const unsigned char* const _end;
+            const unsigned char* _types;
+            unsigned char _mask;
+        };
+
+        /** the value of type 'type', taken verbatim */
+        void appendRaw(BSONObjBuilder& b, BSONType type, const StringData& fieldName,
+                       const std::string& value) {
+            BufBuilder& bb = b.bb();
+            bb.appendNum(static_cast<char>(type));
+            bb.appendStr(fieldName);
+            bb.appendBuf(value.data(), value.size());
+        }
+
+        void readElement(Reader& r, BSONObjBuilder& b, unsigned char type,
+                         const StringData& fieldName);
+
+        void readObject(Reader& r, BSONObjBuilder& b) {
+            std::string fieldName;
+            for (unsigned char type; (type = r.read()) != kEnd; ) {
+                r.readCString(fieldName);
+                readElement(r, b, type, fieldName);
+            }
+        }
+
+        void readNumber(Reader& r, BSONObjBuilder& b, const StringData& fieldName) {
+            double d = decodeDouble(r.readBigEndian64());
+            unsigned char exactness = r.read();
+            unsigned char type = r.readType();
+            if (exactness != kExact) {
+                b.append(fieldName, static_cast<long long>(r.readBigEndian64() ^ signBit));
+                return;
+            }
+            switch (type) {
+            case kTypeInt:
+                b.append(fieldName, static_cast<int>(d));
+                break;
+            case kTypeLong:
+                b.append(fieldName, static_cast<long long>(d));
+                break;
+            case kTypeDouble:
+                b.append(fieldName, d);
+                break;
+            case kTypeNegativeZero:
+                b.append(fieldName, -0.0);
+                break;
+            default:
+                massert(17147, "bad number type in KeyString", false);
+            }
+        }
+
+        void readElement(Reader& r, BSONObjBuilder& b, unsigned char type,
+                         const StringData& fieldName) {
+            std::string s;
+            switch (type) {
+            case kMinKey:
+                b.appendMinKey(fieldName);
+                break;
+            case kUndefined:
+                b.appendUndefined(fieldName);
+                break;
+            case kNull:
+                b.appendNull(fieldName);
+                break;
+            case kNumber:
+                readNumber(r, b, fieldName);
+                break;
+            case kString:
+                r.readEscaped(s);
+                if (r.readType() == kTypeSymbol)
+                    b.appendSymbol(fieldName, s);
+                else
+                    b.append(fieldName, StringData(s));
+                break;
+            case kCode:
+                r.readEscaped(s);
+                b.appendCode(fieldName, s);
+                break;
+            case kObject: {
+                BSONObjBuilder sub(b.subobjStart(fieldName));
+                readObject(r, sub);
+                sub.done();
+                break;
+            }
+            case kArray: {
+                BSONObjBuilder sub(b.subarrayStart(fieldName));
+                readObject(r, sub);
+                sub.done();
+                break;
+            }
+            case kBinData: {
+                unsigned len = r.readBigEndian32();
+                BinDataType subtype = static_cast<BinDataType>(r.read());
+                r.readBytes(s, len);
+                b.appendBinData(fieldName, len, subtype, s.data());
+                break;
+            }
+            case kOID:
+                r.readBytes(s, OID::kOIDSize);
+                appendRaw(b, jstOID, fieldName, s);
+                break;
+            case kBool:
+                b.appendBool(fieldName, r.read());
+                break;
+            case kDate:
+                b.appendDate(fieldName, Date_t(r.readBigEndian64() ^ signBit));
+                break;
+            case kTimestamp:
+                b.appendTimestamp(fieldName, r.readBigEndian64());
+                break;
+            case kRegEx: {
+                std::string flags;
+                r.readCString(s);
+                r.readCString(flags);
+                b.appendRegex(fieldName, s, flags);
+                break;
+            }
+            case kDBRef:
+                r.readBytes(s, r.readBigEndian32());
+                appendRaw(b, DBRef, fieldName, s);
+                break;
+            case kCodeWScope: {
+                r.readCString(s);
+                r.readCString(s);
+                unsigned len = 0;
+                for (int i = 0; i < 4; ++i)
+                    len = (len << 8) | r.readType();
+                s.resize(len);
+                for (unsigned i = 0; i < len; ++i)
+                    s[i] = static_cast<char>(r.readType());
+                appendRaw(b, CodeWScope, fieldName, s);
+                break;
+            }
+            case kMaxKey:
+                b.appendMaxKey(fieldName);
+                break;
+            default:
+                massert(17148, mongoutils::str::stream() << "bad type byte " << int(type)
+                                                         << " in KeyString",
+                        false);
+            }
+        }
+
+    } // namespace
+
+    int KeyString::append(BufBuilder& b, const BSONObj& key, const Ordering& ord) {
+        const int begin = b.len();
+        std::string types;
+        BSONObjIterator i(key);
+        for (int n = 0; i.more(); ++n) {
+            int start = b.len();
+            appendElement(b, types, i.next(), false);
+            if (ord.get(n) < 0) {
+                for (char* p = b.buf() + start; p < b.buf() + b.len(); ++p)
+                    *p = ~*p;
+            }
+        }
+        b.appendChar(kEnd);
+        const int valuesLen = b.len() - begin;
+        for (std::string::reverse_iterator t = types.rbegin(); t != types.rend(); ++t)
+            b.appendChar(*t);
+        return valuesLen;
+    }
+
+    BSONObj KeyString::toBson(const char* data, int len) {
+        Reader r(data, len);
+        BSONObjBuilder b;
+        for (unsigned char type; (type = r.read()) != kEnd; ) {
+            bool inverted = type & 0x80;
+            r.setInverted(inverted);
+            readElement(r, b, inverted ? ~type & 0xff : type, "");
+            r.setInverted(false);
+        }
+        return b.obj();
+    }
+
+    BSONObj KeyString::toSortKey(const BSONObj& key, const Ordering& ord) {
+        // build the BinData in place rather than encoding and then copying
+        BSONObjBuilder b(key.objsize() + 32);
+        BufBuilder& bb = b.bb();
+        bb.appendNum(static_cast<char>(BinData));
+        bb.appendStr("");
+        int lenOfs = bb.len();
+        bb.appendNum(0);
+        bb.appendNum(static_cast<char>(BinDataGeneral));
+        bb.appendNum(append(bb, key, ord));
+        int len = bb.len() - lenOfs - 5;
+        memcpy(bb.buf() + lenOfs, &len, sizeof(len));
+        return b.obj();
+    }
+
+    BSONObj KeyString::fromSortKey(const BSONObj& sortKey) {
+        int len;
+        const char* data = sortKey.firstElement().binData(len);
+        return toBson(data, len - static_cast<int>(sizeof(int)));
+    }
+
+    namespace {
+        /** @return the value part of the encoding in the sort key 'sortKey', see toSortKey() */
+        const char* sortKeyValues(const BSONObj& sortKey, int* valuesLen) {
+            int len;
+            const char* data = sortKey.firstElement().binData(len);
+            memcpy(valuesLen, data + len - sizeof(int), sizeof(int));
+            return data;
+        }
+    }
+
+    int KeyString::compareSortKeys(const BSONObj& l, const BSONObj& r) {
+        int llen, rlen;
+        const char* ld = sortKeyValues(l, &llen);
+        const char* rd = sortKeyValues(r, &rlen);
+        return compare(ld, llen, rd, rlen);
+    }
+
+}  // namespace mongo
@@ -0,0 +1,73 @@
+// @file key_string.h index keys encoded as byte strings that sort by memcmp
+
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    /** KeyString encodes an index key as a byte string such that memcmp of two encodings orders
+        them as key.woCompare(other, ordering, false) orders the keys.  Fields that are
+        descending in the ordering are written bit inverted.
+
+        Each field is a type byte in canonical type order followed by an order preserving
+        encoding of the value: numbers of every type as one order preserving double (followed by
+        the exact value of a long a double can't hold), strings with zero bytes escaped, embedded
+        objects and arrays element by element.  Every value encoding is prefix free so inverting
+        it reverses its order, and ascending type bytes are below 0x80 so an encoding can be read
+        back without knowing the ordering.  What woCompare doesn't look at, whether a number is
+        an int, long or double and whether a string is a Symbol, follows the values, so it only
+        orders keys woCompare finds equal.
+
+        Where woCompare isn't a total order the encoding picks one: a long a double can't hold is
+        ordered by its exact value against the double it rounds to, and Date values are ordered
+        before Timestamp values.
+    */
+    class KeyString {
+    public:
+        /** append the encoding of 'key' under 'ord' to 'b'
+            @return the length of the part of the encoding up to and including the end of the
+                    values, which orders keys exactly as woCompare does: keys woCompare finds equal
+                    have equal value parts, and differ at most in the type bits after them
+        */
+        static int append(BufBuilder& b, const BSONObj& key, const Ordering& ord);
+
+        /** @return the key encoded in data[0..len), with empty field names as in an index key */
+        static BSONObj toBson(const char* data, int len);
+
+        static int compare(const char* l, int llen, const char* r, int rlen) {
+            int res = memcmp(l, r, std::min(llen, rlen));
+            if (res)
+                return res;
+            return llen - rlen;
+        }
+
+        /** the encoding of 'key' wrapped as { "" : BinData } so it can travel where a BSONObj
+            is expected, e.g. through the external sorter.  the length of its value part follows
+            the encoding.
+        */
+        static BSONObj toSortKey(const BSONObj& key, const Ordering& ord);
+        static BSONObj fromSortKey(const BSONObj& sortKey);
+        /** compares the value parts of two sort keys only, so keys woCompare finds equal compare
+            equal here too and the caller breaks the tie, e.g. by DiskLoc as a btree orders them
+        */
+        static int compareSortKeys(const BSONObj& l, const BSONObj& r);
+    };
+
+}  // namespace mongo
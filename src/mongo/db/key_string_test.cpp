@@ -0,0 +1,179 @@
+// key_string_test.cpp
+
+/*    Copyright 2013 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "mongo/unittest/unittest.h"
+
+#include <limits>
+
+#include "mongo/db/json.h"
+#include "mongo/db/key_string.h"
+
+namespace mongo {
+
+    namespace {
+
+        /** one element of each type, with values woCompare tells apart and values it doesn't */
+        BSONArray values() {
+            const double inf = std::numeric_limits<double>::infinity();
+            const long long twoTo53 = 1LL << 53;
+            BSONArrayBuilder b;
+            b << MINKEY;
+            b.appendUndefined();
+            b.appendNull();
+            b << std::numeric_limits<double>::quiet_NaN() << -inf << -1e300;
+            b << std::numeric_limits<long long>::min() << -twoTo53 - 1 << -twoTo53;
+            b << -5 << -5.0 << -4.5 << 0 << 0LL << 0.0 << -0.0 << 1e-300 << 5 << 5LL << 5.0;
+            b << twoTo53 << static_cast<double>(twoTo53) << twoTo53 + 1 << twoTo53 + 2;
+            b << (1LL << 62) + 1 << (1LL << 62) - 1 << static_cast<double>(1LL << 62);
+            b << std::numeric_limits<long long>::max() << 9223372036854775808.0 << inf;
+            b << "" << "a" << StringData("a\0", 2) << StringData("a\0b", 3) << "ab" << "b";
+            b << BSONSymbol("a") << BSONSymbol("ab") << "\xff";
+            b << BSONObj() << BSON("a" << 1) << BSON("a" << 1 << "b" << 2) << BSON("a" << 1.5)
+              << BSON("a" << "x") << BSON("ab" << 1) << BSON("b" << MINKEY);
+            b << BSONArray() << BSON_ARRAY(1) << BSON_ARRAY(1 << 2) << BSON_ARRAY(2);
+            b << BSONBinData("", 0, BinDataGeneral) << BSONBinData("\0", 1, BinDataGeneral)
+              << BSONBinData("\0", 1, Function) << BSONBinData("ab", 2, BinDataGeneral);
+            b << OID("000000000000000000000000") << OID("0123456789abcdef01234567");
+            b << false << true;
+            b.append(Date_t(-1000));
+            b.append(Date_t(0));
+            b.append(Date_t(1000));
+            b.appendTimestamp(1, 2);
+            b.appendTimestamp(2, 1);
+            b << BSONRegEx("a") << BSONRegEx("a", "i") << BSONRegEx("b");
+            b.append(BSONDBRef("a.b", OID("0123456789abcdef01234567")));
+            b << BSONCode("x") << BSONCode("y");
+            b << BSONCodeWScope("x", BSON("a" << 1)) << BSONCodeWScope("x", BSON("a" << 2));
+            b << MAXKEY;
+            return b.arr();
+        }
+
+        std::string encode(const BSONObj& key, const Ordering& ord) {
+            BufBuilder b;
+            KeyString::append(b, key, ord);
+            return std::string(b.buf(), b.len());
+        }
+
+        int sign(int x) {
+            return x < 0 ? -1 : x > 0 ? 1 : 0;
+        }
+
+        bool inexactLong(const BSONElement& e) {
+            return e.type() == NumberLong &&
+                   (e.numberDouble() >= 9223372036854775808.0 ||
+                    static_cast<long long>(e.numberDouble()) != e.numberLong());
+        }
+
+        /** the pairs where woCompare() is a total order */
+        bool comparable(const BSONElement& l, const BSONElement& r) {
+            if (l.canonicalType() != r.canonicalType() || l.type() == r.type())
+                return true;
+            // woCompare() asserts comparing a Date and a Timestamp, and finds a long a double
+            // can't hold equal to the double it rounds to
+            return l.canonicalType() != canonicalizeBSONType(Date) &&
+                   !inexactLong(l) && !inexactLong(r);
+        }
+
+    } // namespace
+
+    TEST(KeyStringTest, RoundTrip) {
+        const Ordering ascending = Ordering::make(BSON("a" << 1));
+        const Ordering descending = Ordering::make(BSON("a" << -1));
+        BSONArray vals = values();
+        BSONObjIterator i(vals);
+        while (i.more()) {
+            BSONObj key = i.next().wrap("");
+            std::string asc = encode(key, ascending);
+            std::string desc = encode(key, descending);
+            ASSERT_EQUALS(0, KeyString::toBson(asc.data(), asc.size()).woCompare(key));
+            ASSERT_EQUALS(0, KeyString::toBson(desc.data(), desc.size()).woCompare(key));
+            if (!isNaN(key.firstElement().number())) {
+                ASSERT(KeyString::toBson(asc.data(), asc.size()).binaryEqual(key));
+            }
+        }
+    }
+
+    TEST(KeyStringTest, OrderMatchesWoCompare) {
+        BSONArray vals = values();
+        const char* patterns[] = { "{a:1,b:1}", "{a:1,b:-1}", "{a:-1,b:1}", "{a:-1,b:-1}" };
+        for (unsigned p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p) {
+            const Ordering ord = Ordering::make(fromjson(patterns[p]));
+            BSONObjIterator i(vals);
+            while (i.more()) {
+                BSONElement l = i.next();
+                BSONObjIterator j(vals);
+                while (j.more()) {
+                    BSONElement r = j.next();
+                    if (!comparable(l, r))
+                        continue;
+                    // the second field decides when the first ones compare equal
+                    BSONObjBuilder lb, rb;
+                    lb.appendAs(l, "");
+                    lb.append("", 1);
+                    rb.appendAs(r, "");
+                    rb.append("", 2);
+                    BSONObj lk = lb.obj(), rk = rb.obj();
+                    std::string le = encode(lk, ord), re = encode(rk, ord);
+                    ASSERT_EQUALS(sign(lk.woCompare(rk, ord, false)),
+                                  sign(KeyString::compare(le.data(), le.size(),
+                                                          re.data(), re.size())));
+                }
+            }
+        }
+    }
+
+    TEST(KeyStringTest, SortKey) {
+        const Ordering ord = Ordering::make(BSON("a" << 1 << "b" << -1));
+        BSONObj key = BSON("" << "x" << "" << 3);
+        BSONObj sortKey = KeyString::toSortKey(key, ord);
+        ASSERT_EQUALS(BinData, sortKey.firstElement().type());
+        ASSERT(KeyString::fromSortKey(sortKey).binaryEqual(key));
+        ASSERT(KeyString::compareSortKeys(sortKey,
+                                          KeyString::toSortKey(BSON("" << "x" << "" << 4), ord))
+               > 0);
+    }
+
+    TEST(KeyStringTest, SortKeysOfEqualKeysCompareEqual) {
+        const Ordering ord = Ordering::make(BSON("a" << 1));
+        BSONArrayBuilder equal;
+        equal << 1.0 << 1 << 1LL;
+        equal.append(0.0);
+        BSONArray values = equal.arr();
+        BSONObjIterator i(values);
+        while (i.more()) {
+            BSONElement l = i.next();
+            BSONObjIterator j(values);
+            while (j.more()) {
+                BSONElement r = j.next();
+                BSONObjBuilder lb, rb;
+                lb.appendAs(l, "");
+                rb.appendAs(r, "");
+                BSONObj lk = lb.obj(), rk = rb.obj();
+                ASSERT_EQUALS(sign(lk.woCompare(rk, ord, false)),
+                              sign(KeyString::compareSortKeys(KeyString::toSortKey(lk, ord),
+                                                              KeyString::toSortKey(rk, ord))));
+            }
+        }
+        ASSERT_EQUALS(0, KeyString::compareSortKeys(KeyString::toSortKey(BSON("" << 0.0), ord),
+                                                    KeyString::toSortKey(BSON("" << -0.0), ord)));
+        BSONObjBuilder symbol;
+        symbol.appendSymbol("", "x");
+        ASSERT_EQUALS(0, KeyString::compareSortKeys(KeyString::toSortKey(BSON("" << "x"), ord),
+                                                    KeyString::toSortKey(symbol.obj(), ord)));
+    }
+
+} // namespace mongo
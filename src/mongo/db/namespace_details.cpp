@@ -73,6 +73,7 @@ namespace mongo {
         _reservedA = 0;
         _extraOffset = 0;
         _indexBuildsInProgress = 0;
+        memset(_fileSet, 0, sizeof(_fileSet));
         memset(_reserved, 0, sizeof(_reserved));
     }
 
@@ -96,7 +97,7 @@ namespace mongo {
         cout << "ns         " << _stats.datasize << ' ' << _stats.nrecords << ' ' << _nIndexes << '\n';
         cout << "ns         " << isCapped() << ' ' << _paddingFactor << ' ' << _systemFlags << ' ' << _userFlags << ' ' << _dataFileVersion << '\n';
         cout << "ns         " << _multiKeyIndexBits << ' ' << _indexBuildsInProgress << '\n';
-        cout << "ns         " << (int)_reserved[0] << ' ' << (int)_reserved[59];
+        cout << "ns         " << fileSet() << ' ' << (int)_reserved[0] << ' ' << (int)_reserved[39];
         cout << endl;
     }
 #endif
@@ -176,6 +177,10 @@ namespace mongo {
     DiskLoc NamespaceDetails::allocWillBeAt(const char *ns, int lenToAlloc) {
         if ( ! isCapped() ) {
             lenToAlloc = (lenToAlloc + 3) & 0xfffffffc;
+            if ( isUserFlagSet( Flag_HotPlacement ) )
+                return __hotAlloc(lenToAlloc, true);
+            if ( isUserFlagSet( Flag_SegregatedFitAlloc ) )
+                return __segregatedAlloc(lenToAlloc, true);
             return __stdAlloc(lenToAlloc, true);
         }
         return DiskLoc();
@@ -244,6 +249,21 @@ namespace mongo {
         return loc;
     }
 
+    /* defensive check of a deleted list link before it is dereferenced */
+    static void checkDeletedListLink( const DiskLoc& cur, int b, int chain ) {
+        int fileNumber = cur.a();
+        int fileOffset = cur.getOfs();
+        if (fileNumber < -1 || fileNumber >= 100000 || fileOffset < 0) {
+            StringBuilder sb;
+            sb << "Deleted record list corrupted in bucket " << b
+               << ", link number " << chain
+               << ", invalid link is " << cur.toString()
+               << ", throwing Fatal Assertion";
+            problem() << sb.str() << endl;
+            fassertFailed(16469);
+        }
+    }
+
     /* for non-capped collections.
        @param peekOnly just look up where and don't reserve
        returned item is out of the deleted list upon return
@@ -259,19 +279,7 @@ namespace mongo {
         int extra = 5; // look for a better fit, a little.
         int chain = 0;
         while ( 1 ) {
-            { // defensive check
-                int fileNumber = cur.a();
-                int fileOffset = cur.getOfs();
-                if (fileNumber < -1 || fileNumber >= 100000 || fileOffset < 0) {
-                    StringBuilder sb;
-                    sb << "Deleted record list corrupted in bucket " << b
-                       << ", link number " << chain
-                       << ", invalid link is " << cur.toString()
-                       << ", throwing Fatal Assertion";
-                    problem() << sb.str() << endl;
-                    fassertFailed(16469);
-                }
-            }
+            checkDeletedListLink( cur, b, chain );
             if ( cur.isNull() ) {
                 // move to next bucket.  if we were doing "extra", just break
                 if ( bestmatchlen < 0x7fffffff )
@@ -317,15 +325,182 @@ namespace mongo {
 
         /* unlink ourself from the deleted list */
         if( !peekOnly ) {
-            DeletedRecord *bmr = bestmatch.drec();
-            *getDur().writing(bestprev) = bmr->nextDeleted();
-            bmr->nextDeleted().writing().setInvalid(); // defensive.
-            verify(bmr->extentOfs() < bestmatch.getOfs());
+            unlinkDeletedRecord(bestprev, bestmatch);
+        }
+
+        return bestmatch;
+    }
+
+    /* segregated fit allocation for non-capped collections with Flag_SegregatedFitAlloc set.
+
+       __stdAlloc() may walk up to 30 links of every bucket from bucket(len) up to MaxBucket
+       before giving up, and on a collection fragmented by update/delete churn most of those
+       links are records slightly too small for the request.  here the search is bounded:
+
+         - probe at most SegregatedFitProbes records of bucket(len) for the best fit.
+         - otherwise take the head of the first non empty larger bucket.  every record in a
+           larger bucket is at least bucketSizes[bucket(len)] > len, so the head is always a fit
+           and no chain is walked.  the excess is split off by alloc() as usual.
+
+       only MaxBucket holds records of unbounded size, so only it needs a (bounded) walk when
+       the request itself is that large.
+       @param peekOnly just look up where and don't reserve
+    */
+    DiskLoc NamespaceDetails::__segregatedAlloc(int len, bool peekOnly) {
+        const int SegregatedFitProbes = 4;
+
+        const int b = bucket(len);
+        DiskLoc *bestprev = 0;
+        DiskLoc bestmatch;
+        int bestmatchlen = 0x7fffffff;
+
+        {
+            DiskLoc *prev = &_deletedList[b];
+            DiskLoc cur = *prev;
+            const int maxProbes = ( b == MaxBucket ) ? 30 : SegregatedFitProbes;
+            for ( int chain = 0; !cur.isNull() && chain < maxProbes; chain++ ) {
+                checkDeletedListLink( cur, b, chain );
+                DeletedRecord *r = cur.drec();
+                int l = r->lengthWithHeaders();
+                if ( l >= len && l < bestmatchlen ) {
+                    bestmatchlen = l;
+                    bestmatch = cur;
+                    bestprev = prev;
+                    if ( l == len )
+                        break;
+                }
+                prev = &r->nextDeleted();
+                cur = *prev;
+            }
+        }
+
+        for ( int i = b + 1; bestmatch.isNull() && i <= MaxBucket; i++ ) {
+            if ( _deletedList[i].isNull() )
+                continue;
+            checkDeletedListLink( _deletedList[i], i, 0 );
+            bestmatch = _deletedList[i];
+            bestprev = &_deletedList[i];
+            dassert( bestmatch.drec()->lengthWithHeaders() >= len );
+        }
+
+        if ( bestmatch.isNull() ) {
+            // out of space. alloc a new extent.
+            return DiskLoc();
+        }
+
+        if( !peekOnly ) {
+            unlinkDeletedRecord(bestprev, bestmatch);
         }
 
         return bestmatch;
     }
 
+    /* hot placement for non-capped collections with Flag_HotPlacement set.
+
+       records that are inserted or moved by a growing update are the ones being written right
+       now, so they are put in free space on pages that are already resident where possible.
+       on skewed workloads the hot records then collect on a set of pages that stays in memory,
+       instead of each move pulling in a page of otherwise cold data.
+
+       residency is checked with hotPlacementResidency() *before* a deleted record is read, as
+       reading it would fault the page in.  walking the lists faults in every record read, so the
+       walk is bounded by HotPlacementProbes in total.  residency only decides between the
+       candidates of one bucket: the walk stops at the end of the first bucket holding a fit, as
+       __stdAlloc() does, and the best resident fit in it wins over the best fit of any kind.
+       so records are never put in a larger bucket than standard allocation would use, and only
+       when nothing fits is a new extent needed.
+
+       Flag_HotPlacement takes precedence over Flag_SegregatedFitAlloc when both are set; the
+       buckets are then searched as above, not with __segregatedAlloc()'s bounded search.
+       @param peekOnly just look up where and don't reserve
+    */
+    bool (*NamespaceDetails::hotPlacementResidency)( const char* data ) =
+        static_cast<bool (*)( const char* )>( &Record::likelyInPhysicalMemory );
+
+    DiskLoc NamespaceDetails::__hotAlloc(int len, bool peekOnly) {
+        const int HotPlacementProbes = 32;
+
+        DiskLoc *bestprev[2] = { 0, 0 }; // [resident]
+        DiskLoc bestmatch[2];
+        int bestmatchlen[2] = { 0x7fffffff, 0x7fffffff };
+
+        int probes = 0;
+        int extra = 5; // once a resident fit is found, look for a better one, a little
+        for ( int b = bucket(len); b <= MaxBucket; b++ ) {
+            DiskLoc *prev = &_deletedList[b];
+            DiskLoc cur = *prev;
+            for ( int chain = 0; !cur.isNull() && chain <= 30; chain++ ) {
+                if ( probes++ >= HotPlacementProbes && !bestmatch[0].isNull() )
+                    break;
+                checkDeletedListLink( cur, b, chain );
+                DeletedRecord *r = cur.drec();
+                const int resident =
+                    hotPlacementResidency( reinterpret_cast<const char*>( r ) ) ? 1 : 0;
+                int l = r->lengthWithHeaders();
+                if ( l >= len && l < bestmatchlen[resident] ) {
+                    bestmatchlen[resident] = l;
+                    bestmatch[resident] = cur;
+                    bestprev[resident] = prev;
+                }
+                if ( bestmatchlen[1] == len )
+                    break;
+                if ( bestmatchlen[1] < 0x7fffffff && --extra <= 0 )
+                    break;
+                prev = &r->nextDeleted();
+                cur = *prev;
+            }
+            // only the candidates of one bucket compete
+            if ( !bestmatch[0].isNull() || !bestmatch[1].isNull() )
+                break;
+        }
+
+        const int resident = bestmatch[1].isNull() ? 0 : 1;
+        if ( bestmatch[resident].isNull() ) {
+            // out of space. alloc a new extent.
+            return DiskLoc();
+        }
+
+        if( !peekOnly ) {
+            unlinkDeletedRecord(bestprev[resident], bestmatch[resident]);
+            Record::notePlacement( resident );
+        }
+
+        return bestmatch[resident];
+    }
+
+    void NamespaceDetails::unlinkDeletedRecord(DiskLoc *prev, const DiskLoc& loc) {
+        DeletedRecord *r = loc.drec();
+        *getDur().writing(prev) = r->nextDeleted();
+        r->nextDeleted().writing().setInvalid(); // defensive.
+        verify(r->extentOfs() < loc.getOfs());
+    }
+
+    long long NamespaceDetails::removeDeletedRecordsInExtents(const set<DiskLoc>& extentLocs,
+                                                              vector<DiskLoc>* removed) {
+        verify( !isCapped() );
+        long long nbytes = 0;
+        for ( int b = 0; b < Buckets; b++ ) {
+            DiskLoc *prev = &_deletedList[b];
+            DiskLoc cur = *prev;
+            for ( int chain = 0; !cur.isNull(); chain++ ) {
+                checkDeletedListLink( cur, b, chain );
+                DeletedRecord *r = cur.drec();
+                DiskLoc next = r->nextDeleted();
+                if ( extentLocs.count( r->myExtentLoc( cur ) ) ) {
+                    nbytes += r->lengthWithHeaders();
+                    unlinkDeletedRecord( prev, cur );
+                    if ( removed )
+                        removed->push_back( cur );
+                }
+                else {
+                    prev = &r->nextDeleted();
+                }
+                cur = next;
+            }
+        }
+        return nbytes;
+    }
+
     void NamespaceDetails::dumpDeleted(set<DiskLoc> *extents) {
         for ( int i = 0; i < Buckets; i++ ) {
             DiskLoc dl = _deletedList[i];
@@ -382,8 +557,13 @@ namespace mongo {
 
     /* alloc with capped table handling. */
     DiskLoc NamespaceDetails::_alloc(const char *ns, int len) {
-        if ( ! isCapped() )
+        if ( ! isCapped() ) {
+            if ( isUserFlagSet( Flag_HotPlacement ) )
+                return __hotAlloc(len, false);
+            if ( isUserFlagSet( Flag_SegregatedFitAlloc ) )
+                return __segregatedAlloc(len, false);
             return __stdAlloc(len, false);
+        }
 
         return cappedAlloc(ns,len);
     }
@@ -571,6 +751,7 @@ namespace mongo {
         Lock::assertWriteLocked(_ns); 
         clearQueryCache();
         _keysComputed = false;
+        _uniqueKeyFilters.clear();
     }
 
     NamespaceDetailsTransient::CMap& NamespaceDetailsTransient::get_cmap_inlock(const string& ns) {
@@ -690,6 +871,13 @@ namespace mongo {
         getDur().writingInt(_lastExtentSize) = newMax;
     }
 
+    void NamespaceDetails::setFileSet( const StringData& fileSet ) {
+        verify( fileSet.size() < sizeof( _fileSet ) );
+        char* p = static_cast<char*>( getDur().writingPtr( _fileSet, sizeof( _fileSet ) ) );
+        memset( p, 0, sizeof( _fileSet ) );
+        fileSet.copyTo( p, false );
+    }
+
     void NamespaceDetails::incrementStats( long long dataSizeIncrement,
                                            long long numRecordsIncrement ) {
 
@@ -32,6 +32,7 @@
 
 namespace mongo {
     class Database;
+    class UniqueKeyFilter;
 
     /** @return true if a client can modify this namespace even though it is under ".system."
         For example <dbname>.system.users is ok for regular clients to update.
@@ -106,7 +107,8 @@ namespace mongo {
         int _indexBuildsInProgress;            // Number of indexes currently being built
 
         int _userFlags;
-        char _reserved[72];
+        char _fileSet[32];                     // file set the extents are allocated in, "" for the default set
+        char _reserved[40];
         /*-------- end data 496 bytes */
     public:
         explicit NamespaceDetails( const DiskLoc &loc, bool _capped );
@@ -191,12 +193,17 @@ namespace mongo {
 
 
         bool isCapped() const { return _isCapped; }
+        bool isInMemory() const { return isSystemFlagSet( Flag_InMemory ); }
         long long maxCappedDocs() const;
         void setMaxCappedDocs( long long max );
 
         int lastExtentSize() const { return _lastExtentSize; }
         void setLastExtentSize( int newMax );
 
+        /** the file set new extents are allocated in.  see ExtentManager */
+        StringData fileSet() const { return StringData( _fileSet, strnlen( _fileSet, sizeof( _fileSet ) ) ); }
+        void setFileSet( const StringData& fileSet );
+
         const DiskLoc& deletedListEntry( int bucket ) const { return _deletedList[bucket]; }
         DiskLoc& deletedListEntry( int bucket ) { return _deletedList[bucket]; }
 
@@ -237,11 +244,18 @@ namespace mongo {
                  this isn't thread safe.  TODO
         */
         enum SystemFlags {
-            Flag_HaveIdIndex = 1 << 0 // set when we have _id index (ONLY if ensureIdIndex was called -- 0 if that has never been called)
+            Flag_HaveIdIndex = 1 << 0, // set when we have _id index (ONLY if ensureIdIndex was called -- 0 if that has never been called)
+            Flag_InMemory = 1 << 1 // records are kept in a HeapRecordStore, not in the extents
         };
 
         enum UserFlags {
-            Flag_UsePowerOf2Sizes = 1 << 0
+            Flag_UsePowerOf2Sizes = 1 << 0,
+            // allocate from the deleted lists with a bounded, segregated-fit search.  see
+            // __segregatedAlloc()
+            Flag_SegregatedFitAlloc = 1 << 1,
+            // prefer deleted records on pages already in physical memory.  takes precedence
+            // over Flag_SegregatedFitAlloc.  see __hotAlloc()
+            Flag_HotPlacement = 1 << 2
         };
 
         IndexDetails& idx(int idxNo, bool missingExpected = false );
@@ -460,8 +474,19 @@ namespace mongo {
         */
         DiskLoc alloc(const char* ns, int lenToAlloc);
 
+        /* tells hot placement (Flag_HotPlacement) whether the deleted record at 'data' is likely
+           in physical memory.  Record::likelyInPhysicalMemory() unless replaced for testing */
+        static bool (*hotPlacementResidency)( const char* data );
+
         /* add a given record to the deleted chains for this NS */
         void addDeletedRec(DeletedRecord *d, DiskLoc dloc);
+        /* remove all deleted records that lie in the given extents from the deleted chains, so
+           nothing more gets allocated there.  not for capped collections.
+           @param removed if not null, receives the locations of the removed records, which can
+                  be put back with addDeletedRec()
+           @return number of bytes removed */
+        long long removeDeletedRecordsInExtents(const set<DiskLoc>& extentLocs,
+                                                vector<DiskLoc>* removed = 0);
         void dumpDeleted(set<DiskLoc> *extents = 0);
         // Start from firstExtent by default.
         DiskLoc firstRecord( const DiskLoc &startExtent = DiskLoc() ) const;
@@ -498,6 +523,9 @@ namespace mongo {
         DiskLoc _alloc(const char *ns, int len);
         void maybeComplain( const char *ns, int len ) const;
         DiskLoc __stdAlloc(int len, bool willBeAt);
+        DiskLoc __segregatedAlloc(int len, bool peekOnly);
+        DiskLoc __hotAlloc(int len, bool peekOnly);
+        void unlinkDeletedRecord(DiskLoc *prev, const DiskLoc& loc);
         void compact(); // combine adjacent deleted records
         friend class NamespaceIndex;
         struct ExtraOld {
@@ -622,6 +650,37 @@ namespace mongo {
             _qcCache[ pattern ] = cachedQueryPlan;
         }
 
+        /* unique key filters (see UniqueKeyFilter) ------------------------------ */
+    private:
+        map< string, shared_ptr<UniqueKeyFilter> > _uniqueKeyFilters; // by index name
+    public:
+        /** @return the filter of the index named 'indexName', or NULL if it has none */
+        UniqueKeyFilter* uniqueKeyFilter(const string& indexName) const {
+            map< string, shared_ptr<UniqueKeyFilter> >::const_iterator i =
+                _uniqueKeyFilters.find(indexName);
+            return i == _uniqueKeyFilters.end() ? NULL : i->second.get();
+        }
+        /* assumed to be in write lock for this.  a null 'filter' drops the index's filter */
+        void setUniqueKeyFilter(const string& indexName,
+                                const shared_ptr<UniqueKeyFilter>& filter) {
+            DEV Lock::assertWriteLocked(_ns);
+            if ( filter )
+                _uniqueKeyFilters[ indexName ] = filter;
+            else
+                _uniqueKeyFilters.erase( indexName );
+        }
+        /* assumed to be in write lock for this.  the index gets no filter until the next reset() */
+        void declineUniqueKeyFilter(const string& indexName) {
+            DEV Lock::assertWriteLocked(_ns);
+            _uniqueKeyFilters[ indexName ].reset();
+        }
+        /** @return true if declineUniqueKeyFilter() was called for the index since the last reset() */
+        bool uniqueKeyFilterDeclined(const string& indexName) const {
+            map< string, shared_ptr<UniqueKeyFilter> >::const_iterator i =
+                _uniqueKeyFilters.find(indexName);
+            return i != _uniqueKeyFilters.end() && !i->second;
+        }
+
     }; /* NamespaceDetailsTransient */
 
     inline NamespaceDetailsTransient& NamespaceDetailsTransient::get_inlock(const string& ns) {
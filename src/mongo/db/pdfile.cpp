@@ -166,16 +166,15 @@ namespace mongo {
         // Return true if file exists and operation successful
         virtual bool apply( const boost::filesystem::path &p ) = 0;
         virtual const char * op() const = 0;
+
+        // directory of the file set, relative to the database directory, of the file being
+        // applied to.  empty for the default set
+        string fileSetDir;
     };
 
     void _applyOpToDataFiles( const char *database, FileOp &fo, bool afterAllocator = false, const string& path = dbpath );
 
     void _deleteDataFiles(const char *database) {
-        if ( directoryperdb ) {
-            FileAllocator::get()->waitUntilFinished();
-            MONGO_ASSERT_ON_EXCEPTION_WITH_MSG( boost::filesystem::remove_all( boost::filesystem::path( dbpath ) / database ), "delete data files with a directoryperdb" );
-            return;
-        }
         class : public FileOp {
             virtual bool apply( const boost::filesystem::path &p ) {
                 return boost::filesystem::remove( p );
@@ -184,7 +183,12 @@ namespace mongo {
                 return "remove";
             }
         } deleter;
+        // with directoryperdb too: a file set directory may be a symlink, which remove_all
+        // would remove without the files it points to
         _applyOpToDataFiles( database, deleter, true );
+        if ( directoryperdb ) {
+            MONGO_ASSERT_ON_EXCEPTION_WITH_MSG( boost::filesystem::remove_all( boost::filesystem::path( dbpath ) / database ), "delete data files with a directoryperdb" );
+        }
     }
 
     void checkConfigNS(const char *ns) {
@@ -206,6 +210,33 @@ namespace mongo {
 
         checkConfigNS(ns);
 
+        const bool inMemory = options["inMemory"].trueValue();
+        if ( inMemory ) {
+            // the records are gone after a restart, so the collection must be dropped then
+            if ( !options["temp"].trueValue() ) {
+                err = "an inMemory collection must be temp";
+                return false;
+            }
+            if ( options["capped"].trueValue() ) {
+                err = "an inMemory collection cannot be capped";
+                return false;
+            }
+        }
+
+        string fileSet;
+        if ( options.hasField( "fileSet" ) ) {
+            if ( options["fileSet"].type() != String ) {
+                err = "fileSet must be a string";
+                return false;
+            }
+            fileSet = options["fileSet"].String();
+            Status s = ExtentManager::validateFileSetName( fileSet );
+            if ( !s.isOK() ) {
+                err = s.reason();
+                return false;
+            }
+        }
+
         long long size = Extent::initialSize(128);
         {
             BSONElement e = options.getField("size");
@@ -247,7 +278,7 @@ namespace mongo {
                 // $nExtents is just for testing - always allocate new extents
                 // rather than reuse existing extents so we have some predictibility
                 // in the extent size used by our tests
-                database->allocExtent( ns, (int)size, newCapped, false );
+                database->allocExtent( ns, (int)size, newCapped, false, fileSet );
             }
         }
         else if ( int( e.number() ) > 0 ) {
@@ -259,7 +290,7 @@ namespace mongo {
                 // $nExtents is just for testing - always allocate new extents
                 // rather than reuse existing extents so we have some predictibility
                 // in the extent size used by our tests
-                database->allocExtent( ns, (int)size, newCapped, false );
+                database->allocExtent( ns, (int)size, newCapped, false, fileSet );
             }
         }
         else {
@@ -271,13 +302,19 @@ namespace mongo {
                 desiredExtentSize = static_cast<int> (desiredExtentSize < min ? min : desiredExtentSize);
 
                 desiredExtentSize &= 0xffffff00;
-                Extent *e = database->allocExtent( ns, desiredExtentSize, newCapped, true );
+                Extent *e = database->allocExtent( ns, desiredExtentSize, newCapped, true, fileSet );
                 size -= e->length;
             }
         }
 
         NamespaceDetails *d = nsdetails(ns);
         verify(d);
+
+        if ( inMemory ) {
+            // the extent allocated above stays empty
+            d->setSystemFlag( NamespaceDetails::Flag_InMemory );
+            database->createHeapRecordStore( ns );
+        }
         
         bool ensure = true;
 
@@ -357,7 +394,21 @@ namespace mongo {
         details->addDeletedRec(emptyLoc.drec(), emptyLoc);
     }
 
-    Extent* DataFileMgr::allocFromFreeList(const char *ns, int approxSize, bool capped) {
+    /** unlink an extent from the freelist namespace 'f' */
+    static void unlinkFromFreeList(NamespaceDetails *f, Extent *e) {
+        if( !e->xprev.isNull() )
+            e->xprev.ext()->xnext.writing() = e->xnext;
+        if( !e->xnext.isNull() )
+            e->xnext.ext()->xprev.writing() = e->xprev;
+        if( f->firstExtent() == e->myLoc )
+            f->setFirstExtent( e->xnext );
+        if( f->lastExtent() == e->myLoc )
+            f->setLastExtent( e->xprev );
+    }
+
+    Extent* DataFileMgr::allocFromFreeList(const char *ns, int approxSize, bool capped,
+                                           const StringData& fileSet) {
+        ExtentManager& em = cc().database()->getExtentManager();
         string s = cc().database()->name() + FREELIST_NS;
         NamespaceDetails *f = nsdetails(s);
         if( f ) {
@@ -388,7 +439,8 @@ namespace mongo {
                 DiskLoc L = f->firstExtent();
                 while( !L.isNull() ) {
                     Extent * e = L.ext();
-                    if( e->length >= low && e->length <= high ) {
+                    if( e->length >= low && e->length <= high &&
+                        em.fileSetOf( L.a() ) == fileSet ) {
                         int diff = abs(e->length - approxSize);
                         if( diff < bestDiff ) {
                             bestDiff = diff;
@@ -424,15 +476,14 @@ namespace mongo {
 
             if( best ) {
                 Extent *e = best;
+
+                // the extent's space may have been released by reclaimFreedSpace(), if its file
+                // was ever reclaimed from
+                Status st = em.getFile( e->myLoc.a() )->ensureSpace( e->myLoc.getOfs(), e->length );
+                uassert( 17124, st.reason(), st.isOK() );
+
                 // remove from the free list
-                if( !e->xprev.isNull() )
-                    e->xprev.ext()->xnext.writing() = e->xnext;
-                if( !e->xnext.isNull() )
-                    e->xnext.ext()->xprev.writing() = e->xprev;
-                if( f->firstExtent() == e->myLoc )
-                    f->setFirstExtent( e->xnext );
-                if( f->lastExtent() == e->myLoc )
-                    f->setLastExtent( e->xprev );
+                unlinkFromFreeList(f, e);
 
                 // use it
                 OCCASIONALLY if( n > 512 ) log() << "warning: newExtent " << n << " scanned" << endl;
@@ -481,6 +532,13 @@ namespace mongo {
         if ( ! d )
             return shared_ptr<Cursor>(new BasicCursor(DiskLoc()));
 
+        if ( d->isInMemory() ) {
+            if ( !startLoc.isNull() )
+                return shared_ptr<Cursor>(new BasicCursor( startLoc ));
+            HeapRecordStore *store = cc().database()->getHeapRecordStore( ns );
+            return shared_ptr<Cursor>(new BasicCursor( store ? store->firstRecord() : DiskLoc() ));
+        }
+
         DiskLoc loc = d->firstExtent();
         Extent *e = getExtent(loc);
 
@@ -539,6 +597,10 @@ namespace mongo {
         if ( !d->isCapped() ) {
             if ( !startLoc.isNull() )
                 return shared_ptr<Cursor>(new ReverseCursor( startLoc ));
+            if ( d->isInMemory() ) {
+                HeapRecordStore *store = cc().database()->getHeapRecordStore( ns );
+                return shared_ptr<Cursor>(new ReverseCursor( store ? store->lastRecord() : DiskLoc() ));
+            }
             Extent *e = d->lastExtent().ext();
             while ( e->lastRecord.isNull() && !e->xprev.isNull() ) {
                 OCCASIONALLY out() << "  findTableScan: extent empty, skipping ahead" << endl;
@@ -606,6 +668,77 @@ namespace mongo {
         //printFreeList();
     }
 
+    Status reclaimFreedSpace(long long* bytesReleased, int* filesRemoved) {
+        Lock::assertWriteLocked("");
+        *bytesReleased = 0;
+        *filesRemoved = 0;
+
+        Database *database = cc().database();
+        ExtentManager& em = database->getExtentManager();
+        NamespaceDetails *f = nsdetails(database->name() + FREELIST_NS);
+        if( f == 0 || f->firstExtent().isNull() )
+            return Status::OK();
+
+        // freed bytes per data file
+        vector<long long> freedInFile( em.numFiles(), 0 );
+        for( DiskLoc L = f->firstExtent(); !L.isNull(); L = L.ext()->xnext )
+            freedInFile[L.a()] += L.ext()->length;
+
+        // trailing files whose every extent is on the freelist.  file 0 always stays.
+        int keepFiles = static_cast<int>( em.numFiles() );
+        while( keepFiles > 1 ) {
+            DataFileHeader *h = em.getFile( keepFiles - 1 )->getHeader();
+            long long inExtents = h->fileLength - DataFileHeader::HeaderSize - 16 - h->unusedLength;
+            if( freedInFile[keepFiles - 1] != inExtents )
+                break;
+            keepFiles--;
+        }
+
+        // freelist extents in these files may have holes from now on, which allocFromFreeList()
+        // fills again before reusing them.  durable with the commit below, before any hole.
+        for( int i = 0; i < keepFiles; i++ ) {
+            DataFileHeader *h = em.getFile( i )->getHeader();
+            if( freedInFile[i] > 0 && !h->spaceReleased )
+                getDur().writingInt( h->spaceReleased ) = 1;
+        }
+
+        if( keepFiles < static_cast<int>( em.numFiles() ) ) {
+            // cursors or the read-ahead of scans must not be left pointing into the files
+            ClientCursor::invalidate( ( database->name() + '.' ).c_str() );
+
+            for( DiskLoc L = f->firstExtent(); !L.isNull(); ) {
+                Extent *e = L.ext();
+                L = e->xnext;
+                if( e->myLoc.a() >= keepFiles )
+                    unlinkFromFreeList(f, e);
+            }
+            // the journal must not hold writes to the files we delete when they are gone, and
+            // the freelist must no longer point into them should we crash right after
+            getDur().syncDataAndTruncateJournal();
+            while( static_cast<int>( em.numFiles() ) > keepFiles ) {
+                *bytesReleased += em.getFile( em.numFiles() - 1 )->length();
+                em.removeLastFile();
+                (*filesRemoved)++;
+            }
+        }
+        else {
+            // the extents must be durably freed before their contents are thrown away
+            getDur().commitNow();
+        }
+
+        for( DiskLoc L = f->firstExtent(); !L.isNull(); L = L.ext()->xnext ) {
+            Extent *e = L.ext();
+            long long released;
+            Status s = em.getFile( L.a() )->releaseSpace( L.getOfs() + Extent::HeaderSize(),
+                                                          e->length - Extent::HeaderSize(),
+                                                          &released );
+            if( !s.isOK() )
+                return s;
+            *bytesReleased += released;
+        }
+        return Status::OK();
+    }
+
     /* drop a collection/namespace */
     void dropNS(const string& nsToDrop) {
         NamespaceDetails* d = nsdetails(nsToDrop);
@@ -678,7 +811,8 @@ namespace mongo {
     /* deletes a record, just the pdfile portion -- no index cleanup, no cursor cleanup, etc.
        caller must check if capped
     */
-    void DataFileMgr::_deleteRecord(NamespaceDetails *d, const char *ns, Record *todelete, const DiskLoc& dl) {
+    /* removes a record from its extent's record chain, leaving its space unaccounted for */
+    static void unlinkRecordFromExtent(Record *todelete, const DiskLoc& dl) {
         /* remove ourself from the record next/prev chain */
         {
             if ( todelete->prevOfs() != DiskLoc::NullOfs )
@@ -703,6 +837,20 @@ namespace mongo {
                     e->lastRecord.set(dl.a(), todelete->prevOfs() );
             }
         }
+    }
+
+    void DataFileMgr::_deleteRecord(NamespaceDetails *d, const char *ns, Record *todelete, const DiskLoc& dl) {
+        if ( d->isInMemory() ) {
+            d->incrementStats( -1 * todelete->netLength(), -1 );
+            HeapRecordStore *store = cc().database()->getHeapRecordStore( ns );
+            massert( 17129, str::stream() << "records of in memory collection " << ns
+                                          << " were lost when the database was closed",
+                     store );
+            store->deleteRecord( dl );
+            return;
+        }
+
+        unlinkRecordFromExtent(todelete, dl);
 
         /* add to the free list */
         {
@@ -761,6 +909,20 @@ namespace mongo {
         }
     }
 
+    DiskLoc DataFileMgr::moveRecordOutOfExtent(NamespaceDetails* d, const char *ns, Record *r, const DiskLoc& dl) {
+        dassert( r == dl.rec() );
+        verify( !d->isCapped() );
+
+        BSONObj obj = BSONObj::make(r).getOwned();
+
+        ClientCursor::aboutToDelete(ns, d, dl);
+        unindexRecord(d, r, dl, false);
+        unlinkRecordFromExtent(r, dl);
+        d->incrementStats( -1 * r->netLength(), -1 );
+
+        return insert(ns, obj.objdata(), obj.objsize(), false, false);
+    }
+
     Counter64 moveCounter;
     ServerStatusMetricField<Counter64> moveCounterDisplay( "record.moves", &moveCounter );
 
@@ -1027,6 +1189,26 @@ namespace mongo {
         return true;
     }
 
+    /**
+     * the file set for the first extent of a new namespace.  an index is in the set named by its
+     * spec, else in its collection's set.
+     */
+    static string fileSetForNewNamespace(const char *ns) {
+        const char *idx = strstr(ns, ".$");
+        if ( !idx )
+            return "";
+        NamespaceDetails *d = nsdetails( StringData( ns, idx - ns ) );
+        if ( !d )
+            return "";
+        int i = d->findIndexByName( idx + 2, true );
+        if ( i >= 0 ) {
+            BSONElement e = d->idx( i ).info.obj()["fileSet"];
+            if ( e.type() == String )
+                return e.String();
+        }
+        return d->fileSet().toString();
+    }
+
     NOINLINE_DECL NamespaceDetails* insert_newNamespace(const char *ns, int len, bool god) { 
         checkConfigNS(ns);
         // This may create first file in the database.
@@ -1036,7 +1218,7 @@ namespace mongo {
             // for user collections.  TODO: we could look at the # of records in the parent collection to be smarter here.
             ies = (32+4) * 1024;
         }
-        cc().database()->allocExtent(ns, ies, false, false);
+        cc().database()->allocExtent(ns, ies, false, false, fileSetForNewNamespace(ns));
         NamespaceDetails *d = nsdetails(ns);
         if ( !god )
             ensureIdIndexForNewNs(ns);
@@ -1141,6 +1323,110 @@ namespace mongo {
         }
     }
 
+    /**
+     * inserts the index specs 'specs' of the collection 'tabletoidxns' into 'ns', its
+     * system.indexes, and builds them from one scan of it, completing each as insert_makeIndex()
+     * does.  on an error all the indexes not completed are rolled back.
+     */
+    /** @param stored out: the specs stored, as they were, those of existing indexes left out */
+    void NOINLINE_DECL insert_makeIndexes(const char* ns,
+                                          const string& tabletoidxns,
+                                          const vector<BSONObj>& specs,
+                                          bool mayInterrupt,
+                                          vector<BSONObj>* stored) {
+        // see insert_makeIndex()
+        if (mayInterrupt) {
+            BSONObjBuilder b;
+            b.append("ns", tabletoidxns);
+            b.append("indexes", specs);
+            cc().curop()->setQuery(b.obj());
+        }
+
+        // the indexes registered and not completed, and the blocks counting them in progress
+        vector<string> idxNames;
+        vector<shared_ptr<NamespaceDetails::IndexBuildBlock> > indexBuildBlocks;
+
+        try {
+            for (size_t i = 0; i < specs.size(); i++) {
+                string sourceNS;
+                NamespaceDetails* sourceCollection;
+                BSONObj fixedIndexObject;
+                if (!prepareToBuildIndex(specs[i],
+                                         mayInterrupt,
+                                         false,
+                                         sourceNS,
+                                         sourceCollection,
+                                         fixedIndexObject)) {
+                    // the index already exists
+                    continue;
+                }
+                verify(sourceNS == tabletoidxns);
+
+                BSONObj info = fixedIndexObject.isEmpty() ? specs[i] : fixedIndexObject;
+                DiskLoc loc = theDataFileMgr.insert(ns,
+                                                    info.objdata(),
+                                                    info.objsize(),
+                                                    mayInterrupt,
+                                                    false,
+                                                    false /* mayAddIndex: built below */);
+                IndexDetails& idx = sourceCollection->getNextIndexDetails(tabletoidxns.c_str());
+                std::string idxName = info["name"].valuestr();
+                indexBuildBlocks.push_back(shared_ptr<NamespaceDetails::IndexBuildBlock>(
+                        new NamespaceDetails::IndexBuildBlock(tabletoidxns, idxName)));
+                getDur().writingDiskLoc(idx.info) = loc;
+                idxNames.push_back(idxName);
+                stored->push_back(info);
+            }
+
+            if (idxNames.empty()) {
+                return;
+            }
+
+            buildIndexes(tabletoidxns, nsdetails(tabletoidxns), idxNames, mayInterrupt);
+
+            while (!idxNames.empty()) {
+                NamespaceDetails* tableToIndex = nsdetails(tabletoidxns);
+                int idxNo = IndexBuildsInProgress::get(tabletoidxns.c_str(), idxNames.front());
+                if ( idxNo != tableToIndex->getCompletedIndexCount() ) {
+                    log() << "switching indexes at position " << idxNo << " and "
+                          << tableToIndex->getCompletedIndexCount() << endl;
+
+                    tableToIndex->swapIndex( tabletoidxns.c_str(),
+                                             idxNo,
+                                             tableToIndex->getCompletedIndexCount() );
+
+                    idxNo = tableToIndex->getCompletedIndexCount();
+                }
+
+                // increments nIndexes, then no longer in progress
+                tableToIndex->addIndex(tabletoidxns.c_str());
+                indexBuildBlocks.erase(indexBuildBlocks.begin());
+                idxNames.erase(idxNames.begin());
+
+                IndexLegacy::postBuildHook(tableToIndex, tableToIndex->idx(idxNo));
+            }
+        }
+        catch (...) {
+            // save our error msg as dropping the indexes would overwrite it
+            LastError *le = lastError.get();
+            int savecode = le ? le->code : 0;
+            string saveerrmsg = le ? le->msg : "";
+
+            while (!idxNames.empty()) {
+                int idxNo = IndexBuildsInProgress::get(tabletoidxns.c_str(), idxNames.back());
+                nsdetails(tabletoidxns)->idx(idxNo).kill_idx();
+                IndexBuildsInProgress::remove(tabletoidxns.c_str(), idxNo);
+                indexBuildBlocks.pop_back();
+                idxNames.pop_back();
+            }
+
+            if ( le ) {
+                setLastError(savecode, saveerrmsg.c_str());
+            }
+            throw;
+        }
+    }
+
     // indexName is passed in because index details may not be pointing to something valid at this
     // point
     int IndexBuildsInProgress::get(const char* ns, const std::string& indexName) {
@@ -1255,7 +1541,16 @@ namespace mongo {
             checkNoIndexConflicts( d, BSONObj( reinterpret_cast<const char *>( obuf ) ) );
         }
 
-        DiskLoc loc = allocateSpaceForANewRecord(ns, d, lenWHdr, god);
+        HeapRecordStore *heapStore = 0;
+        if ( d->isInMemory() ) {
+            heapStore = cc().database()->getHeapRecordStore( ns );
+            massert( 17130, str::stream() << "records of in memory collection " << ns
+                                          << " were lost when the database was closed",
+                     heapStore );
+        }
+
+        DiskLoc loc = heapStore ? heapStore->allocRecord( lenWHdr ) :
+                                  allocateSpaceForANewRecord(ns, d, lenWHdr, god);
 
         if ( loc.isNull() ) {
             log() << "insert: couldn't alloc space for object ns:" << ns
@@ -1281,7 +1576,10 @@ namespace mongo {
             }
         }
 
-        addRecordToRecListInExtent(r, loc);
+        if ( heapStore )
+            heapStore->addRecordToNaturalOrder( loc );
+        else
+            addRecordToRecListInExtent(r, loc);
 
         d->incrementStats( r->netLength(), 1 );
 
@@ -1321,6 +1619,216 @@ namespace mongo {
         return loc;
     }
 
+    bool DataFileMgr::canInsertBatch(const char* ns, NamespaceDetails* d) {
+        // no system collections: system.indexes builds indexes, system.users is checked.
+        // no background index builds: their keys are added under their own rules.
+        return d &&
+               !d->isCapped() &&
+               !d->isInMemory() &&
+               NamespaceString::normal( ns ) &&
+               !strstr( ns, ".system." ) &&
+               d->getTotalIndexCount() == d->getCompletedIndexCount();
+    }
+
+    // documents are carved from allocations of up to this many bytes, one write intent each
+    static const int BatchRunBytes = 1024 * 1024;
+
+    void DataFileMgr::insertBatch(const char* ns, NamespaceDetails* d, vector<BSONObj>& objs,
+                                  bool keepGoing, vector<DiskLoc>* locs) {
+        verify( canInsertBatch( ns, d ) );
+        const size_t n = objs.size();
+        locs->assign( n, DiskLoc() );
+
+        const bool mayAddId = nsToDatabase( ns ) != "local" && d->haveIdIndex();
+        vector<IDToInsert> ids( n );
+        vector<int> lens( n );
+        for ( size_t i = 0; i < n; i++ ) {
+            int len = objs[i].objsize();
+            if ( mayAddId && objs[i].getField( "_id" ).eoo() ) {
+                ids[i].init();
+                len += ids[i].size();
+            }
+            BSONElementManipulator::lookForTimestamps( objs[i] );
+            int lenWHdr = d->getRecordAllocationSize( len + Record::HeaderSize );
+            fassert( 17137, lenWHdr >= ( len + Record::HeaderSize ) );
+            // as alloc() would align it
+            lens[i] = ( lenWHdr + 3 ) & 0xfffffffc;
+        }
+
+        // the new records are written directly, not through the Record accessors: most of
+        // them are in pages no one touched yet, and PageFaultException must not be thrown
+        // halfway through a run.
+        size_t written = 0;
+        DiskLoc unlinked;       // the allocation of the run being written, until linked in
+        int unlinkedLen = 0;
+        try {
+            while ( written < n ) {
+                size_t end = written;
+                int runLen = 0;
+                while ( end < n && ( end == written || runLen + lens[end] <= BatchRunBytes ) )
+                    runLen += lens[end++];
+
+                DiskLoc first = allocateSpaceForANewRecord( ns, d, runLen, false );
+                massert( 17138, str::stream() << "couldn't alloc " << runLen
+                                              << " bytes for a batch of inserts into " << ns,
+                         !first.isNull() );
+                unlinked = first;
+
+                Record* firstRec = first.rec();
+                const int regionLen = firstRec->lengthWithHeaders();
+                unlinkedLen = regionLen;
+                const int extentOfs = firstRec->extentOfs();
+                verify( regionLen >= runLen );
+                char* p = static_cast<char*>( getDur().writingPtr( firstRec, runLen ) );
+
+                int ofs = first.getOfs();
+                long long netLength = 0;
+                for ( size_t i = written; i < end; i++ ) {
+                    // the last record of the run gets what alloc() gave past the run
+                    int recLen = i == end - 1 ? regionLen - ( ofs - first.getOfs() ) : lens[i];
+                    int* hdr = reinterpret_cast<int*>( p );
+                    hdr[0] = recLen;                                  // lengthWithHeaders
+                    hdr[1] = extentOfs;
+                    hdr[2] = i == end - 1 ? DiskLoc::NullOfs : ofs + lens[i];    // nextOfs
+                    hdr[3] = i == written ? DiskLoc::NullOfs : ofs - lens[i - 1]; // prevOfs
+
+                    char* data = p + Record::HeaderSize;
+                    const char* obuf = objs[i].objdata();
+                    if ( ids[i].needed() ) {
+                        int originalSize = objs[i].objsize();
+                        *reinterpret_cast<int*>( data ) = originalSize + ids[i].size();
+                        memcpy( data + 4, ids[i].rawdata(), ids[i].size() );
+                        memcpy( data + 4 + ids[i].size(), obuf + 4, originalSize - 4 );
+                    }
+                    else {
+                        memcpy( data, obuf, objs[i].objsize() );
+                    }
+
+                    if ( ids[i].needed() )
+                        objs[i] = BSONObj( data );
+                    netLength += recLen - Record::HeaderSize;
+
+                    (*locs)[i] = DiskLoc( first.a(), ofs );
+                    p += lens[i];
+                    ofs += lens[i];
+                }
+
+                // link the run in as addRecordToRecListInExtent() does a single record
+                DiskLoc last = (*locs)[end - 1];
+                Extent* e = firstRec->myExtent( first );
+                if ( e->lastRecord.isNull() ) {
+                    Extent::FL* fl = getDur().writing( e->fl() );
+                    fl->firstRecord = first;
+                    fl->lastRecord = last;
+                }
+                else {
+                    firstRec->prevOfs() = e->lastRecord.getOfs();
+                    getDur().writingInt( e->lastRecord.rec()->nextOfs() ) = first.getOfs();
+                    getDur().writingDiskLoc( e->lastRecord ) = last;
+                }
+                unlinked = DiskLoc();
+
+                d->incrementStats( netLength, end - written );
+                written = end;
+            }
+        }
+        catch ( ... ) {
+            if ( !unlinked.isNull() ) {
+                // the run is in no record list, so it goes back to the free lists whole
+                DeletedRecord* dr = unlinked.drec();
+                if ( unlinkedLen )
+                    getDur().writingInt( dr->lengthWithHeaders() ) = unlinkedLen;
+                d->addDeletedRec( dr, unlinked );
+            }
+            // nothing is indexed yet
+            for ( size_t i = 0; i < written; i++ ) {
+                _deleteRecord( d, ns, (*locs)[i].rec(), (*locs)[i] );
+                (*locs)[i] = DiskLoc();
+            }
+            throw;
+        }
+
+        NamespaceDetailsTransient::get( ns ).notifyOfWriteOp();
+
+        // the documents from the first one some index refused on go one by one, so that they
+        // fail or not exactly as they would have inserted one at a time
+        size_t indexed = d->getTotalIndexCount() > 0 ? indexRecordBatch( d, objs, *locs ) : n;
+        for ( size_t i = indexed; i < n; i++ ) {
+            DiskLoc loc = (*locs)[i];
+            try {
+                indexRecord( ns, d, objs[i], loc );
+            }
+            catch ( AssertionException& ) {
+                _deleteRecord( d, ns, loc.rec(), loc );
+                (*locs)[i] = DiskLoc();
+                if ( !keepGoing || i == n - 1 ) {
+                    for ( size_t j = i + 1; j < n; j++ ) {
+                        _deleteRecord( d, ns, (*locs)[j].rec(), (*locs)[j] );
+                        (*locs)[j] = DiskLoc();
+                    }
+                    throw;
+                }
+            }
+        }
+
+        for ( size_t i = 0; i < n; i++ ) {
+            if ( !(*locs)[i].isNull() )
+                d->paddingFits();
+        }
+    }
+
+    size_t DataFileMgr::insertIndexes(const char* ns, const vector<BSONObj>& specs,
+                                      bool mayInterrupt, bool logForRepl) {
+        verify( nsToCollectionSubstring( ns ) == "system.indexes" );
+        size_t nStored = 0;
+
+        // the specs built together, by collection in the order of the first of each
+        vector<string> collections;
+        map<string, vector<BSONObj> > together;
+        for ( size_t i = 0; i < specs.size(); i++ ) {
+            BSONObj spec = specs[i];
+            BSONElement sourceNS = spec["ns"];
+            if ( sourceNS.type() != String || !canBuildWithOtherIndexes( spec ) ) {
+                // built, or refused, on its own
+                DiskLoc loc = insertWithObjMod( ns, spec, mayInterrupt );
+                if ( !loc.isNull() ) {
+                    nStored++;
+                    if ( logForRepl )
+                        logOp( "i", ns, BSONObj::make( loc.rec() ) );
+                }
+                getDur().commitIfNeeded();
+                continue;
+            }
+            vector<BSONObj>& specsOfCollection = together[sourceNS.String()];
+            if ( specsOfCollection.empty() )
+                collections.push_back( sourceNS.String() );
+            specsOfCollection.push_back( spec );
+        }
+
+        for ( size_t i = 0; i < collections.size(); i++ ) {
+            const vector<BSONObj>& specsOfCollection = together[collections[i]];
+            // the specs as stored, fixed up by prepareToBuildIndex()
+            vector<BSONObj> stored;
+            if ( specsOfCollection.size() == 1 ) {
+                BSONObj spec = specsOfCollection[0];
+                DiskLoc loc = insertWithObjMod( ns, spec, mayInterrupt );
+                if ( !loc.isNull() )
+                    stored.push_back( BSONObj::make( loc.rec() ) );
+            }
+            else {
+                insert_makeIndexes( ns, collections[i], specsOfCollection, mayInterrupt,
+                                    &stored );
+            }
+            nStored += stored.size();
+            if ( logForRepl ) {
+                for ( size_t j = 0; j < stored.size(); j++ )
+                    logOp( "i", ns, stored[j] );
+            }
+            getDur().commitIfNeeded();
+        }
+        return nStored;
+    }
+
     /* special version of insert for transaction logging -- streamlined a bit.
        assumes ns is capped and no indexes
     */
@@ -1442,7 +1950,9 @@ namespace mongo {
             virtual bool apply( const Path &p ) {
                 if ( !boost::filesystem::exists( p ) )
                     return false;
-                boostRenameWrapper( p, newPath_ / ( p.leaf().string() + ".bak" ) );
+                Path dir = newPath_ / fileSetDir;
+                boost::filesystem::create_directories( dir );
+                boostRenameWrapper( p, dir / ( p.leaf().string() + ".bak" ) );
                 return true;
             }
             virtual const char * op() const {
@@ -1465,7 +1975,9 @@ namespace mongo {
             virtual bool apply( const Path &p ) {
                 if ( !boost::filesystem::exists( p ) )
                     return false;
-                boostRenameWrapper( p, newPath_ / p.leaf() );
+                Path dir = newPath_ / fileSetDir;
+                boost::filesystem::create_directories( dir );
+                boostRenameWrapper( p, dir / p.leaf() );
                 return true;
             }
             virtual const char * op() const {
@@ -1631,6 +2143,38 @@ namespace mongo {
                 break;
             i++;
         }
+
+        // files of other file sets.  their numbers have gaps, so look at what is there
+        if ( !boost::filesystem::is_directory( p ) )
+            return;
+        vector<boost::filesystem::path> dirs;
+        for ( boost::filesystem::directory_iterator j( p );
+              j != boost::filesystem::directory_iterator(); ++j ) {
+            boost::filesystem::path d = *j;
+            if ( str::startsWith( d.leaf().string(), ExtentManager::fileSetDirPrefix ) &&
+                 boost::filesystem::is_directory( d ) )
+                dirs.push_back( d );
+        }
+        for ( size_t j = 0; j < dirs.size(); j++ ) {
+            // collect first, the op may remove or rename them
+            vector<boost::filesystem::path> files;
+            for ( boost::filesystem::directory_iterator k( dirs[j] );
+                  k != boost::filesystem::directory_iterator(); ++k ) {
+                boost::filesystem::path f = *k;
+                string name = f.leaf().string();
+                if ( str::startsWith( name, c ) && name.size() > c.size() &&
+                     name.find_first_not_of( "0123456789", c.size() ) == string::npos )
+                    files.push_back( f );
+            }
+            fo.fileSetDir = dirs[j].leaf().string();
+            for ( size_t k = 0; k < files.size(); k++ ) {
+                MONGO_ASSERT_ON_EXCEPTION( ok = fo.apply( files[k] ) );
+                if ( ok ) {
+                    LOG(2) << fo.op() << " file " << files[k].string() << endl;
+                }
+            }
+            fo.fileSetDir.clear();
+        }
     }
 
     NamespaceDetails* nsdetails_notinline(const char *ns) { return nsdetails(ns); }
@@ -57,6 +57,14 @@ namespace mongo {
     /* low level - only drops this ns */
     void dropNS(const string& dropNs);
 
+    /* gives the disk space of the current database's freed extents back to the OS: trailing
+       data files holding only freed extents are deleted, and the other freelist extents get
+       holes punched past their headers.  needs the global write lock.
+       @param bytesReleased out: bytes given back, including removed files
+       @param filesRemoved out: number of trailing data files deleted
+    */
+    Status reclaimFreedSpace(long long* bytesReleased, int* filesRemoved);
+
     /* deletes this ns, indexes and cursors */
     void dropCollection( const string &name, string &errmsg, BSONObjBuilder &result );
     bool userCreateNS(const char *ns, BSONObj j, string& err, bool logForReplication, bool *deferIdIndex = 0);
@@ -72,8 +80,9 @@ namespace mongo {
         DataFileMgr();
         void init(const string& path );
 
-        /* see if we can find an extent of the right size in the freelist. */
-        static Extent* allocFromFreeList(const char *ns, int approxSize, bool capped = false);
+        /* see if we can find an extent of the right size in the freelist, in a file of 'fileSet'. */
+        static Extent* allocFromFreeList(const char *ns, int approxSize, bool capped = false,
+                                         const StringData& fileSet = StringData());
 
         /** @return DiskLoc where item ends up */
         // changedId should be initialized to false
@@ -117,6 +126,45 @@ namespace mongo {
                        bool god = false,
                        bool mayAddIndex = true,
                        bool* addedID = 0);
+
+        /**
+         * inserts a batch of documents into the existing collection ns, as a loop of
+         * insertWithObjMod() would, but with the records of consecutive documents carved from
+         * one allocation under one write intent, and each index given the keys of the whole
+         * batch in key order.  the allocations do not use the small holes of the deleted lists.
+         * a document that cannot be inserted (duplicate key) is taken back out, and with
+         * !keepGoing so are all the documents after it.
+         * note: does NOT put on oplog
+         * @param d canInsertBatch( ns, d ) must be true
+         * @param objs in/out: a document given an _id is replaced by the stored document
+         * @param locs out: where each document went, null if it was not inserted
+         * throws the error of a document not inserted when !keepGoing or if it is the last one
+         */
+        void insertBatch(const char* ns,
+                         NamespaceDetails* d,
+                         vector<BSONObj>& objs,
+                         bool keepGoing,
+                         vector<DiskLoc>* locs);
+
+        /** @return true if insertBatch() can be used for collection ns, d (which may be null) */
+        static bool canInsertBatch(const char* ns, NamespaceDetails* d);
+
+        /**
+         * inserts the index specs 'specs' into ns, a system.indexes collection, building the
+         * indexes as a loop of insertWithObjMod() would but with those of each collection that
+         * canBuildWithOtherIndexes() built together, from one scan of it, after the others.
+         * stops at the first error, leaving none of the indexes built together with the
+         * failing one.
+         * @param mayInterrupt When true, killop may interrupt the function call.
+         * @param logForRepl puts each spec stored, as it was stored, on the oplog once its
+         *        index is built
+         * @return the number of specs stored, those of indexes that already existed are not
+         */
+        size_t insertIndexes(const char* ns,
+                             const vector<BSONObj>& specs,
+                             bool mayInterrupt,
+                             bool logForRepl);
+
         static shared_ptr<Cursor> findAll(const StringData& ns, const DiskLoc &startLoc = DiskLoc());
 
         /* special version of insert for transaction logging -- streamlined a bit.
@@ -136,6 +184,14 @@ namespace mongo {
         /* does not clean up indexes, etc. : just deletes the record in the pdfile. use deleteRecord() to unindex */
         void _deleteRecord(NamespaceDetails *d, const char *ns, Record *todelete, const DiskLoc& dl);
 
+        /**
+         * moves a record to newly allocated space, reindexing it and advancing cursors as an
+         * update that does not fit would.  the old space is NOT returned to the deleted lists:
+         * used by online compaction which frees the whole extent once it has been emptied.
+         * @return the new location
+         */
+        DiskLoc moveRecordOutOfExtent(NamespaceDetails* d, const char *ns, Record *r, const DiskLoc& dl);
+
         /**
          * accessor/mutator for the 'precalced' keys (that is, sorted index keys)
          *
@@ -269,6 +325,12 @@ namespace mongo {
         static void appendStats( BSONObjBuilder& b );
 
         static void appendWorkingSetInfo( BSONObjBuilder& b );
+
+        /**
+         * count an allocation made with hot placement (Flag_HotPlacement) in the record stats
+         * @param resident true if the space handed out was likely in physical memory
+         */
+        static void notePlacement( bool resident );
     private:
         
         int _netLength() const { return _lengthWithHeaders - HeaderSize; }
@@ -313,6 +375,8 @@ namespace mongo {
 
             return DiskLoc(myLoc.a(), _nextOfs);
         }
+        if ( HeapRecordStore::isHeapLoc( myLoc ) )
+            return DiskLoc(); // in memory records have no extents, end of table.
         Extent *e = myExtent(myLoc);
         while ( 1 ) {
             if ( e->xnext.isNull() )
@@ -333,6 +397,9 @@ namespace mongo {
             return DiskLoc(myLoc.a(), _prevOfs);
         }
 
+        if ( HeapRecordStore::isHeapLoc( myLoc ) )
+            return DiskLoc(); // in memory records have no extents, start of table.
+
         // Get the current extent
         Extent *e = myExtent(myLoc);
         while ( 1 ) {
@@ -33,6 +33,8 @@ namespace mongo {
 
     // todo / idea: the prefetcher, when it fetches _id, on an upsert, will see if the record exists. if it does not, 
     //              at write time, we can just do an insert, which will be faster.
+    //              (with uniqueIndexBloomFilters, findById() and replicated inserts skip the _id
+    //              index for an _id its filter rules out, see UniqueKeyFilter)
 
     //The count (of batches) and time spent fetching pages before application
     //    -- meaning depends on the prefetch behavior: all, _id index, none, etc.)
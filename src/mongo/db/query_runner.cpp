@@ -18,6 +18,7 @@
 
 #include "mongo/db/btree.h"
 #include "mongo/db/index.h"
+#include "mongo/db/index/unique_key_filter.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/pdfile.h"
 
@@ -25,13 +26,26 @@ namespace mongo {
 
     // static
     DiskLoc QueryRunner::fastFindSingle(const IndexDetails &indexdetails, const BSONObj& key) {
+        UniqueKeyFilter::Answer answer = UniqueKeyFilter::check(indexdetails, key);
+        if (UniqueKeyFilter::ABSENT == answer) {
+            return DiskLoc();
+        }
+
+        DiskLoc loc;
         const int version = indexdetails.version();
         if (0 == version) {
-            return indexdetails.head.btree<V0>()->findSingle(indexdetails, indexdetails.head, key);
+            loc = indexdetails.head.btree<V0>()->findSingle(indexdetails, indexdetails.head, key);
+        } else if (1 == version) {
+            loc = indexdetails.head.btree<V1>()->findSingle(indexdetails, indexdetails.head, key);
         } else {
-            verify(1 == version);
-            return indexdetails.head.btree<V1>()->findSingle(indexdetails, indexdetails.head, key);
+            verify(2 == version);
+            loc = indexdetails.head.btree<V2>()->findSingle(indexdetails, indexdetails.head, key);
+        }
+
+        if (loc.isNull() && UniqueKeyFilter::MAYBE_PRESENT == answer) {
+            UniqueKeyFilter::noteFalsePositive();
         }
+        return loc;
     }
 
 }  // namespace mongo
@@ -26,6 +26,7 @@
 #include "mongo/db/auth/action_type.h"
 #include "mongo/db/auth/privilege.h"
 #include "mongo/db/commands.h"
+#include "mongo/db/index/unique_key_filter.h"
 #include "mongo/db/index_builder.h"
 #include "mongo/db/index_update.h"
 #include "mongo/db/instance.h"
@@ -493,16 +494,27 @@ namespace mongo {
                               */
                     BSONObjBuilder b;
                     b.append(_id);
+                    BSONObj idQuery = b.done();
+
+                    // an _id the _id index's filter certainly doesn't have makes this an insert
+                    int idIdxNo = nsd ? nsd->findIdIndex() : -1;
+                    if ( idIdxNo >= 0 &&
+                         UniqueKeyFilter::ABSENT == UniqueKeyFilter::check( nsd->idx( idIdxNo ),
+                                                                           idQuery ) ) {
+                        BSONObj toInsert = o;
+                        theDataFileMgr.insertWithObjMod( ns, toInsert );
+                    }
+                    else {
+                        const NamespaceString requestNs(ns);
+                        UpdateRequest request(requestNs, QueryPlanSelectionPolicy::idElseNatural());
 
-                    const NamespaceString requestNs(ns);
-                    UpdateRequest request(requestNs, QueryPlanSelectionPolicy::idElseNatural());
-
-                    request.setQuery(b.done());
-                    request.setUpdates(o);
-                    request.setUpsert();
-                    request.setFromReplication();
+                        request.setQuery(idQuery);
+                        request.setUpdates(o);
+                        request.setUpsert();
+                        request.setFromReplication();
 
-                    update(request, &debug);
+                        update(request, &debug);
+                    }
                 }
             }
         }
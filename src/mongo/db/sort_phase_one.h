@@ -17,6 +17,7 @@
 #pragma once
 
 #include "mongo/db/extsort.h"
+#include "mongo/db/key_string.h"
 
 namespace mongo {
 
@@ -29,6 +30,8 @@ namespace mongo {
         }
         shared_ptr<BSONObjExternalSorter> sorter;
         shared_ptr<ExternalSortComparison> sortCmp;
+        // when set keys are sorted as KeyStrings for this ordering, see KeyString::toSortKey()
+        shared_ptr<Ordering> keyStringOrdering;
 
         unsigned long long n; // # of records
         unsigned long long nkeys;
@@ -37,7 +40,12 @@ namespace mongo {
         void addKeys(const BSONObjSet& keys, const DiskLoc& loc, bool mayInterrupt) {
             multi = multi || (keys.size() > 1);
             for (BSONObjSet::iterator it = keys.begin(); it != keys.end(); ++it) {
-                sorter->add(*it, loc, mayInterrupt);
+                if (keyStringOrdering) {
+                    sorter->add(KeyString::toSortKey(*it, *keyStringOrdering), loc, mayInterrupt);
+                }
+                else {
+                    sorter->add(*it, loc, mayInterrupt);
+                }
                 ++nkeys;
             }
             ++n;
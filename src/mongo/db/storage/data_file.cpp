@@ -22,6 +22,11 @@
 
 #include <boost/filesystem/operations.hpp>
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/falloc.h>
+#endif
+
 #include "mongo/db/cmdline.h"
 #include "mongo/db/d_concurrency.h"
 #include "mongo/db/dur.h"
@@ -135,7 +140,7 @@ namespace mongo {
             size = (int) sz;
         }
         data_file_check(_mb);
-        header()->init(fileNo, size, filename);
+        header()->init(fileNo, size, filename, _fileSet);
     }
 
     void DataFile::flush( bool sync ) {
@@ -158,9 +163,48 @@ namespace mongo {
         return DiskLoc( fileNo, offset );
     }
 
+    Status DataFile::releaseSpace( int offset, int length, long long* released ) {
+        *released = 0;
+        const long long pageSize = 4096;
+        long long begin = ( offset + pageSize - 1 ) & ~( pageSize - 1 );
+        long long end = ( static_cast<long long>( offset ) + length ) & ~( pageSize - 1 );
+        if ( end <= begin )
+            return Status::OK();
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+        if ( fallocate( getFd(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                        begin, end - begin ) != 0 ) {
+            return Status( ErrorCodes::IllegalOperation,
+                           str::stream() << "fallocate(FALLOC_FL_PUNCH_HOLE) failed on "
+                                         << mmf.filename() << ": " << errnoWithDescription() );
+        }
+        *released = end - begin;
+        return Status::OK();
+#else
+        return Status( ErrorCodes::IllegalOperation,
+                       "releasing data file space is not supported on this platform" );
+#endif
+    }
+
+    Status DataFile::ensureSpace( int offset, int length ) {
+        if ( !header()->spaceReleased )
+            return Status::OK();
+#if defined(__linux__)
+        if ( fallocate( getFd(), FALLOC_FL_KEEP_SIZE, offset, length ) != 0 ) {
+            // EOPNOTSUPP: the filesystem cannot have holes punched either
+            if ( errno == EOPNOTSUPP )
+                return Status::OK();
+            return Status( ErrorCodes::IllegalOperation,
+                           str::stream() << "fallocate failed on " << mmf.filename() << ": "
+                                         << errnoWithDescription() );
+        }
+#endif
+        return Status::OK();
+    }
+
     // -------------------------------------------------------------------------------
 
-    void DataFileHeader::init(int fileno, int filelength, const char* filename) {
+    void DataFileHeader::init(int fileno, int filelength, const char* filename,
+                              const StringData& fileSet) {
         if ( uninitialized() ) {
             DEV log() << "datafileheader::init initializing " << filename << " n:" << fileno << endl;
             if( !(filelength > 32768 ) ) {
@@ -189,6 +233,9 @@ namespace mongo {
             h->version = PDFILE_VERSION;
             h->versionMinor = PDFILE_VERSION_MINOR_22_AND_OLDER; // All dbs start like this
             h->unused.set( fileno, HeaderSize );
+            verify( fileSet.size() < sizeof( h->fileSet ) );
+            memset( h->fileSet, 0, sizeof( h->fileSet ) );
+            fileSet.copyTo( h->fileSet, false );
             verify( (data-(char*)this) == HeaderSize );
             h->unusedLength = fileLength - HeaderSize - 16;
         }
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "mongo/base/string_data.h"
 #include "mongo/db/diskloc.h"
 #include "mongo/db/pdfile_version.h"
 #include "mongo/db/storage/durable_mapped_file.h"
@@ -47,7 +48,9 @@ namespace mongo {
         int fileLength;
         DiskLoc unused; /* unused is the portion of the file that doesn't belong to any allocated extents. -1 = no more */
         int unusedLength;
-        char reserved[8192 - 4*4 - 8];
+        char fileSet[32]; /* name of the file set this file belongs to, "" for the default set. see ExtentManager */
+        int spaceReleased; /* nonzero once reclaimFreedSpace() may have punched holes in this file */
+        char reserved[8192 - 4*4 - 8 - 32 - 4];
 
         char data[4]; // first extent starts here
 
@@ -61,7 +64,7 @@ namespace mongo {
 
         bool uninitialized() const { return version == 0; }
 
-        void init(int fileno, int filelength, const char* filename);
+        void init(int fileno, int filelength, const char* filename, const StringData& fileSet);
 
         bool isEmpty() const {
             return uninitialized() || ( unusedLength == fileLength - HeaderSize - 16 );
@@ -75,7 +78,9 @@ namespace mongo {
         friend class BasicCursor;
         friend class ExtentManager;
     public:
-        DataFile(int fn) : _mb(0), fileNo(fn) { }
+        /** @param fileSet - the file set a new file is created for, see ExtentManager */
+        DataFile(int fn, const StringData& fileSet = StringData()) :
+            _mb(0), fileNo(fn), _fileSet(fileSet.toString()) { }
 
         /** @return true if found and opened. if uninitialized (prealloc only) does not open. */
         Status openExisting( const char *filename );
@@ -85,7 +90,26 @@ namespace mongo {
 
         DiskLoc allocExtentArea( int size );
 
+        /**
+         * give the disk blocks of [offset, offset+length) back to the filesystem, leaving a hole
+         * that reads as zeroes.  only whole pages inside the range are released.
+         * the range must not hold anything live that is not yet durable elsewhere.
+         * @param released out: number of bytes released
+         */
+        Status releaseSpace( int offset, int length, long long* released );
+
+        /** make sure [offset, offset+length) is backed by disk blocks again before it is written
+            through the mapped views, so running out of disk is an error rather than a SIGBUS.
+            nothing to do unless header()->spaceReleased is set. */
+        Status ensureSpace( int offset, int length );
+
         DataFileHeader *getHeader() { return header(); }
+
+        /** name of the file set this file belongs to, "" for the default set */
+        StringData fileSet() const {
+            const char* s = header()->fileSet;
+            return StringData( s, strnlen( s, sizeof( header()->fileSet ) ) );
+        }
         HANDLE getFd() { return mmf.getFd(); }
         unsigned long long length() const { return mmf.length(); }
 
@@ -103,11 +127,12 @@ namespace mongo {
         void grow(DiskLoc dl, int size);
 
         char* p() const { return (char *) _mb; }
-        DataFileHeader* header() { return (DataFileHeader*) _mb; }
+        DataFileHeader* header() const { return (DataFileHeader*) _mb; }
 
         DurableMappedFile mmf;
         void *_mb; // the memory mapped view
         int fileNo;
+        std::string _fileSet; // for a file not yet initialized
     };
 
 
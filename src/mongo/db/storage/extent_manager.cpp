@@ -22,20 +22,27 @@
 
 #include "mongo/db/client.h"
 #include "mongo/db/d_concurrency.h"
+#include "mongo/db/namespace_string.h"
 #include "mongo/db/storage/data_file.h"
 #include "mongo/db/storage/extent_manager.h"
+#include "mongo/db/storage/extent_read_ahead.h"
+#include "mongo/util/file_allocator.h"
 
 // XXX-erh
 #include "mongo/db/pdfile.h"
 
 namespace mongo {
 
+    const char ExtentManager::fileSetDirPrefix[] = "fileset.";
+
     ExtentManager::ExtentManager( const StringData& dbname,
                                   const StringData& path,
                                   bool directoryPerDB )
         : _dbname( dbname.toString() ),
           _path( path.toString() ),
-          _directoryPerDB( directoryPerDB ) {
+          _directoryPerDB( directoryPerDB ),
+          _lastFileAddedMillis( 0 ),
+          _fileAddedIntervalMillis( 0 ) {
     }
 
     ExtentManager::~ExtentManager() {
@@ -49,38 +56,102 @@ namespace mongo {
         _files.clear();
     }
 
-    boost::filesystem::path ExtentManager::fileName( int n ) const {
+    boost::filesystem::path ExtentManager::dbDirectory() const {
+        boost::filesystem::path dir( _path );
+        if ( _directoryPerDB )
+            dir /= _dbname;
+        return dir;
+    }
+
+    boost::filesystem::path ExtentManager::fileName( int n, const StringData& fileSet ) const {
         stringstream ss;
         ss << _dbname << '.' << n;
-        boost::filesystem::path fullName( _path );
-        if ( _directoryPerDB )
-            fullName /= _dbname;
+        boost::filesystem::path fullName = dbDirectory();
+        if ( !fileSet.empty() )
+            fullName /= fileSetDirPrefix + fileSet.toString();
         fullName /= ss.str();
         return fullName;
     }
 
+    Status ExtentManager::validateFileSetName( const StringData& fileSet ) {
+        if ( fileSet.empty() ||
+             fileSet.size() >= sizeof( reinterpret_cast<DataFileHeader*>( 0 )->fileSet ) ) {
+            return Status( ErrorCodes::BadValue,
+                           str::stream() << "file set name must be 1 to "
+                                         << sizeof( reinterpret_cast<DataFileHeader*>( 0 )->fileSet ) - 1
+                                         << " characters: '" << fileSet << "'" );
+        }
+        for ( size_t i = 0; i < fileSet.size(); i++ ) {
+            char c = fileSet[i];
+            if ( !isalnum( c ) && c != '_' && c != '-' ) {
+                return Status( ErrorCodes::BadValue,
+                               str::stream() << "file set name may only contain letters, digits, "
+                                             << "'_' and '-': '" << fileSet << "'" );
+            }
+        }
+        return Status::OK();
+    }
+
+    vector<string> ExtentManager::listFileSets() const {
+        vector<string> fileSets;
+        boost::filesystem::path dir = dbDirectory();
+        if ( !boost::filesystem::is_directory( dir ) )
+            return fileSets;
+        for ( boost::filesystem::directory_iterator i( dir );
+              i != boost::filesystem::directory_iterator(); ++i ) {
+            boost::filesystem::path p = *i;
+            string name = p.leaf().string();
+            if ( !str::startsWith( name, fileSetDirPrefix ) || !boost::filesystem::is_directory( p ) )
+                continue;
+            string fileSet = name.substr( strlen( fileSetDirPrefix ) );
+            if ( validateFileSetName( fileSet ).isOK() )
+                fileSets.push_back( fileSet );
+        }
+        return fileSets;
+    }
 
     Status ExtentManager::init() {
         verify( _files.size() == 0 );
 
+        vector<string> fileSets = listFileSets();
+
         for ( int n = 0; n < DiskLoc::MaxFiles; n++ ) {
-            boost::filesystem::path fullName = fileName( n );
-            if ( !boost::filesystem::exists( fullName ) )
-                break;
+            // file n is in exactly one set, look in all of them.  the default set is first as
+            // it holds most files.
+            auto_ptr<DataFile> df;
+            for ( int i = -1; i < static_cast<int>( fileSets.size() ) && !df.get(); i++ ) {
+                StringData fileSet = i < 0 ? StringData() : StringData( fileSets[i] );
+                boost::filesystem::path fullName = fileName( n, fileSet );
+                if ( !boost::filesystem::exists( fullName ) )
+                    continue;
+
+                string fullNameString = fullName.string();
+
+                auto_ptr<DataFile> f( new DataFile( n ) );
+
+                Status s = f->openExisting( fullNameString.c_str() );
+                if ( !s.isOK() ) {
+                    return s;
+                }
 
-            string fullNameString = fullName.string();
+                if ( f->getHeader()->uninitialized() ) {
+                    // pre-alloc only
+                    continue;
+                }
 
-            auto_ptr<DataFile> df( new DataFile(n) );
+                if ( f->fileSet() != fileSet ) {
+                    return Status( ErrorCodes::BadValue,
+                                   str::stream() << "data file " << fullNameString
+                                                 << " of file set '" << f->fileSet()
+                                                 << "' found in the directory of file set '"
+                                                 << fileSet << "'" );
+                }
 
-            Status s = df->openExisting( fullNameString.c_str() );
-            if ( !s.isOK() ) {
-                return s;
+                df = f;
             }
 
-            if ( df->getHeader()->uninitialized() ) {
-                // pre-alloc only, so we're done
+            if ( !df.get() )
                 break;
-            }
 
             _files.push_back( df.release() );
         }
@@ -97,7 +168,8 @@ namespace mongo {
 
 
     // todo: this is called a lot. streamline the common case
-    DataFile* ExtentManager::getFile( int n, int sizeNeeded , bool preallocateOnly) {
+    DataFile* ExtentManager::getFile( int n, int sizeNeeded , bool preallocateOnly,
+                                      const StringData& fileSet ) {
         verify(this);
         DEV Lock::assertAtLeastReadLocked( _dbname );
 
@@ -126,11 +198,32 @@ namespace mongo {
         }
         if ( p == 0 ) {
             DEV Lock::assertWriteLocked( _dbname );
-            boost::filesystem::path fullName = fileName( n );
+            boost::filesystem::path fullName = fileName( n, fileSet );
             string fullNameString = fullName.string();
-            p = new DataFile(n);
+            if ( !fileSet.empty() ) {
+                verify( !preallocateOnly );
+
+                // the journal names a file by its path relative to the dbpath, without suffix
+                string relativePath = ( _directoryPerDB ? _dbname + '/' : string() ) +
+                    fileSetDirPrefix + fileSet.toString() + '/' + _dbname;
+                uassert( 17132, str::stream() << "database and file set names too long: "
+                                              << relativePath,
+                         relativePath.size() < MaxDatabaseNameLen );
+
+                MONGO_ASSERT_ON_EXCEPTION_WITH_MSG(
+                    boost::filesystem::create_directories( fullName.branch_path() ),
+                    "create file set directory" );
+
+                // the default set may have file n preallocated already, or being preallocated
+                FileAllocator::get()->waitUntilFinished( fileName( n ).string() );
+                if ( boost::filesystem::exists( fileName( n ) ) ) {
+                    MONGO_ASSERT_ON_EXCEPTION_WITH_MSG( boost::filesystem::remove( fileName( n ) ),
+                                                        "remove preallocated data file" );
+                }
+            }
+            p = new DataFile(n, fileSet);
             int minSize = 0;
-            if ( n != 0 && _files[ n - 1 ] )
+            if ( n != 0 && n - 1 < static_cast<int>( _files.size() ) && _files[ n - 1 ] )
                 minSize = _files[ n - 1 ]->getHeader()->fileLength;
             if ( sizeNeeded + DataFileHeader::HeaderSize > minSize )
                 minSize = sizeNeeded + DataFileHeader::HeaderSize;
@@ -149,15 +242,68 @@ namespace mongo {
         return preallocateOnly ? 0 : p;
     }
 
-    DataFile* ExtentManager::addAFile( int sizeNeeded, bool preallocateNextFile ) {
+    DataFile* ExtentManager::addAFile( int sizeNeeded, bool preallocateNextFile,
+                                       const StringData& fileSet ) {
         DEV Lock::assertWriteLocked( _dbname );
         int n = (int) _files.size();
-        DataFile *ret = getFile( n, sizeNeeded );
-        if ( preallocateNextFile )
+        DataFile *ret = getFile( n, sizeNeeded, false, fileSet );
+
+        unsigned long long now = curTimeMillis64();
+        if ( _lastFileAddedMillis ) {
+            unsigned long long interval = now - _lastFileAddedMillis;
+            _fileAddedIntervalMillis = _fileAddedIntervalMillis ?
+                ( _fileAddedIntervalMillis * 3 + interval ) / 4 : interval;
+        }
+        _lastFileAddedMillis = now;
+
+        if ( preallocateNextFile && fileSet.empty() )
             preallocateAFile();
         return ret;
     }
 
+    void ExtentManager::preallocateAFile() {
+        // enough files for this much time at the rate files were added lately
+        const unsigned long long lookAheadMillis = 30 * 1000;
+        const int maxFilesAhead = 3;
+
+        int ahead = 1;
+        if ( _fileAddedIntervalMillis > 0 ) {
+            ahead += static_cast<int>( lookAheadMillis / _fileAddedIntervalMillis );
+            if ( ahead > maxFilesAhead )
+                ahead = maxFilesAhead;
+        }
+
+        for ( int i = 0; i < ahead && numFiles() + i < DiskLoc::MaxFiles; i++ )
+            getFile( numFiles() + i, 0, true );
+    }
+
+    void ExtentManager::removeLastFile() {
+        Lock::assertWriteLocked( _dbname );
+        verify( _files.size() > 1 );
+
+        // the allocator may be creating the successor of the file we remove
+        FileAllocator::get()->waitUntilFinished();
+
+        int n = static_cast<int>( _files.size() ) - 1;
+        boost::filesystem::path last = fileName( n, _files[n]->fileSet() );
+        // scans may have queued read-ahead of its extents
+        ExtentReadAhead::forgetRange( reinterpret_cast<const char*>( _files[n]->getHeader() ),
+                                      _files[n]->length() );
+        delete _files[n];
+        _files.pop_back();
+
+        log() << "removing data file " << last.string() << endl;
+        MONGO_ASSERT_ON_EXCEPTION_WITH_MSG( boost::filesystem::remove( last ),
+                                            "remove data file" );
+
+        // preallocated files are in the default set
+        for ( int i = n + 1; boost::filesystem::exists( fileName( i ) ); i++ ) {
+            log() << "removing data file " << fileName( i ).string() << endl;
+            MONGO_ASSERT_ON_EXCEPTION_WITH_MSG( boost::filesystem::remove( fileName( i ) ),
+                                                "remove data file" );
+        }
+    }
+
     size_t ExtentManager::numFiles() const {
         DEV Lock::assertAtLeastReadLocked( _dbname );
         return _files.size();
@@ -167,9 +313,30 @@ namespace mongo {
         long long size=0;
         for ( int n = 0; boost::filesystem::exists( fileName(n) ); n++)
             size += boost::filesystem::file_size( fileName(n) );
+
+        // the numbers of a set's files have gaps, so look at what is there
+        vector<string> fileSets = listFileSets();
+        string prefix = _dbname + '.';
+        for ( size_t i = 0; i < fileSets.size(); i++ ) {
+            boost::filesystem::path dir = dbDirectory() / ( fileSetDirPrefix + fileSets[i] );
+            for ( boost::filesystem::directory_iterator j( dir );
+                  j != boost::filesystem::directory_iterator(); ++j ) {
+                boost::filesystem::path p = *j;
+                string name = p.leaf().string();
+                if ( str::startsWith( name, prefix ) &&
+                     name.find_first_not_of( "0123456789", prefix.size() ) == string::npos &&
+                     name.size() > prefix.size() ) {
+                    size += boost::filesystem::file_size( p );
+                }
+            }
+        }
         return size;
     }
 
+    StringData ExtentManager::fileSetOf( int n ) const {
+        return _getOpenFile( n )->fileSet();
+    }
+
     void ExtentManager::flushFiles( bool sync ) {
         DEV Lock::assertAtLeastReadLocked( _dbname );
         for( vector<DataFile*>::iterator i = _files.begin(); i != _files.end(); i++ ) {
@@ -180,6 +347,9 @@ namespace mongo {
 
     Record* ExtentManager::recordFor( const DiskLoc& loc ) const {
         loc.assertOk();
+        if ( HeapRecordStore::isHeapLoc( loc ) )
+            return HeapRecordStore::heapRecordFor( loc );
+
         const DataFile* df = _getOpenFile( loc.a() );
 
         int ofs = loc.getOfs();
@@ -218,7 +388,7 @@ namespace mongo {
 
     DiskLoc ExtentManager::getNextRecord( const DiskLoc& loc ) const {
         DiskLoc next = getNextRecordInExtent( loc );
-        if ( !next.isNull() )
+        if ( !next.isNull() || HeapRecordStore::isHeapLoc( loc ) )
             return next;
 
         // now traverse extents
@@ -247,7 +417,7 @@ namespace mongo {
 
     DiskLoc ExtentManager::getPrevRecord( const DiskLoc& loc ) const {
         DiskLoc prev = getPrevRecordInExtent( loc );
-        if ( !prev.isNull() )
+        if ( !prev.isNull() || HeapRecordStore::isHeapLoc( loc ) )
             return prev;
 
         // now traverse extents
@@ -353,7 +523,8 @@ namespace mongo {
     }
 
 
-    Extent* ExtentManager::createExtent(const char *ns, int size, bool newCapped, bool enforceQuota ) {
+    Extent* ExtentManager::createExtent( const char *ns, int size, bool newCapped, bool enforceQuota,
+                                         const StringData& fileSet ) {
         size = quantizeExtentSize( size );
 
         if ( size > Extent::maxSize() )
@@ -363,7 +534,7 @@ namespace mongo {
 
         for ( int i = numFiles() - 1; i >= 0; i-- ) {
             DataFile* f = getFile( i );
-            if ( f->getHeader()->unusedLength >= size ) {
+            if ( f->fileSet() == fileSet && f->getHeader()->unusedLength >= size ) {
                 return _createExtentInFile( i, f, ns, size, newCapped, enforceQuota );
             }
         }
@@ -378,7 +549,7 @@ namespace mongo {
         // no space in an existing file
         // allocate files until we either get one big enough or hit maxSize
         for ( int i = 0; i < 8; i++ ) {
-            DataFile* f = addAFile( size, false );
+            DataFile* f = addAFile( size, true, fileSet );
 
             if ( f->getHeader()->unusedLength >= size ) {
                 return _createExtentInFile( numFiles() - 1, f, ns, size, newCapped, enforceQuota );
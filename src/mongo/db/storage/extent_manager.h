@@ -44,6 +44,16 @@ namespace mongo {
      *
      * implementation:
      *  - ExtentManager holds a list of DataFile
+     *
+     * file sets:
+     *  - every data file belongs to a file set, named in its header.  files of the default set
+     *    ("") are <db>.# in the database directory, files of set S are fileset.S/<db>.# in it.
+     *    fileset.S can be a mount point or a symlink to put the set on another volume.
+     *  - the files of all sets share one sequence of file numbers, so a DiskLoc still names a
+     *    file by number.
+     *  - a collection or index names its set when it is created; its extents are then only
+     *    allocated in files of that set.
+     *  - only the default set has a file preallocated ahead of time.
      */
     class ExtentManager {
         MONGO_DISALLOW_COPYING( ExtentManager );
@@ -65,18 +75,50 @@ namespace mongo {
         size_t numFiles() const;
         long long fileSize() const;
 
-        DataFile* getFile( int n, int sizeNeeded = 0, bool preallocateOnly = false );
+        /**
+         * @param fileSet - the set the file is created in, if it does not exist yet
+         */
+        DataFile* getFile( int n, int sizeNeeded = 0, bool preallocateOnly = false,
+                           const StringData& fileSet = StringData() );
 
-        DataFile* addAFile( int sizeNeeded, bool preallocateNextFile );
+        DataFile* addAFile( int sizeNeeded, bool preallocateNextFile,
+                            const StringData& fileSet = StringData() );
 
-        void preallocateAFile() { getFile( numFiles() , 0, true ); }// XXX-ERH
+        /**
+         * requests allocation of the next files of the default set ahead of time: one, or
+         * more when files were recently added quickly, so that a bulk load does not wait for
+         * each new file to be allocated.
+         */
+        void preallocateAFile();
+
+        /**
+         * closes and deletes the last data file (and a preallocated successor, if any).
+         * the caller must have made sure nothing refers to the file anymore and that the
+         * journal holds no writes to it.  file 0 is never removed.
+         */
+        void removeLastFile();
 
         void flushFiles( bool sync );
 
         /* allocate a new Extent
            @param capped - true if capped collection
+           @param fileSet - the file set to allocate from
         */
-        Extent* createExtent( const char *ns, int approxSize, bool newCapped, bool enforceQuota );
+        Extent* createExtent( const char *ns, int approxSize, bool newCapped, bool enforceQuota,
+                              const StringData& fileSet = StringData() );
+
+        /**
+         * @return the file set an open file belongs to
+         */
+        StringData fileSetOf( int n ) const;
+
+        /**
+         * a valid name is 1 to 31 of [A-Za-z0-9_-]
+         */
+        static Status validateFileSetName( const StringData& fileSet );
+
+        // the directory of file set S is this followed by S
+        static const char fileSetDirPrefix[];
 
         /**
          * @param loc - has to be for a specific Record
@@ -123,7 +165,12 @@ namespace mongo {
                                      const char* ns, int size, bool newCapped,
                                      bool enforceQuota );
 
-        boost::filesystem::path fileName( int n ) const;
+        boost::filesystem::path fileName( int n, const StringData& fileSet = StringData() ) const;
+
+        boost::filesystem::path dbDirectory() const;
+
+        /** names of the file sets with a directory for this database */
+        std::vector<std::string> listFileSets() const;
 
 // -----
 
@@ -136,6 +183,11 @@ namespace mongo {
         //   to others and we are in the dbholder lock then.
         std::vector<DataFile*> _files;
 
+        // when the last file was added, and a moving average of the time between added files.
+        // used to decide how many files to preallocate.
+        unsigned long long _lastFileAddedMillis;
+        unsigned long long _fileAddedIntervalMillis;
+
     };
 
 }
@@ -0,0 +1,240 @@
+// extent_read_ahead.cpp
+
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/db/storage/extent_read_ahead.h"
+
+#include <boost/thread/condition.hpp>
+#include <deque>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+#include "mongo/base/counter.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/pdfile.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage/extent.h"
+#include "mongo/db/structure/record_store.h"
+#include "mongo/util/background.h"
+#include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/processinfo.h"
+
+namespace mongo {
+
+    // number of extents past the current one that collection scans ask the OS to read in.
+    // 0 disables read-ahead.
+    MONGO_EXPORT_SERVER_PARAMETER( collectionScanReadAheadExtents, int, 0 );
+
+    namespace {
+
+        Counter64 extentsQueuedCounter;
+        ServerStatusMetricField<Counter64> extentsQueuedDisplay( "readAhead.extentsQueued",
+                                                                 &extentsQueuedCounter );
+        Counter64 bytesQueuedCounter;
+        ServerStatusMetricField<Counter64> bytesQueuedDisplay( "readAhead.bytesQueued",
+                                                               &bytesQueuedCounter );
+        Counter64 droppedCounter;
+        ServerStatusMetricField<Counter64> droppedDisplay( "readAhead.dropped",
+                                                           &droppedCounter );
+        Counter64 hitsCounter;
+        ServerStatusMetricField<Counter64> hitsDisplay( "readAhead.hits", &hitsCounter );
+        Counter64 missesCounter;
+        ServerStatusMetricField<Counter64> missesDisplay( "readAhead.misses", &missesCounter );
+
+        /**
+         * issues the madvise calls, so that a scan does not wait for the OS to queue the IO.
+         * only ever sees address ranges: if the range was unmapped in the meantime, madvise
+         * just fails.  a data file being removed has its ranges dropped first, see forget().
+         */
+        class ReadAheadThread : public BackgroundJob {
+        public:
+            ReadAheadThread() : _mutex( "ReadAheadThread" ) { }
+
+            virtual string name() const { return "ReadAheadThread"; }
+
+            /** @return false if too many requests are pending already */
+            bool queue( const char* p, size_t len ) {
+                scoped_lock lk( _mutex );
+                if ( _pending.size() >= MaxPending )
+                    return false;
+                _pending.push_back( make_pair( p, len ) );
+                _pendingUpdated.notify_one();
+                return true;
+            }
+
+            /** drops the requests overlapping [start, start+len), waiting for one in progress */
+            void forget( const char* start, size_t len ) {
+                scoped_lock lk( _mutex );
+                Range r( start, len );
+                for ( std::deque<Range>::iterator i = _pending.begin(); i != _pending.end(); ) {
+                    if ( overlap( *i, r ) )
+                        i = _pending.erase( i );
+                    else
+                        ++i;
+                }
+                while ( _inProgress.first && overlap( _inProgress, r ) )
+                    _inProgressDone.wait( lk.boost() );
+            }
+
+            virtual void run() {
+                while ( 1 ) {
+                    Range r;
+                    {
+                        scoped_lock lk( _mutex );
+                        while ( _pending.empty() )
+                            _pendingUpdated.wait( lk.boost() );
+                        r = _pending.front();
+                        _pending.pop_front();
+                        _inProgress = r;
+                    }
+#if !defined(_WIN32)
+                    size_t start = reinterpret_cast<size_t>( r.first ) & ~size_t( 4095 );
+                    size_t len = reinterpret_cast<size_t>( r.first ) + r.second - start;
+                    madvise( reinterpret_cast<void*>( start ), len, MADV_WILLNEED );
+#endif
+                    {
+                        scoped_lock lk( _mutex );
+                        _inProgress = Range();
+                        _inProgressDone.notify_all();
+                    }
+                }
+            }
+
+        private:
+            typedef pair<const char*, size_t> Range;
+
+            static bool overlap( const Range& a, const Range& b ) {
+                return a.first < b.first + b.second && b.first < a.first + a.second;
+            }
+
+            static const size_t MaxPending = 64;
+
+            mongo::mutex _mutex;
+            boost::condition _pendingUpdated;
+            std::deque<Range> _pending;
+            Range _inProgress; // being madvise()d, null if none
+            boost::condition _inProgressDone;
+        };
+
+        SimpleMutex readAheadThreadMutex( "readAheadThread" );
+        ReadAheadThread* readAheadThread = 0;
+
+        ReadAheadThread* getReadAheadThread() {
+            SimpleMutex::scoped_lock lk( readAheadThreadMutex );
+            if ( !readAheadThread ) {
+                readAheadThread = new ReadAheadThread();
+                readAheadThread->go();
+            }
+            return readAheadThread;
+        }
+
+    }
+
+    void ExtentReadAhead::forgetRange( const char* start, size_t len ) {
+        ReadAheadThread* t;
+        {
+            SimpleMutex::scoped_lock lk( readAheadThreadMutex );
+            t = readAheadThread;
+        }
+        if ( t )
+            t->forget( start, len );
+    }
+
+    ExtentReadAhead::ExtentReadAhead( bool forward, int numExtents )
+        : _forward( forward ), _numExtents( numExtents ), _ahead( 0 ) {
+        if ( _numExtents < 0 )
+            _numExtents = collectionScanReadAheadExtents;
+#if defined(_WIN32)
+        _numExtents = 0;
+#endif
+    }
+
+    void ExtentReadAhead::reset() {
+        _start.Null();
+        _current.Null();
+        _tail.Null();
+        _ahead = 0;
+    }
+
+    void ExtentReadAhead::noteRecord( const DiskLoc& loc ) {
+        if ( !enabled() || loc.isNull() || HeapRecordStore::isHeapLoc( loc ) )
+            return;
+
+        DiskLoc extentLoc( loc.a(), loc.rec()->extentOfs() );
+        if ( extentLoc == _current )
+            return;
+
+        _enterExtent( extentLoc );
+    }
+
+    DiskLoc ExtentReadAhead::_after( const DiskLoc& extentLoc ) const {
+        Extent* e = extentLoc.ext();
+        DiskLoc next = _forward ? e->xnext : e->xprev;
+        if ( next.isNull() )
+            next = _wrapTo;
+        if ( next == _start )
+            return DiskLoc();
+        return next;
+    }
+
+    void ExtentReadAhead::_enterExtent( const DiskLoc& extentLoc ) {
+        if ( _start.isNull() )
+            _start = extentLoc;
+
+        if ( _ahead > 0 && extentLoc == _after( _current ) ) {
+            // this extent was queued earlier.  the scan has only read its first page yet, so
+            // the last page tells whether read-ahead got there first.
+            _ahead--;
+            if ( ProcessInfo::blockCheckSupported() ) {
+                Extent* e = extentLoc.ext();
+                const char* lastPage = reinterpret_cast<const char*>( e ) + e->length - 1;
+                if ( ProcessInfo::blockInMemory( lastPage ) )
+                    hitsCounter.increment();
+                else
+                    missesCounter.increment();
+            }
+        }
+        else {
+            // the first extent, or the scan went elsewhere than the extents queued
+            _ahead = 0;
+            _tail = extentLoc;
+        }
+        _current = extentLoc;
+
+        while ( _ahead < _numExtents ) {
+            DiskLoc next = _after( _tail );
+            if ( next.isNull() )
+                break;
+
+            Extent* e = next.ext();
+            if ( !getReadAheadThread()->queue( reinterpret_cast<const char*>( e ), e->length ) ) {
+                droppedCounter.increment();
+                break;
+            }
+            extentsQueuedCounter.increment();
+            bytesQueuedCounter.increment( e->length );
+
+            _tail = next;
+            _ahead++;
+        }
+    }
+
+}
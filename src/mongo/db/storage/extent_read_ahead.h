@@ -0,0 +1,86 @@
+// extent_read_ahead.h
+
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/db/diskloc.h"
+
+namespace mongo {
+
+    /**
+     * read-ahead for scans walking a collection in natural order.
+     *
+     * a scan reports each record it returns.  when that record is in a new extent, the next
+     * extents of the collection (in the scan's direction) are handed to a helper thread,
+     * which asks the OS to read them in (madvise MADV_WILLNEED).  the scan itself then
+     * mostly finds its pages in memory instead of faulting them in one at a time.
+     *
+     *  - extent headers are only read by the scan's thread, under its lock.  the helper
+     *    thread only ever sees address ranges.
+     *  - after a yield the extents queued may have been freed, so call reset().
+     *  - in memory collections and platforms without madvise are skipped.
+     *
+     * hits/misses in serverStatus metrics.readAhead count whether an extent queued earlier
+     * was found resident by the time the scan entered it.
+     */
+    class ExtentReadAhead {
+    public:
+        /**
+         * @param numExtents - how many extents past the current one to keep queued.
+         *                     0 disables read-ahead, < 0 uses the collectionScanReadAheadExtents
+         *                     server parameter.
+         */
+        ExtentReadAhead( bool forward, int numExtents = -1 );
+
+        /** call with each record the scan returns */
+        void noteRecord( const DiskLoc& loc );
+
+        /** forget the extents queued.  call after a yield. */
+        void reset();
+
+        /**
+         * for a capped collection that has looped: past the end of the extent chain the scan
+         * goes on from 'wrapTo', up to the extent it started in.
+         */
+        void setWrap( const DiskLoc& wrapTo ) { _wrapTo = wrapTo; }
+
+        bool enabled() const { return _numExtents > 0; }
+
+        /**
+         * drops the read-ahead queued for [start, start+len), and waits for the one in progress
+         * there if any.  call before unmapping a data file.
+         */
+        static void forgetRange( const char* start, size_t len );
+
+    private:
+        void _enterExtent( const DiskLoc& extentLoc );
+
+        /** @return the extent the scan reads after 'extentLoc', null if none */
+        DiskLoc _after( const DiskLoc& extentLoc ) const;
+
+        bool _forward;
+        int _numExtents;
+        DiskLoc _wrapTo;
+
+        DiskLoc _start;   // first extent noted
+        DiskLoc _current; // extent of the last record noted
+        DiskLoc _tail;    // last extent queued
+        int _ahead;       // extents queued past _current
+    };
+
+}
@@ -39,6 +39,8 @@ namespace mongo {
     void RecordStats::record( BSONObjBuilder& b ) {
         b.appendNumber( "accessesNotInMemory" , accessesNotInMemory.load() );
         b.appendNumber( "pageFaultExceptionsThrown" , pageFaultExceptionsThrown.load() );
+        b.appendNumber( "residentPlacements" , residentPlacements.load() );
+        b.appendNumber( "nonResidentPlacements" , nonResidentPlacements.load() );
 
     }
 
@@ -545,6 +547,19 @@ namespace mongo {
         throw PageFaultException(this);
     }
 
+    void Record::notePlacement( bool resident ) {
+        AtomicInt64& global = resident ? recordStats.residentPlacements :
+                                         recordStats.nonResidentPlacements;
+        global.fetchAndAdd(1);
+
+        Database* db = cc().database();
+        if ( db ) {
+            AtomicInt64& local = resident ? db->recordStats().residentPlacements :
+                                            db->recordStats().nonResidentPlacements;
+            local.fetchAndAdd(1);
+        }
+    }
+
     void DeletedRecord::_accessing() const {
 
     }
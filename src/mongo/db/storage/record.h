@@ -28,6 +28,8 @@ namespace mongo {
 
         AtomicInt64 accessesNotInMemory;
         AtomicInt64 pageFaultExceptionsThrown;
+        AtomicInt64 residentPlacements;
+        AtomicInt64 nonResidentPlacements;
     };
 
 
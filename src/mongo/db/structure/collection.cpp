@@ -28,7 +28,8 @@ namespace mongo {
 
     CollectionTemp::CollectionTemp( const StringData& fullNS,
                                     NamespaceDetails* details,
-                                    Database* database ) {
+                                    Database* database )
+        : _extentRecordStore( details, &database->getExtentManager() ) {
         _ns = fullNS.toString();
         _details = details;
         _database = database;
@@ -41,14 +42,27 @@ namespace mongo {
     }
 
     CollectionIterator* CollectionTemp::getIterator( const DiskLoc& start, bool tailable,
-                                                     const CollectionScanParams::Direction& dir) const {
+                                                     const CollectionScanParams::Direction& dir,
+                                                     int readAheadExtents ) const {
         verify( ok() );
         if ( _details->isCapped() )
             return new CappedIterator( this, start, tailable, dir );
-        return new FlatIterator( this, start, dir );
+        return new FlatIterator( this, start, dir, readAheadExtents );
     }
 
 
+    const RecordStore* CollectionTemp::getRecordStore() const {
+        verify( ok() );
+        if ( _details->isInMemory() ) {
+            const RecordStore* store = _database->getHeapRecordStore( _ns );
+            massert( 17131, str::stream() << "records of in memory collection " << _ns
+                                          << " were lost when the database was closed",
+                     store );
+            return store;
+        }
+        return &_extentRecordStore;
+    }
+
     ExtentManager* CollectionTemp::getExtentManager() {
         verify( ok() );
         return &_database->getExtentManager();
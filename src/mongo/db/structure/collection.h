@@ -23,6 +23,7 @@
 #include "mongo/base/string_data.h"
 #include "mongo/db/diskloc.h"
 #include "mongo/db/exec/collection_scan_common.h"
+#include "mongo/db/structure/record_store.h"
 
 namespace mongo {
 
@@ -50,8 +51,18 @@ namespace mongo {
 
         StringData ns() const { return _ns; }
 
+        /**
+         * @param readAheadExtents - see CollectionScanParams::readAheadExtents
+         */
         CollectionIterator* getIterator( const DiskLoc& start, bool tailable,
-                                         const CollectionScanParams::Direction& dir) const;
+                                         const CollectionScanParams::Direction& dir,
+                                         int readAheadExtents = -1 ) const;
+
+        /**
+         * the store holding the records: the database's HeapRecordStore for an in memory
+         * collection, otherwise one over the extents
+         */
+        const RecordStore* getRecordStore() const;
 
     private:
 
@@ -64,6 +75,8 @@ namespace mongo {
         NamespaceDetails* _details;
         Database* _database;
 
+        ExtentRecordStore _extentRecordStore;
+
         friend class Database;
         friend class FlatIterator;
         friend class CappedIterator;
@@ -29,40 +29,20 @@ namespace mongo {
 
     FlatIterator::FlatIterator(const CollectionTemp* collection,
                                const DiskLoc& start,
-                               const CollectionScanParams::Direction& dir)
-        : _curr(start), _collection(collection), _direction(dir) {
+                               const CollectionScanParams::Direction& dir,
+                               int readAheadExtents)
+        : _curr(start), _collection(collection), _direction(dir),
+          _readAhead(CollectionScanParams::FORWARD == dir, readAheadExtents) {
 
         if (_curr.isNull()) {
+            const RecordStore* rs = _collection->getRecordStore();
 
-            const ExtentManager* em = _collection->getExtentManager();
-
+            // _curr may be set to DiskLoc() here if the collection is empty
             if (CollectionScanParams::FORWARD == _direction) {
-
-                // Find a non-empty extent and start with the first record in it.
-                Extent* e = em->getExtent( _collection->_details->firstExtent() );
-
-                while (e->firstRecord.isNull() && !e->xnext.isNull()) {
-                    e = em->getNextExtent( e );
-                }
-
-                // _curr may be set to DiskLoc() here if e->lastRecord isNull but there is no
-                // valid e->xnext
-                _curr = e->firstRecord;
+                _curr = rs->firstRecord();
             }
             else {
-                // Walk backwards, skipping empty extents, and use the last record in the first
-                // non-empty extent we see.
-                Extent* e = em->getExtent( _collection->_details->lastExtent() );
-
-                // TODO ELABORATE
-                // Does one of e->lastRecord.isNull(), e.firstRecord.isNull() imply the other?
-                while (e->lastRecord.isNull() && !e->xprev.isNull()) {
-                    e = em->getPrevExtent( e );
-                }
-
-                // _curr may be set to DiskLoc() here if e->lastRecord isNull but there is no
-                // valid e->xprev
-                _curr = e->lastRecord;
+                _curr = rs->lastRecord();
             }
         }
     }
@@ -73,14 +53,15 @@ namespace mongo {
 
     DiskLoc FlatIterator::getNext() {
         DiskLoc ret = _curr;
+        _readAhead.noteRecord(ret);
 
         // Move to the next thing.
         if (!isEOF()) {
             if (CollectionScanParams::FORWARD == _direction) {
-                _curr = _collection->getExtentManager()->getNextRecord( _curr );
+                _curr = _collection->getRecordStore()->getNextRecord( _curr );
             }
             else {
-                _curr = _collection->getExtentManager()->getPrevRecord( _curr );
+                _curr = _collection->getRecordStore()->getPrevRecord( _curr );
             }
         }
 
@@ -107,6 +88,9 @@ namespace mongo {
         // has need been destroyed
         verify( _collection->ok() );
 
+        // the extents queued for read-ahead may have been freed while we yielded
+        _readAhead.reset();
+
         return true;
     }
 
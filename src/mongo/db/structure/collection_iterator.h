@@ -17,6 +17,7 @@
 #pragma once
 
 #include "mongo/db/exec/collection_scan_common.h"
+#include "mongo/db/storage/extent_read_ahead.h"
 
 namespace mongo {
 
@@ -59,7 +60,7 @@ namespace mongo {
     class FlatIterator : public CollectionIterator {
     public:
         FlatIterator(const CollectionTemp* collection, const DiskLoc& start,
-                     const CollectionScanParams::Direction& dir);
+                     const CollectionScanParams::Direction& dir, int readAheadExtents = -1);
         virtual ~FlatIterator() { }
 
         virtual bool isEOF();
@@ -76,6 +77,8 @@ namespace mongo {
         const CollectionTemp* _collection;
 
         CollectionScanParams::Direction _direction;
+
+        ExtentReadAhead _readAhead;
     };
 
     /**
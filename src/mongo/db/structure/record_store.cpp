@@ -0,0 +1,327 @@
+// record_store.cpp
+
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/db/structure/record_store.h"
+
+#include "mongo/db/namespace_details.h"
+#include "mongo/db/pdfile.h"
+#include "mongo/db/storage/extent.h"
+#include "mongo/db/storage/extent_manager.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/mutex.h"
+
+namespace mongo {
+
+    // ---- ExtentRecordStore
+
+    ExtentRecordStore::ExtentRecordStore( const NamespaceDetails* details,
+                                          const ExtentManager* em )
+        : _details( details ), _em( em ) {
+    }
+
+    Record* ExtentRecordStore::recordFor( const DiskLoc& loc ) const {
+        return _em->recordFor( loc );
+    }
+
+    DiskLoc ExtentRecordStore::firstRecord() const {
+        // Find a non-empty extent and start with the first record in it.
+        Extent* e = _em->getExtent( _details->firstExtent() );
+        while ( e->firstRecord.isNull() && !e->xnext.isNull() ) {
+            e = _em->getNextExtent( e );
+        }
+        return e->firstRecord;
+    }
+
+    DiskLoc ExtentRecordStore::lastRecord() const {
+        Extent* e = _em->getExtent( _details->lastExtent() );
+        while ( e->lastRecord.isNull() && !e->xprev.isNull() ) {
+            e = _em->getPrevExtent( e );
+        }
+        return e->lastRecord;
+    }
+
+    DiskLoc ExtentRecordStore::getNextRecord( const DiskLoc& loc ) const {
+        return _em->getNextRecord( loc );
+    }
+
+    DiskLoc ExtentRecordStore::getPrevRecord( const DiskLoc& loc ) const {
+        return _em->getPrevRecord( loc );
+    }
+
+    // ---- HeapRecordStore
+
+    namespace {
+        const int HeapChunkSize = 1024 * 1024;
+
+        // protects the stores below and the changes to the chunk regions.  stores are created
+        // and dropped under their database's write lock, but write intents are declared under
+        // other databases' locks.
+        SimpleMutex heapStoresMutex( "heapRecordStores" );
+
+        // indexed by file number - HeapFileBase
+        HeapRecordStore* heapStores[HeapRecordStore::MaxHeapStores];
+        int nextHeapStore = 0;
+
+        /**
+         * one bit for each HeapChunkSize aligned region of the address space, set for the regions
+         * of the chunks of every store.  a two level table of atomic words, so that ownsMemory(),
+         * called for every write intent in the process, reads it without taking a lock.  bits
+         * change under heapStoresMutex only; leaves are never freed.
+         */
+        const int RegionShift = 20; // log2( HeapChunkSize )
+        const int AddressBits = 48;
+        const int LeafShift = 16;   // regions per leaf, as a power of 2
+        const int LeafWords = ( 1 << LeafShift ) / 64;
+        const int TopEntries = 1 << ( AddressBits - RegionShift - LeafShift );
+        AtomicUInt64 regionLeaves[TopEntries]; // an AtomicUInt64[LeafWords] each, or 0
+        AtomicUInt32 numHeapChunks;
+
+        /** @return the word holding the bit of the region of 'p', 0 if it has no leaf */
+        AtomicUInt64* regionWord( const void* p, bool create ) {
+            const unsigned long long region =
+                static_cast<unsigned long long>( reinterpret_cast<uintptr_t>( p ) ) >> RegionShift;
+            const unsigned long long top = region >> LeafShift;
+            if ( top >= static_cast<unsigned long long>( TopEntries ) )
+                return 0;
+            AtomicUInt64* leaf = reinterpret_cast<AtomicUInt64*>(
+                static_cast<uintptr_t>( regionLeaves[top].load() ) );
+            if ( !leaf ) {
+                if ( !create )
+                    return 0;
+                leaf = new AtomicUInt64[LeafWords];
+                regionLeaves[top].store( reinterpret_cast<uintptr_t>( leaf ) );
+            }
+            return &leaf[( region & ( ( 1 << LeafShift ) - 1 ) ) / 64];
+        }
+
+        unsigned long long regionBit( const void* p ) {
+            return 1ULL << ( ( reinterpret_cast<uintptr_t>( p ) >> RegionShift ) % 64 );
+        }
+
+        /**
+         * sets or clears the bits of the regions of [start, start+size), all or none of them.
+         * call holding heapStoresMutex.
+         */
+        void markRegions( const char* start, int size, bool set ) {
+            std::vector<AtomicUInt64*> words;
+            for ( const char* p = start; p < start + size; p += HeapChunkSize ) {
+                words.push_back( regionWord( p, true ) );
+                massert( 17156, "in memory collection memory above the addressable range",
+                         words.back() );
+            }
+            for ( size_t i = 0; i < words.size(); i++ ) {
+                const unsigned long long bit = regionBit( start + i * HeapChunkSize );
+                words[i]->store( set ? words[i]->load() | bit : words[i]->load() & ~bit );
+            }
+        }
+    }
+
+    HeapRecordStore::HeapRecordStore( const StringData& ns )
+        : _ns( ns.toString() ), _fileNo( -1 ), _currentChunk( -1 ), _numRecords( 0 ) {
+        SimpleMutex::scoped_lock lk( heapStoresMutex );
+        for ( int i = 0; i < MaxHeapStores; i++ ) {
+            int n = ( nextHeapStore + i ) % MaxHeapStores;
+            if ( heapStores[n] == 0 ) {
+                heapStores[n] = this;
+                nextHeapStore = n + 1;
+                _fileNo = HeapFileBase + n;
+                break;
+            }
+        }
+        uassert( 17125, str::stream() << "too many in memory collections, max is "
+                                      << MaxHeapStores,
+                 _fileNo >= 0 );
+    }
+
+    HeapRecordStore::~HeapRecordStore() {
+        for ( size_t i = 0; i < _chunks.size(); i++ ) {
+            if ( _chunks[i].buf )
+                _freeChunk( i );
+        }
+        SimpleMutex::scoped_lock lk( heapStoresMutex );
+        heapStores[_fileNo - HeapFileBase] = 0;
+    }
+
+    Record* HeapRecordStore::heapRecordFor( const DiskLoc& loc ) {
+        int n = loc.a() - HeapFileBase;
+        HeapRecordStore* store = n < MaxHeapStores ? heapStores[n] : 0;
+        massert( 17126, str::stream() << "no in memory collection for " << loc.toString(),
+                 store );
+        return store->_recordFor( loc );
+    }
+
+    bool HeapRecordStore::ownsMemory( const void* p ) {
+        if ( numHeapChunks.load() == 0 )
+            return false;
+        // a thread only writes to a chunk after allocRecord() set the bits of its regions, and
+        // chunks are aligned to whole regions, so no other memory shares a region with them
+        AtomicUInt64* word = regionWord( p, false );
+        return word && ( word->load() & regionBit( p ) );
+    }
+
+    Record* HeapRecordStore::recordFor( const DiskLoc& loc ) const {
+        return _recordFor( loc );
+    }
+
+    int HeapRecordStore::_slotFor( const DiskLoc& loc ) const {
+        int slot = loc.getOfs() / 8 - 2;
+        massert( 17127, str::stream() << "bad in memory record " << loc.toString()
+                                      << " for " << _ns,
+                 loc.a() == _fileNo && slot >= 0 && slot < static_cast<int>( _slots.size() ) &&
+                 _slots[slot].rec );
+        return slot;
+    }
+
+    Record* HeapRecordStore::_recordFor( const DiskLoc& loc ) const {
+        return _slots[_slotFor( loc )].rec;
+    }
+
+    DiskLoc HeapRecordStore::getNextRecord( const DiskLoc& loc ) const {
+        int ofs = _recordFor( loc )->nextOfs();
+        return ofs == DiskLoc::NullOfs ? DiskLoc() : DiskLoc( _fileNo, ofs );
+    }
+
+    DiskLoc HeapRecordStore::getPrevRecord( const DiskLoc& loc ) const {
+        int ofs = _recordFor( loc )->prevOfs();
+        return ofs == DiskLoc::NullOfs ? DiskLoc() : DiskLoc( _fileNo, ofs );
+    }
+
+    DiskLoc HeapRecordStore::allocRecord( int lengthWithHeaders ) {
+        verify( lengthWithHeaders >= Record::HeaderSize );
+        int len = ( lengthWithHeaders + 7 ) & ~7;
+
+        if ( _currentChunk < 0 || _chunks[_currentChunk].used + len > _chunks[_currentChunk].size ) {
+            Chunk c;
+            c.size = ( len + HeapChunkSize - 1 ) & ~( HeapChunkSize - 1 );
+            // over allocated so that the chunk covers whole regions, see ownsMemory()
+            c.raw = static_cast<char*>( malloc( c.size + HeapChunkSize ) );
+            uassert( 17128, str::stream() << "out of memory allocating " << c.size
+                                          << " bytes for in memory collection " << _ns,
+                     c.raw );
+            c.buf = reinterpret_cast<char*>(
+                ( reinterpret_cast<uintptr_t>( c.raw ) + HeapChunkSize - 1 ) &
+                ~static_cast<uintptr_t>( HeapChunkSize - 1 ) );
+            c.used = 0;
+            c.live = 0;
+
+            try {
+                SimpleMutex::scoped_lock lk( heapStoresMutex );
+                markRegions( c.buf, c.size, true );
+                numHeapChunks.fetchAndAdd( 1 );
+            }
+            catch ( ... ) {
+                free( c.raw );
+                throw;
+            }
+
+            // the current chunk keeps its memory until its last record goes
+            if ( _currentChunk >= 0 && _chunks[_currentChunk].live == 0 )
+                _freeChunk( _currentChunk );
+
+            _currentChunk = _chunks.size();
+            _chunks.push_back( c );
+        }
+
+        Chunk& c = _chunks[_currentChunk];
+        char* p = c.buf + c.used;
+        c.used += len;
+        c.live++;
+
+        int slot;
+        if ( _freeSlots.empty() ) {
+            slot = _slots.size();
+            _slots.push_back( Slot() );
+        }
+        else {
+            slot = _freeSlots.back();
+            _freeSlots.pop_back();
+        }
+
+        // the header is written directly rather than through the Record accessors, which may
+        // throw PageFaultException for memory that was never touched
+        Record::NP* np = reinterpret_cast<Record*>( p )->np();
+        *reinterpret_cast<int*>( p ) = len; // lengthWithHeaders
+        *( reinterpret_cast<int*>( p ) + 1 ) = 0; // extentOfs
+        np->nextOfs = DiskLoc::NullOfs;
+        np->prevOfs = DiskLoc::NullOfs;
+
+        _slots[slot].rec = reinterpret_cast<Record*>( p );
+        _slots[slot].chunk = _currentChunk;
+        return _locFor( slot );
+    }
+
+    void HeapRecordStore::addRecordToNaturalOrder( const DiskLoc& loc ) {
+        Record* r = _recordFor( loc );
+        r->nextOfs() = DiskLoc::NullOfs;
+        if ( _last.isNull() ) {
+            r->prevOfs() = DiskLoc::NullOfs;
+            _first = loc;
+        }
+        else {
+            r->prevOfs() = _last.getOfs();
+            _recordFor( _last )->nextOfs() = loc.getOfs();
+        }
+        _last = loc;
+        _numRecords++;
+    }
+
+    void HeapRecordStore::deleteRecord( const DiskLoc& loc ) {
+        int slot = _slotFor( loc );
+        Record* r = _slots[slot].rec;
+
+        DiskLoc prev = getPrevRecord( loc );
+        DiskLoc next = getNextRecord( loc );
+        if ( prev.isNull() )
+            _first = next;
+        else
+            _recordFor( prev )->nextOfs() = r->nextOfs();
+        if ( next.isNull() )
+            _last = prev;
+        else
+            _recordFor( next )->prevOfs() = r->prevOfs();
+        _numRecords--;
+
+        int chunk = _slots[slot].chunk;
+        _slots[slot].rec = 0;
+        _freeSlots.push_back( slot );
+
+        if ( --_chunks[chunk].live == 0 ) {
+            if ( chunk == _currentChunk )
+                _chunks[chunk].used = 0;
+            else
+                _freeChunk( chunk );
+        }
+    }
+
+    void HeapRecordStore::_freeChunk( int chunk ) {
+        Chunk& c = _chunks[chunk];
+        {
+            SimpleMutex::scoped_lock lk( heapStoresMutex );
+            markRegions( c.buf, c.size, false );
+            numHeapChunks.fetchAndSubtract( 1 );
+        }
+        free( c.raw );
+        c.buf = 0;
+        c.raw = 0;
+        if ( chunk == _currentChunk )
+            _currentChunk = -1;
+    }
+
+}
@@ -0,0 +1,186 @@
+// record_store.h
+
+/**
+*    Copyright (C) 2013 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/string_data.h"
+#include "mongo/db/diskloc.h"
+
+namespace mongo {
+
+    class ExtentManager;
+    class NamespaceDetails;
+    class Record;
+
+    /**
+     * RecordStore basics
+     *  - one per collection
+     *  - holds the records of the collection and resolves the DiskLocs naming them
+     *  - keeps the natural order of the records
+     *  - indexes, cursors and the query layer only ever see DiskLocs, so they work on any
+     *    RecordStore
+     *  - NOT responsible for indexes, NamespaceDetails stats, cursors or the oplog
+     *  - this class is NOT thread safe, locking should be above (for now)
+     */
+    class RecordStore {
+    public:
+        virtual ~RecordStore() {}
+
+        /**
+         * @param loc - has to be for a specific Record of this store
+         */
+        virtual Record* recordFor( const DiskLoc& loc ) const = 0;
+
+        // first and last record in natural order, DiskLoc() if empty
+        virtual DiskLoc firstRecord() const = 0;
+        virtual DiskLoc lastRecord() const = 0;
+
+        // follow the natural order, DiskLoc() at the end
+        virtual DiskLoc getNextRecord( const DiskLoc& loc ) const = 0;
+        virtual DiskLoc getPrevRecord( const DiskLoc& loc ) const = 0;
+
+        /**
+         * @return false if writes to the records are neither journaled nor flushed to disk,
+         *         so they do not survive a restart
+         */
+        virtual bool isDurable() const = 0;
+    };
+
+    /**
+     * the RecordStore of collections kept in the database's mmap data files: records live in
+     * the collection's extents and are allocated from its deleted lists.
+     * the write side lives in DataFileMgr.
+     */
+    class ExtentRecordStore : public RecordStore {
+    public:
+        ExtentRecordStore( const NamespaceDetails* details, const ExtentManager* em );
+
+        virtual Record* recordFor( const DiskLoc& loc ) const;
+
+        virtual DiskLoc firstRecord() const;
+        virtual DiskLoc lastRecord() const;
+
+        virtual DiskLoc getNextRecord( const DiskLoc& loc ) const;
+        virtual DiskLoc getPrevRecord( const DiskLoc& loc ) const;
+
+        virtual bool isDurable() const { return true; }
+
+    private:
+        const NamespaceDetails* _details;
+        const ExtentManager* _em;
+    };
+
+    /**
+     * the RecordStore of collections created with { inMemory : true }: records are kept in
+     * process memory and never reach the data files, the journal or msync.  meant for scratch
+     * collections (map/reduce incremental output and the like), which must also be temp, so
+     * that they are dropped at startup: their records are gone after a restart.
+     *
+     * records are bump allocated from chunks of memory; a chunk is given back once all the
+     * records in it are deleted.  the DiskLoc of a record is (heap file number of the store,
+     * slot number).
+     *
+     * the stores are owned by their Database.
+     */
+    class HeapRecordStore : public RecordStore {
+        MONGO_DISALLOW_COPYING( HeapRecordStore );
+    public:
+        HeapRecordStore( const StringData& ns );
+        virtual ~HeapRecordStore();
+
+        virtual Record* recordFor( const DiskLoc& loc ) const;
+
+        virtual DiskLoc firstRecord() const { return _first; }
+        virtual DiskLoc lastRecord() const { return _last; }
+
+        virtual DiskLoc getNextRecord( const DiskLoc& loc ) const;
+        virtual DiskLoc getPrevRecord( const DiskLoc& loc ) const;
+
+        virtual bool isDurable() const { return false; }
+
+        /**
+         * reserves a record with room for lengthWithHeaders bytes.  the record is not in the
+         * natural order until addRecordToNaturalOrder() is called.
+         * @return never null; throws if out of memory
+         */
+        DiskLoc allocRecord( int lengthWithHeaders );
+
+        /** appends a record returned by allocRecord() to the natural order */
+        void addRecordToNaturalOrder( const DiskLoc& loc );
+
+        /** unlinks the record from the natural order and frees it */
+        void deleteRecord( const DiskLoc& loc );
+
+        long long numRecords() const { return _numRecords; }
+
+        /** @return true if 'loc' names a record of some HeapRecordStore */
+        static bool isHeapLoc( const DiskLoc& loc ) { return loc.a() >= HeapFileBase; }
+
+        /** @param loc - isHeapLoc( loc ) must be true */
+        static Record* heapRecordFor( const DiskLoc& loc );
+
+        /**
+         * @return true if 'p' points into memory of some HeapRecordStore.  write intents for such
+         *         memory are not journaled.  lock free: it is called for every write intent.
+         */
+        static bool ownsMemory( const void* p );
+
+        enum {
+            // DiskLoc file numbers from here up name a HeapRecordStore.  well above
+            // DiskLoc::MaxFiles and below what DiskLoc::questionable() accepts.
+            HeapFileBase = 0x40000,
+            MaxHeapStores = 4096
+        };
+
+    private:
+        struct Chunk {
+            char* raw; // as malloc'd
+            char* buf; // raw, aligned up to HeapChunkSize
+            int size;
+            int used; // bytes handed out
+            int live; // records not yet deleted
+        };
+
+        struct Slot {
+            Record* rec; // 0 if free
+            int chunk;
+        };
+
+        Record* _recordFor( const DiskLoc& loc ) const;
+        int _slotFor( const DiskLoc& loc ) const;
+        DiskLoc _locFor( int slot ) const { return DiskLoc( _fileNo, ( slot + 2 ) * 8 ); }
+        void _freeChunk( int chunk );
+
+        std::string _ns;
+        int _fileNo;
+
+        std::vector<Chunk> _chunks; // buf of a freed chunk is 0
+        int _currentChunk;
+        std::vector<Slot> _slots;
+        std::vector<int> _freeSlots;
+
+        DiskLoc _first;
+        DiskLoc _last;
+        long long _numRecords;
+    };
+
+}
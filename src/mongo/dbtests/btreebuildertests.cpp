@@ -21,6 +21,7 @@
 #include "mongo/db/btreecursor.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/platform/cstdint.h"
+#include "mongo/util/timer.h"
 
 #include "mongo/dbtests/dbtests.h"
 
@@ -149,6 +150,74 @@ namespace BtreeBuilderTests {
         bool _mayInterrupt;
     };
 
+    /**
+     * A foreground index build generating and sorting its keys on several threads builds the
+     * index a serial build does.  The time each build takes is logged.
+     */
+    class ParallelKeyGeneration {
+    public:
+        ParallelKeyGeneration() {
+            BSONObj res;
+            ASSERT( _client.runCommand( "admin",
+                                        BSON( "getParameter" << 1 << "indexBuildThreads" << 1 ),
+                                        res ) );
+            _oldThreads = res[ "indexBuildThreads" ].numberInt();
+        }
+        ~ParallelKeyGeneration() {
+            setThreads( _oldThreads );
+            _client.dropCollection( _ns );
+        }
+        void run() {
+            // Enough documents that the build uses the threads, with multikey documents.
+            for( int32_t i = 0; i < nDocs; ++i ) {
+                _client.insert( _ns, BSON( "_id" << i <<
+                                           "a" << ( i * 7919 % 1000 ) <<
+                                           "b" << BSON_ARRAY( i % 3 << i % 5 ) ) );
+            }
+            vector<BSONObj> serial = build( 1 );
+            vector<BSONObj> parallel = build( 4 );
+            ASSERT_EQUALS( static_cast<size_t>( nDocs ), serial.size() );
+            ASSERT_EQUALS( serial.size(), parallel.size() );
+            for( size_t i = 0; i < serial.size(); ++i ) {
+                ASSERT_EQUALS( serial[ i ], parallel[ i ] );
+            }
+        }
+    private:
+        static const int32_t nDocs = 50000;
+
+        /** Builds an index with 'threads' threads, and drops it after scanning it. */
+        vector<BSONObj> build( int threads ) {
+            setThreads( threads );
+            BSONObj key = BSON( "a" << 1 << "b" << 1 );
+            Timer t;
+            _client.ensureIndex( _ns, key, false, "", false );
+            ASSERT( _client.getLastError().empty() );
+            mongo::log() << "index build of " << nDocs << " documents with " << threads
+                  << " key generation threads: " << t.millis() << "ms" << endl;
+
+            BSONObj res;
+            ASSERT( _client.runCommand( "unittests",
+                                        BSON( "validate" << "btreebuilder" << "full" << true ),
+                                        res ) );
+            ASSERT( res[ "valid" ].trueValue() );
+            vector<BSONObj> found;
+            auto_ptr<DBClientCursor> cursor = _client.query( _ns, Query().hint( key ) );
+            while( cursor->more() ) {
+                found.push_back( cursor->next().getOwned() );
+            }
+            _client.dropIndex( _ns, key );
+            return found;
+        }
+        void setThreads( int threads ) {
+            BSONObj res;
+            ASSERT( _client.runCommand( "admin",
+                                        BSON( "setParameter" << 1 <<
+                                              "indexBuildThreads" << threads ),
+                                        res ) );
+        }
+        int _oldThreads;
+    };
+
     class BtreeBuilderTests : public Suite {
     public:
         BtreeBuilderTests() :
@@ -159,6 +228,7 @@ namespace BtreeBuilderTests {
             add<Commit>();
             add<InterruptCommit>( false );
             add<InterruptCommit>( true );
+            add<ParallelKeyGeneration>();
         }
     } btreeBuilderTests;
 
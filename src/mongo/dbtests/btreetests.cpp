@@ -47,3 +47,72 @@ namespace BtreeTests0 {
 namespace BtreeTests1 {
 #include "mongo/dbtests/btreetests.inl"
 }
+
+#undef BtreeBucket
+#undef btree
+#undef btreemod
+namespace BtreeTests2 {
+
+    const char* ns() {
+        return "unittests.btreetests2";
+    }
+
+    /** Deleting most of the keys of a v:2 index merges its sparse buckets. */
+    class MergeSparseBuckets {
+    public:
+        MergeSparseBuckets() : _context( ns() ) {
+            _c.ensureIndex( ns(), BSON( "a" << 1 ), false, "testIndex", false, false, 2 );
+        }
+        ~MergeSparseBuckets() {
+            _c.dropCollection( ns() );
+        }
+        void run() {
+            IndexDetails& id = nsdetails( ns() )->idx( 1 );
+            ASSERT_EQUALS( 2, id.version() );
+            Ordering order = Ordering::make( id.keyPattern() );
+            const int nKeys = 5000;
+            for( int i = 0; i < nKeys; ++i ) {
+                BSONObj k = key( i );
+                id.head.btree<V2>()->bt_insert( id.head, DiskLoc( 0, 2 ), k, order, true, id,
+                                                true );
+                getDur().commitIfNeeded();
+            }
+            string indexNs = id.indexNamespace();
+            long long fullBuckets = nsdetails( indexNs )->numRecords();
+            ASSERT( fullBuckets > 10 );
+
+            // Keep one key in ten, so that no bucket is emptied.
+            for( int i = 0; i < nKeys; ++i ) {
+                if ( i % 10 == 0 ) {
+                    continue;
+                }
+                BSONObj k = key( i );
+                ASSERT( id.head.btree<V2>()->unindex( id.head, id, k, DiskLoc( 0, 2 ) ) );
+                getDur().commitIfNeeded();
+            }
+            ASSERT_EQUALS( nKeys / 10,
+                           id.head.btree<V2>()->fullValidate( id.head, id.keyPattern(), 0,
+                                                              true ) );
+            ASSERT( nsdetails( indexNs )->numRecords() < fullBuckets / 2 );
+        }
+    private:
+        static BSONObj key( int i ) {
+            stringstream ss;
+            ss << "/projects/alpha/documents/2013/07/report-" << i * 7919 % 5000;
+            return BSON( "" << ss.str() );
+        }
+        Lock::GlobalWrite _lk;
+        Client::Context _context;
+        DBDirectClient _c;
+    };
+
+    class All : public Suite {
+    public:
+        All() : Suite( "btree2" ) {
+        }
+        void setupTests() {
+            add< MergeSparseBuckets >();
+        }
+    } myall;
+
+}
@@ -123,6 +123,32 @@ namespace ExtSortTests {
         }
     };
 
+    /** Merge the values sorted by several sorters, one of them on disk, with adopt(). */
+    class Adopt {
+    public:
+        void run() {
+            BSONObjExternalSorter sorter( _aFirstSort );
+            BSONObjExternalSorter spilled( _aFirstSort, 10 );
+            BSONObjExternalSorter empty( _aFirstSort );
+            int32_t nDocs = 100;
+            for( int32_t i = 0; i < nDocs; ++i ) {
+                // A permutation of 0 .. nDocs - 1.
+                BSONObj key = BSON( "" << ( i * 37 % nDocs ) );
+                ( i % 3 ? sorter : spilled ).add( key, DiskLoc( 0, i ), false );
+            }
+            sorter.adopt( spilled );
+            sorter.adopt( empty );
+            ASSERT( sorter.numFiles() > 0 );
+            sorter.sort( false );
+            auto_ptr<BSONObjExternalSorter::Iterator> i = sorter.iterator();
+            int32_t expectedKey = 0;
+            while( i->more() ) {
+                ASSERT_EQUALS( BSON( "" << expectedKey++ ), i->next().first );
+            }
+            ASSERT_EQUALS( nDocs, expectedKey );
+        }
+    };
+
     /** Check sorting by disk location. */
     class SortByDiskLock {
     public:
@@ -861,6 +887,7 @@ namespace ExtSortTests {
             add<SortFour>();
             add<SortFourCheckDiskLoc>();
             add<SortNone>();
+            add<Adopt>();
             add<SortByDiskLock>();
             add<Sort1e4>();
             add<Sort1e5>();
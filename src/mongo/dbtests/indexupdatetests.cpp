@@ -22,6 +22,8 @@
 #include "mongo/db/btreecursor.h"
 #include "mongo/db/dbhelpers.h"
 #include "mongo/db/index/btree_based_builder.h"
+#include "mongo/db/index/unique_key_filter.h"
+#include "mongo/db/key_string.h"
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/db/sort_phase_one.h"
@@ -97,6 +99,16 @@ namespace IndexUpdateTests {
                                                  nsdetails(_ns)->idxNo(id) );
             // Keys for all documents were added to phaseOne.
             ASSERT_EQUALS( static_cast<uint64_t>( nDocs ), phaseOne.n );
+            // The keys of a v:1 index are sorted as KeyStrings, and come back in key order.
+            ASSERT( phaseOne.keyStringOrdering );
+            phaseOne.sorter->sort( false );
+            auto_ptr<BSONObjExternalSorter::Iterator> i = phaseOne.sorter->iterator();
+            int32_t expected = 0;
+            while( i->more() ) {
+                ASSERT_EQUALS( BSON( "" << expected ), KeyString::fromSortKey( i->next().first ) );
+                ++expected;
+            }
+            ASSERT_EQUALS( nDocs, expected );
         }
     };
 
@@ -523,6 +535,161 @@ namespace IndexUpdateTests {
         }
     };
 
+    /**
+     * A foreground build orders keys that compare equal but differ in type, such as 1.0,
+     * NumberInt(1) and NumberLong(1), by record location as the btree does, so each of them
+     * can be found and unindexed.
+     */
+    class BuildEqualKeysOfDifferentTypes : public IndexBuildBase {
+    public:
+        void run() {
+            int32_t nDocs = 300;
+            for( int32_t i = 0; i < nDocs; ++i ) {
+                switch( i % 3 ) {
+                case 0: _client.insert( _ns, BSON( "_id" << i << "a" << 1.0 ) ); break;
+                case 1: _client.insert( _ns, BSON( "_id" << i << "a" << 1 ) ); break;
+                default: _client.insert( _ns, BSON( "_id" << i << "a" << 1LL ) ); break;
+                }
+            }
+            _client.ensureIndex( _ns, BSON( "a" << 1 ) );
+            ASSERT_EQUALS( nDocs, keys() );
+
+            // Removing each document takes its key out of the index.
+            for( int32_t i = 0; i < nDocs; ++i ) {
+                _client.remove( _ns, BSON( "_id" << i ) );
+                ASSERT_EQUALS( nDocs - i - 1, keys() );
+            }
+            ASSERT_EQUALS( 0, _client.query( _ns, Query().hint( BSON( "a" << 1 ) ) )->itcount() );
+        }
+    private:
+        /** @return the number of keys of the a_1 index, after checking that it validates */
+        int keys() {
+            BSONObj result;
+            ASSERT( _client.runCommand( "unittests",
+                                        BSON( "validate" << "indexupdate" << "full" << true ),
+                                        result ) );
+            ASSERT( result[ "valid" ].trueValue() );
+            return result[ "keysPerIndex" ][ string( _ns ) + ".$a_1" ].numberInt();
+        }
+    };
+
+    /** DataFileMgr::insertIndexes() builds the indexes of a collection together. */
+    class InsertIndexes : public IndexBuildBase {
+    public:
+        void run() {
+            // Insert some documents.
+            int32_t nDocs = 1000;
+            for( int32_t i = 0; i < nDocs; ++i ) {
+                _client.insert( _ns, BSON( "a" << i << "b" << BSON_ARRAY( i << i + 1 ) <<
+                                           "c" << i % 10 ) );
+            }
+            vector<BSONObj> specs;
+            specs.push_back( BSON( "key" << BSON( "a" << 1 ) << "ns" << _ns << "name" << "a_1" <<
+                                   "unique" << true ) );
+            specs.push_back( BSON( "key" << BSON( "b" << 1 ) << "ns" << _ns << "name" << "b_1" ) );
+            specs.push_back( BSON( "key" << BSON( "c" << -1 ) << "ns" << _ns <<
+                                   "name" << "c_-1" ) );
+            // Already in the batch.
+            specs.push_back( BSON( "key" << BSON( "a" << 1 ) << "ns" << _ns << "name" << "a_1" <<
+                                   "unique" << true ) );
+            theDataFileMgr.insertIndexes( "unittests.system.indexes", specs, false, false );
+
+            // The three new indexes are complete, and only b_1 is multikey.
+            NamespaceDetails* nsd = nsdetails( _ns );
+            ASSERT_EQUALS( 4, nsd->getCompletedIndexCount() );
+            ASSERT_EQUALS( 4, nsd->getTotalIndexCount() );
+            ASSERT( !nsd->isMultikey( nsd->findIndexByName( "a_1" ) ) );
+            ASSERT( nsd->isMultikey( nsd->findIndexByName( "b_1" ) ) );
+            ASSERT( !nsd->isMultikey( nsd->findIndexByName( "c_-1" ) ) );
+            ASSERT_EQUALS( 4U, _client.count( "unittests.system.indexes", BSON( "ns" << _ns ) ) );
+
+            // Each has the keys of every document.
+            ASSERT_EQUALS( 1, itcount( BSON( "a" << 5 ), BSON( "a" << 1 ) ) );
+            ASSERT_EQUALS( 2, itcount( BSON( "b" << 5 ), BSON( "b" << 1 ) ) );
+            ASSERT_EQUALS( nDocs / 10, itcount( BSON( "c" << 5 ), BSON( "c" << -1 ) ) );
+        }
+    private:
+        int itcount( const BSONObj& query, const BSONObj& hint ) {
+            return _client.query( _ns, Query( query ).hint( hint ) )->itcount();
+        }
+    };
+
+    /** An index DataFileMgr::insertIndexes() fails to build leaves none of the others built. */
+    class InsertIndexesFailure : public IndexBuildBase {
+    public:
+        void run() {
+            // Insert some documents.
+            int32_t nDocs = 1000;
+            for( int32_t i = 0; i < nDocs; ++i ) {
+                _client.insert( _ns, BSON( "a" << i << "c" << i % 10 ) );
+            }
+            vector<BSONObj> specs;
+            specs.push_back( BSON( "key" << BSON( "a" << 1 ) << "ns" << _ns << "name" << "a_1" ) );
+            // The documents have duplicate c values.
+            specs.push_back( BSON( "key" << BSON( "c" << 1 ) << "ns" << _ns << "name" << "c_1" <<
+                                   "unique" << true ) );
+            ASSERT_THROWS( theDataFileMgr.insertIndexes( "unittests.system.indexes",
+                                                         specs,
+                                                         false,
+                                                         false ),
+                           UserException );
+
+            // Only the _id index is left.
+            NamespaceDetails* nsd = nsdetails( _ns );
+            ASSERT_EQUALS( 1, nsd->getCompletedIndexCount() );
+            ASSERT_EQUALS( 1, nsd->getTotalIndexCount() );
+            ASSERT_EQUALS( 1U, _client.count( "unittests.system.indexes", BSON( "ns" << _ns ) ) );
+        }
+    };
+
+    /** Keys equal in a btree have the same UniqueKeyFilter hash. */
+    class UniqueKeyFilterHash {
+    public:
+        void run() {
+            BSONObj fives[] = { BSON( "" << 5 ), BSON( "a" << 5LL ), BSON( "b" << 5.0 ) };
+            for( int i = 0; i < 3; ++i ) {
+                ASSERT_EQUALS( UniqueKeyFilter::hash( fives[ 0 ] ),
+                               UniqueKeyFilter::hash( fives[ i ] ) );
+            }
+            ASSERT_EQUALS( UniqueKeyFilter::hash( BSON( "" << 0.0 ) ),
+                           UniqueKeyFilter::hash( BSON( "" << -0.0 ) ) );
+            ASSERT_EQUALS( UniqueKeyFilter::hash( BSON( "" << BSON( "x" << 1 ) << "" << "s" ) ),
+                           UniqueKeyFilter::hash( BSON( "" << BSON( "x" << 1.0 ) <<
+                                                        "" << "s" ) ) );
+            // Field names count inside a key.
+            ASSERT_NOT_EQUALS( UniqueKeyFilter::hash( BSON( "" << BSON( "x" << 1 ) ) ),
+                               UniqueKeyFilter::hash( BSON( "" << BSON( "y" << 1 ) ) ) );
+            ASSERT_NOT_EQUALS( UniqueKeyFilter::hash( BSON( "" << 5 ) ),
+                               UniqueKeyFilter::hash( BSON( "" << "5" ) ) );
+            ASSERT_NOT_EQUALS( UniqueKeyFilter::hash( BSON( "" << 5 << "" << 6 ) ),
+                               UniqueKeyFilter::hash( BSON( "" << 6 << "" << 5 ) ) );
+        }
+    };
+
+    /** A UniqueKeyFilter holds every key added, and few others. */
+    class UniqueKeyFilterLookups {
+    public:
+        void run() {
+            int32_t nKeys = 10000;
+            UniqueKeyFilter filter( nKeys );
+            for( int32_t i = 0; i < nKeys; ++i ) {
+                filter.add( UniqueKeyFilter::hash( BSON( "" << i ) ) );
+            }
+            ASSERT_EQUALS( static_cast<size_t>( nKeys ), filter.size() );
+            ASSERT( !filter.full() );
+            int32_t falsePositives = 0;
+            for( int32_t i = 0; i < nKeys; ++i ) {
+                ASSERT( filter.mayContain( UniqueKeyFilter::hash( BSON( "" << i ) ) ) );
+                if ( filter.mayContain( UniqueKeyFilter::hash( BSON( "" << nKeys + i ) ) ) ) {
+                    ++falsePositives;
+                }
+            }
+            ASSERT_LESS_THAN( falsePositives, nKeys / 20 );
+            filter.add( UniqueKeyFilter::hash( BSON( "" << -1 ) ) );
+            ASSERT( filter.full() );
+        }
+    };
+
     class IndexBuildInProgressTest : public IndexBuildBase {
     public:
         void run() {
@@ -749,6 +916,11 @@ namespace IndexUpdateTests {
             add<InsertBuildIdIndexInterruptDisallowed>();
             add<DirectClientEnsureIndexInterruptDisallowed>();
             add<HelpersEnsureIndexInterruptDisallowed>();
+            add<BuildEqualKeysOfDifferentTypes>();
+            add<InsertIndexes>();
+            add<InsertIndexesFailure>();
+            add<UniqueKeyFilterHash>();
+            add<UniqueKeyFilterLookups>();
             add<IndexBuildInProgressTest>();
             add<SameSpecDifferentOption>();
             add<SameSpecSameOptions>();
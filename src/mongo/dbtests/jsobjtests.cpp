@@ -72,6 +72,15 @@ namespace JsobjTests {
                 cout << r3 << endl;
             }
             ASSERT(ok);
+            {
+                // a btree search may decide on searchPrefix() alone when they differ
+                unsigned p = k.searchPrefix();
+                unsigned pLast = kLast->searchPrefix();
+                if( p && pLast && p != pLast ) {
+                    ASSERT( r2 != 0 );
+                    ASSERT( ( p < pLast ) == ( r2 < 0 ) );
+                }
+            }
             if( k.isCompactFormat() && kLast->isCompactFormat() ) { // only check if not bson as bson woEqual is broken! (or was may2011)
                 if( k.woEqual(*kLast) != (r2 == 0) ) { // check woEqual matches
                     cout << r2 << endl;
@@ -2099,6 +2099,174 @@ namespace NamespaceTests {
             virtual string spec() const { return ""; }
         };
         
+        /**
+         * With Flag_SegregatedFitAlloc, a too small deleted record in the requested size's bucket
+         * is skipped and the head of a larger bucket is used instead.
+         */
+        class AllocSegregatedFitUsesLargerBucket : public Base {
+        public:
+            void run() {
+                create();
+                ASSERT( nsd()->setUserFlag( NamespaceDetails::Flag_SegregatedFitAlloc ) );
+
+                // Carve a 299 byte deleted record out of the extent's deleted record.
+                DiskLoc small = nsd()->alloc( ns(), 300 );
+                ASSERT( !small.isNull() );
+                getDur().writingInt( small.drec()->lengthWithHeaders() ) = 299;
+                nsd()->addDeletedRec( small.drec(), small );
+                ASSERT_EQUALS( small, smallestDeletedRecord() );
+
+                DiskLoc expectedLocation = nsd()->allocWillBeAt( ns(), 300 );
+                DiskLoc actualLocation = nsd()->alloc( ns(), 300 );
+                ASSERT_EQUALS( expectedLocation, actualLocation );
+                ASSERT_NOT_EQUALS( small, actualLocation );
+                ASSERT_EQUALS( 320, actualLocation.rec()->lengthWithHeaders() );
+
+                // The too small deleted record is left in place.
+                ASSERT_EQUALS( small, smallestDeletedRecord() );
+            }
+            virtual string spec() const { return ""; }
+        };
+
+        /** With Flag_SegregatedFitAlloc, allocation fails if no deleted record is large enough. */
+        class AllocSegregatedFitFailsWithTooSmallDeletedRecord : public Base {
+        public:
+            void run() {
+                create();
+                ASSERT( nsd()->setUserFlag( NamespaceDetails::Flag_SegregatedFitAlloc ) );
+                cookDeletedList( 299 );
+                ASSERT( nsd()->allocWillBeAt( ns(), 300 ).isNull() );
+                ASSERT( nsd()->alloc( ns(), 300 ).isNull() );
+            }
+            virtual string spec() const { return ""; }
+        };
+
+        /**
+         * With Flag_HotPlacement, a fitting deleted record is used and the placement is counted
+         * in the record stats.
+         */
+        class AllocHotPlacement : public Base {
+        public:
+            void run() {
+                create();
+                ASSERT( nsd()->setUserFlag( NamespaceDetails::Flag_HotPlacement ) );
+                long long placementsBefore = placements();
+
+                DiskLoc expectedLocation = nsd()->allocWillBeAt( ns(), 300 );
+                ASSERT( !expectedLocation.isNull() );
+                // Only looking up the location isn't counted.
+                ASSERT_EQUALS( placementsBefore, placements() );
+
+                DiskLoc actualLocation = nsd()->alloc( ns(), 300 );
+                ASSERT_EQUALS( expectedLocation, actualLocation );
+                ASSERT_EQUALS( placementsBefore + 1, placements() );
+            }
+            virtual string spec() const { return ""; }
+        private:
+            static long long placements() {
+                BSONObjBuilder b;
+                Record::appendStats( b );
+                BSONObj stats = b.obj();
+                return stats[ "residentPlacements" ].numberLong() +
+                       stats[ "nonResidentPlacements" ].numberLong();
+            }
+        };
+
+        /** Replaces the residency check of hot placement for the life of the object. */
+        class HotPlacementResidency {
+        public:
+            HotPlacementResidency( bool (*residency)( const char* ) ) :
+                _old( NamespaceDetails::hotPlacementResidency ) {
+                NamespaceDetails::hotPlacementResidency = residency;
+            }
+            ~HotPlacementResidency() {
+                NamespaceDetails::hotPlacementResidency = _old;
+            }
+        private:
+            bool (*_old)( const char* );
+        };
+
+        DiskLoc residentDeletedRecord;
+        bool onlyResidentDeletedRecord( const char* data ) {
+            return data == reinterpret_cast<const char*>( residentDeletedRecord.drec() );
+        }
+
+        /**
+         * With Flag_HotPlacement, a resident deleted record is preferred to a better fitting one
+         * of the same bucket.
+         */
+        class AllocHotPlacementPrefersResident : public Base {
+        public:
+            void run() {
+                create();
+
+                // Carve 400 and 350 byte deleted records out of the extent's deleted record.
+                DiskLoc larger = nsd()->alloc( ns(), 400 );
+                DiskLoc smaller = nsd()->alloc( ns(), 350 );
+                ASSERT( !larger.isNull() );
+                ASSERT( !smaller.isNull() );
+                ASSERT_EQUALS( NamespaceDetails::bucket( 400 ), NamespaceDetails::bucket( 350 ) );
+                nsd()->addDeletedRec( larger.drec(), larger );
+                nsd()->addDeletedRec( smaller.drec(), smaller );
+
+                ASSERT( nsd()->setUserFlag( NamespaceDetails::Flag_HotPlacement ) );
+                residentDeletedRecord = larger;
+                HotPlacementResidency residency( onlyResidentDeletedRecord );
+
+                DiskLoc expectedLocation = nsd()->allocWillBeAt( ns(), 300 );
+                DiskLoc actualLocation = nsd()->alloc( ns(), 300 );
+                ASSERT_EQUALS( expectedLocation, actualLocation );
+                ASSERT_EQUALS( larger, actualLocation );
+                ASSERT_EQUALS( smaller, nsd()->deletedListEntry( NamespaceDetails::bucket( 350 ) ) );
+            }
+            virtual string spec() const { return ""; }
+        };
+
+        /**
+         * With Flag_HotPlacement, a resident deleted record of a larger bucket is not preferred to
+         * a fitting one that is not resident.
+         */
+        class AllocHotPlacementStaysInBucket : public Base {
+        public:
+            void run() {
+                create();
+
+                // Carve a 350 byte deleted record out of the extent's deleted record, which is left
+                // in a larger bucket.
+                DiskLoc small = nsd()->alloc( ns(), 350 );
+                ASSERT( !small.isNull() );
+                nsd()->addDeletedRec( small.drec(), small );
+
+                ASSERT( nsd()->setUserFlag( NamespaceDetails::Flag_HotPlacement ) );
+                residentDeletedRecord = DiskLoc();
+                for( int i = NamespaceDetails::bucket( 350 ) + 1; i < Buckets; ++i ) {
+                    if ( !nsd()->deletedListEntry( i ).isNull() ) {
+                        residentDeletedRecord = nsd()->deletedListEntry( i );
+                        break;
+                    }
+                }
+                ASSERT( !residentDeletedRecord.isNull() );
+                HotPlacementResidency residency( onlyResidentDeletedRecord );
+
+                DiskLoc actualLocation = nsd()->alloc( ns(), 300 );
+                ASSERT_EQUALS( small, actualLocation );
+            }
+            virtual string spec() const { return ""; }
+        };
+
+        /** With Flag_HotPlacement, allocation fails if no deleted record is large enough. */
+        class AllocHotPlacementFailsWithTooSmallDeletedRecord : public Base {
+        public:
+            void run() {
+                create();
+                ASSERT( nsd()->setUserFlag( NamespaceDetails::Flag_HotPlacement ) );
+                cookDeletedList( 299 );
+                ASSERT( nsd()->allocWillBeAt( ns(), 300 ).isNull() );
+                ASSERT( nsd()->alloc( ns(), 300 ).isNull() );
+            }
+            virtual string spec() const { return ""; }
+        };
+
         /* test  NamespaceDetails::cappedTruncateAfter(const char *ns, DiskLoc loc)
         */
         class TruncateCapped : public Base {
@@ -2431,6 +2599,12 @@ namespace NamespaceTests {
             add< NamespaceDetailsTests::AllocQuantizedWithoutExtra >();
             add< NamespaceDetailsTests::AllocNotQuantizedNearDeletedSize >();
             add< NamespaceDetailsTests::AllocFailsWithTooSmallDeletedRecord >();
+            add< NamespaceDetailsTests::AllocSegregatedFitUsesLargerBucket >();
+            add< NamespaceDetailsTests::AllocSegregatedFitFailsWithTooSmallDeletedRecord >();
+            add< NamespaceDetailsTests::AllocHotPlacement >();
+            add< NamespaceDetailsTests::AllocHotPlacementPrefersResident >();
+            add< NamespaceDetailsTests::AllocHotPlacementStaysInBucket >();
+            add< NamespaceDetailsTests::AllocHotPlacementFailsWithTooSmallDeletedRecord >();
             add< NamespaceDetailsTests::TwoExtent >();
             add< NamespaceDetailsTests::TruncateCapped >();
             add< NamespaceDetailsTests::Migrate >();
@@ -53,6 +53,8 @@ public:
     virtual ~InsertAndRemoveStrategy() {}
     virtual BSONObj insertObj() = 0;
     virtual BSONObj removeObj() = 0;
+    /** @return a spec for a single document lookup, or an empty object if not supported */
+    virtual BSONObj lookupObj() { return BSONObj(); }
 protected:
     /**
      * Helper functions for converting a sample value to a sample object with
@@ -168,6 +170,8 @@ class InsertAndRangedRemoveStrategy : public InsertAndRemoveStrategy {
 public:
     virtual BSONObj insertObj() { return insertObjWithVal( insertVal() ); }
     virtual BSONObj removeObj() { return rangedRemoveObjWithVal( removeVal() ); }
+    /** The first document at or after a removal key, found without removing it. */
+    virtual BSONObj lookupObj() { return rangedRemoveObjWithVal( removeVal() ); }
 protected:
     /** Small likelihood that this removal spec will not match any document */
     template< class U >
@@ -248,6 +252,45 @@ private:
     UniformInsertRangedUniformRemoveString _gen;
 };
 
+/**
+ * Path String Keys, e.g. "/tenant0042/project07/docs/2013/07/qhzkvw"
+ * Uniform Inserts
+ * Uniform Removes
+ *
+ * Neighboring keys share long prefixes, as the keys of a {tenant:1, path:1} style index do.
+ * Compare the index size with indexVersion 1 and 2 below.
+ */
+class UniformInsertRangedUniformRemovePath : public InsertAndRangedRemoveStrategy< string > {
+public:
+    UniformInsertRangedUniformRemovePath() :
+        _uniform_tenant( 0, 99 ),
+        _nextTenant( randomNumberGenerator, _uniform_tenant ),
+        _uniform_project( 0, 9 ),
+        _nextProject( randomNumberGenerator, _uniform_project ),
+        _uniform_char( 'a', 'z' ),
+        _nextChar( randomNumberGenerator, _uniform_char ) {
+    }
+    /** Small likelihood of duplicates */
+    virtual string insertVal() { return nextPath(); }
+    virtual string removeVal() { return nextPath(); }
+private:
+    string nextPath() {
+        char prefix[ 64 ];
+        sprintf( prefix, "/tenant%04d/project%02d/docs/2013/07/", _nextTenant(), _nextProject() );
+        string ret( prefix );
+        for( int i = 0; i < 6; ++i ) {
+            ret += _nextChar();
+        }
+        return ret;
+    }
+    uniform_int< int > _uniform_tenant;
+    variate_generator< mt19937&, uniform_int< int > > _nextTenant;
+    uniform_int< int > _uniform_project;
+    variate_generator< mt19937&, uniform_int< int > > _nextProject;
+    uniform_int< char > _uniform_char;
+    variate_generator< mt19937&, uniform_int< char > > _nextChar;
+};
+
 /**
  * OID Keys
  * Increasing Inserts
@@ -404,21 +447,34 @@ int main( int argc, const char **argv ) {
     conn.connect( "127.0.0.1:27017" );
     conn.dropCollection( ns );
 
+    // Version of the _id index under test: 1, or 2 for prefix compressed buckets.
+    const int indexVersion = 1;
+    if ( indexVersion != 1 ) {
+        BSONObj info;
+        conn.runCommand( db, BSON( "create" << "btreeperf" << "autoIndexId" << false ), info );
+        conn.insert( "test.system.indexes",
+                     BSON( "ns" << ns << "key" << BSON( "_id" << 1 ) << "name" << "_id_" <<
+                           "unique" << true << "v" << indexVersion ) );
+    }
+
 //    UniformInsertRangedUniformRemoveInteger strategy;
 //    UniformInsertUniformRemoveInteger strategy;
 //    UniformInsertRangedUniformRemoveString strategy;
 //    UniformInsertUniformRemoveString strategy;
+//    UniformInsertRangedUniformRemovePath strategy;
 //    IncreasingInsertRangedUniformRemoveOID strategy;
 //    IncreasingInsertUniformRemoveOID strategy;
 //    IncreasingInsertIncreasingRemoveInteger strategy;
 //    InsertAndRemoveScriptGenerator runner( strategy, 5 );
     InsertAndRemoveScriptRunner runner( conn );
+    // Lookups timed with each line of statistics, when running a strategy directly.
+    InsertAndRemoveStrategy *lookupStrategy = 0; // &strategy;
 
     Timer t;
     BSONObj statsCmd = BSON( "collstats" << index_collection );
 
     // Print header, unless we are generating a script (in that case, comment this out).
-    cout << "ops,milliseconds,docs,totalBucketSize" << endl;
+    cout << "ops,milliseconds,docs,totalBucketSize,lookupMicros" << endl;
 
     long long i = 0;
     long long n = 10000000000;
@@ -436,7 +492,17 @@ int main( int argc, const char **argv ) {
             // The total number of bytes used for all allocated 8K buckets of the
             // btree.
             long long totalBucketSize = result.getField( "count" ).numberLong() * 8192;
-            cout << i << ',' << t.millis() << ',' << docs << ',' << totalBucketSize << endl;
+            // The time taken by 1000 lookups through the index.
+            long long lookupMicros = 0;
+            if ( lookupStrategy ) {
+                Timer lookupTimer;
+                for( int j = 0; j < 1000; ++j ) {
+                    conn.findOne( ns, Query( lookupStrategy->lookupObj() ).hint( BSON( "_id" << 1 ) ) );
+                }
+                lookupMicros = lookupTimer.micros();
+            }
+            cout << i << ',' << t.millis() << ',' << docs << ',' << totalBucketSize << ','
+                 << lookupMicros << endl;
         }
     }
 }
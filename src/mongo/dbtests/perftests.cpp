@@ -29,6 +29,7 @@
 #include <fstream>
 
 #include "mongo/db/db.h"
+#include "mongo/db/dur_journalformat.h"
 #include "mongo/db/dur_stats.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/json.h"
@@ -40,6 +41,7 @@
 #include "mongo/util/compress.h"
 #include "mongo/util/concurrency/qlock.h"
 #include "mongo/util/fail_point.h"
+#include "mongo/util/mmap.h"
 #include "mongo/util/timer.h"
 #include "mongo/util/version.h"
 
@@ -787,6 +789,87 @@ namespace PerfTests {
         virtual bool showDurStats() { return false; }
     };
 
+    struct MapDefault {
+        static string name() { return "default"; }
+        static MemoryMappedFile::MapPolicy policy() { return MemoryMappedFile::MapPolicy(); }
+    };
+    struct MapHugePages {
+        static string name() { return "hugepages"; }
+        static MemoryMappedFile::MapPolicy policy() {
+            MemoryMappedFile::MapPolicy p;
+            p.hugePages = true;
+            return p;
+        }
+    };
+    struct MapInterleave {
+        static string name() { return "interleave"; }
+        static MemoryMappedFile::MapPolicy policy() {
+            MemoryMappedFile::MapPolicy p;
+            p.numa = MemoryMappedFile::MapPolicy::NumaInterleave;
+            return p;
+        }
+    };
+    struct MapBindNode0 {
+        static string name() { return "bind0"; }
+        static MemoryMappedFile::MapPolicy policy() {
+            MemoryMappedFile::MapPolicy p;
+            p.numa = MemoryMappedFile::MapPolicy::NumaBind;
+            return p;
+        }
+    };
+
+    /**
+     * random 8 byte reads from a mapped file, with the file mapped under the MapPolicy of P.
+     * every page is faulted in first, so what is timed is the TLB and the node the pages are
+     * on, not IO.  with PrivateView the reads go to a private view all of whose pages were
+     * written, as the journal's private view is.
+     */
+    template< class P, bool PrivateView >
+    class MmapRandomRead : public B {
+    public:
+        MmapRandomRead() : _view( 0 ), _seed( 1 ) { }
+        string name() {
+            return string( "mmap-random-read-" ) + P::name() + ( PrivateView ? "-private" : "" );
+        }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        virtual unsigned batchSize() { return 1000; }
+        void prep() {
+            _oldPolicy = MemoryMappedFile::getMapPolicy();
+            MemoryMappedFile::setMapPolicy( P::policy() );
+            _path = dbpath + "/perftest_mmap.dat";
+            boost::filesystem::remove( _path );
+            _view = static_cast<char*>( _mmf.create( _path, Length, true ) );
+            ASSERT( _view );
+            if ( PrivateView ) {
+                _view = static_cast<char*>( _mmf.createPrivateMap() );
+                ASSERT( _view );
+                for ( unsigned long long ofs = 0; ofs < Length; ofs += g_minOSPageSizeBytes )
+                    _view[ofs] = 1;
+            }
+        }
+        void timed() {
+            _seed = _seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            unsigned long long ofs = ( _seed >> 16 ) % Length & ~7ULL;
+            dontOptimizeOutHopefully += *reinterpret_cast<unsigned*>( _view + ofs );
+        }
+        void post() {
+            {
+                LockMongoFilesExclusive lk;
+                _mmf.close();
+            }
+            boost::filesystem::remove( _path );
+            MemoryMappedFile::setMapPolicy( _oldPolicy );
+        }
+    private:
+        static const unsigned long long Length = 256 * 1024 * 1024;
+        MemoryMappedFile::MapPolicy _oldPolicy;
+        MemoryMappedFile _mmf;
+        string _path;
+        char* _view;
+        unsigned long long _seed;
+    };
+
     // test thread local speed
 #if defined(_WIN32)
     __declspec( thread ) int x;
@@ -1096,6 +1179,86 @@ namespace PerfTests {
         }
     };
 
+    /**
+     * inserts of 100 documents per message into a collection with one secondary index,
+     * through DataFileMgr::insertBatch() or document by document.
+     */
+    template< bool FastPath >
+    class InsertBatch : public B {
+    public:
+        InsertBatch() : _i( 0 ) { }
+        virtual int howLongMillis() { return profiling ? 30000 : 5000; }
+        virtual unsigned batchSize() { return 10; }
+        string name() { return FastPath ? "insert-batch100-fastpath" : "insert-batch100"; }
+        void prep() {
+            // the fast path only takes existing collections
+            client().insert( ns(), BSONObj() );
+            client().ensureIndex( ns(), BSON( "x" << 1 ) );
+            setFastPath( FastPath );
+        }
+        void timed() {
+            vector<BSONObj> docs;
+            for ( int j = 0; j < 100; j++ ) {
+                docs.push_back( BSON( "_id" << _i++ << "x" << rand() << "y" << "abcdefghij" ) );
+            }
+            client().insert( ns(), docs );
+        }
+        void post() {
+            setFastPath( true );
+        }
+    private:
+        void setFastPath( bool on ) {
+            BSONObj res;
+            ASSERT( client().runCommand( "admin",
+                                         BSON( "setParameter" << 1 << "bulkInsertFastPath" << on ),
+                                         res ) );
+        }
+        long long _i;
+    };
+
+    /**
+     * journaled inserts, each batch waiting for its group commit, with the journal written
+     * with a given codec.  the durStats reported show the journal size (journaledMB, compression).
+     */
+    template< dur::JSectCodec Codec >
+    class JournalCodec : public B {
+    public:
+        JournalCodec() : _i( 0 ) { }
+        virtual unsigned batchSize() { return 1; }
+        string name() { return string( "journal-codec-" ) + codecName(); }
+        void prep() {
+            client().insert( ns(), BSONObj() );
+            client().ensureIndex( ns(), BSON( "x" << 1 ) );
+            setParameters( codecName(), 0 );
+        }
+        void timed() {
+            for ( int j = 0; j < 20; j++ ) {
+                client().insert( ns(), BSON( "_id" << _i++ << "x" << rand() << 
+                                             "s" << "journal bytes journal bytes journal bytes" ) );
+            }
+            client().getLastError( /*fsync*/false, /*j*/true );
+        }
+        void post() {
+            setParameters( "snappy", -1 );
+        }
+    private:
+        static const char* codecName() {
+            switch ( Codec ) {
+            case dur::JSectCodec_None: return "none";
+            case dur::JSectCodec_Zstd: return "zstd";
+            default: return "snappy";
+            }
+        }
+        void setParameters( const char *codec, int maxWaitMs ) {
+            BSONObj res;
+            ASSERT( client().runCommand( "admin",
+                                         BSON( "setParameter" << 1 << "journalCompressor" << codec <<
+                                               "journalCommitMaxWaitMs" << maxWaitMs ),
+                                         res ) );
+        }
+        long long _i;
+    };
+
     /** upserts about 32k records and then keeps updating them
         2 indexes
     */
@@ -1129,6 +1292,48 @@ namespace PerfTests {
         }
     };
 
+    /** inserts of varying size into a collection whose deleted lists were fragmented by
+        deleting most of a large number of varying size documents first.  'segregatedFit'
+        selects the bounded segregated fit deleted list search (Flag_SegregatedFitAlloc)
+        instead of the default quantizeAllocationSpace() / __stdAlloc() path.
+    */
+    template <bool segregatedFit>
+    class InsertFragmented : public B {
+        string _filler;
+        unsigned _i;
+    public:
+        InsertFragmented() : _filler( 4000, 'x' ), _i( 0 ) { }
+        virtual string name() {
+            return segregatedFit ? "insert-fragmented-segregated-fit" : "insert-fragmented";
+        }
+        virtual int howLongMillis() { return profiling ? 30000 : 5000; }
+        BSONObj doc( unsigned id ) {
+            // sizes spread over several deleted list buckets
+            int len = 16 + ( ( id * 2654435761U ) >> 20 ) % ( _filler.size() - 16 );
+            return BSON( "_id" << id << "s" << _filler.substr( 0, len ) );
+        }
+        void prep() {
+            if ( segregatedFit ) {
+                BSONObj info;
+                client().createCollection( ns() );
+                ASSERT( client().runCommand( "perftest",
+                                             BSON( "collMod" << nsToCollectionSubstring( ns() ).toString()
+                                                   << "segregatedFitAlloc" << true ),
+                                             info ) );
+            }
+            const unsigned N = 100000;
+            for ( _i = 0; _i < N; _i++ )
+                client().insert( ns(), doc( _i ) );
+            // leave a third of the documents; the rest become deleted records of every size
+            client().remove( ns(),
+                             BSON( "_id" << BSON( "$not" << BSON( "$mod" << BSON_ARRAY( 3 << 0 ) ) ) ) );
+            client().getLastError();
+        }
+        void timed() {
+            client().insert( ns(), doc( _i++ ) );
+        }
+    };
+
     template <typename T>
     class MoreIndexes : public T {
     public:
@@ -1357,6 +1562,12 @@ namespace PerfTests {
             }
             else {
                 add< Dummy >();
+                add< MmapRandomRead< MapDefault, false > >();
+                add< MmapRandomRead< MapDefault, true > >();
+                add< MmapRandomRead< MapHugePages, false > >();
+                add< MmapRandomRead< MapHugePages, true > >();
+                add< MmapRandomRead< MapInterleave, false > >();
+                add< MmapRandomRead< MapBindNode0, false > >();
                 add< ChecksumTest >();
                 add< Compress >();
                 add< TLS >();
@@ -1404,9 +1615,16 @@ namespace PerfTests {
                 add< Insert1 >();
                 add< InsertRandom >();
                 add< MoreIndexes<InsertRandom> >();
+                add< InsertBatch<false> >();
+                add< InsertBatch<true> >();
+                add< JournalCodec<dur::JSectCodec_Snappy> >();
+                add< JournalCodec<dur::JSectCodec_Zstd> >();
+                add< JournalCodec<dur::JSectCodec_None> >();
                 add< Update1 >();
                 add< MoreIndexes<Update1> >();
                 add< InsertBig >();
+                add< InsertFragmented<false> >();
+                add< InsertFragmented<true> >();
                 add< FailPointTest<false, false> >();
                 add< FailPointTest<true, false> >();
                 add< FailPointTest<true, true> >();
@@ -397,9 +397,12 @@ public:
 
         if (_restoreIndexes && metadataObject.hasField("indexes")) {
             vector<BSONElement> indexes = metadataObject["indexes"].Array();
+            vector<BSONObj> indexObjs;
             for (vector<BSONElement>::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                createIndex((*it).Obj(), false);
+                indexObjs.push_back((*it).Obj());
             }
+            // in one insert, so the server builds them from one scan of the collection
+            createIndexes(indexObjs, false);
         }
     }
 
@@ -548,22 +551,34 @@ private:
        If keepCollName is true, however, we keep the same collection name that's in the index object.
      */
     void createIndex(BSONObj indexObj, bool keepCollName) {
-        BSONObjBuilder bo;
-        BSONObjIterator i(indexObj);
-        while ( i.more() ) {
-            BSONElement e = i.next();
-            if (strcmp(e.fieldName(), "ns") == 0) {
-                NamespaceString n(e.String());
-                string s = _curdb + "." + (keepCollName ? n.coll().toString() : _curcoll);
-                bo.append("ns", s);
-            }
-            else if (strcmp(e.fieldName(), "v") != 0 || _keepIndexVersion) { // Remove index version number
-                bo.append(e);
+        createIndexes(vector<BSONObj>(1, indexObj), keepCollName);
+    }
+
+    /* createIndex() for several index objects, inserted together */
+    void createIndexes(const vector<BSONObj>& indexObjs, bool keepCollName) {
+        if (indexObjs.empty()) {
+            return;
+        }
+        vector<BSONObj> specs;
+        for (vector<BSONObj>::const_iterator it = indexObjs.begin(); it != indexObjs.end(); ++it) {
+            BSONObjBuilder bo;
+            BSONObjIterator i(*it);
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                if (strcmp(e.fieldName(), "ns") == 0) {
+                    NamespaceString n(e.String());
+                    string s = _curdb + "." + (keepCollName ? n.coll().toString() : _curcoll);
+                    bo.append("ns", s);
+                }
+                else if (strcmp(e.fieldName(), "v") != 0 || _keepIndexVersion) { // Remove index version number
+                    bo.append(e);
+                }
             }
+            BSONObj o = bo.obj();
+            LOG(0) << "\tCreating index: " << o << endl;
+            specs.push_back(o);
         }
-        BSONObj o = bo.obj();
-        LOG(0) << "\tCreating index: " << o << endl;
-        conn().insert( _curdb + ".system.indexes" ,  o );
+        conn().insert( _curdb + ".system.indexes" ,  specs );
 
         // We're stricter about errors for indexes than for regular data
         BSONObj err = conn().getLastErrorDetailed(_curdb, false, false, _w);
@@ -579,7 +594,7 @@ private:
                     errCode = str::stream() << err["code"].numberInt();
                 }
 
-                error() << "Error creating index " << o["ns"].String() << ": "
+                error() << "Error creating index " << specs[0]["ns"].String() << ": "
                         << errCode << " " << err["err"] << endl;
             }
 
@@ -30,7 +30,10 @@
 
 #include "mongo/util/compress.h"
 
+#include <boost/thread/tss.hpp>
+
 #include "snappy.h"
+#include "zstd.h"
 
 namespace mongo {
 
@@ -54,4 +57,52 @@ namespace mongo {
         return snappy::Uncompress(compressed, compressed_length, uncompressed);
     }
 
+    namespace {
+        /** a zstd compression context, kept per thread as it holds megabytes of tables */
+        class ZstdCompressor {
+        public:
+            ZstdCompressor() : _cctx(ZSTD_createCCtx()) { }
+            ~ZstdCompressor() { ZSTD_freeCCtx(_cctx); }
+            ZSTD_CCtx* get() const { return _cctx; }
+        private:
+            ZSTD_CCtx* _cctx;
+        };
+
+        boost::thread_specific_ptr<ZstdCompressor> zstdCompressor;
+    }
+
+    size_t zstdMaxCompressedLength(size_t source_len) {
+        return ZSTD_compressBound(source_len);
+    }
+
+    bool zstdRawCompress(const char* input,
+        size_t input_length,
+        int level,
+        char* compressed,
+        size_t capacity,
+        size_t* compressed_length)
+    {
+        if (!zstdCompressor.get())
+            zstdCompressor.reset(new ZstdCompressor());
+        if (!zstdCompressor->get())
+            return false;
+        size_t n = ZSTD_compressCCtx(zstdCompressor->get(), compressed, capacity,
+                                     input, input_length, level);
+        if (ZSTD_isError(n))
+            return false;
+        *compressed_length = n;
+        return true;
+    }
+
+    bool zstdUncompress(const char* compressed, size_t compressed_length, std::string* uncompressed) {
+        unsigned long long len = ZSTD_getFrameContentSize(compressed, compressed_length);
+        if (len == ZSTD_CONTENTSIZE_UNKNOWN || len == ZSTD_CONTENTSIZE_ERROR)
+            return false;
+        uncompressed->resize(len);
+        if (len == 0)
+            return true;
+        size_t n = ZSTD_decompress(&(*uncompressed)[0], len, compressed, compressed_length);
+        return !ZSTD_isError(n) && n == len;
+    }
+
 }
@@ -44,6 +44,21 @@ namespace mongo {
         char* compressed,
         size_t* compressed_length);
 
+    // zstd: slower than the snappy functions above, but compresses further.  level is 1 (fastest)
+    // to 22 (smallest).
+
+    size_t zstdMaxCompressedLength(size_t source_len);
+
+    /** @return false if the output doesn't fit in 'capacity' bytes */
+    bool zstdRawCompress(const char* input,
+        size_t input_length,
+        int level,
+        char* compressed,
+        size_t capacity,
+        size_t* compressed_length);
+
+    bool zstdUncompress(const char* compressed, size_t compressed_length, std::string* uncompressed);
+
 }
 
 
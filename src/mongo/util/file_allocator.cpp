@@ -79,12 +79,24 @@ namespace mongo {
     }
 
     FileAllocator::FileAllocator()
-        : _pendingMutex("FileAllocator"), _failed() {
+        : _pendingMutex("FileAllocator"), _failed(), _numThreads(0), _filesAllocated(0),
+          _bytesAllocated(0), _allocationMicros(0), _waits(0), _waitMicros(0) {
     }
 
 
-    void FileAllocator::start() {
-        boost::thread t( boost::bind( &FileAllocator::run , this ) );
+    void FileAllocator::start( int numThreads ) {
+        {
+            // initialize unique temporary file name counter
+            // TODO: SERVER-6055 -- Unify temporary file name selection
+            SimpleMutex::scoped_lock lk(_uniqueNumberMutex);
+            _uniqueNumber = curTimeMicros64();
+        }
+        if ( numThreads < 1 )
+            numThreads = 1;
+        _numThreads = numThreads;
+        for ( int i = 0; i < numThreads; i++ ) {
+            boost::thread t( boost::bind( &FileAllocator::run , this, i ) );
+        }
     }
 
     void FileAllocator::requestAllocation( const string &name, long &size ) {
@@ -111,20 +123,38 @@ namespace mongo {
         }
         checkFailure();
         _pendingSize[ name ] = size;
-        if ( _pending.size() == 0 )
-            _pending.push_back( name );
-        else if ( _pending.front() != name ) {
+        if ( _allocating.count( name ) == 0 ) {
+            // threads take the first file they can, so this one is next
             _pending.remove( name );
-            list< string >::iterator i = _pending.begin();
-            ++i;
-            _pending.insert( i, name );
+            _pending.push_front( name );
         }
         _pendingUpdated.notify_all();
+
+        Timer t;
+        bool waited = false;
         while( inProgress( name ) ) {
             checkFailure();
             _pendingUpdated.wait( lk.boost() );
+            waited = true;
+        }
+        if ( waited ) {
+            _waits++;
+            _waitMicros += t.micros();
         }
+    }
 
+    FileAllocator::Stats FileAllocator::getStats() const {
+        scoped_lock lk( _pendingMutex );
+        Stats s;
+        s.threads = _numThreads;
+        s.pending = _pending.size();
+        s.inProgress = _allocating.size();
+        s.filesAllocated = _filesAllocated;
+        s.bytesAllocated = _bytesAllocated;
+        s.allocationMicros = _allocationMicros;
+        s.waits = _waits;
+        s.waitMicros = _waitMicros;
+        return s;
     }
 
     void FileAllocator::waitUntilFinished() const {
@@ -135,6 +165,14 @@ namespace mongo {
             _pendingUpdated.wait( lk.boost() );
     }
 
+    void FileAllocator::waitUntilFinished( const string &name ) const {
+        if ( _failed )
+            return;
+        scoped_lock lk( _pendingMutex );
+        while( inProgress( name ) )
+            _pendingUpdated.wait( lk.boost() );
+    }
+
     // TODO: pull this out to per-OS files once they exist
     static bool useSparseFiles(int fd) {
 #if defined(__linux__)
@@ -233,6 +271,22 @@ namespace mongo {
         return false;
     }
 
+    string FileAllocator::groupOf( const string &name ) {
+        // "/data/db/test.3" -> "/data/db/test"
+        size_t dot = name.rfind( '.' );
+        return dot == string::npos ? name : name.substr( 0, dot );
+    }
+
+    bool FileAllocator::nextToAllocate( string* name ) const {
+        for( list< string >::const_iterator i = _pending.begin(); i != _pending.end(); ++i ) {
+            if ( _allocating.count( *i ) == 0 && _allocatingGroups.count( groupOf( *i ) ) == 0 ) {
+                *name = *i;
+                return true;
+            }
+        }
+        return false;
+    }
+
     string FileAllocator::makeTempFileName( boost::filesystem::path root ) {
         while( 1 ) {
             boost::filesystem::path p = root / "_tmp";
@@ -254,110 +308,112 @@ namespace mongo {
         return "";
 	}
 
-    void FileAllocator::run( FileAllocator * fa ) {
-        setThreadName( "FileAllocator" );
-        {
-            // initialize unique temporary file name counter
-            // TODO: SERVER-6055 -- Unify temporary file name selection
-            SimpleMutex::scoped_lock lk(_uniqueNumberMutex);
-            _uniqueNumber = curTimeMicros64();
-        }
+    void FileAllocator::run( FileAllocator * fa, int threadNo ) {
+        if ( threadNo == 0 )
+            setThreadName( "FileAllocator" );
+        else
+            setThreadName( string( str::stream() << "FileAllocator" << threadNo ) );
         while( 1 ) {
+            string name;
+            long size;
             {
                 scoped_lock lk( fa->_pendingMutex );
-                if ( fa->_pending.size() == 0 )
+                while ( !fa->nextToAllocate( &name ) )
                     fa->_pendingUpdated.wait( lk.boost() );
+                size = fa->_pendingSize[ name ];
+                fa->_allocating.insert( name );
+                fa->_allocatingGroups.insert( groupOf( name ) );
             }
-            while( 1 ) {
-                string name;
-                long size;
-                {
-                    scoped_lock lk( fa->_pendingMutex );
-                    if ( fa->_pending.size() == 0 )
-                        break;
-                    name = fa->_pending.front();
-                    size = fa->_pendingSize[ name ];
-                }
 
-                string tmp;
-                long fd = 0;
-                try {
-                    log() << "allocating new datafile " << name << ", filling with zeroes..." << endl;
-                    
-                    boost::filesystem::path parent = ensureParentDirCreated(name);
-                    tmp = fa->makeTempFileName( parent );
-                    ensureParentDirCreated(tmp);
+            Timer t;
+            string tmp;
+            long fd = 0;
+            try {
+                log() << "allocating new datafile " << name << ", filling with zeroes..." << endl;
+                
+                boost::filesystem::path parent = ensureParentDirCreated(name);
+                tmp = fa->makeTempFileName( parent );
+                ensureParentDirCreated(tmp);
 
 #if defined(_WIN32)
-                    fd = _open( tmp.c_str(), _O_RDWR | _O_CREAT | O_NOATIME, _S_IREAD | _S_IWRITE );
+                fd = _open( tmp.c_str(), _O_RDWR | _O_CREAT | O_NOATIME, _S_IREAD | _S_IWRITE );
 #else
-                    fd = open(tmp.c_str(), O_CREAT | O_RDWR | O_NOATIME, S_IRUSR | S_IWUSR);
+                fd = open(tmp.c_str(), O_CREAT | O_RDWR | O_NOATIME, S_IRUSR | S_IWUSR);
 #endif
-                    if ( fd < 0 ) {
-                        log() << "FileAllocator: couldn't create " << name << " (" << tmp << ") " << errnoWithDescription() << endl;
-                        uasserted(10439, "");
-                    }
+                if ( fd < 0 ) {
+                    log() << "FileAllocator: couldn't create " << name << " (" << tmp << ") " << errnoWithDescription() << endl;
+                    uasserted(10439, "");
+                }
 
 #if defined(POSIX_FADV_DONTNEED)
-                    if( posix_fadvise(fd, 0, size, POSIX_FADV_DONTNEED) ) {
-                        log() << "warning: posix_fadvise fails " << name << " (" << tmp << ") " << errnoWithDescription() << endl;
-                    }
+                if( posix_fadvise(fd, 0, size, POSIX_FADV_DONTNEED) ) {
+                    log() << "warning: posix_fadvise fails " << name << " (" << tmp << ") " << errnoWithDescription() << endl;
+                }
 #endif
 
-                    Timer t;
+                /* make sure the file is the full desired length */
+                ensureLength( fd , size );
+
+                close( fd );
+                fd = 0;
+
+                if( rename(tmp.c_str(), name.c_str()) ) {
+                    const string& errStr = errnoWithDescription();
+                    const string& errMessage = str::stream()
+                            << "error: couldn't rename " << tmp
+                            << " to " << name << ' ' << errStr;
+                    msgasserted(13653, errMessage);
+                }
+                flushMyDirectory(name);
 
-                    /* make sure the file is the full desired length */
-                    ensureLength( fd , size );
+                log() << "done allocating datafile " << name << ", "
+                      << "size: " << size/1024/1024 << "MB, "
+                      << " took " << ((double)t.millis())/1000.0 << " secs"
+                      << endl;
 
+                // no longer in a failed state. allow new writers.
+                fa->_failed = false;
+            }
+            catch ( const std::exception& e ) {
+                log() << "error: failed to allocate new file: " << name
+                      << " size: " << size << ' ' << e.what()
+                      << ".  will try again in 10 seconds" << endl;
+                if ( fd > 0 )
                     close( fd );
-                    fd = 0;
-
-                    if( rename(tmp.c_str(), name.c_str()) ) {
-                        const string& errStr = errnoWithDescription();
-                        const string& errMessage = str::stream()
-                                << "error: couldn't rename " << tmp
-                                << " to " << name << ' ' << errStr;
-                        msgasserted(13653, errMessage);
-                    }
-                    flushMyDirectory(name);
-
-                    log() << "done allocating datafile " << name << ", "
-                          << "size: " << size/1024/1024 << "MB, "
-                          << " took " << ((double)t.millis())/1000.0 << " secs"
-                          << endl;
-
-                    // no longer in a failed state. allow new writers.
-                    fa->_failed = false;
+                try {
+                    if ( ! tmp.empty() )
+                        boost::filesystem::remove( tmp );
+                    boost::filesystem::remove( name );
+                } catch ( const std::exception& e ) {
+                    log() << "error removing files: " << e.what() << endl;
                 }
-                catch ( const std::exception& e ) {
-                    log() << "error: failed to allocate new file: " << name
-                          << " size: " << size << ' ' << e.what()
-                          << ".  will try again in 10 seconds" << endl;
-                    if ( fd > 0 )
-                        close( fd );
-                    try {
-                        if ( ! tmp.empty() )
-                            boost::filesystem::remove( tmp );
-                        boost::filesystem::remove( name );
-                    } catch ( const std::exception& e ) {
-                        log() << "error removing files: " << e.what() << endl;
-                    }
+                {
                     scoped_lock lk( fa->_pendingMutex );
                     fa->_failed = true;
                     // not erasing from pending
                     fa->_pendingUpdated.notify_all();
-                    
-                    
-                    sleepsecs(10);
-                    continue;
                 }
 
-                {
-                    scoped_lock lk( fa->_pendingMutex );
-                    fa->_pendingSize.erase( name );
-                    fa->_pending.pop_front();
-                    fa->_pendingUpdated.notify_all();
-                }
+                // still marked as allocating, so no other thread retries it meanwhile
+                sleepsecs(10);
+
+                scoped_lock lk( fa->_pendingMutex );
+                fa->_allocating.erase( name );
+                fa->_allocatingGroups.erase( groupOf( name ) );
+                fa->_pendingUpdated.notify_all();
+                continue;
+            }
+
+            {
+                scoped_lock lk( fa->_pendingMutex );
+                fa->_pendingSize.erase( name );
+                fa->_pending.remove( name );
+                fa->_allocating.erase( name );
+                fa->_allocatingGroups.erase( groupOf( name ) );
+                fa->_filesAllocated++;
+                fa->_bytesAllocated += size;
+                fa->_allocationMicros += t.micros();
+                fa->_pendingUpdated.notify_all();
             }
         }
     }
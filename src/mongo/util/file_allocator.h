@@ -18,6 +18,7 @@
 #include "mongo/pch.h"
 
 #include <list>
+#include <set>
 #include <boost/filesystem/path.hpp>
 #include <boost/thread/condition.hpp>
 
@@ -28,6 +29,10 @@ namespace mongo {
     /*
      * Handles allocation of contiguous files on disk.  Allocation may be
      * requested asynchronously or synchronously.
+     * Files of different databases (more precisely: of different directories
+     * or database names) are allocated in parallel, up to the number of
+     * threads started.  Files of one database are allocated one at a time,
+     * as they most likely share a disk.
      * singleton
      */
     class FileAllocator : boost::noncopyable {
@@ -37,7 +42,8 @@ namespace mongo {
          * size specified per file will be used.
         */
     public:
-        void start();
+        /** starts numThreads allocation threads */
+        void start( int numThreads = 1 );
 
         /**
          * May be called if file exists. If file exists, or its allocation has
@@ -53,11 +59,27 @@ namespace mongo {
         void allocateAsap( const string &name, unsigned long long &size );
 
         void waitUntilFinished() const;
+
+        /** Returns when file 'name' is neither pending nor being allocated. */
+        void waitUntilFinished( const string &name ) const;
         
         bool hasFailed() const;
 
         static void ensureLength(int fd, long size);
 
+        struct Stats {
+            int threads;
+            int pending;                 // requested, including those in progress
+            int inProgress;
+            long long filesAllocated;
+            long long bytesAllocated;
+            long long allocationMicros;  // time spent allocating, summed over threads
+            long long waits;             // allocateAsap() calls that had to wait
+            long long waitMicros;        // time spent waiting in allocateAsap()
+        };
+
+        Stats getStats() const;
+
         /** @return the singleton */
         static FileAllocator * get();
         
@@ -74,8 +96,15 @@ namespace mongo {
         // caller must hold pendingMutex_ lock.
         bool inProgress( const string &name ) const;
 
-        /** called from the worked thread */
-        static void run( FileAllocator * fa );
+        // caller must hold pendingMutex_ lock.  the first pending file that no
+        // thread is allocating and whose database has no allocation running.
+        bool nextToAllocate( string* name ) const;
+
+        /** files with the same group are allocated one at a time */
+        static string groupOf( const string &name );
+
+        /** called from the worker threads */
+        static void run( FileAllocator * fa, int threadNo );
 
         // generate a unique name for temporary files
         string makeTempFileName( boost::filesystem::path root );
@@ -86,6 +115,16 @@ namespace mongo {
         std::list< string > _pending;
         mutable map< string, long > _pendingSize;
 
+        std::set< string > _allocating;      // files being allocated by a thread
+        std::set< string > _allocatingGroups;
+
+        int _numThreads;
+        long long _filesAllocated;
+        long long _bytesAllocated;
+        long long _allocationMicros;
+        long long _waits;
+        long long _waitMicros;
+
         // unique number for temporary files
         static unsigned long long _uniqueNumber;
 
@@ -189,6 +189,50 @@ namespace {
         return seen.size();
     }
 
+    // where startFlushSome stopped.  the file is only compared to, it may be gone.
+    static MongoFile *flushSomeFile = 0;
+    static unsigned long long flushSomeOfs = 0;
+
+    /*static*/ unsigned long long MongoFile::startFlushSome( unsigned long long rangeBytes ) {
+        const unsigned long long Chunk = 8 * 1024 * 1024;
+        unsigned long long started = 0;
+        unsigned files = 0; // visited, so we stop when there is nothing (more) to do
+        while ( started < rangeBytes ) {
+            // a chunk at a time so files can be opened and closed in between
+            LockMongoFilesShared lk;
+            if ( files > mmfiles.size() * 2 )
+                break;
+
+            set<MongoFile*>::iterator i = mmfiles.lower_bound( flushSomeFile );
+            if ( i == mmfiles.end() )
+                i = mmfiles.begin();
+            if ( i == mmfiles.end() )
+                break;
+            if ( *i != flushSomeFile ) {
+                flushSomeFile = *i;
+                flushSomeOfs = 0;
+                files++;
+            }
+
+            MongoFile *mmf = *i;
+            unsigned long long len = mmf->length();
+            if ( flushSomeOfs < len ) {
+                unsigned long long n = std::min( Chunk, len - flushSomeOfs );
+                if ( !mmf->startFlush( flushSomeOfs, n ) )
+                    break;
+                started += n;
+                flushSomeOfs += n;
+            }
+            if ( flushSomeOfs >= len ) {
+                ++i;
+                flushSomeFile = i == mmfiles.end() ? 0 : *i;
+                flushSomeOfs = 0;
+                files++;
+            }
+        }
+        return started;
+    }
+
     void MongoFile::created() {
         LockMongoFilesExclusive lk;
         mmfiles.insert(this);
@@ -94,6 +94,14 @@ namespace mongo {
         static void (*notifyPostFlush)();
 
         static int flushAll( bool sync ); // returns n flushed
+
+        /** starts the write out of the dirty pages in about rangeBytes of the files, from where the
+            last call stopped, going round.  does not wait for the writes.  flushAll is still what
+            makes the files durable; this makes it have less to do.
+            @return the bytes of file range started, 0 if the platform can't
+        */
+        static unsigned long long startFlushSome( unsigned long long rangeBytes );
+
         static long long totalMappedLength();
         static void closeAllFiles( stringstream &message );
 
@@ -108,6 +116,8 @@ namespace mongo {
     protected:
         virtual void close() = 0;
         virtual void flush(bool sync) = 0;
+        /** start writing out the dirty pages in [ofs, ofs+len).  @return false if not supported */
+        virtual bool startFlush( unsigned long long ofs, unsigned long long len ) { return false; }
         /**
          * returns a thread safe object that you can call flush on
          * Flushable has to fail nicely if the underlying object gets killed
@@ -181,6 +191,7 @@ namespace mongo {
 
         void flush(bool sync);
         virtual Flushable * prepareFlush();
+        virtual bool startFlush( unsigned long long ofs, unsigned long long len );
 
         long shortLength() const          { return (long) len; }
         unsigned long long length() const { return len; }
@@ -199,6 +210,35 @@ namespace mongo {
         { }
 #endif
 
+        /** how the pages of views are backed.  applies to views mapped after it is set. */
+        struct MapPolicy {
+            enum Numa {
+                NumaDefault,    // whatever the process' memory policy says
+                NumaInterleave, // round robin over all nodes
+                NumaBind        // on numaNode only
+            };
+            MapPolicy() : hugePages( false ), numa( NumaDefault ), numaNode( 0 ) { }
+            bool hugePages;     // ask for transparent huge pages
+            Numa numa;
+            int numaNode;
+        };
+
+        /**
+         * sets the policy for views mapped from now on.  on linux the NUMA part is also set
+         * as the process' memory policy, which is what the page cache (so the shared views)
+         * follows.  does nothing on platforms without the support.  call early: threads
+         * started before keep the policy they had.
+         */
+        static void setMapPolicy( const MapPolicy& policy );
+        static MapPolicy getMapPolicy();
+
+        /**
+         * adds the number of pages of this file's views that are in physical memory, per NUMA
+         * node, to pagesByNode (grown as needed).
+         * @return false if not supported on this platform
+         */
+        bool residentPagesByNode( vector<long long>* pagesByNode ) const;
+
     private:
         static void updateLength( const char *filename, unsigned long long &length );
 
@@ -23,6 +23,13 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <boost/filesystem/operations.hpp>
+
 #include "mongo/db/d_concurrency.h"
 #include "mongo/util/file_allocator.h"
 #include "mongo/util/mmap.h"
@@ -39,6 +46,138 @@ namespace mongo {
     }
     const size_t g_minOSPageSizeBytes = fetchMinOSPageSizeBytes();
 
+// NUMA placement goes through the system calls directly, so that there is no dependency on
+// libnuma.  the MPOL_ values are from linux/mempolicy.h.
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_set_mempolicy) && defined(SYS_move_pages)
+#define MONGO_MMAP_NUMA 1
+    namespace {
+        const int MPolDefault = 0;
+        const int MPolBind = 2;
+        const int MPolInterleave = 3;
+
+        const int MaxNumaNodes = 1024;
+
+        struct NodeMask {
+            unsigned long bits[MaxNumaNodes / ( 8 * sizeof(unsigned long) )];
+            NodeMask() { memset( bits, 0, sizeof(bits) ); }
+            void set( int node ) {
+                bits[node / ( 8 * sizeof(unsigned long) )] |= 1UL << ( node % ( 8 * sizeof(unsigned long) ) );
+            }
+        };
+
+        /** @return 1 + the highest node number the kernel knows of, 1 without NUMA */
+        int numNumaNodes() {
+            int n = 1;
+            for ( int i = 0; i < 64; i++ ) {
+                string dir = str::stream() << "/sys/devices/system/node/node" << i;
+                if ( boost::filesystem::exists( dir ) )
+                    n = i + 1;
+            }
+            return n;
+        }
+
+        /** @return MPolDefault for NumaDefault, and then mask is left empty */
+        int numaMode( const MemoryMappedFile::MapPolicy& policy, NodeMask* mask ) {
+            switch ( policy.numa ) {
+            case MemoryMappedFile::MapPolicy::NumaInterleave:
+                for ( int i = 0; i < numNumaNodes(); i++ )
+                    mask->set( i );
+                return MPolInterleave;
+            case MemoryMappedFile::MapPolicy::NumaBind:
+                mask->set( policy.numaNode );
+                return MPolBind;
+            default:
+                return MPolDefault;
+            }
+        }
+    }
+#endif
+
+    namespace {
+        MemoryMappedFile::MapPolicy mapPolicy;
+
+        /**
+         * applies the MapPolicy to a view just mapped.  failures are only logged when
+         * 'logFailures': remapping the private view runs often and would say the same each time.
+         */
+        void applyMapPolicy( void* view, unsigned long long length, const char* filename,
+                             bool logFailures ) {
+#if defined(MADV_HUGEPAGE)
+            if ( mapPolicy.hugePages && madvise( view, length, MADV_HUGEPAGE ) && logFailures ) {
+                warning() << "map: madvise MADV_HUGEPAGE failed for " << filename << ' '
+                          << errnoWithDescription() << endl;
+            }
+#endif
+#if defined(MONGO_MMAP_NUMA)
+            NodeMask mask;
+            int mode = numaMode( mapPolicy, &mask );
+            if ( mode != MPolDefault &&
+                 syscall( SYS_mbind, view, length, mode, mask.bits, MaxNumaNodes, 0 ) &&
+                 logFailures ) {
+                warning() << "map: mbind failed for " << filename << ' '
+                          << errnoWithDescription() << endl;
+            }
+#endif
+        }
+    }
+
+    /*static*/ void MemoryMappedFile::setMapPolicy( const MapPolicy& policy ) {
+        mapPolicy = policy;
+#if !defined(MADV_HUGEPAGE)
+        if ( policy.hugePages )
+            warning() << "huge pages for mapped files are not supported on this platform" << endl;
+#endif
+#if defined(MONGO_MMAP_NUMA)
+        // the views only decide where private (copy on write) pages go.  pages of the shared
+        // view are page cache pages, which are placed by the policy of the thread faulting
+        // them in.
+        NodeMask mask;
+        int mode = numaMode( policy, &mask );
+        if ( syscall( SYS_set_mempolicy, mode, mode == MPolDefault ? NULL : mask.bits,
+                      mode == MPolDefault ? 0 : MaxNumaNodes ) ) {
+            warning() << "set_mempolicy failed: " << errnoWithDescription() << endl;
+        }
+#else
+        if ( policy.numa != MapPolicy::NumaDefault )
+            warning() << "NUMA policy for mapped files is not supported on this platform" << endl;
+#endif
+    }
+
+    /*static*/ MemoryMappedFile::MapPolicy MemoryMappedFile::getMapPolicy() {
+        return mapPolicy;
+    }
+
+    bool MemoryMappedFile::residentPagesByNode( vector<long long>* pagesByNode ) const {
+#if defined(MONGO_MMAP_NUMA)
+        // move_pages with no target nodes only reports the node of each page, and
+        // -ENOENT/-EFAULT for pages not in memory.  it does not fault them in.
+        const int Batch = 1024;
+        void* pages[Batch];
+        int status[Batch];
+        const unsigned long long numPages = ( len + g_minOSPageSizeBytes - 1 ) / g_minOSPageSizeBytes;
+        for ( vector<void*>::const_iterator i = views.begin(); i != views.end(); i++ ) {
+            char* view = static_cast<char*>( *i );
+            for ( unsigned long long first = 0; first < numPages; first += Batch ) {
+                int n = static_cast<int>( std::min<unsigned long long>( Batch, numPages - first ) );
+                for ( int j = 0; j < n; j++ )
+                    pages[j] = view + ( first + j ) * g_minOSPageSizeBytes;
+                if ( syscall( SYS_move_pages, 0, n, pages, NULL, status, 0 ) < 0 )
+                    return false;
+                for ( int j = 0; j < n; j++ ) {
+                    if ( status[j] < 0 )
+                        continue;
+                    if ( static_cast<size_t>( status[j] ) >= pagesByNode->size() )
+                        pagesByNode->resize( status[j] + 1, 0 );
+                    (*pagesByNode)[status[j]]++;
+                }
+            }
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
     MemoryMappedFile::MemoryMappedFile() {
         fd = 0;
         maphandle = 0;
@@ -135,6 +274,7 @@ namespace mongo {
             }
         }
 #endif
+        applyMapPolicy( view, length, filename, true );
 
         views.push_back( view );
 
@@ -171,6 +311,7 @@ namespace mongo {
             }
             return 0;
         }
+        applyMapPolicy( x, len, filename().c_str(), true );
 
         views.push_back(x);
         return x;
@@ -191,6 +332,7 @@ namespace mongo {
             printMemInfo();
             abort();
         }
+        applyMapPolicy( x, len, filename().c_str(), false );
         verify( x == oldPrivateAddr );
         return x;
     }
@@ -202,6 +344,19 @@ namespace mongo {
             problem() << "msync " << errnoWithDescription() << endl;
     }
 
+    bool MemoryMappedFile::startFlush( unsigned long long ofs, unsigned long long n ) {
+#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+        if ( views.empty() || fd == 0 )
+            return true;
+        // initiates the writes of the dirty pages in the range, without waiting for them
+        if ( sync_file_range( fd, ofs, n, SYNC_FILE_RANGE_WRITE ) )
+            problem() << "sync_file_range " << errnoWithDescription() << endl;
+        return true;
+#else
+        return false;
+#endif
+    }
+
     class PosixFlushable : public MemoryMappedFile::Flushable {
     public:
         PosixFlushable( void * view , HANDLE fd , long len )
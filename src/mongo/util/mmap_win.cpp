@@ -36,6 +36,23 @@ namespace mongo {
     }
     const size_t g_minOSPageSizeBytes = fetchMinOSPageSizeBytes();
 
+    namespace {
+        MemoryMappedFile::MapPolicy mapPolicy;
+    }
+
+    /*static*/ void MemoryMappedFile::setMapPolicy( const MapPolicy& policy ) {
+        if ( policy.hugePages || policy.numa != MapPolicy::NumaDefault )
+            warning() << "huge pages and NUMA policy for mapped files are not supported on windows" << endl;
+        mapPolicy = policy;
+    }
+
+    /*static*/ MemoryMappedFile::MapPolicy MemoryMappedFile::getMapPolicy() {
+        return mapPolicy;
+    }
+
+    bool MemoryMappedFile::residentPagesByNode( vector<long long>* pagesByNode ) const {
+        return false;
+    }
 
     mutex mapViewMutex("mapView");
     ourbitset writable;
@@ -404,4 +421,9 @@ namespace mongo {
         return new WindowsFlushable( viewForFlushing() , fd , filename() , _flushMutex );
     }
 
+    bool MemoryMappedFile::startFlush( unsigned long long ofs, unsigned long long len ) {
+        // not done on windows, flush() does all the writing
+        return false;
+    }
+
 }